@@ -0,0 +1,108 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <launchdarkly/api.h>
+
+#include "assertion.h"
+#include "ldinternal.h"
+#include "utility.h"
+
+#define REPETITIONS 10
+
+static const unsigned int flagCounts[]  = {1000, 10000, 40000};
+static const unsigned int threadCounts[] = {1, 2, 4, 8};
+
+/* a put of flagCount flags resembling those of a real environment */
+static char *
+makePut(const unsigned int flagCount)
+{
+    char *       payload;
+    size_t       size, offset;
+    unsigned int i;
+
+    size = 128 * (size_t)flagCount + 3;
+
+    LD_ASSERT(payload = (char *)LDAlloc(size));
+
+    offset = 0;
+
+    payload[offset++] = '{';
+
+    for (i = 0; i < flagCount; i++) {
+        offset += snprintf(
+            payload + offset,
+            size - offset,
+            "%s\"flag-%u\":{\"value\":{\"variant\":\"v%u\",\"weight\":%u},"
+            "\"version\":%u,\"variation\":%u,\"trackEvents\":%s}",
+            i ? "," : "",
+            i,
+            i % 7,
+            i % 100,
+            i + 1,
+            i % 3,
+            i % 2 ? "true" : "false");
+
+        LD_ASSERT(offset < size);
+    }
+
+    payload[offset++] = '}';
+    payload[offset]   = 0;
+
+    return payload;
+}
+
+static double
+measure(const char *const payload, const unsigned int threads)
+{
+    struct LDUser *  user;
+    struct LDConfig *config;
+    struct LDClient *client;
+    double           start, finish;
+    unsigned int     i;
+
+    LD_ASSERT(config = LDConfigNew("key"));
+    LDConfigSetOffline(config, LDBooleanTrue);
+    LDConfigSetFlagParseThreads(config, threads);
+
+    LD_ASSERT(user = LDUserNew("user"));
+
+    LD_ASSERT(client = LDClientInit(config, user, 0));
+
+    LD_ASSERT(LDi_getMonotonicMilliseconds(&start));
+
+    for (i = 0; i < REPETITIONS; i++) {
+        LD_ASSERT(LDi_onstreameventput(client, payload));
+    }
+
+    LD_ASSERT(LDi_getMonotonicMilliseconds(&finish));
+
+    LDClientClose(client);
+
+    return (finish - start) / REPETITIONS;
+}
+
+int
+main()
+{
+    size_t i, j;
+
+    printf("flags threads ms/put\n");
+
+    for (i = 0; i < sizeof(flagCounts) / sizeof(flagCounts[0]); i++) {
+        char *payload;
+
+        payload = makePut(flagCounts[i]);
+
+        for (j = 0; j < sizeof(threadCounts) / sizeof(threadCounts[0]); j++) {
+            printf(
+                "%u %u %f\n",
+                flagCounts[i],
+                threadCounts[j],
+                measure(payload, threadCounts[j]));
+        }
+
+        LDFree(payload);
+    }
+
+    return 0;
+}
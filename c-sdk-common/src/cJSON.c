@@ -169,6 +169,9 @@ internal_realloc(void *pointer, size_t size)
 static internal_hooks global_hooks = {
     internal_malloc, internal_free, internal_realloc};
 
+/* for nodes alone, when set */
+static internal_hooks node_hooks = {NULL, NULL, NULL};
+
 static unsigned char *
 cJSON_strdup(const unsigned char *string, const internal_hooks *const hooks)
 {
@@ -217,11 +220,22 @@ CJSON_PUBLIC(void) cJSON_InitHooks(cJSON_Hooks *hooks)
     }
 }
 
+CJSON_PUBLIC(void)
+cJSON_InitNodeHooks(
+    void *(CJSON_CDECL *malloc_fn)(size_t sz),
+    void(CJSON_CDECL *free_fn)(void *ptr))
+{
+    node_hooks.allocate   = malloc_fn;
+    node_hooks.deallocate = free_fn;
+}
+
 /* Internal constructor. */
 static cJSON *
 cJSON_New_Item(const internal_hooks *const hooks)
 {
-    cJSON *node = (cJSON *)hooks->allocate(sizeof(cJSON));
+    cJSON *node = (cJSON *)(node_hooks.allocate != NULL
+                                ? node_hooks.allocate(sizeof(cJSON))
+                                : hooks->allocate(sizeof(cJSON)));
     if (node) {
         memset(node, '\0', sizeof(cJSON));
     }
@@ -238,13 +252,22 @@ CJSON_PUBLIC(void) cJSON_Delete(cJSON *item)
         if (!(item->type & cJSON_IsReference) && (item->child != NULL)) {
             cJSON_Delete(item->child);
         }
+        if (item->type & cJSON_IsShared) {
+            cJSON_Shared *const shared = (cJSON_Shared *)item->valuestring;
+
+            shared->release(shared);
+        }
         if (!(item->type & cJSON_IsReference) && (item->valuestring != NULL)) {
             global_hooks.deallocate(item->valuestring);
         }
         if (!(item->type & cJSON_StringIsConst) && (item->string != NULL)) {
             global_hooks.deallocate(item->string);
         }
-        global_hooks.deallocate(item);
+        if (node_hooks.deallocate != NULL) {
+            node_hooks.deallocate(item);
+        } else {
+            global_hooks.deallocate(item);
+        }
         item = next;
     }
 }
@@ -2489,10 +2512,10 @@ CJSON_PUBLIC(cJSON *) cJSON_Duplicate(const cJSON *item, cJSON_bool recurse)
         goto fail;
     }
     /* Copy over all vars */
-    newitem->type        = item->type & (~cJSON_IsReference);
+    newitem->type = item->type & (~(cJSON_IsReference | cJSON_IsShared));
     newitem->valueint    = item->valueint;
     newitem->valuedouble = item->valuedouble;
-    if (item->valuestring) {
+    if (item->valuestring && !(item->type & cJSON_IsShared)) {
         newitem->valuestring = (char *)cJSON_strdup(
             (unsigned char *)item->valuestring, &global_hooks);
         if (!newitem->valuestring) {
@@ -2757,6 +2780,11 @@ cJSON_Compare(
         return true;
     }
 
+    /* so are references to the same children, such as handles to one value */
+    if ((cJSON_IsArray(a) || cJSON_IsObject(a)) && a->child == b->child) {
+        return true;
+    }
+
     switch (a->type & 0xFF) {
     /* in these cases and equal type is enough */
     case cJSON_False:
@@ -106,6 +106,8 @@ CJSON_EXPORT_SYMBOLS does
 
 #define cJSON_IsReference 256
 #define cJSON_StringIsConst 512
+/* A reference that also holds its referent, see cJSON_Shared */
+#define cJSON_IsShared 1024
 
 /* The cJSON structure: */
 typedef struct cJSON
@@ -133,6 +135,13 @@ typedef struct cJSON
     char *string;
 } cJSON;
 
+/* Stored in valuestring of a cJSON_IsShared item, released when the item is
+ * deleted. Embedded by whatever owns the referenced children. */
+typedef struct cJSON_Shared
+{
+    void (*release)(struct cJSON_Shared *shared);
+} cJSON_Shared;
+
 typedef struct cJSON_Hooks
 {
     /* malloc/free are CDECL on Windows regardless of the default calling
@@ -155,6 +164,13 @@ CJSON_PUBLIC(const char *) cJSON_Version(void);
 
 /* Supply malloc, realloc and free functions to cJSON */
 CJSON_PUBLIC(void) cJSON_InitHooks(cJSON_Hooks *hooks);
+/* Allocates nodes, which are all sizeof(cJSON), with these instead of the
+ * hooks above. Set them before any node exists, both NULL restores the
+ * hooks above. */
+CJSON_PUBLIC(void)
+cJSON_InitNodeHooks(
+    void *(CJSON_CDECL *malloc_fn)(size_t sz),
+    void(CJSON_CDECL *free_fn)(void *ptr));
 
 /* Memory Management: the caller is always responsible to free the results from
  * all variants of cJSON_Parse (with cJSON_Delete) and cJSON_Print (with stdlib
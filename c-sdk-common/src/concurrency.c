@@ -798,3 +798,72 @@ ld_cond_unary_t LDi_cond_init    = LDi_cond_init_imp;
 ld_cond_wait_t  LDi_cond_wait    = LDi_cond_wait_imp;
 ld_cond_unary_t LDi_cond_signal  = LDi_cond_signal_imp;
 ld_cond_unary_t LDi_cond_destroy = LDi_cond_destroy_imp;
+
+LDBoolean
+LDi_epoch_init(struct ld_epoch_t *const epoch)
+{
+    LD_ASSERT(epoch);
+
+    LDi_atomic_store(&epoch->current, 0);
+    LDi_atomic_store(&epoch->readers[0], 0);
+    LDi_atomic_store(&epoch->readers[1], 0);
+
+    return LDi_mutex_init(&epoch->lock);
+}
+
+void
+LDi_epoch_destroy(struct ld_epoch_t *const epoch)
+{
+    LD_ASSERT(epoch);
+
+    LDi_mutex_destroy(&epoch->lock);
+}
+
+int
+LDi_epoch_enter(struct ld_epoch_t *const epoch)
+{
+    LD_ASSERT(epoch);
+
+    for (;;) {
+        const int token = LDi_atomic_load(&epoch->current) & 1;
+
+        LDi_atomic_add(&epoch->readers[token], 1);
+
+        /* a writer that moved on meanwhile may already have stopped
+         * waiting for this side, so register again on the current one */
+        if ((LDi_atomic_load(&epoch->current) & 1) == token) {
+            return token;
+        }
+
+        LDi_atomic_add(&epoch->readers[token], -1);
+    }
+}
+
+void
+LDi_epoch_exit(struct ld_epoch_t *const epoch, const int token)
+{
+    LD_ASSERT(epoch);
+    LD_ASSERT(token == 0 || token == 1);
+
+    LDi_atomic_add(&epoch->readers[token], -1);
+}
+
+void
+LDi_epoch_synchronize(struct ld_epoch_t *const epoch)
+{
+    int token;
+
+    LD_ASSERT(epoch);
+
+    LDi_mutex_lock(&epoch->lock);
+
+    token = (LDi_atomic_add(&epoch->current, 1) - 1) & 1;
+
+    /* an addition rather than a load, so the count is read in the same
+     * total order as the exchange that unpublished the previous value */
+    while (LDi_atomic_add(&epoch->readers[token], 0) != 0) {
+        LDi_sleepMilliseconds(1);
+    }
+
+    LDi_mutex_unlock(&epoch->lock);
+}
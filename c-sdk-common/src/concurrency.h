@@ -40,6 +40,64 @@
 #endif
 #endif
 
+/* Word sized atomics. Loads acquire and stores release, so a value read
+ * through LDi_atomic_load also observes every write made before the matching
+ * LDi_atomic_store. Exchanges are full barriers. */
+#ifdef _WIN32
+#define ld_atomic_int_t LONG volatile
+
+#define LDi_atomic_load(target) InterlockedCompareExchange((target), 0, 0)
+#define LDi_atomic_store(target, value)                                        \
+    ((void)InterlockedExchange((target), (LONG)(value)))
+#define LDi_atomic_exchange(target, value)                                     \
+    InterlockedExchange((target), (LONG)(value))
+/* returns the new value */
+#define LDi_atomic_add(target, delta)                                          \
+    (InterlockedExchangeAdd((target), (LONG)(delta)) + (LONG)(delta))
+
+#define ld_atomic_ptr_t PVOID volatile
+
+#define LDi_atomic_load_ptr(target)                                            \
+    InterlockedCompareExchangePointer((target), NULL, NULL)
+#define LDi_atomic_store_ptr(target, value)                                    \
+    ((void)InterlockedExchangePointer((target), (PVOID)(value)))
+#define LDi_atomic_exchange_ptr(target, value)                                 \
+    InterlockedExchangePointer((target), (PVOID)(value))
+#else
+#define ld_atomic_int_t int
+
+#define LDi_atomic_load(target) __atomic_load_n((target), __ATOMIC_ACQUIRE)
+#define LDi_atomic_store(target, value)                                        \
+    __atomic_store_n((target), (int)(value), __ATOMIC_RELEASE)
+#define LDi_atomic_exchange(target, value)                                     \
+    __atomic_exchange_n((target), (int)(value), __ATOMIC_SEQ_CST)
+/* returns the new value */
+#define LDi_atomic_add(target, delta)                                          \
+    __atomic_add_fetch((target), (int)(delta), __ATOMIC_SEQ_CST)
+
+#define ld_atomic_ptr_t void *
+
+#define LDi_atomic_load_ptr(target) __atomic_load_n((target), __ATOMIC_ACQUIRE)
+#define LDi_atomic_store_ptr(target, value)                                    \
+    __atomic_store_n((target), (void *)(value), __ATOMIC_RELEASE)
+#define LDi_atomic_exchange_ptr(target, value)                                 \
+    __atomic_exchange_n((target), (void *)(value), __ATOMIC_SEQ_CST)
+#endif
+
+/* Grace periods for lock-free readers of a published pointer.
+ *
+ * Readers bracket each access with LDi_epoch_enter and LDi_epoch_exit, neither
+ * of which blocks. A writer that has replaced the pointer calls
+ * LDi_epoch_synchronize, which returns once every reader that could still
+ * observe the previous value has exited. The previous value may then be
+ * reclaimed. */
+struct ld_epoch_t
+{
+    ld_atomic_int_t current;
+    ld_atomic_int_t readers[2];
+    ld_mutex_t      lock;
+};
+
 typedef LDBoolean (*ld_mutex_unary_t)(ld_mutex_t *const mutex);
 
 typedef LDBoolean (*ld_thread_join_t)(ld_thread_t *const thread);
@@ -78,3 +136,19 @@ extern ld_cond_unary_t LDi_cond_init;
 extern ld_cond_wait_t  LDi_cond_wait;
 extern ld_cond_unary_t LDi_cond_signal;
 extern ld_cond_unary_t LDi_cond_destroy;
+
+LDBoolean
+LDi_epoch_init(struct ld_epoch_t *const epoch);
+
+void
+LDi_epoch_destroy(struct ld_epoch_t *const epoch);
+
+/* Returns a token to be given to LDi_epoch_exit */
+int
+LDi_epoch_enter(struct ld_epoch_t *const epoch);
+
+void
+LDi_epoch_exit(struct ld_epoch_t *const epoch, const int token);
+
+void
+LDi_epoch_synchronize(struct ld_epoch_t *const epoch);
@@ -1,8 +1,14 @@
+#include <limits.h>
+#include <string.h>
+
 #include "cJSON.h"
 
 #include <launchdarkly/json.h>
+#include <launchdarkly/memory.h>
 
 #include "assertion.h"
+#include "concurrency.h"
+#include "utility.h"
 
 struct LDJSON *
 LDNewNull(void)
@@ -126,6 +132,11 @@ LDJSONGetType(const struct LDJSON *const inputRaw)
         return LDArray;
     } else if (cJSON_IsString(input)) {
         return LDText;
+    } else if (cJSON_IsRaw(input)) {
+        /* only ever a lazy value, see LDi_newLazyJSON. Its type is that of
+         * the value it decodes to, but it has no children, so it is decoded
+         * by LDi_storeCopyValue before it is iterated or looked into */
+        return input->valuestring[0] == '[' ? LDArray : LDObject;
     }
 
     LD_LOG(LD_LOG_CRITICAL, "LDJSONGetType unknown");
@@ -228,6 +239,7 @@ LDGetIter(const struct LDJSON *const rawCollection)
 
     LD_ASSERT_API(collection);
     LD_ASSERT_API(cJSON_IsArray(collection) || cJSON_IsObject(collection));
+    LD_ASSERT(!cJSON_IsRaw(collection));
 
 #ifdef LAUNCHDARKLY_DEFENSIVE
     if (collection == NULL) {
@@ -289,6 +301,7 @@ LDCollectionGetSize(const struct LDJSON *const rawCollection)
 
     LD_ASSERT_API(collection);
     LD_ASSERT_API(cJSON_IsArray(collection) || cJSON_IsObject(collection));
+    LD_ASSERT(!cJSON_IsRaw(collection));
 
 #ifdef LAUNCHDARKLY_DEFENSIVE
     if (collection == NULL) {
@@ -349,6 +362,7 @@ LDArrayLookup(const struct LDJSON *const rawArray, const unsigned int index)
 
     LD_ASSERT_API(array);
     LD_ASSERT_API(cJSON_IsArray(array));
+    LD_ASSERT(!cJSON_IsRaw(array));
 
 #ifdef LAUNCHDARKLY_DEFENSIVE
     if (array == NULL) {
@@ -461,6 +475,7 @@ LDObjectLookup(const struct LDJSON *const rawObject, const char *const key)
     LD_ASSERT_API(object);
     LD_ASSERT_API(cJSON_IsObject(object));
     LD_ASSERT_API(key);
+    LD_ASSERT(!cJSON_IsRaw(object));
 
 #ifdef LAUNCHDARKLY_DEFENSIVE
     if (object == NULL) {
@@ -676,3 +691,319 @@ LDJSONDeserialize(const char *const text)
 
     return (struct LDJSON *)cJSON_Parse(text);
 }
+
+/* Owns a tree shared by every handle to it */
+struct LDSharedJSON
+{
+    /* first, so a pointer to the header is a pointer to this */
+    cJSON_Shared    header;
+    ld_atomic_int_t references;
+    cJSON *         json;
+    /* the handle LDi_acquireJSON returns, freed along with this */
+    cJSON           handle;
+};
+
+static void
+LDi_releaseSharedJSON(cJSON_Shared *const header)
+{
+    struct LDSharedJSON *const shared = (struct LDSharedJSON *)header;
+
+    if (LDi_atomic_add(&shared->references, -1) == 0) {
+        cJSON_Delete(shared->json);
+        LDFree(shared);
+    }
+}
+
+/* A handle refers to the children of the shared tree, or carries the value
+ * of a scalar, and deleting it leaves the tree in place apart from releasing
+ * it */
+static void
+LDi_initSharedHandle(struct LDSharedJSON *const shared, cJSON *const handle)
+{
+    memset(handle, 0, sizeof(cJSON));
+
+    handle->type =
+        (shared->json->type & 0xFF) | cJSON_IsReference | cJSON_IsShared;
+    handle->child       = shared->json->child;
+    handle->valueint    = shared->json->valueint;
+    handle->valuedouble = shared->json->valuedouble;
+    handle->valuestring = (char *)&shared->header;
+}
+
+static cJSON *
+LDi_newSharedHandle(struct LDSharedJSON *const shared)
+{
+    cJSON *handle;
+
+    if (!(handle = cJSON_CreateNull())) {
+        return NULL;
+    }
+
+    LDi_initSharedHandle(shared, handle);
+
+    return handle;
+}
+
+struct LDJSON *
+LDi_shareJSON(struct LDJSON *const rawJSON)
+{
+    cJSON *const         json = (cJSON *)rawJSON;
+    struct LDSharedJSON *shared;
+    cJSON *              handle;
+
+    LD_ASSERT(json);
+
+    /* a handle has nowhere to keep text of its own */
+    if (cJSON_IsString(json) || cJSON_IsRaw(json) ||
+        (json->type & cJSON_IsShared))
+    {
+        return rawJSON;
+    }
+
+    if (!(shared = (struct LDSharedJSON *)LDAlloc(sizeof(struct LDSharedJSON))))
+    {
+        return NULL;
+    }
+
+    shared->header.release = LDi_releaseSharedJSON;
+    shared->references     = 1;
+    shared->json           = json;
+
+    LDi_initSharedHandle(shared, &shared->handle);
+
+    if (!(handle = LDi_newSharedHandle(shared))) {
+        LDFree(shared);
+
+        return NULL;
+    }
+
+    return (struct LDJSON *)handle;
+}
+
+struct LDJSON *
+LDi_retainJSON(const struct LDJSON *const rawJSON)
+{
+    const cJSON *const   json = (const cJSON *)rawJSON;
+    struct LDSharedJSON *shared;
+    cJSON *              handle;
+
+    LD_ASSERT(json);
+
+    if (!(json->type & cJSON_IsShared)) {
+        return LDJSONDuplicate(rawJSON);
+    }
+
+    shared = (struct LDSharedJSON *)json->valuestring;
+
+    if (!(handle = LDi_newSharedHandle(shared))) {
+        return NULL;
+    }
+
+    LDi_atomic_add(&shared->references, 1);
+
+    return (struct LDJSON *)handle;
+}
+
+struct LDJSON *
+LDi_acquireJSON(const struct LDJSON *const rawJSON)
+{
+    const cJSON *const   json = (const cJSON *)rawJSON;
+    struct LDSharedJSON *shared;
+
+    LD_ASSERT(json);
+    LD_ASSERT(json->type & cJSON_IsShared);
+
+    shared = (struct LDSharedJSON *)json->valuestring;
+
+    LDi_atomic_add(&shared->references, 1);
+
+    return (struct LDJSON *)&shared->handle;
+}
+
+void
+LDi_releaseJSON(struct LDJSON *const rawJSON)
+{
+    cJSON *const         json = (cJSON *)rawJSON;
+    struct LDSharedJSON *shared;
+
+    if (json && (json->type & cJSON_IsShared)) {
+        shared = (struct LDSharedJSON *)json->valuestring;
+
+        if (json == &shared->handle) {
+            LDi_releaseSharedJSON(&shared->header);
+
+            return;
+        }
+    }
+
+    LDJSONFree(rawJSON);
+}
+
+LDBoolean
+LDi_isSharedJSON(const struct LDJSON *const json)
+{
+    LD_ASSERT(json);
+
+    return (((const cJSON *)json)->type & cJSON_IsShared) != 0;
+}
+
+unsigned int
+LDi_sharedJSONReferences(const struct LDJSON *const rawJSON)
+{
+    const cJSON *const   json = (const cJSON *)rawJSON;
+    struct LDSharedJSON *shared;
+
+    LD_ASSERT(json);
+
+    if (!(json->type & cJSON_IsShared)) {
+        return 0;
+    }
+
+    shared = (struct LDSharedJSON *)json->valuestring;
+
+    return (unsigned int)LDi_atomic_load(&shared->references);
+}
+
+/* FNV-1a, in whichever width unsigned long has */
+#if ULONG_MAX > 0xffffffffUL
+#define LD_HASH_BASIS 14695981039346656037UL
+#define LD_HASH_PRIME 1099511628211UL
+#else
+#define LD_HASH_BASIS 2166136261UL
+#define LD_HASH_PRIME 16777619UL
+#endif
+
+static unsigned long
+LDi_hashBytes(unsigned long hash, const void *const bytes, const size_t length)
+{
+    const unsigned char *const iter = (const unsigned char *)bytes;
+    size_t                     i;
+
+    for (i = 0; i < length; i++) {
+        hash = (hash ^ iter[i]) * LD_HASH_PRIME;
+    }
+
+    return hash;
+}
+
+static unsigned long
+LDi_hashValue(const cJSON *const json)
+{
+    const cJSON * iter;
+    unsigned long hash, members;
+    double        number;
+    unsigned char type;
+
+    type = (unsigned char)(json->type & 0xFF);
+    hash = LDi_hashBytes(LD_HASH_BASIS, &type, 1);
+
+    switch (type) {
+        case cJSON_Number:
+            /* equal to zero, and so hashed like it */
+            number = json->valuedouble == 0 ? 0 : json->valuedouble;
+
+            return LDi_hashBytes(hash, &number, sizeof(number));
+        case cJSON_String:
+        case cJSON_Raw:
+            return LDi_hashBytes(
+                hash, json->valuestring, strlen(json->valuestring));
+        case cJSON_Array:
+            for (iter = json->child; iter; iter = iter->next) {
+                const unsigned long element = LDi_hashValue(iter);
+
+                hash = LDi_hashBytes(hash, &element, sizeof(element));
+            }
+
+            return hash;
+        case cJSON_Object:
+            /* members compare equal in any order, so they are summed */
+            members = 0;
+
+            for (iter = json->child; iter; iter = iter->next) {
+                unsigned long member = LDi_hashValue(iter);
+
+                member = LDi_hashBytes(member, iter->string, strlen(iter->string));
+
+                members += member;
+            }
+
+            return LDi_hashBytes(hash, &members, sizeof(members));
+        default:
+            return hash;
+    }
+}
+
+unsigned long
+LDi_hashJSON(const struct LDJSON *const json)
+{
+    unsigned long hash;
+
+    LD_ASSERT(json);
+
+    hash = LDi_hashValue((const cJSON *)json);
+
+    /* zero is left to mean not hashed */
+    return hash ? hash : 1;
+}
+
+struct LDJSON *
+LDi_newLazyJSON(const struct LDJSON *const json)
+{
+    char * text;
+    cJSON *lazy;
+
+    LD_ASSERT(json);
+    LD_ASSERT(cJSON_IsObject((const cJSON *)json) ||
+        cJSON_IsArray((const cJSON *)json));
+
+    if (!(text = cJSON_PrintUnformatted((const cJSON *)json))) {
+        return NULL;
+    }
+
+    /* a raw node prints its text as it is, so serializing needs no decode */
+    if (!(lazy = cJSON_CreateNull())) {
+        LDFree(text);
+
+        return NULL;
+    }
+
+    lazy->type        = cJSON_Raw;
+    lazy->valuestring = text;
+
+    return (struct LDJSON *)lazy;
+}
+
+const char *
+LDi_lazyJSONText(const struct LDJSON *const json)
+{
+    LD_ASSERT(json);
+
+    if (!cJSON_IsRaw((const cJSON *)json)) {
+        return NULL;
+    }
+
+    return ((const cJSON *)json)->valuestring;
+}
+
+char *
+LDi_takeText(struct LDJSON *const rawText)
+{
+    cJSON *const text = (cJSON *)rawText;
+    char *       result;
+
+    LD_ASSERT(text);
+
+    if (!cJSON_IsString(text) || !text->valuestring) {
+        return NULL;
+    }
+
+    /* a reference does not own its text */
+    if (text->type & cJSON_IsReference) {
+        return LDStrDup(text->valuestring);
+    }
+
+    result            = text->valuestring;
+    text->valuestring = NULL;
+
+    return result;
+}
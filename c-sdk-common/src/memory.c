@@ -10,6 +10,7 @@
 
 #include "assertion.h"
 #include "memory.h"
+#include "slab.h"
 
 void *(*LDi_customAlloc)(const size_t bytes) = malloc;
 
@@ -106,6 +107,25 @@ LDSetMemoryRoutines(
     LDi_customStrNDup = newStrNDup;
 }
 
+/* JSON makes up most of what the SDK holds, stored values and queued events
+ * alike, one node at a time */
+static struct LDSlabPool LDi_jsonNodes = LD_SLAB_POOL(sizeof(cJSON));
+
+static void *
+LDi_allocJSONNode(size_t bytes)
+{
+    /* always sizeof(cJSON) */
+    (void)bytes;
+
+    return LDi_slabAlloc(&LDi_jsonNodes);
+}
+
+static void
+LDi_freeJSONNode(void *node)
+{
+    LDi_slabFree(&LDi_jsonNodes, node);
+}
+
 void
 LDGlobalInit(void)
 {
@@ -131,5 +151,6 @@ LDGlobalInit(void)
         hooks.free_fn   = LDFree;
 
         cJSON_InitHooks(&hooks);
+        cJSON_InitNodeHooks(LDi_allocJSONNode, LDi_freeJSONNode);
     }
 }
@@ -0,0 +1,343 @@
+#ifndef _WIN32
+#include <sched.h>
+#endif
+
+#include <launchdarkly/memory.h>
+
+#include "assertion.h"
+#include "slab.h"
+
+#ifdef LAUNCHDARKLY_SLAB_POOLS
+
+/* blocks moved between a thread's cache and the pool at a time */
+#define LD_SLAB_BATCH 32
+/* a cache reaching this many blocks returns a batch to the pool */
+#define LD_SLAB_CACHE_MAX (LD_SLAB_BATCH * 2)
+/* chunks are about this size, unless a block alone is larger */
+#define LD_SLAB_CHUNK_BYTES 16384
+
+#define LD_SLAB_KEY_NONE 0
+#define LD_SLAB_KEY_READY 1
+#define LD_SLAB_KEY_FAILED 2
+
+union LDSlabAlignment
+{
+    long   integer;
+    double real;
+    void * pointer;
+};
+
+struct LDSlabCache
+{
+    struct LDSlabPool * pool;
+    struct LDSlabBlock *free;
+    unsigned int        count;
+};
+
+static size_t
+LDi_slabBlockSize(const struct LDSlabPool *const pool)
+{
+    size_t size;
+
+    size = pool->size;
+
+    if (size < sizeof(struct LDSlabBlock)) {
+        size = sizeof(struct LDSlabBlock);
+    }
+
+    return (size + sizeof(union LDSlabAlignment) - 1) /
+           sizeof(union LDSlabAlignment) * sizeof(union LDSlabAlignment);
+}
+
+static void
+LDi_slabLock(struct LDSlabPool *const pool)
+{
+    while (LDi_atomic_exchange(&pool->lock, 1)) {
+#ifdef _WIN32
+        SwitchToThread();
+#else
+        sched_yield();
+#endif
+    }
+}
+
+static void
+LDi_slabUnlock(struct LDSlabPool *const pool)
+{
+    LDi_atomic_store(&pool->lock, 0);
+}
+
+static void
+LDi_slabGive(
+    struct LDSlabPool *const  pool,
+    struct LDSlabBlock *const head,
+    struct LDSlabBlock *const tail)
+{
+    LDi_slabLock(pool);
+
+    tail->next = pool->free;
+    pool->free = head;
+
+    LDi_slabUnlock(pool);
+}
+
+/* Takes up to a batch of blocks, from the pool or else a new chunk, and
+ * returns how many. Zero on allocation failure. */
+static unsigned int
+LDi_slabTake(
+    struct LDSlabPool *const   pool,
+    struct LDSlabBlock **const head,
+    struct LDSlabBlock **const tail)
+{
+    struct LDSlabBlock *block;
+    char *              chunk;
+    size_t              size;
+    unsigned int        count, blocks, i;
+
+    count = 0;
+
+    LDi_slabLock(pool);
+
+    if ((*head = pool->free)) {
+        for (*tail = *head, count = 1; count < LD_SLAB_BATCH && (*tail)->next;
+             count++)
+        {
+            *tail = (*tail)->next;
+        }
+
+        pool->free    = (*tail)->next;
+        (*tail)->next = NULL;
+    }
+
+    LDi_slabUnlock(pool);
+
+    if (count) {
+        return count;
+    }
+
+    size = LDi_slabBlockSize(pool);
+
+    if (!(blocks = LD_SLAB_CHUNK_BYTES / size)) {
+        blocks = 1;
+    }
+
+    if (!(chunk = (char *)LDAlloc(size * blocks))) {
+        return 0;
+    }
+
+    for (i = 0; i < blocks; i++) {
+        block       = (struct LDSlabBlock *)(chunk + i * size);
+        block->next = i + 1 < blocks
+                          ? (struct LDSlabBlock *)(chunk + (i + 1) * size)
+                          : NULL;
+    }
+
+    *head = (struct LDSlabBlock *)chunk;
+
+    if (blocks <= LD_SLAB_BATCH) {
+        *tail = (struct LDSlabBlock *)(chunk + (blocks - 1) * size);
+
+        return blocks;
+    }
+
+    /* beyond a batch, the chunk goes to the pool for other threads */
+    *tail = (struct LDSlabBlock *)(chunk + (LD_SLAB_BATCH - 1) * size);
+
+    LDi_slabGive(
+        pool,
+        (*tail)->next,
+        (struct LDSlabBlock *)(chunk + (blocks - 1) * size));
+
+    (*tail)->next = NULL;
+
+    return LD_SLAB_BATCH;
+}
+
+static void
+LDi_slabCacheExit(void *const cacheRaw)
+{
+    struct LDSlabCache *cache;
+    struct LDSlabBlock *tail;
+
+    cache = (struct LDSlabCache *)cacheRaw;
+
+    if (cache) {
+        if (cache->free) {
+            for (tail = cache->free; tail->next; tail = tail->next) {}
+
+            LDi_slabGive(cache->pool, cache->free, tail);
+        }
+
+        LDFree(cache);
+    }
+}
+
+#ifdef _WIN32
+static VOID WINAPI
+LDi_slabFiberExit(PVOID cache)
+{
+    LDi_slabCacheExit(cache);
+}
+#endif
+
+/* NULL when the thread cannot have a cache, which leaves it to the pool */
+static struct LDSlabCache *
+LDi_slabCache(struct LDSlabPool *const pool)
+{
+    struct LDSlabCache *cache;
+
+    if (LDi_atomic_load(&pool->keyState) != LD_SLAB_KEY_READY) {
+        LDi_slabLock(pool);
+
+        if (pool->keyState == LD_SLAB_KEY_NONE) {
+#ifdef _WIN32
+            pool->key = FlsAlloc(LDi_slabFiberExit);
+
+            LDi_atomic_store(
+                &pool->keyState,
+                pool->key != FLS_OUT_OF_INDEXES ? LD_SLAB_KEY_READY
+                                                : LD_SLAB_KEY_FAILED);
+#else
+            LDi_atomic_store(
+                &pool->keyState,
+                pthread_key_create(&pool->key, LDi_slabCacheExit) == 0
+                    ? LD_SLAB_KEY_READY
+                    : LD_SLAB_KEY_FAILED);
+#endif
+        }
+
+        LDi_slabUnlock(pool);
+
+        if (LDi_atomic_load(&pool->keyState) != LD_SLAB_KEY_READY) {
+            return NULL;
+        }
+    }
+
+#ifdef _WIN32
+    cache = (struct LDSlabCache *)FlsGetValue(pool->key);
+#else
+    cache = (struct LDSlabCache *)pthread_getspecific(pool->key);
+#endif
+
+    if (cache) {
+        return cache;
+    }
+
+    if (!(cache = (struct LDSlabCache *)LDAlloc(sizeof(struct LDSlabCache)))) {
+        return NULL;
+    }
+
+    cache->pool  = pool;
+    cache->free  = NULL;
+    cache->count = 0;
+
+#ifdef _WIN32
+    if (!FlsSetValue(pool->key, cache)) {
+#else
+    if (pthread_setspecific(pool->key, cache) != 0) {
+#endif
+        LDFree(cache);
+
+        return NULL;
+    }
+
+    return cache;
+}
+
+void *
+LDi_slabAlloc(struct LDSlabPool *const pool)
+{
+    struct LDSlabCache *cache;
+    struct LDSlabBlock *head, *tail;
+
+    LD_ASSERT(pool);
+
+    if ((cache = LDi_slabCache(pool))) {
+        if (!cache->free) {
+            if (!(cache->count = LDi_slabTake(pool, &head, &tail))) {
+                return NULL;
+            }
+
+            cache->free = head;
+        }
+
+        head        = cache->free;
+        cache->free = head->next;
+        cache->count--;
+
+        return head;
+    }
+
+    if (!LDi_slabTake(pool, &head, &tail)) {
+        return NULL;
+    }
+
+    if (head->next) {
+        LDi_slabGive(pool, head->next, tail);
+    }
+
+    return head;
+}
+
+void
+LDi_slabFree(struct LDSlabPool *const pool, void *const blockRaw)
+{
+    struct LDSlabCache *cache;
+    struct LDSlabBlock *block, *head, *tail;
+    unsigned int        i;
+
+    LD_ASSERT(pool);
+
+    if (!(block = (struct LDSlabBlock *)blockRaw)) {
+        return;
+    }
+
+    if (!(cache = LDi_slabCache(pool))) {
+        block->next = NULL;
+
+        LDi_slabGive(pool, block, block);
+
+        return;
+    }
+
+    block->next = cache->free;
+    cache->free = block;
+
+    if (++cache->count < LD_SLAB_CACHE_MAX) {
+        return;
+    }
+
+    /* the most recently freed blocks stay, being the likeliest in cache */
+    for (tail = cache->free, i = 1; i < cache->count - LD_SLAB_BATCH; i++) {
+        tail = tail->next;
+    }
+
+    head       = tail->next;
+    tail->next = NULL;
+
+    for (tail = head; tail->next; tail = tail->next) {}
+
+    LDi_slabGive(pool, head, tail);
+
+    cache->count -= LD_SLAB_BATCH;
+}
+
+#else
+
+void *
+LDi_slabAlloc(struct LDSlabPool *const pool)
+{
+    LD_ASSERT(pool);
+
+    return LDAlloc(pool->size);
+}
+
+void
+LDi_slabFree(struct LDSlabPool *const pool, void *const block)
+{
+    (void)pool;
+
+    LDFree(block);
+}
+
+#endif
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "concurrency.h"
+
+/* Fixed size pools for the allocations the SDK makes the most of, such as
+ * JSON nodes and store nodes, taken in chunks from LDAlloc so that custom
+ * memory routines still supply all memory.
+ *
+ * Each thread caches a few blocks of every pool it uses, so that most
+ * allocations and frees touch nothing shared. Caches move blocks to and from
+ * the pool in batches, and a thread returns its cache when it exits. A pool
+ * keeps the chunks it has grown to, as flags and events come and go in
+ * roughly steady numbers.
+ *
+ * Pools are global, statically initialized with LD_SLAB_POOL, and need no
+ * setup. Built without LAUNCHDARKLY_SLAB_POOLS, they are LDAlloc and LDFree,
+ * which suits memory checkers. */
+
+struct LDSlabBlock
+{
+    struct LDSlabBlock *next;
+};
+
+struct LDSlabPool
+{
+    size_t              size;
+    /* a spin lock, held only to move a batch of blocks */
+    ld_atomic_int_t     lock;
+    ld_atomic_int_t     keyState;
+#ifdef _WIN32
+    DWORD               key;
+#else
+    pthread_key_t       key;
+#endif
+    /* blocks no thread has cached */
+    struct LDSlabBlock *free;
+};
+
+#define LD_SLAB_POOL(bytes)                                                    \
+    {                                                                          \
+        (bytes), 0, 0, 0, NULL                                                 \
+    }
+
+/* A block of pool->size bytes, aligned for any type */
+void *
+LDi_slabAlloc(struct LDSlabPool *const pool);
+
+/* Only blocks from the same pool. NULL is allowed. */
+void
+LDi_slabFree(struct LDSlabPool *const pool, void *const block);
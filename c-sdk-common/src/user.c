@@ -7,6 +7,7 @@
 #include "assertion.h"
 #include "user.h"
 #include "utility.h"
+#include "uthash.h"
 
 struct LDUser *
 LDi_userNew(const char *const key)
@@ -298,27 +299,91 @@ LDi_textInArray(const struct LDJSON *const array, const char *const text)
     return LDBooleanFalse;
 }
 
+/* set of private attribute names, borrowed from the array they came from */
+struct LDPrivateAttribute
+{
+    const char *   name;
+    UT_hash_handle hh;
+};
+
+void
+LDi_freePrivateAttributes(struct LDPrivateAttribute **const set)
+{
+    struct LDPrivateAttribute *entry, *tmp;
+
+    LD_ASSERT(set);
+
+    HASH_ITER(hh, *set, entry, tmp)
+    {
+        HASH_DEL(*set, entry);
+        LDFree(entry);
+    }
+}
+
+LDBoolean
+LDi_newPrivateAttributes(
+    struct LDPrivateAttribute **const set, const struct LDJSON *const names)
+{
+    struct LDJSON *            iter;
+    struct LDPrivateAttribute *entry;
+
+    LD_ASSERT(set);
+
+    *set = NULL;
+
+    if (!names) {
+        return LDBooleanTrue;
+    }
+
+    for (iter = LDGetIter(names); iter; iter = LDIterNext(iter)) {
+        const char *const name = LDGetText(iter);
+
+        HASH_FIND_STR(*set, name, entry);
+
+        if (entry) {
+            continue;
+        }
+
+        if (!(entry = (struct LDPrivateAttribute *)LDAlloc(
+                  sizeof(struct LDPrivateAttribute))))
+        {
+            LDi_freePrivateAttributes(set);
+
+            return LDBooleanFalse;
+        }
+
+        entry->name = name;
+
+        HASH_ADD_KEYPTR(hh, *set, entry->name, strlen(entry->name), entry);
+    }
+
+    return LDBooleanTrue;
+}
+
 static LDBoolean
 isPrivateAttr(
-    const struct LDUser *const user,
-    const char *const          key,
-    const LDBoolean            allAttributesPrivate,
-    const struct LDJSON *const globalPrivateAttributeNames)
+    const struct LDUser *const             user,
+    const struct LDPrivateAttribute *const set,
+    const char *const                      key,
+    const LDBoolean                        allAttributesPrivate)
 {
-    LD_ASSERT(user);
+    struct LDPrivateAttribute *entry;
+
     LD_ASSERT(key);
 
     if (allAttributesPrivate) {
         return LDBooleanTrue;
     }
 
-    if (globalPrivateAttributeNames) {
-        if (LDi_textInArray(globalPrivateAttributeNames, key)) {
-            return LDBooleanTrue;
-        }
+    HASH_FIND_STR(set, key, entry);
+
+    if (entry) {
+        return LDBooleanTrue;
     }
 
-    return LDi_textInArray(user->privateAttributeNames, key);
+    /* users rarely name more than one or two */
+    return user->privateAttributeNames &&
+           LDi_textInArray(user->privateAttributeNames, key);
 }
 
 static LDBoolean
@@ -350,9 +415,9 @@ addHidden(struct LDJSON **const ref, const char *const value)
 
 struct LDJSON *
 LDi_createEventUser(
-    const struct LDUser *user,
-    LDBoolean            allAttributesPrivate,
-    const struct LDJSON *globalPrivateAttributeNames)
+    const struct LDUser *                  user,
+    LDBoolean                              allAttributesPrivate,
+    const struct LDPrivateAttribute *const privateAttributes)
 {
     struct LDJSON *hidden, *json, *temp;
 
@@ -397,10 +462,7 @@ LDi_createEventUser(
 #define addstring(field)                                                       \
     if (user->field) {                                                         \
         if (isPrivateAttr(                                                     \
-                          user,                                                \
-                          #field,                                              \
-                          allAttributesPrivate,                                \
-                          globalPrivateAttributeNames))                        \
+                user, privateAttributes, #field, allAttributesPrivate))        \
         {                                                                      \
             if (!addHidden(&hidden, #field)) {                                 \
                 LDJSONFree(json);                                              \
@@ -449,9 +511,9 @@ LDi_createEventUser(
 
                 if (isPrivateAttr(
                         user,
+                        privateAttributes,
                         LDIterKey(item),
-                        allAttributesPrivate,
-                        globalPrivateAttributeNames))
+                        allAttributesPrivate))
                 {
                     if (!addHidden(&hidden, LDIterKey(item))) {
                         LDJSONFree(json);
@@ -488,7 +550,6 @@ LDi_createEventUser(
 #undef addstring
 }
 
-
 char *
 LDi_serializeUser(const struct LDUser *user)
 {
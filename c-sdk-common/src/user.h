@@ -22,16 +22,29 @@ struct LDJSON *
 LDi_valueOfAttribute(
     const struct LDUser *const user, const char *const attribute);
 
+/* A set of private attribute names, which borrows the names from the array it
+ * was built from */
+struct LDPrivateAttribute;
+
+/* Builds the set once, for any number of LDi_createEventUser calls. NULL
+ * names give an empty set, which is NULL. */
+LDBoolean
+LDi_newPrivateAttributes(
+    struct LDPrivateAttribute **const set, const struct LDJSON *const names);
+
+void
+LDi_freePrivateAttributes(struct LDPrivateAttribute **const set);
+
 /* Creates an "event user", which is a representation of a user suitable
- * for events. Attributes are redacted according to allAttributesPrivate, and
- * the list of global private attribute names.
+ * for events. Attributes are redacted according to allAttributesPrivate, the
+ * set of global private attribute names, which may be NULL, and the private
+ * attribute names of the user.
  * The returned LDJSON must be freed with LDJSONFree. */
 struct LDJSON *
 LDi_createEventUser(
-    const struct LDUser *user,
-    LDBoolean            allAttributesPrivate,
-    const struct LDJSON *globalPrivateAttributeNames);
-
+    const struct LDUser *                  user,
+    LDBoolean                              allAttributesPrivate,
+    const struct LDPrivateAttribute *const privateAttributes);
 
 /* Serializes a user to its JSON representation. The returned string must be
  * freed with LDFree. */
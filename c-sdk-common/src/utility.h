@@ -81,6 +81,63 @@ LDi_isDeleted(const struct LDJSON *const feature);
 LDBoolean
 LDi_textInArray(const struct LDJSON *const array, const char *const text);
 
+/* Takes ownership of `json` and returns a handle sharing it, which must no
+ * longer be modified. Handles are freed with LDJSONFree, and the tree once
+ * the last handle to it is. Text is returned as it is, a handle having
+ * nowhere to keep it. Returns NULL on failure, leaving `json` with the
+ * caller. */
+struct LDJSON *
+LDi_shareJSON(struct LDJSON *const json);
+
+/* Returns another handle to a shared value, costing one node regardless of
+ * its size, and a copy of any other value. Safe from any thread. The handle
+ * may be placed within other values, while LDJSONDuplicate of a handle
+ * yields an owned copy. */
+struct LDJSON *
+LDi_retainJSON(const struct LDJSON *const json);
+
+/* Adds a reference to a shared value without allocating a handle, by
+ * returning the one handle embedded in the value. The result must only be
+ * released with LDi_releaseJSON, never freed or placed within other
+ * values. */
+struct LDJSON *
+LDi_acquireJSON(const struct LDJSON *const json);
+
+/* Releases a value from LDi_acquireJSON, or frees any other value. NULL is
+ * allowed. */
+void
+LDi_releaseJSON(struct LDJSON *const json);
+
+LDBoolean
+LDi_isSharedJSON(const struct LDJSON *const json);
+
+/* The number of handles to a shared value, zero for any other value */
+unsigned int
+LDi_sharedJSONReferences(const struct LDJSON *const json);
+
+/* A hash of the content of `json`, which is equal for values that compare
+ * equal with LDJSONCompare. Never zero, so that zero can stand for a value
+ * not yet hashed. */
+unsigned long
+LDi_hashJSON(const struct LDJSON *const json);
+
+/* Returns a lazy form of an object or array, holding its compact text
+ * instead of a tree. A lazy value serializes, duplicates, and compares like
+ * any other, and reports the type of the value it stands for, while
+ * anything reading within it must decode the text first. Returns NULL on
+ * failure. */
+struct LDJSON *
+LDi_newLazyJSON(const struct LDJSON *const json);
+
+/* The text of a lazy value, or NULL for any other value */
+const char *
+LDi_lazyJSONText(const struct LDJSON *const json);
+
+/* Moves the text out of a text node instead of copying it, leaving the node
+ * fit only to be freed. Returns NULL if the node is not text. */
+char *
+LDi_takeText(struct LDJSON *const text);
+
 int
 LDi_strncasecmp(const char *const s1, const char *const s2, const size_t n);
 
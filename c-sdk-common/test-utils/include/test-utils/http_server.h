@@ -37,3 +37,7 @@ void LDi_readHTTPRequest(const ld_socket_t acceptFD,
     struct LDHTTPRequest *const request);
 
 void LDi_send200(const ld_socket_t socket, const char *const body);
+
+/* status is the code and reason, headers are complete CRLF terminated lines */
+void LDi_sendResponse(const ld_socket_t socket, const char *const status,
+    const char *const headers, const char *const body);
@@ -49,9 +49,24 @@ LDi_writeAllString(const ld_socket_t socket, const char *const string)
 void
 LDi_send200(const ld_socket_t socket, const char *const body)
 {
-    LDi_writeAllString(socket, "HTTP/1.1 200 OK\r\n");
+    LDi_sendResponse(socket, "200 OK", NULL, body);
+}
+
+void
+LDi_sendResponse(const ld_socket_t socket, const char *const status,
+    const char *const headers, const char *const body)
+{
+    LD_ASSERT(status);
+
+    LDi_writeAllString(socket, "HTTP/1.1 ");
+    LDi_writeAllString(socket, status);
+    LDi_writeAllString(socket, "\r\n");
     LDi_writeAllString(socket, "Connection: Closed\r\n");
 
+    if (headers != NULL) {
+        LDi_writeAllString(socket, headers);
+    }
+
     if (body != NULL) {
         char contentSizeHeader[1024];
 
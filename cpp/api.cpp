@@ -196,12 +196,30 @@ LDClientCPP::restoreFlags(const std::string &flags)
     LDClientRestoreFlags(this->client, flags.c_str());
 }
 
+bool
+LDClientCPP::saveFlagsFile(const std::string &path)
+{
+    return LDClientSaveFlagsFile(this->client, path.c_str());
+}
+
+bool
+LDClientCPP::restoreFlagsFile(const std::string &path)
+{
+    return LDClientRestoreFlagsFile(this->client, path.c_str());
+}
+
 void
 LDClientCPP::identify(LDUser *const user)
 {
     LDClientIdentify(this->client, user);
 }
 
+bool
+LDClientCPP::identifyAwait(LDUser *const user, const unsigned int timeoutmilli)
+{
+    return LDClientIdentifyAwait(this->client, user, timeoutmilli);
+}
+
 bool
 LDClientCPP::registerFeatureFlagListener(const std::string &name,
     LDlistenerfn fn)
@@ -215,3 +233,16 @@ LDClientCPP::unregisterFeatureFlagListener(const std::string &name,
 {
     LDClientUnregisterFeatureFlagListener(this->client, name.c_str(), fn);
 }
+
+bool
+LDClientCPP::registerAllFlagsListener(LDallflagslistenerfn fn,
+    void *const userData)
+{
+    return LDClientRegisterAllFlagsListener(this->client, fn, userData);
+}
+
+void
+LDClientCPP::unregisterAllFlagsListener(LDallflagslistenerfn fn)
+{
+    LDClientUnregisterAllFlagsListener(this->client, fn);
+}
@@ -112,6 +112,12 @@ class LD_EXPORT(LDClientCPP) {
         /** @brief Set flag store from JSON string. */
         void restoreFlags(const std::string &flags);
 
+        /** @brief Save all flags to a file in a compact binary format. */
+        bool saveFlagsFile(const std::string &path);
+
+        /** @brief Set flag store from a file written by saveFlagsFile. */
+        bool restoreFlagsFile(const std::string &path);
+
         /** @brief Update the client with a new user.
          *
          * The old user is freed. This will re-fetch feature flag settings from
@@ -119,6 +125,9 @@ class LD_EXPORT(LDClientCPP) {
          * changed frequently. */
         void identify(LDUser *user);
 
+        /** @brief Identify a new user, blocking until its flags are in use. */
+        bool identifyAwait(LDUser *user, unsigned int timeoutmilli);
+
         /** @brief Record an alias event for a user. */
         void alias(const struct LDUser *currentUser, const struct LDUser *previousUser);
 
@@ -148,6 +157,12 @@ class LD_EXPORT(LDClientCPP) {
 
         /** @brief Unregister a callback registered with `LDClientRegisterFeatureFlagListener`. */
         void unregisterFeatureFlagListener(const std::string &name, LDlistenerfn fn);
+
+        /** @brief Register a callback for whenever any flags change. */
+        bool registerAllFlagsListener(LDallflagslistenerfn fn, void *const userData);
+
+        /** @brief Unregister a callback registered with `LDClientRegisterAllFlagsListener`. */
+        void unregisterAllFlagsListener(LDallflagslistenerfn fn);
     private:
         struct LDClient *client;
 };
@@ -82,6 +82,23 @@ LD_EXPORT(char *) LDClientSaveFlags(struct LDClient *const client);
 LD_EXPORT(LDBoolean)
 LDClientRestoreFlags(struct LDClient *const client, const char *const data);
 
+/** @brief Save all flags to a file in a compact binary format.
+ *
+ * Restoring such a file with LDClientRestoreFlagsFile is considerably
+ * cheaper than restoring JSON. The file is replaced atomically. Returns true
+ * on success. */
+LD_EXPORT(LDBoolean)
+LDClientSaveFlagsFile(struct LDClient *const client, const char *const path);
+
+/** @brief Set flag store from a file written by LDClientSaveFlagsFile.
+ *
+ * The file is mapped into memory, and each flag is only decoded the first
+ * time it is evaluated, until flags from LaunchDarkly replace the snapshot.
+ * The file must not be modified while in use. Returns false if the file is
+ * missing, was written by an incompatible version, or is corrupt. */
+LD_EXPORT(LDBoolean)
+LDClientRestoreFlagsFile(struct LDClient *const client, const char *const path);
+
 /** @brief Asynchronously update the client with a new user.
  *
  * The old user is freed. This will re-fetch feature flag settings from
@@ -98,10 +115,34 @@ LDClientRestoreFlags(struct LDClient *const client, const char *const data);
  *      The client is initialized if the return value is true.
  * 3) Monitor the client status via LDSetClientStatusCallbackUserData.
  *      The client is initialized if the status parameter is equal to LDStatusInitialized.
+ * 4) Call LDClientIdentifyAwait instead.
+ *
+ * A client that is already initialized stays initialized, serving the flags of
+ * the previous user until those of the new user replace them all at once.
+ * Otherwise the client status returns to LDStatusInitializing.
  * */
 LD_EXPORT(void)
 LDClientIdentify(struct LDClient *const client, struct LDUser *const user);
 
+/** @brief Update the client with a new user, and block until the flags of
+ * that user are in use, up to the timeout.
+ *
+ * Behaves like LDClientIdentify otherwise. Returns true if the flags of the
+ * new user were stored in time by every environment. */
+LD_EXPORT(LDBoolean)
+LDClientIdentifyAwait(
+    struct LDClient *const client,
+    struct LDUser *const   user,
+    const unsigned int     timeoutmilli);
+
+/** @brief Get how many milliseconds the most recent identify took to replace
+ * the flags of an already initialized client.
+ *
+ * Returns false if no such identify has completed yet. */
+LD_EXPORT(LDBoolean)
+LDClientGetIdentifyLatency(
+    struct LDClient *const client, double *const latencyMilliseconds);
+
 /** @brief  Send any pending events to the server. They will normally be
  *
  * flushed after a timeout, but may also be flushed manually. This operation
@@ -111,6 +152,12 @@ LD_EXPORT(void) LDClientFlush(struct LDClient *const client);
 /** @brief Returns true if the client has been initialized. */
 LD_EXPORT(LDBoolean) LDClientIsInitialized(struct LDClient *const client);
 
+/** @brief Returns true while the client serves flags restored from a cache
+ * that LaunchDarkly has not confirmed yet.
+ *
+ * See LDConfigSetFlagCacheDirectory and LDConfigSetUserCache. */
+LD_EXPORT(LDBoolean) LDClientIsUsingCachedFlags(struct LDClient *const client);
+
 /** @brief Block until initialized up to timeout, returns true if initialized */
 LD_EXPORT(LDBoolean)
 LDClientAwaitInitialized(
@@ -316,3 +363,45 @@ LDClientUnregisterFeatureFlagListener(
     struct LDClient *const client,
     const char *const      flagKey,
     LDlistenerfn           listener);
+
+/** @brief How a flag changed, as reported to an all flags listener. */
+typedef enum
+{
+    LDFlagAdded = 0,
+    LDFlagUpdated,
+    LDFlagDeleted
+} LDFlagChangeKind;
+
+/** @brief A single flag changed by an update. */
+struct LDFlagChange
+{
+    const char *     flagKey;
+    LDFlagChangeKind kind;
+};
+
+/** @brief All flags listener callback type.
+ *
+ * Invoked once for every update that changed at least one flag, such as a
+ * full replacement of the flags, or a single patch or delete. `changes` and
+ * the keys it refers to are only valid for the duration of the callback. */
+typedef void (*LDallflagslistenerfn)(
+    const struct LDFlagChange *const changes,
+    const unsigned int               changeCount,
+    void *const                      userData);
+
+/** @brief Register a callback for whenever any flags change.
+ *
+ * Unlike `LDClientRegisterFeatureFlagListener`, flags that are replaced
+ * with an identical version are not reported. Registering the same callback
+ * again replaces its `userData`. */
+LD_EXPORT(LDBoolean)
+LDClientRegisterAllFlagsListener(
+    struct LDClient *const client,
+    LDallflagslistenerfn   listener,
+    void *const            userData);
+
+/** @brief Unregister a callback registered with
+ * `LDClientRegisterAllFlagsListener` */
+LD_EXPORT(void)
+LDClientUnregisterAllFlagsListener(
+    struct LDClient *const client, LDallflagslistenerfn listener);
@@ -62,6 +62,23 @@ LD_EXPORT(void)
 LDConfigSetEventsFlushIntervalMillis(
     struct LDConfig *const config, const int millis);
 
+/** @brief Sets the max number of event payloads delivered concurrently.
+ *
+ * Only effective when LDConfigSetUseNetworkRuntime is enabled, otherwise
+ * payloads are delivered one at a time. Defaults to 1. */
+LD_EXPORT(void)
+LDConfigSetEventsMaxConcurrentRequests(
+    struct LDConfig *const config, const unsigned int requests);
+
+/** @brief Sets the approximate max size in bytes of a single event payload.
+ *
+ * A flush that serializes to more than this is split into several payloads.
+ * A single event larger than the limit is still sent on its own.
+ * Defaults to 0, meaning payloads are never split. */
+LD_EXPORT(void)
+LDConfigSetEventsMaxPayloadBytes(
+    struct LDConfig *const config, const unsigned int bytes);
+
 /** @brief Set the events uri for sending analytics to LaunchDarkly. You
  * probably don't need to set this unless instructed by LaunchDarkly. */
 LD_EXPORT(LDBoolean)
@@ -91,6 +108,16 @@ LD_EXPORT(void)
 LDConfigSetPollingIntervalMillis(
     struct LDConfig *const config, const int millis);
 
+/** @brief Enables adaptive polling, bounded by the given interval.
+ *
+ * While consecutive polls find the flags unchanged the interval between them
+ * doubles, up to `millis`. Once a poll observes a change the interval drops
+ * back to the polling interval, or background polling interval, in effect.
+ * Defaults to 0, meaning the interval is fixed. */
+LD_EXPORT(void)
+LDConfigSetMaxPollingIntervalMillis(
+    struct LDConfig *const config, const int millis);
+
 /** @brief Set the stream uri for connecting to the flag update stream. You
  * probably don't need to set this unless instructed by LaunchDarkly. */
 LD_EXPORT(LDBoolean)
@@ -165,6 +192,73 @@ LDConfigSetInlineUsersInEvents(
 LD_EXPORT(void)
 LDConfigAutoAliasOptOut(struct LDConfig *const config, const LDBoolean optOut);
 
+/** @brief Determines if a single network thread should serve every
+ * environment.
+ *
+ * By default each environment runs dedicated threads for streaming, polling,
+ * and event delivery. When enabled all of this work is instead multiplexed
+ * onto one thread using the libcurl multi interface, which greatly reduces
+ * thread count when many secondary environments are configured.
+ * Defaults to false. */
+LD_EXPORT(void)
+LDConfigSetUseNetworkRuntime(
+    struct LDConfig *const config, const LDBoolean useRuntime);
+
+/** @brief Determines if event payloads are gzip compressed when delivered.
+ *
+ * Small payloads are always sent uncompressed. Has no effect if the SDK was
+ * built without zlib. Defaults to false. */
+LD_EXPORT(void)
+LDConfigSetCompressEvents(
+    struct LDConfig *const config, const LDBoolean compress);
+
+/** @brief Spool event payloads that could not be delivered to disk.
+ *
+ * Payloads that fail delivery are appended to segment files within
+ * `directory`, which must already exist, and are resent in the background
+ * once delivery succeeds again. At most `maxBytes`, no less than 256KB, are
+ * kept on disk, the oldest payloads are discarded beyond this. Payloads
+ * retain their identifier so that a resend is never counted twice.
+ * By default undelivered payloads are discarded. */
+LD_EXPORT(LDBoolean)
+LDConfigSetEventSpool(
+    struct LDConfig *const config,
+    const char *const      directory,
+    const unsigned int     maxBytes);
+
+/** @brief Persist flags across runs in `directory`, which must already exist.
+ *
+ * Each environment keeps one file per user, rewritten in the background
+ * after flags change. LDClientInit and LDClientIdentify load the file of the
+ * user if present, so the client is initialized immediately with the flags
+ * of the previous run while fresh flags are requested. Flags are not
+ * persisted by default. */
+LD_EXPORT(LDBoolean)
+LDConfigSetFlagCacheDirectory(
+    struct LDConfig *const config, const char *const directory);
+
+/** @brief Keep the flags of recently identified users in memory.
+ *
+ * When LDClientIdentify switches back to one of the last `maxUsers` users,
+ * the flags last received for that user are served immediately while they
+ * are revalidated in the background. Flags kept for all users together
+ * occupy approximately at most `maxBytes` per environment, the least
+ * recently used are discarded beyond this. Disabled by default. */
+LD_EXPORT(void)
+LDConfigSetUserCache(
+    struct LDConfig *const config,
+    const unsigned int     maxUsers,
+    const unsigned int     maxBytes);
+
+/** @brief Parse flag payloads of many flags on up to `threads` threads.
+ *
+ * Only payloads large enough to benefit are split across threads, which are
+ * started for the duration of the parse. Defaults to 1, parsing every payload
+ * on the thread receiving it. */
+LD_EXPORT(void)
+LDConfigSetFlagParseThreads(
+    struct LDConfig *const config, const unsigned int threads);
+
 /** @brief Sets the timeout, in milliseconds, for requests to LaunchDarkly.
  *  Applies to polling requests and sending events. A value of 0 specifies
  *  that the request will never timeout. Defaults to 30000. */
@@ -11,6 +11,7 @@
 
 #include <launchdarkly/api.h>
 
+#include "flag_journal.h"
 #include "ldinternal.h"
 #include "uthash.h"
 
@@ -41,14 +42,41 @@ static struct status_callback_closure LDi_statuscallback_closure = {
         NULL
 };
 
+/* Invoked on the notifier thread */
+static void
+LDi_deliverstatus(void *const context, const char *const key, const int status)
+{
+    UNUSED(context);
+    UNUSED(key);
+
+    if (LDi_statuscallback_closure.callback) {
+        LDi_statuscallback_closure.callback(
+            (LDStatus)status, LDi_statuscallback_closure.userData);
+    }
+}
+
+/* Only valid between entering and exiting userEpoch, the user may be freed
+ * by an identify at any point after. */
+static struct LDUser *
+LDi_currentuser(struct LDGlobal_i *const shared)
+{
+    return (struct LDUser *)LDi_atomic_load_ptr(&shared->sharedUser);
+}
+
 void
 LDi_earlyinit(void)
 {
-    LDi_rwlock_init(&globalContext.sharedUserLock);
+    LDi_epoch_init(&globalContext.userEpoch);
+    LDi_mutex_init(&globalContext.identifyLock);
+    LDi_mutex_init(&globalContext.userRequestLock);
     globalContext.clientTable   = NULL;
     globalContext.primaryClient = NULL;
     globalContext.sharedConfig  = NULL;
-    globalContext.sharedUser    = NULL;
+    LDi_atomic_store_ptr(&globalContext.sharedUser, NULL);
+    globalContext.networkRuntime = NULL;
+    globalContext.userRequest    = NULL;
+    globalContext.notifier       = NULL;
+    globalContext.persister      = NULL;
 
     curl_global_init(CURL_GLOBAL_DEFAULT);
 
@@ -81,12 +109,192 @@ LDClientGetForMobileKey(const char *const keyName)
     return lookup;
 }
 
+/* 64-bit FNV-1a, with the hash in two 32-bit halves as C89 has no 64-bit
+ * integer type */
+static void
+LDi_fnv1a64(
+    unsigned long *const high, unsigned long *const low, const char *text)
+{
+    unsigned long lower, upper;
+
+    for (; *text; text++) {
+        *low ^= (unsigned char)*text;
+
+        /* the prime is 2^40 + 0x1b3, low is multiplied in 16-bit halves so
+         * that no product exceeds 32 bits */
+        lower = (*low & 0xffffUL) * 0x1b3UL;
+        upper = (*low >> 16) * 0x1b3UL + (lower >> 16);
+
+        *high = (*high * 0x1b3UL + (upper >> 16) + (*low << 8)) & 0xffffffffUL;
+        *low  = ((upper & 0xffffUL) << 16) | (lower & 0xffffUL);
+    }
+}
+
+char *
+LDi_flagcachepath(
+    const struct LDClient *const      client,
+    const struct LDUserRequest *const request)
+{
+    const char *const directory =
+        client->shared->sharedConfig->flagCacheDirectory;
+    unsigned long low, high;
+    size_t        size;
+    char *        path;
+
+    if (!directory) {
+        return NULL;
+    }
+
+    high = 0xcbf29ce4UL;
+    low  = 0x84222325UL;
+
+    LDi_fnv1a64(&high, &low, client->mobileKey);
+    LDi_fnv1a64(&high, &low, "\n");
+    LDi_fnv1a64(&high, &low, request->json);
+
+    size = strlen(directory) + sizeof("/ld-0123456789abcdef.flags");
+
+    if (!(path = (char *)LDAlloc(size))) {
+        return NULL;
+    }
+
+    snprintf(path, size, "%s/ld-%08lx%08lx.flags", directory, high, low);
+
+    return path;
+}
+
+/* Persists flags from the next put on in the file of the user, or nowhere
+ * if that fails. Does nothing unless a cache directory is configured. */
+static void
+LDi_pointflagcache(
+    struct LDClient *const client, const struct LDUserRequest *const request)
+{
+    char *path;
+
+    if (!client->shared->sharedConfig->flagCacheDirectory) {
+        return;
+    }
+
+    path = request ? LDi_flagcachepath(client, request) : NULL;
+
+    if (!LDi_storeSetCachePath(&client->store, path)) {
+        LDi_storeSetCachePath(&client->store, NULL);
+    }
+
+    LDFree(path);
+}
+
+/* The flags persisted for a user, read from disk before identify takes any
+ * locks, so that only storing them happens under those */
+struct LDCachedFlags
+{
+    /* NULL if nothing was persisted for the user */
+    struct LDFlagImage *image;
+    /* updates journaled since the snapshot, in the order appended */
+    struct LDFlag *updates;
+    unsigned int   updateCount;
+    unsigned int   updateCapacity;
+};
+
+static void
+LDi_collectcachedupdate(void *const cachedRaw, struct LDFlag flag)
+{
+    struct LDCachedFlags *const cached = (struct LDCachedFlags *)cachedRaw;
+    struct LDFlag *             updates;
+    unsigned int                capacity;
+
+    if (cached->updateCount == cached->updateCapacity) {
+        capacity = cached->updateCapacity ? cached->updateCapacity * 2 : 16;
+
+        if (!(updates = (struct LDFlag *)LDRealloc(
+                  cached->updates, sizeof(struct LDFlag) * capacity)))
+        {
+            LD_LOG(LD_LOG_ERROR, "failed to allocate journaled flag");
+
+            LDi_flag_destroy(&flag);
+
+            return;
+        }
+
+        cached->updates        = updates;
+        cached->updateCapacity = capacity;
+    }
+
+    cached->updates[cached->updateCount++] = flag;
+}
+
+static void
+LDi_freecachedflags(struct LDCachedFlags *const cached)
+{
+    unsigned int i;
+
+    LDi_flagImageClose(cached->image);
+
+    for (i = 0; i < cached->updateCount; i++) {
+        LDi_flag_destroy(&cached->updates[i]);
+    }
+
+    LDFree(cached->updates);
+
+    memset(cached, 0, sizeof(struct LDCachedFlags));
+}
+
+/* Reads the flags persisted for the user, including updates journaled
+ * since. Leaves cached->image NULL if there are none. */
+static void
+LDi_readflagcache(
+    struct LDClient *const            client,
+    const struct LDUserRequest *const request,
+    struct LDCachedFlags *const       cached)
+{
+    char *path;
+
+    memset(cached, 0, sizeof(struct LDCachedFlags));
+
+    if (!client->shared->sharedConfig->flagCacheDirectory || !request ||
+        !(path = LDi_flagcachepath(client, request)))
+    {
+        return;
+    }
+
+    if ((cached->image = LDi_flagImageOpen(path))) {
+        LDi_flagJournalReplay(path, LDi_collectcachedupdate, cached);
+    }
+
+    LDFree(path);
+}
+
+/* Replaces the flags with those read by LDi_readflagcache, returns true if
+ * there were any. Expects LDi_pointflagcache for the user first. */
+static LDBoolean
+LDi_storeflagcache(
+    struct LDClient *const client, struct LDCachedFlags *const cached)
+{
+    unsigned int i;
+
+    if (!cached->image) {
+        return LDBooleanFalse;
+    }
+
+    LDi_storePutImage(&client->store, cached->image);
+    cached->image = NULL;
+
+    for (i = 0; i < cached->updateCount; i++) {
+        LDi_storeReplayFlag(&client->store, cached->updates[i]);
+    }
+
+    cached->updateCount = 0;
+
+    return LDBooleanTrue;
+}
+
 struct LDClient *
 LDi_clientInitIsolated(
     struct LDGlobal_i *const shared, const char *const mobileKey)
 {
     struct LDClient *client;
     unsigned int     threadCount;
+    int              epoch;
 
     LD_ASSERT_API(shared);
     LD_ASSERT_API(mobileKey);
@@ -108,6 +316,9 @@ LDi_clientInitIsolated(
     client->background          = LDBooleanFalse;
     client->status              = LDStatusInitializing;
     client->shouldstopstreaming = LDBooleanFalse;
+    client->identifyPending     = LDBooleanFalse;
+    client->cachedFlags         = LDBooleanFalse;
+    client->identifyLatency     = -1;
 
     LDi_initSocket(&client->streamhandle);
 
@@ -120,10 +331,26 @@ LDi_clientInitIsolated(
         goto err2;
     }
 
+    if (shared->sharedConfig->eventSpoolDirectory) {
+        /* events are still delivered without a spool, just not durably */
+        if (!(client->eventSpool = LDi_eventSpoolOpen(
+                  shared->sharedConfig->eventSpoolDirectory,
+                  mobileKey,
+                  shared->sharedConfig->eventSpoolMaxBytes)))
+        {
+            LD_LOG(LD_LOG_ERROR, "failed to open event spool");
+        }
+    }
+
     if (!LDi_storeInitialize(&client->store)) {
         goto err3;
     }
 
+    client->store.notifier          = shared->notifier;
+    client->store.persister         = shared->persister;
+    client->store.snapshotsMaxCount = shared->sharedConfig->userCacheMaxUsers;
+    client->store.snapshotsMaxBytes = shared->sharedConfig->userCacheMaxBytes;
+
     if (!LDi_rwlock_init(&client->clientLock)) {
         goto err4;
     }
@@ -152,32 +379,58 @@ LDi_clientInitIsolated(
         goto err10;
     }
 
-    if (!LDi_thread_create(&client->eventThread, LDi_bgeventsender, client)) {
-        goto err11;
-    }
-    threadCount++;
-
-    if (!LDi_thread_create(&client->pollingThread, LDi_bgfeaturepoller, client))
+    /* before any network activity, so that cached flags are ready at once */
     {
-        goto err12;
+        struct LDUserRequest *const request = LDi_acquireUserRequest(shared);
+        struct LDCachedFlags        cached;
+
+        LDi_pointflagcache(client, request);
+        LDi_readflagcache(client, request, &cached);
+
+        if (LDi_storeflagcache(client, &cached)) {
+            LDi_rwlock_wrlock(&client->clientLock);
+            LDi_atomic_store(&client->cachedFlags, LDBooleanTrue);
+            LDi_updatestatus(client, LDStatusInitialized);
+            LDi_rwlock_wrunlock(&client->clientLock);
+        }
+
+        LDi_freecachedflags(&cached);
+        LDi_userRequestRelease(request);
     }
-    threadCount++;
 
-    if (!LDi_thread_create(
-            &client->streamingThread, LDi_bgfeaturestreamer, client)) {
-        goto err12;
+    if (shared->networkRuntime) {
+        if (!LDi_attachnetworktask(client)) {
+            goto err11;
+        }
+    } else {
+        if (!LDi_thread_create(
+                &client->eventThread, LDi_bgeventsender, client)) {
+            goto err11;
+        }
+        threadCount++;
+
+        if (!LDi_thread_create(
+                &client->pollingThread, LDi_bgfeaturepoller, client)) {
+            goto err12;
+        }
+        threadCount++;
+
+        if (!LDi_thread_create(
+                &client->streamingThread, LDi_bgfeaturestreamer, client)) {
+            goto err12;
+        }
+        threadCount++;
     }
-    threadCount++;
 
-    LDi_rwlock_rdlock(&shared->sharedUserLock);
+    epoch = LDi_epoch_enter(&shared->userEpoch);
 
-    if (!LDi_identify(client->eventProcessor, shared->sharedUser)) {
-        LDi_rwlock_rdunlock(&shared->sharedUserLock);
+    if (!LDi_identify(client->eventProcessor, LDi_currentuser(shared))) {
+        LDi_epoch_exit(&shared->userEpoch, epoch);
 
         goto err12;
     }
 
-    LDi_rwlock_rdunlock(&shared->sharedUserLock);
+    LDi_epoch_exit(&shared->userEpoch, epoch);
 
     return client;
 
@@ -187,6 +440,8 @@ err12:
     LDi_reinitializeconnection(client);
     LDi_rwlock_wrunlock(&client->clientLock);
 
+    LDi_detachnetworktask(client);
+
     if (threadCount > 0) {
         LDi_thread_join(&client->eventThread);
     }
@@ -215,6 +470,7 @@ err5:
 err4:
     LDi_storeDestroy(&client->store);
 err3:
+    LDi_eventSpoolFree(client->eventSpool);
     LDi_freeEventProcessor(client->eventProcessor);
 err2:
     LDFree(client->mobileKey);
@@ -256,9 +512,34 @@ LDClientInit(
     }
 #endif
 
-    globalContext.sharedUser   = user;
     globalContext.sharedConfig = config;
 
+    LDi_once(&LDi_earlyonce, LDi_earlyinit);
+
+    LDi_atomic_store_ptr(&globalContext.sharedUser, user);
+
+    LDi_setUserRequest(&globalContext, LDi_newUserRequest(user));
+
+    if (!(globalContext.notifier = LDi_notifierNew())) {
+        LD_LOG(
+            LD_LOG_ERROR,
+            "failed to start notifier, callbacks will be invoked inline");
+    }
+
+    if (!(globalContext.persister = LDi_notifierNew())) {
+        LD_LOG(
+            LD_LOG_ERROR,
+            "failed to start flag persistence, flags will not be cached");
+    }
+
+    if (config->useNetworkRuntime) {
+        if (!(globalContext.networkRuntime = LDi_networkRuntimeNew())) {
+            LD_LOG(
+                LD_LOG_ERROR,
+                "failed to start network runtime, using dedicated threads");
+        }
+    }
+
     globalContext.primaryClient =
         LDi_clientInitIsolated(&globalContext, config->mobileKey);
 
@@ -327,9 +608,7 @@ LDClientSetOffline(struct LDClient *const client)
 
     HASH_ITER(hh, globalContext.clientTable, clientIter, tmp)
     {
-        LDi_rwlock_wrlock(&clientIter->clientLock);
-        clientIter->offline = LDBooleanTrue;
-        LDi_rwlock_wrunlock(&clientIter->clientLock);
+        LDi_atomic_store(&clientIter->offline, LDBooleanTrue);
     }
 }
 
@@ -351,7 +630,7 @@ LDClientSetOnline(struct LDClient *const client)
     HASH_ITER(hh, globalContext.clientTable, clientIter, tmp)
     {
         LDi_rwlock_wrlock(&clientIter->clientLock);
-        clientIter->offline = LDBooleanFalse;
+        LDi_atomic_store(&clientIter->offline, LDBooleanFalse);
         LDi_updatestatus(clientIter, LDStatusInitializing);
         LDi_rwlock_wrunlock(&clientIter->clientLock);
     }
@@ -360,8 +639,6 @@ LDClientSetOnline(struct LDClient *const client)
 LDBoolean
 LDClientIsOffline(struct LDClient *const client)
 {
-    LDBoolean offline;
-
     LD_ASSERT_API(client);
 
 #ifdef LAUNCHDARKLY_DEFENSIVE
@@ -372,11 +649,7 @@ LDClientIsOffline(struct LDClient *const client)
     }
 #endif
 
-    LDi_rwlock_rdlock(&client->clientLock);
-    offline = client->offline;
-    LDi_rwlock_rdunlock(&client->clientLock);
-
-    return offline;
+    return LDi_isoffline(client);
 }
 
 void
@@ -393,7 +666,9 @@ LDClientSetBackground(struct LDClient *const client, const LDBoolean background)
 #endif
 
     LDi_rwlock_wrlock(&client->clientLock);
-    client->background = background;
+    LDi_atomic_store(&client->background, background);
+    /* the other interval starts over rather than backed off */
+    client->pollsUnchanged = 0;
     LDi_startstopstreaming(client, background);
     LDi_rwlock_wrunlock(&client->clientLock);
 }
@@ -401,9 +676,12 @@ LDClientSetBackground(struct LDClient *const client, const LDBoolean background)
 void
 LDClientIdentify(struct LDClient *const client, struct LDUser *const user)
 {
-    struct LDClient *clientIter, *tmp;
-    struct LDUser *  previousUser;
-    LDBoolean        shouldAlias;
+    struct LDClient *     clientIter, *tmp;
+    struct LDUser *       previousUser;
+    struct LDUserRequest *request, *previousRequest;
+    struct LDCachedFlags *cached;
+    unsigned int          clientCount, i;
+    LDBoolean             shouldAlias;
 
     LD_ASSERT_API(client);
     LD_ASSERT_API(user);
@@ -422,20 +700,86 @@ LDClientIdentify(struct LDClient *const client, struct LDUser *const user)
     }
 #endif
 
-    LDi_rwlock_wrlock(&globalContext.sharedUserLock);
+    /* built before taking any locks, network requests only need this */
+    request = LDi_newUserRequest(user);
+
+    /* so is reading the flags cached for the user, only storing them is
+     * left for under the locks */
+    clientCount = HASH_COUNT(globalContext.clientTable);
+
+    if ((cached = (struct LDCachedFlags *)LDAlloc(
+             sizeof(struct LDCachedFlags) * clientCount)))
+    {
+        i = 0;
+
+        HASH_ITER(hh, globalContext.clientTable, clientIter, tmp)
+        {
+            LDi_readflagcache(clientIter, request, &cached[i++]);
+        }
+    } else {
+        LD_LOG(LD_LOG_ERROR, "failed to allocate cached flags");
+    }
+
+    LDi_mutex_lock(&globalContext.identifyLock);
+
+    /* evaluations racing with this see either user, never a partial state */
+    previousUser = (struct LDUser *)LDi_atomic_exchange_ptr(
+        &globalContext.sharedUser, user);
 
-    previousUser             = globalContext.sharedUser;
-    globalContext.sharedUser = user;
-    shouldAlias              = previousUser->anonymous && !user->anonymous &&
+    previousRequest = LDi_acquireUserRequest(&globalContext);
+    LDi_setUserRequest(&globalContext, request);
+    shouldAlias = previousUser->anonymous && !user->anonymous &&
                   !globalContext.sharedConfig->autoAliasOptOut;
 
+    i = 0;
+
     HASH_ITER(hh, globalContext.clientTable, clientIter, tmp)
     {
+        struct LDCachedFlags *const clientCached = cached ? &cached[i++] : NULL;
+        LDBoolean                   current, restored;
+
         LDi_rwlock_wrlock(&clientIter->clientLock);
 
-        LDi_updatestatus(client, LDStatusInitializing);
+        LDi_getMonotonicMilliseconds(&clientIter->identifyStarted);
+
+        /* flags requested before this belong to the previous user */
+        clientIter->identifyGeneration++;
+
+        /* true if the store holds the flags of the previous user */
+        current = LDi_getstatus(clientIter) == LDStatusInitialized &&
+                  !LDi_atomic_load(&clientIter->identifyPending);
+
+        LDi_pointflagcache(clientIter, request);
+
+        restored = (previousRequest && request &&
+                    LDi_storeSwitchUser(
+                        &clientIter->store,
+                        current ? previousRequest->json : NULL,
+                        request->json)) ||
+                   (clientCached &&
+                    LDi_storeflagcache(clientIter, clientCached));
+
+        if (restored) {
+            /* served from a cache while the connection revalidates it */
+            LDi_atomic_store(&clientIter->cachedFlags, LDBooleanTrue);
+            LDi_atomic_store(&clientIter->identifyPending, LDBooleanTrue);
+            LDi_identifycompleted(clientIter);
+            LDi_updatestatus(clientIter, LDStatusInitialized);
+        } else if (
+            LDi_getstatus(clientIter) == LDStatusInitialized &&
+            !LDi_isoffline(clientIter))
+        {
+            /* an initialized client keeps serving the flags it has until
+             * those of the new user replace them in a single put */
+            LDi_atomic_store(&clientIter->identifyPending, LDBooleanTrue);
+        } else {
+            LDi_atomic_store(&clientIter->cachedFlags, LDBooleanFalse);
+            LDi_atomic_store(&clientIter->identifyPending, LDBooleanFalse);
+            LDi_updatestatus(clientIter, LDStatusInitializing);
+        }
 
         LDi_reinitializeconnection(clientIter);
+        LDi_resetpolletag(clientIter);
         LDi_identify(clientIter->eventProcessor, user);
 
         if (shouldAlias) {
@@ -445,11 +789,120 @@ LDClientIdentify(struct LDClient *const client, struct LDUser *const user)
         LDi_rwlock_wrunlock(&clientIter->clientLock);
     }
 
+    LDi_mutex_unlock(&globalContext.identifyLock);
+
+    if (cached) {
+        for (i = 0; i < clientCount; i++) {
+            LDi_freecachedflags(&cached[i]);
+        }
+
+        LDFree(cached);
+    }
+
+    LDi_userRequestRelease(previousRequest);
+
     if (previousUser != user) {
+        /* readers that loaded the previous user may still be using it */
+        LDi_epoch_synchronize(&globalContext.userEpoch);
         LDUserFree(previousUser);
     }
+}
+
+LDBoolean
+LDClientIdentifyAwait(
+    struct LDClient *const client,
+    struct LDUser *const   user,
+    const unsigned int     timeoutmilli)
+{
+    struct LDClient *clientIter, *tmp;
+    double           deadline, now;
+    LDBoolean        switched;
+
+    LD_ASSERT_API(client);
+    LD_ASSERT_API(user);
+
+#ifdef LAUNCHDARKLY_DEFENSIVE
+    if (client == NULL) {
+        LD_LOG(LD_LOG_WARNING, "LDClientIdentifyAwait NULL client");
+
+        return LDBooleanFalse;
+    }
+
+    if (user == NULL) {
+        LD_LOG(LD_LOG_WARNING, "LDClientIdentifyAwait NULL user");
+
+        return LDBooleanFalse;
+    }
+#endif
+
+    LDClientIdentify(client, user);
+
+    LDi_getMonotonicMilliseconds(&deadline);
+    deadline += timeoutmilli;
+    switched = LDBooleanTrue;
 
-    LDi_rwlock_wrunlock(&globalContext.sharedUserLock);
+    HASH_ITER(hh, globalContext.clientTable, clientIter, tmp)
+    {
+        LDi_mutex_lock(&clientIter->initCondMtx);
+
+        while (LDi_getstatus(clientIter) == LDStatusInitializing ||
+               LDi_atomic_load(&clientIter->identifyPending))
+        {
+            const LDStatus status = LDi_getstatus(clientIter);
+
+            LDi_getMonotonicMilliseconds(&now);
+
+            if (now >= deadline || status == LDStatusFailed ||
+                status == LDStatusShuttingdown)
+            {
+                switched = LDBooleanFalse;
+
+                break;
+            }
+
+            /* the condition is signalled, not broadcast, so another waiter
+             * may consume the signal, recheck at least this often */
+            LDi_cond_wait(
+                &clientIter->initCond,
+                &clientIter->initCondMtx,
+                deadline - now < 100 ? (int)(deadline - now) + 1 : 100);
+        }
+
+        LDi_mutex_unlock(&clientIter->initCondMtx);
+    }
+
+    return switched;
+}
+
+LDBoolean
+LDClientGetIdentifyLatency(
+    struct LDClient *const client, double *const latencyMilliseconds)
+{
+    LDBoolean known;
+
+    LD_ASSERT_API(client);
+    LD_ASSERT_API(latencyMilliseconds);
+
+#ifdef LAUNCHDARKLY_DEFENSIVE
+    if (client == NULL) {
+        LD_LOG(LD_LOG_WARNING, "LDClientGetIdentifyLatency NULL client");
+
+        return LDBooleanFalse;
+    }
+
+    if (latencyMilliseconds == NULL) {
+        LD_LOG(LD_LOG_WARNING, "LDClientGetIdentifyLatency NULL latency");
+
+        return LDBooleanFalse;
+    }
+#endif
+
+    LDi_rwlock_rdlock(&client->clientLock);
+    known                = client->identifyLatency >= 0;
+    *latencyMilliseconds = client->identifyLatency;
+    LDi_rwlock_rdunlock(&client->clientLock);
+
+    return known;
 }
 
 void
@@ -464,16 +917,29 @@ clientCloseIsolated(struct LDClient *const client)
 
     LDi_mutex_lock(&client->condMtx);
     LDi_cond_signal(&client->initCond);
-    LDi_cond_signal(&client->eventCond);
-    LDi_cond_signal(&client->pollCond);
-    LDi_cond_signal(&client->streamCond);
+    LDi_signalbackground(client, LD_SIGNAL_ALL);
     LDi_mutex_unlock(&client->condMtx);
 
-    LDi_thread_join(&client->eventThread);
-    LDi_thread_join(&client->pollingThread);
-    LDi_thread_join(&client->streamingThread);
+    if (client->networkTask) {
+        LDi_detachnetworktask(client);
+    } else {
+        LDi_thread_join(&client->eventThread);
+        LDi_thread_join(&client->pollingThread);
+        LDi_thread_join(&client->streamingThread);
+    }
+
+    /* nothing is notified anymore, deliver whatever is left for the store
+     * before destroying it */
+    if (client->shared->notifier) {
+        LDi_notifierFlush(client->shared->notifier);
+    }
+
+    if (client->shared->persister) {
+        LDi_notifierFlush(client->shared->persister);
+    }
 
     LDi_freeEventProcessor(client->eventProcessor);
+    LDi_eventSpoolFree(client->eventSpool);
     LDi_storeDestroy(&client->store);
 
     LDi_rwlock_destroy(&client->clientLock);
@@ -484,6 +950,8 @@ clientCloseIsolated(struct LDClient *const client)
     LDi_cond_destroy(&client->initCond);
     LDi_cond_destroy(&client->eventCond);
     LDi_cond_destroy(&client->pollCond);
+    LDi_cond_destroy(&client->streamCond);
+    LDFree(client->pollETag);
     LDFree(client->mobileKey);
 
     LDFree(client);
@@ -501,20 +969,43 @@ LDClientClose(struct LDClient *const client)
             clientCloseIsolated(clientIter);
         }
 
-        LDUserFree(globalContext.sharedUser);
+        LDi_networkRuntimeFree(globalContext.networkRuntime);
+        LDi_notifierFree(globalContext.notifier);
+        LDi_notifierFree(globalContext.persister);
+        LDi_setUserRequest(&globalContext, NULL);
+
+        LDUserFree((struct LDUser *)LDi_atomic_exchange_ptr(
+            &globalContext.sharedUser, NULL));
         LDConfigFree(globalContext.sharedConfig);
 
         globalContext.sharedConfig  = NULL;
         globalContext.primaryClient = NULL;
         globalContext.clientTable   = NULL;
+        globalContext.networkRuntime = NULL;
+        globalContext.notifier       = NULL;
+        globalContext.persister      = NULL;
     }
 }
 
 LDBoolean
-LDClientIsInitialized(struct LDClient *const client)
+LDClientIsUsingCachedFlags(struct LDClient *const client)
 {
-    LDBoolean isInit;
+    LD_ASSERT_API(client);
+
+#ifdef LAUNCHDARKLY_DEFENSIVE
+    if (client == NULL) {
+        LD_LOG(LD_LOG_WARNING, "LDClientIsUsingCachedFlags NULL client");
+
+        return LDBooleanFalse;
+    }
+#endif
+
+    return LDi_atomic_load(&client->cachedFlags);
+}
 
+LDBoolean
+LDClientIsInitialized(struct LDClient *const client)
+{
     LD_ASSERT_API(client);
 
 #ifdef LAUNCHDARKLY_DEFENSIVE
@@ -525,19 +1016,13 @@ LDClientIsInitialized(struct LDClient *const client)
     }
 #endif
 
-    LDi_rwlock_rdlock(&client->clientLock);
-    isInit = client->status == LDStatusInitialized;
-    LDi_rwlock_rdunlock(&client->clientLock);
-
-    return isInit;
+    return LDi_getstatus(client) == LDStatusInitialized;
 }
 
 LDBoolean
 LDClientAwaitInitialized(
     struct LDClient *const client, const unsigned int timeoutmilli)
 {
-    LDBoolean isInit;
-
     LD_ASSERT_API(client);
 
 #ifdef LAUNCHDARKLY_DEFENSIVE
@@ -549,25 +1034,17 @@ LDClientAwaitInitialized(
 #endif
 
     LDi_mutex_lock(&client->initCondMtx);
-    LDi_rwlock_rdlock(&client->clientLock);
 
-    if (client->status == LDStatusInitialized) {
-        LDi_rwlock_rdunlock(&client->clientLock);
+    if (LDi_getstatus(client) == LDStatusInitialized) {
         LDi_mutex_unlock(&client->initCondMtx);
 
         return LDBooleanTrue;
     }
 
-    LDi_rwlock_rdunlock(&client->clientLock);
-
     LDi_cond_wait(&client->initCond, &client->initCondMtx, timeoutmilli);
     LDi_mutex_unlock(&client->initCondMtx);
 
-    LDi_rwlock_rdlock(&client->clientLock);
-    isInit = client->status == LDStatusInitialized;
-    LDi_rwlock_rdunlock(&client->clientLock);
-
-    return isInit;
+    return LDi_getstatus(client) == LDStatusInitialized;
 }
 
 void
@@ -615,10 +1092,113 @@ LDClientSaveFlags(struct LDClient *const client)
 LDBoolean
 LDClientRestoreFlags(struct LDClient *const client, const char *const data)
 {
+    unsigned int generation;
+
     LD_ASSERT_API(client);
     LD_ASSERT_API(data);
 
-    return LDi_onstreameventput(client, data);
+    LDi_rwlock_wrlock(&client->clientLock);
+    LDi_resetpolletag(client);
+    generation = client->identifyGeneration;
+    LDi_rwlock_wrunlock(&client->clientLock);
+
+    return LDi_onstreameventput(client, generation, data);
+}
+
+LDBoolean
+LDClientSaveFlagsFile(struct LDClient *const client, const char *const path)
+{
+    struct LDStoreNode **nodes;
+    struct LDFlag **     flags;
+    unsigned int         nodeCount, flagCount, i;
+    LDBoolean            saved;
+
+    LD_ASSERT_API(client);
+    LD_ASSERT_API(path);
+
+#ifdef LAUNCHDARKLY_DEFENSIVE
+    if (client == NULL) {
+        LD_LOG(LD_LOG_WARNING, "LDClientSaveFlagsFile NULL client");
+
+        return LDBooleanFalse;
+    }
+
+    if (path == NULL) {
+        LD_LOG(LD_LOG_WARNING, "LDClientSaveFlagsFile NULL path");
+
+        return LDBooleanFalse;
+    }
+#endif
+
+    if (!LDi_storeGetAll(&client->store, &nodes, &nodeCount)) {
+        return LDBooleanFalse;
+    }
+
+    flags     = NULL;
+    flagCount = 0;
+    saved     = LDBooleanFalse;
+
+    if (nodeCount &&
+        !(flags = (struct LDFlag **)LDAlloc(sizeof(struct LDFlag *) * nodeCount)))
+    {
+        goto cleanup;
+    }
+
+    for (i = 0; i < nodeCount; i++) {
+        if (!nodes[i]->flag.deleted) {
+            flags[flagCount++] = &nodes[i]->flag;
+        }
+    }
+
+    saved = LDi_flagImageSave(
+        path, (const struct LDFlag *const *)flags, flagCount);
+
+cleanup:
+    for (i = 0; i < nodeCount; i++) {
+        LDi_rc_decrement(&nodes[i]->rc);
+    }
+
+    LDFree(nodes);
+    LDFree(flags);
+
+    return saved;
+}
+
+LDBoolean
+LDClientRestoreFlagsFile(struct LDClient *const client, const char *const path)
+{
+    struct LDFlagImage *image;
+
+    LD_ASSERT_API(client);
+    LD_ASSERT_API(path);
+
+#ifdef LAUNCHDARKLY_DEFENSIVE
+    if (client == NULL) {
+        LD_LOG(LD_LOG_WARNING, "LDClientRestoreFlagsFile NULL client");
+
+        return LDBooleanFalse;
+    }
+
+    if (path == NULL) {
+        LD_LOG(LD_LOG_WARNING, "LDClientRestoreFlagsFile NULL path");
+
+        return LDBooleanFalse;
+    }
+#endif
+
+    if (!(image = LDi_flagImageOpen(path))) {
+        return LDBooleanFalse;
+    }
+
+    LDi_storePutImage(&client->store, image);
+
+    LDi_rwlock_wrlock(&client->clientLock);
+    LDi_resetpolletag(client);
+    LDi_identifycompleted(client);
+    LDi_updatestatus(client, LDStatusInitialized);
+    LDi_rwlock_wrunlock(&client->clientLock);
+
+    return LDBooleanTrue;
 }
 
 struct LDJSON *
@@ -653,7 +1233,7 @@ LDAllFlags(struct LDClient *const client)
 
         if (!flags[i]->flag.deleted)
         {
-            if (!(tmp = LDJSONDuplicate(flags[i]->flag.value)))
+            if (!(tmp = LDi_storeCopyValue(&client->store, flags[i])))
             {
                 goto error;
             }
@@ -789,6 +1369,7 @@ LDi_evalInternal(
     struct LDStoreNode **const selected)
 {
     struct LDStoreNode *node;
+    int                 epoch;
 
     LD_ASSERT_API(client);
     LD_ASSERT_API(flagKey);
@@ -831,11 +1412,11 @@ LDi_evalInternal(
         *resultValue = fallbackValue;
     }
 
-    LDi_rwlock_rdlock(&client->shared->sharedUserLock);
+    epoch = LDi_epoch_enter(&client->shared->userEpoch);
 
     LDi_processEvalEvent(
         client->eventProcessor,
-        client->shared->sharedUser,
+        LDi_currentuser(client->shared),
         flagKey,
         variationKind,
         node,
@@ -843,7 +1424,7 @@ LDi_evalInternal(
         fallbackValue,
         selected != NULL);
 
-    LDi_rwlock_rdunlock(&client->shared->sharedUserLock);
+    LDi_epoch_exit(&client->shared->userEpoch, epoch);
 
     if (selected) {
         *selected = node;
@@ -1090,6 +1671,29 @@ LDStringVariationAlloc(
     return LDStrDup(value);
 }
 
+/* Copies the result of a JSON evaluation for the caller, decoding it if it
+ * is the lazy value of the selected node, and releases the node */
+static struct LDJSON *
+LDi_copyVariation(
+    struct LDClient *const     client,
+    const struct LDJSON *const value,
+    struct LDStoreNode *const  selected)
+{
+    struct LDJSON *result;
+
+    if (selected && value == selected->flag.value) {
+        result = LDi_storeCopyValue(&client->store, selected);
+    } else {
+        result = LDJSONDuplicate(value);
+    }
+
+    if (selected) {
+        LDi_rc_decrement(&selected->rc);
+    }
+
+    return result;
+}
+
 struct LDJSON *
 LDJSONVariationDetail(
     struct LDClient *const     client,
@@ -1121,11 +1725,8 @@ LDJSONVariationDetail(
     LDi_evalInternal(
         client, key, LDNull, (void *)fallback, (void **)&value, &selected);
     fillDetails(client, key, selected, details, LDNull);
-    if (selected) {
-        LDi_rc_decrement(&selected->rc);
-    }
 
-    return LDJSONDuplicate(value);
+    return LDi_copyVariation(client, value, selected);
 }
 
 struct LDJSON *
@@ -1135,15 +1736,16 @@ LDJSONVariation(
     const struct LDJSON *const fallback)
 {
     const struct LDJSON *value;
+    struct LDStoreNode * selected;
 
     LD_ASSERT_API(client);
     LD_ASSERT_API(key);
     LD_ASSERT_API(fallback);
 
     LDi_evalInternal(
-        client, key, LDNull, (void *)fallback, (void **)&value, NULL);
+        client, key, LDNull, (void *)fallback, (void **)&value, &selected);
 
-    return LDJSONDuplicate(value);
+    return LDi_copyVariation(client, value, selected);
 }
 
 void
@@ -1182,6 +1784,8 @@ LDClientAlias(
 void
 LDClientTrack(struct LDClient *const client, const char *const name)
 {
+    int epoch;
+
     LD_ASSERT_API(client);
     LD_ASSERT_API(name);
 
@@ -1199,15 +1803,15 @@ LDClientTrack(struct LDClient *const client, const char *const name)
     }
 #endif
 
-    LDi_rwlock_rdlock(&client->shared->sharedUserLock);
+    epoch = LDi_epoch_enter(&client->shared->userEpoch);
     LDi_track(
         client->eventProcessor,
-        client->shared->sharedUser,
+        LDi_currentuser(client->shared),
         name,
         NULL,
         0,
         LDBooleanFalse);
-    LDi_rwlock_rdunlock(&client->shared->sharedUserLock);
+    LDi_epoch_exit(&client->shared->userEpoch, epoch);
 }
 
 void
@@ -1216,6 +1820,8 @@ LDClientTrackData(
     const char *const      name,
     struct LDJSON *const   data)
 {
+    int epoch;
+
     LD_ASSERT_API(client);
     LD_ASSERT_API(name);
 
@@ -1233,15 +1839,15 @@ LDClientTrackData(
     }
 #endif
 
-    LDi_rwlock_rdlock(&client->shared->sharedUserLock);
+    epoch = LDi_epoch_enter(&client->shared->userEpoch);
     LDi_track(
         client->eventProcessor,
-        client->shared->sharedUser,
+        LDi_currentuser(client->shared),
         name,
         data,
         0,
         LDBooleanFalse);
-    LDi_rwlock_rdunlock(&client->shared->sharedUserLock);
+    LDi_epoch_exit(&client->shared->userEpoch, epoch);
 }
 
 void
@@ -1251,6 +1857,8 @@ LDClientTrackMetric(
     struct LDJSON *const   data,
     const double           metric)
 {
+    int epoch;
+
     LD_ASSERT_API(client);
     LD_ASSERT_API(name);
 
@@ -1268,15 +1876,15 @@ LDClientTrackMetric(
     }
 #endif
 
-    LDi_rwlock_rdlock(&client->shared->sharedUserLock);
+    epoch = LDi_epoch_enter(&client->shared->userEpoch);
     LDi_track(
         client->eventProcessor,
-        client->shared->sharedUser,
+        LDi_currentuser(client->shared),
         name,
         data,
         metric,
         LDBooleanTrue);
-    LDi_rwlock_rdunlock(&client->shared->sharedUserLock);
+    LDi_epoch_exit(&client->shared->userEpoch, epoch);
 }
 
 void
@@ -1296,7 +1904,7 @@ LDClientFlush(struct LDClient *const client)
 
     HASH_ITER(hh, globalContext.clientTable, clientIter, tmp)
     {
-        LDi_cond_signal(&clientIter->eventCond);
+        LDi_signalbackground(clientIter, LD_SIGNAL_EVENTS);
     }
 }
 
@@ -1370,15 +1978,77 @@ LDClientUnregisterFeatureFlagListener(
     LDi_storeUnregisterListener(&client->store, key, fn);
 }
 
+LDBoolean
+LDClientRegisterAllFlagsListener(
+    struct LDClient *const     client,
+    LDallflagslistenerfn       fn,
+    void *const                userData)
+{
+    LD_ASSERT_API(client);
+    LD_ASSERT_API(fn);
+
+#ifdef LAUNCHDARKLY_DEFENSIVE
+    if (client == NULL) {
+        LD_LOG(LD_LOG_WARNING, "LDClientRegisterAllFlagsListener NULL client");
+
+        return LDBooleanFalse;
+    }
+
+    if (fn == NULL) {
+        LD_LOG(
+            LD_LOG_WARNING, "LDClientRegisterAllFlagsListener NULL listener");
+
+        return LDBooleanFalse;
+    }
+#endif
+
+    return LDi_storeRegisterAllFlagsListener(&client->store, fn, userData);
+}
+
+void
+LDClientUnregisterAllFlagsListener(
+    struct LDClient *const client, LDallflagslistenerfn fn)
+{
+    LD_ASSERT_API(client);
+    LD_ASSERT_API(fn);
+
+#ifdef LAUNCHDARKLY_DEFENSIVE
+    if (client == NULL) {
+        LD_LOG(
+            LD_LOG_WARNING, "LDClientUnregisterAllFlagsListener NULL client");
+
+        return;
+    }
+
+    if (fn == NULL) {
+        LD_LOG(
+            LD_LOG_WARNING, "LDClientUnregisterAllFlagsListener NULL listener");
+
+        return;
+    }
+#endif
+
+    LDi_storeUnregisterAllFlagsListener(&client->store, fn);
+}
+
 void
 LDi_updatestatus(struct LDClient *const client, const LDStatus status)
 {
-    if (client->status != status) {
-        client->status = status;
+    if (LDi_getstatus(client) != status) {
+        LDi_atomic_store(&client->status, status);
         if (LDi_statuscallback_closure.callback) {
-            LDi_rwlock_wrunlock(&client->clientLock);
-            LDi_statuscallback_closure.callback(status, LDi_statuscallback_closure.userData);
-            LDi_rwlock_wrlock(&client->clientLock);
+            if (client->shared->notifier) {
+                /* not coalesced, every transition is reported */
+                if (!LDi_notify(client->shared->notifier,
+                        LDi_deliverstatus, NULL, NULL, status))
+                {
+                    LD_LOG(LD_LOG_ERROR, "failed to queue status callback");
+                }
+            } else {
+                LDi_rwlock_wrunlock(&client->clientLock);
+                LDi_statuscallback_closure.callback(status, LDi_statuscallback_closure.userData);
+                LDi_rwlock_wrlock(&client->clientLock);
+            }
         }
     }
     LDi_cond_signal(&client->initCond);
@@ -1389,3 +2059,58 @@ LDFreeDetailContents(LDVariationDetails details)
 {
     LDJSONFree(details.reason);
 }
+
+LDStatus
+LDi_getstatus(struct LDClient *const client)
+{
+    return (LDStatus)LDi_atomic_load(&client->status);
+}
+
+LDBoolean
+LDi_isoffline(struct LDClient *const client)
+{
+    return (LDBoolean)LDi_atomic_load(&client->offline);
+}
+
+LDBoolean
+LDi_isbackground(struct LDClient *const client)
+{
+    return (LDBoolean)LDi_atomic_load(&client->background);
+}
+
+LDBoolean
+LDi_awaitingflags(struct LDClient *const client)
+{
+    return LDi_getstatus(client) == LDStatusInitializing ||
+           LDi_atomic_load(&client->identifyPending) ||
+           LDi_atomic_load(&client->cachedFlags);
+}
+
+void
+LDi_identifycompleted(struct LDClient *const client)
+{
+    double now;
+
+    if (LDi_atomic_exchange(&client->identifyPending, LDBooleanFalse)) {
+        LDi_getMonotonicMilliseconds(&now);
+
+        client->identifyLatency = now - client->identifyStarted;
+
+        LD_LOG_1(
+            LD_LOG_DEBUG,
+            "identify stored new flags after %.0f milliseconds",
+            client->identifyLatency);
+    }
+}
+
+unsigned int
+LDi_identifygeneration(struct LDClient *const client)
+{
+    unsigned int generation;
+
+    LDi_rwlock_rdlock(&client->clientLock);
+    generation = client->identifyGeneration;
+    LDi_rwlock_rdunlock(&client->clientLock);
+
+    return generation;
+}
@@ -7,13 +7,31 @@
 #include "user.h"
 #include "socket.h"
 
+struct LDNetworkRuntime;
+struct LDNotifier;
+struct LDClientNetworkTask;
+struct LDUserRequest;
+struct LDEventSpool;
+
 struct LDGlobal_i
 {
     struct LDClient *clientTable;
     struct LDClient *primaryClient;
     struct LDConfig *sharedConfig;
-    struct LDUser *  sharedUser;
-    ld_rwlock_t      sharedUserLock;
+    /* struct LDUser *, immutable once published. Read inside userEpoch,
+     * replaced under identifyLock, and freed after a grace period. */
+    ld_atomic_ptr_t   sharedUser;
+    struct ld_epoch_t userEpoch;
+    ld_mutex_t        identifyLock;
+    /* request form of sharedUser, only replaced under userRequestLock */
+    struct LDUserRequest *userRequest;
+    ld_mutex_t            userRequestLock;
+    /* NULL unless the shared network thread is in use */
+    struct LDNetworkRuntime *networkRuntime;
+    /* delivers listener and status callbacks, NULL if it failed to start */
+    struct LDNotifier *notifier;
+    /* writes flag caches, NULL if it failed to start */
+    struct LDNotifier *persister;
 };
 
 struct LDClient
@@ -21,9 +39,11 @@ struct LDClient
     struct LDGlobal_i *    shared;
     char *                 mobileKey;
     ld_rwlock_t            clientLock;
-    LDBoolean              offline;
-    LDBoolean              background;
-    LDStatus               status;
+    /* LDBoolean, LDBoolean, and LDStatus. Read without clientLock, which
+     * is only held to change these together with other state. */
+    ld_atomic_int_t        offline;
+    ld_atomic_int_t        background;
+    ld_atomic_int_t        status;
     ld_thread_t            eventThread;
     ld_thread_t            pollingThread;
     ld_thread_t            streamingThread;
@@ -31,10 +51,36 @@ struct LDClient
     ld_cond_t              pollCond;
     ld_cond_t              streamCond;
     ld_mutex_t             condMtx;
-    LDBoolean              shouldstopstreaming;
+    /* replaces the threads above when a network runtime is in use */
+    struct LDClientNetworkTask *networkTask;
+    ld_atomic_int_t        shouldstopstreaming;
     struct ld_socket_state streamhandle;
     struct EventProcessor *eventProcessor;
+    /* NULL unless configured, only used by whichever thread sends events */
+    struct LDEventSpool *eventSpool;
     struct LDStore         store;
+    /* entity tag of the flags last stored by a poll, guarded by clientLock */
+    char *pollETag;
+    /* counts resets of pollETag, so that a poll issued before one can tell
+     * its response is stale, guarded by clientLock */
+    unsigned int pollGeneration;
+    /* consecutive polls that left the store unchanged, restarted along with
+     * pollETag and on switching to or from the background, guarded by
+     * clientLock */
+    unsigned int pollsUnchanged;
+    /* counts identifies, so that a connection or poll issued before one can
+     * tell its flags are those of a previous user, guarded by clientLock */
+    unsigned int identifyGeneration;
+    /* LDBoolean, set while the store still holds the flags of the user
+     * before the latest identify. Read without clientLock. */
+    ld_atomic_int_t identifyPending;
+    /* LDBoolean, set while serving flags restored from a cache that
+     * LaunchDarkly has not confirmed yet. Read without clientLock. */
+    ld_atomic_int_t cachedFlags;
+    /* monotonic milliseconds at which the pending identify started, and how
+     * long the last one took to store its flags, guarded by clientLock */
+    double identifyStarted;
+    double identifyLatency;
     ld_cond_t              initCond;
     ld_mutex_t             initCondMtx;
     UT_hash_handle         hh;
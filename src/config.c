@@ -64,6 +64,7 @@ LDConfigNew(const char *const mobileKey)
     config->eventsFlushIntervalMillis       = 30000;
     config->offline                         = LDBooleanFalse;
     config->pollingIntervalMillis           = 30 * 1000;
+    config->maxPollingIntervalMillis        = 0;
     config->privateAttributeNames           = NULL;
     config->streaming                       = LDBooleanTrue;
     config->useReport                       = LDBooleanFalse;
@@ -78,6 +79,16 @@ LDConfigNew(const char *const mobileKey)
     config->streamURI                       = NULL;
     config->secondaryMobileKeys             = NULL;
     config->autoAliasOptOut                 = 0;
+    config->useNetworkRuntime               = LDBooleanFalse;
+    config->compressEvents                  = LDBooleanFalse;
+    config->eventsMaxConcurrentRequests     = 1;
+    config->eventsMaxPayloadBytes           = 0;
+    config->eventSpoolDirectory             = NULL;
+    config->eventSpoolMaxBytes              = 0;
+    config->flagCacheDirectory              = NULL;
+    config->userCacheMaxUsers               = 0;
+    config->userCacheMaxBytes               = 0;
+    config->flagParseThreads                = 1;
 
     if (!LDSetString(&config->appURI, "https://app.launchdarkly.com")) {
         goto error;
@@ -270,6 +281,42 @@ LDConfigSetEventsFlushIntervalMillis(
     config->eventsFlushIntervalMillis = millis;
 }
 
+void
+LDConfigSetEventsMaxConcurrentRequests(
+    struct LDConfig *const config, const unsigned int requests)
+{
+    LD_ASSERT_API(config);
+
+#ifdef LAUNCHDARKLY_DEFENSIVE
+    if (config == NULL) {
+        LD_LOG(
+            LD_LOG_WARNING,
+            "LDConfigSetEventsMaxConcurrentRequests NULL config");
+
+        return;
+    }
+#endif
+
+    config->eventsMaxConcurrentRequests = requests > 0 ? requests : 1;
+}
+
+void
+LDConfigSetEventsMaxPayloadBytes(
+    struct LDConfig *const config, const unsigned int bytes)
+{
+    LD_ASSERT_API(config);
+
+#ifdef LAUNCHDARKLY_DEFENSIVE
+    if (config == NULL) {
+        LD_LOG(LD_LOG_WARNING, "LDConfigSetEventsMaxPayloadBytes NULL config");
+
+        return;
+    }
+#endif
+
+    config->eventsMaxPayloadBytes = bytes;
+}
+
 LDBoolean
 LDConfigSetEventsURI(struct LDConfig *const config, const char *const uri)
 {
@@ -373,6 +420,24 @@ LDConfigSetPollingIntervalMillis(
     }
 }
 
+void
+LDConfigSetMaxPollingIntervalMillis(
+    struct LDConfig *const config, const int millis)
+{
+    LD_ASSERT_API(config);
+
+#ifdef LAUNCHDARKLY_DEFENSIVE
+    if (config == NULL) {
+        LD_LOG(
+            LD_LOG_WARNING, "LDConfigSetMaxPollingIntervalMillis NULL config");
+
+        return;
+    }
+#endif
+
+    config->maxPollingIntervalMillis = millis > 0 ? millis : 0;
+}
+
 LDBoolean
 LDConfigSetStreamURI(struct LDConfig *const config, const char *const uri)
 {
@@ -604,6 +669,156 @@ LDConfigAutoAliasOptOut(struct LDConfig *const config, const LDBoolean optOut)
     config->autoAliasOptOut = optOut;
 }
 
+void
+LDConfigSetUseNetworkRuntime(
+    struct LDConfig *const config, const LDBoolean useRuntime)
+{
+    LD_ASSERT_API(config);
+
+#ifdef LAUNCHDARKLY_DEFENSIVE
+    if (config == NULL) {
+        LD_LOG(LD_LOG_WARNING, "LDConfigSetUseNetworkRuntime NULL config");
+
+        return;
+    }
+#endif
+
+    config->useNetworkRuntime = useRuntime;
+}
+
+void
+LDConfigSetCompressEvents(
+    struct LDConfig *const config, const LDBoolean compress)
+{
+    LD_ASSERT_API(config);
+
+#ifdef LAUNCHDARKLY_DEFENSIVE
+    if (config == NULL) {
+        LD_LOG(LD_LOG_WARNING, "LDConfigSetCompressEvents NULL config");
+
+        return;
+    }
+#endif
+
+#ifndef LAUNCHDARKLY_HAVE_ZLIB
+    if (compress) {
+        LD_LOG(
+            LD_LOG_WARNING,
+            "LDConfigSetCompressEvents built without zlib, ignoring");
+    }
+#endif
+
+    config->compressEvents = compress;
+}
+
+LDBoolean
+LDConfigSetEventSpool(
+    struct LDConfig *const config,
+    const char *const      directory,
+    const unsigned int     maxBytes)
+{
+    unsigned int minimum;
+
+    LD_ASSERT_API(config);
+    LD_ASSERT_API(directory);
+
+#ifdef LAUNCHDARKLY_DEFENSIVE
+    if (config == NULL) {
+        LD_LOG(LD_LOG_WARNING, "LDConfigSetEventSpool NULL config");
+
+        return LDBooleanFalse;
+    }
+
+    if (directory == NULL) {
+        LD_LOG(LD_LOG_WARNING, "LDConfigSetEventSpool NULL directory");
+
+        return LDBooleanFalse;
+    }
+#endif
+
+    if (!LDi_setTrimmedString(&config->eventSpoolDirectory, directory)) {
+        return LDBooleanFalse;
+    }
+
+    /* each segment of the spool holds an eighth of this, which must leave
+     * room for whole payloads */
+    minimum = 256 * 1024;
+
+    if (maxBytes >= minimum) {
+        config->eventSpoolMaxBytes = maxBytes;
+    } else {
+        LD_LOG_1(
+            LD_LOG_WARNING,
+            "LDConfigSetEventSpool maxBytes below minimum, using %u",
+            minimum);
+
+        config->eventSpoolMaxBytes = minimum;
+    }
+
+    return LDBooleanTrue;
+}
+
+LDBoolean
+LDConfigSetFlagCacheDirectory(
+    struct LDConfig *const config, const char *const directory)
+{
+    LD_ASSERT_API(config);
+    LD_ASSERT_API(directory);
+
+#ifdef LAUNCHDARKLY_DEFENSIVE
+    if (config == NULL) {
+        LD_LOG(LD_LOG_WARNING, "LDConfigSetFlagCacheDirectory NULL config");
+
+        return LDBooleanFalse;
+    }
+
+    if (directory == NULL) {
+        LD_LOG(LD_LOG_WARNING, "LDConfigSetFlagCacheDirectory NULL directory");
+
+        return LDBooleanFalse;
+    }
+#endif
+
+    return LDi_setTrimmedString(&config->flagCacheDirectory, directory);
+}
+
+void
+LDConfigSetUserCache(
+    struct LDConfig *const config,
+    const unsigned int     maxUsers,
+    const unsigned int     maxBytes)
+{
+    LD_ASSERT_API(config);
+
+#ifdef LAUNCHDARKLY_DEFENSIVE
+    if (config == NULL) {
+        LD_LOG(LD_LOG_WARNING, "LDConfigSetUserCache NULL config");
+
+        return;
+    }
+#endif
+
+    config->userCacheMaxUsers = maxUsers;
+    config->userCacheMaxBytes = maxBytes;
+}
+
+void
+LDConfigSetFlagParseThreads(
+    struct LDConfig *const config, const unsigned int threads)
+{
+    LD_ASSERT_API(config);
+
+#ifdef LAUNCHDARKLY_DEFENSIVE
+    if (config == NULL) {
+        LD_LOG(LD_LOG_WARNING, "LDConfigSetFlagParseThreads NULL config");
+
+        return;
+    }
+#endif
+
+    config->flagParseThreads = threads > 0 ? threads : 1;
+}
+
 void
 LDConfigFree(struct LDConfig *const config)
 {
@@ -614,6 +829,8 @@ LDConfigFree(struct LDConfig *const config)
         LDFree(config->streamURI);
         LDFree(config->proxyURI);
         LDFree(config->certFile);
+        LDFree(config->eventSpoolDirectory);
+        LDFree(config->flagCacheDirectory);
         LDJSONFree(config->privateAttributeNames);
         LDJSONFree(config->secondaryMobileKeys);
         LDFree(config);
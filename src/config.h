@@ -14,9 +14,12 @@ struct LDConfig
     unsigned int eventsCapacity;
     int          eventsFlushIntervalMillis;
     char *       eventsURI;
+    unsigned int eventsMaxConcurrentRequests;
+    unsigned int eventsMaxPayloadBytes;
     char *       mobileKey;
     LDBoolean    offline;
     int          pollingIntervalMillis;
+    int          maxPollingIntervalMillis;
     LDBoolean    streaming;
     char *       streamURI;
     LDBoolean    useReport;
@@ -26,6 +29,18 @@ struct LDConfig
     char *       certFile;
     LDBoolean    inlineUsersInEvents;
     LDBoolean    autoAliasOptOut;
+    LDBoolean    useNetworkRuntime;
+    LDBoolean    compressEvents;
+    /* NULL unless undelivered events should be spooled to disk */
+    char *       eventSpoolDirectory;
+    unsigned int eventSpoolMaxBytes;
+    /* NULL unless flags should persist across runs */
+    char *       flagCacheDirectory;
+    /* flags kept for recent users, disabled while userCacheMaxUsers is 0 */
+    unsigned int userCacheMaxUsers;
+    unsigned int userCacheMaxBytes;
+    /* threads parsing large puts, including the receiving thread */
+    unsigned int flagParseThreads;
     /* map of name -> key */
     struct LDJSON *secondaryMobileKeys;
     /* array of strings */
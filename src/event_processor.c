@@ -31,10 +31,20 @@ LDi_newEventProcessor(const struct LDConfig *const config)
     context->lastUserKeyFlush = 0;
     context->lastServerTime   = 0;
     context->config           = config;
+    context->eventUserOf      = NULL;
+    context->eventUser        = NULL;
+    context->events           = NULL;
+    context->summaryCounters  = NULL;
 
     LDi_getMonotonicMilliseconds(&context->lastUserKeyFlush);
     LDi_mutex_init(&context->lock);
 
+    if (!LDi_newPrivateAttributes(
+            &context->privateAttributes, config->privateAttributeNames))
+    {
+        goto error;
+    }
+
     if (!(context->events = LDNewArray())) {
         goto error;
     }
@@ -58,6 +68,8 @@ LDi_freeEventProcessor(struct EventProcessor *const context)
         LDi_mutex_destroy(&context->lock);
         LDJSONFree(context->events);
         LDJSONFree(context->summaryCounters);
+        LDJSONFree(context->eventUser);
+        LDi_freePrivateAttributes(&context->privateAttributes);
         LDFree(context);
     }
 }
@@ -127,6 +139,22 @@ error:
     return NULL;
 }
 
+/* Returns the event form of user, shared with other events when it is the
+ * last identified user */
+static struct LDJSON *
+LDi_eventUserFor(
+    const struct EventProcessor *const context, const struct LDUser *const user)
+{
+    if (context->eventUser && user == context->eventUserOf) {
+        return LDi_retainJSON(context->eventUser);
+    }
+
+    return LDi_createEventUser(
+        user,
+        context->config->allAttributesPrivate,
+        context->privateAttributes);
+}
+
 LDBoolean
 LDi_addUserInfoToEvent(
     const struct EventProcessor *const context,
@@ -140,11 +168,7 @@ LDi_addUserInfoToEvent(
     LD_ASSERT(user);
 
     if (context->config->inlineUsersInEvents) {
-        if (!(tmp = LDi_createEventUser(
-                  user,
-                  context->config->allAttributesPrivate,
-                  context->config->privateAttributeNames)))
-        {
+        if (!(tmp = LDi_eventUserFor(context, user))) {
             LD_LOG(LD_LOG_ERROR, "alloc error");
 
             return LDBooleanFalse;
@@ -213,11 +237,7 @@ LDi_newIdentifyEvent(
         return LDBooleanFalse;
     }
 
-    if (!(tmp = LDi_createEventUser(
-              user,
-              context->config->allAttributesPrivate,
-              context->config->privateAttributeNames)))
-    {
+    if (!(tmp = LDi_eventUserFor(context, user))) {
         LD_LOG(LD_LOG_ERROR, "alloc error");
 
         LDJSONFree(event);
@@ -241,7 +261,7 @@ LDBoolean
 LDi_identify(
     struct EventProcessor *const context, const struct LDUser *const user)
 {
-    struct LDJSON *event;
+    struct LDJSON *event, *eventUser, *shared, *previous;
     double         now;
 
     LD_ASSERT(context);
@@ -249,18 +269,57 @@ LDi_identify(
 
     LDi_getUnixMilliseconds(&now);
 
-    if (!(event = LDi_newIdentifyEvent(context, user, now))) {
-        LD_LOG(LD_LOG_ERROR, "failed to construct identify event");
+    /* rendered once here, and then shared by all events for this user */
+    if (!(eventUser = LDi_createEventUser(
+              user,
+              context->config->allAttributesPrivate,
+              context->privateAttributes)))
+    {
+        LD_LOG(LD_LOG_ERROR, "failed to construct event user");
+
+        /* the previous user is freed once replaced, and another may later
+         * be allocated at its address */
+        LDi_mutex_lock(&context->lock);
+        eventUser            = context->eventUser;
+        context->eventUserOf = NULL;
+        context->eventUser   = NULL;
+        LDi_mutex_unlock(&context->lock);
+
+        LDJSONFree(eventUser);
 
         return LDBooleanFalse;
     }
 
+    /* left unshared on failure, then every event copies it instead */
+    if ((shared = LDi_shareJSON(eventUser))) {
+        eventUser = shared;
+    }
+
     LDi_mutex_lock(&context->lock);
 
+    /* replaced even for the same address, which may be a new user in the
+     * memory of a freed one */
+    previous             = context->eventUser;
+    context->eventUserOf = user;
+    context->eventUser   = eventUser;
+    eventUser            = previous;
+
+    if (!(event = LDi_newIdentifyEvent(context, user, now))) {
+        LDi_mutex_unlock(&context->lock);
+
+        LD_LOG(LD_LOG_ERROR, "failed to construct identify event");
+
+        LDJSONFree(eventUser);
+
+        return LDBooleanFalse;
+    }
+
     LDi_addEvent(context, event);
 
     LDi_mutex_unlock(&context->lock);
 
+    LDJSONFree(eventUser);
+
     return LDBooleanTrue;
 }
 
@@ -715,7 +774,7 @@ LDi_valueToJSON(const void *const value, const LDJSONType valueType)
 
     switch (valueType) {
     case LDNull:
-        tmp = LDJSONDuplicate((struct LDJSON *)value);
+        tmp = LDi_retainJSON((const struct LDJSON *)value);
         break;
     case LDBool:
         tmp = LDNewBool(*(LDBoolean *)value);
@@ -764,13 +823,6 @@ LDi_newFeatureRequestEvent(
         return NULL;
     }
 
-    if (!LDi_addUserInfoToEvent(context, event, user)) {
-        LD_LOG(
-            LD_LOG_ERROR, "LDi_newFeatureRequestEvent failed adding user info");
-
-        return NULL;
-    }
-
     if (!(tmp = LDNewText(flagKey))) {
         return NULL;
     }
@@ -837,7 +889,7 @@ LDi_newFeatureRequestEvent(
          **/
 
         if (node->flag.reason && (detailed || node->flag.trackReason)) {
-            if (!(tmp = LDJSONDuplicate(node->flag.reason))) {
+            if (!(tmp = LDi_retainJSON(node->flag.reason))) {
                 return NULL;
             }
 
@@ -1148,6 +1200,18 @@ LDi_processEvalEvent(
     }
 
     if (featureEvent) {
+        /* under the lock, so that a shared event user cannot be released
+         * between attaching it and queueing the event */
+        if (!LDi_addUserInfoToEvent(context, featureEvent, user)) {
+            LD_LOG(LD_LOG_ERROR, "failed adding user info to feature event");
+
+            LDi_mutex_unlock(&context->lock);
+
+            LDJSONFree(featureEvent);
+
+            return LDBooleanFalse;
+        }
+
         LDi_addEvent(context, featureEvent);
     }
 
@@ -16,6 +16,13 @@ struct EventProcessor
     double                 lastUserKeyFlush;
     double                 lastServerTime;
     const struct LDConfig *config;
+    /* the private attribute names of config, built once for every event
+     * user */
+    struct LDPrivateAttribute *privateAttributes;
+    /* The redacted event form of the last identified user, shared by queued
+     * events instead of each holding a copy */
+    const struct LDUser *eventUserOf;
+    struct LDJSON *      eventUser;
 };
 
 void
@@ -24,12 +31,14 @@ LDi_addEvent(struct EventProcessor *const context, struct LDJSON *const event);
 struct LDJSON *
 LDi_newBaseEvent(const char *const kind, const double now);
 
+/* Expects context->lock */
 LDBoolean
 LDi_addUserInfoToEvent(
     const struct EventProcessor *const context,
     struct LDJSON *const               event,
     const struct LDUser *const         user);
 
+/* Expects context->lock */
 struct LDJSON *
 LDi_newIdentifyEvent(
     const struct EventProcessor *const context,
@@ -0,0 +1,474 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <launchdarkly/api.h>
+
+#include "event_spool.h"
+#include "ldinternal.h"
+
+/* number of segment files in the ring, each may use 1/N of the byte cap */
+#define LD_SPOOL_SEGMENTS 8
+/* generous upper bound on the length of a segment header */
+#define LD_SPOOL_HEADER_MAX 32
+#define LD_SPOOL_MAGIC "LDSPOOL1"
+
+struct LDEventSpoolSegment
+{
+    LDBoolean     present;
+    unsigned long sequence;
+    long          size;
+};
+
+struct LDEventSpool
+{
+    /* path of the segment files without the slot suffix */
+    char *        prefix;
+    unsigned int  segmentMaxBytes;
+    unsigned long nextSequence;
+    /* segments in use form a contiguous run of the ring from head to tail */
+    struct LDEventSpoolSegment segments[LD_SPOOL_SEGMENTS];
+    unsigned int               head;
+    unsigned int               tail;
+    unsigned int               count;
+    /* offset of the next unread record in head, 0 if the header is unread */
+    long readOffset;
+    /* end of the record returned by the last peek, 0 if none */
+    long peekedEnd;
+};
+
+static LDBoolean
+segmentPath(
+    const struct LDEventSpool *const spool,
+    const unsigned int               slot,
+    char *const                      path,
+    const size_t                     pathSize)
+{
+    const int status = snprintf(path, pathSize, "%s-%u.spool", spool->prefix, slot);
+
+    if (status < 0 || (size_t)status >= pathSize) {
+        LD_LOG(LD_LOG_ERROR, "event spool path too long");
+
+        return LDBooleanFalse;
+    }
+
+    return LDBooleanTrue;
+}
+
+static void
+removeSegment(struct LDEventSpool *const spool, const unsigned int slot)
+{
+    char path[4096];
+
+    if (segmentPath(spool, slot, path, sizeof(path))) {
+        remove(path);
+    }
+
+    spool->segments[slot].present = LDBooleanFalse;
+}
+
+static void
+removeHead(struct LDEventSpool *const spool)
+{
+    LD_ASSERT(spool->count > 0);
+
+    removeSegment(spool, spool->head);
+
+    spool->head       = (spool->head + 1) % LD_SPOOL_SEGMENTS;
+    spool->readOffset = 0;
+    spool->peekedEnd  = 0;
+
+    spool->count--;
+}
+
+static LDBoolean
+startSegment(struct LDEventSpool *const spool)
+{
+    FILE *       handle;
+    unsigned int slot;
+    char         path[4096];
+    int          headerSize;
+
+    slot = (spool->tail + 1) % LD_SPOOL_SEGMENTS;
+
+    if (spool->count > 0 && slot == spool->head) {
+        LD_LOG(LD_LOG_WARNING, "event spool full, discarding oldest events");
+
+        removeHead(spool);
+    }
+
+    if (!segmentPath(spool, slot, path, sizeof(path))) {
+        return LDBooleanFalse;
+    }
+
+    if (!(handle = fopen(path, "wb"))) {
+        LD_LOG_1(LD_LOG_ERROR, "failed to create event spool %s", path);
+
+        return LDBooleanFalse;
+    }
+
+    headerSize =
+        fprintf(handle, LD_SPOOL_MAGIC " %lu\n", spool->nextSequence);
+
+    if (fclose(handle) != 0 || headerSize < 0) {
+        LD_LOG_1(LD_LOG_ERROR, "failed to write event spool %s", path);
+
+        remove(path);
+
+        return LDBooleanFalse;
+    }
+
+    spool->segments[slot].present  = LDBooleanTrue;
+    spool->segments[slot].sequence = spool->nextSequence++;
+    spool->segments[slot].size     = headerSize;
+
+    if (spool->count == 0) {
+        spool->head       = slot;
+        spool->readOffset = 0;
+        spool->peekedEnd  = 0;
+    }
+
+    spool->tail = slot;
+    spool->count++;
+
+    return LDBooleanTrue;
+}
+
+/* Reads the headers of segments left by a previous run */
+static void
+adoptSegments(struct LDEventSpool *const spool)
+{
+    unsigned int slot, i;
+    LDBoolean    found;
+
+    found = LDBooleanFalse;
+
+    for (slot = 0; slot < LD_SPOOL_SEGMENTS; slot++) {
+        struct LDEventSpoolSegment *const segment = &spool->segments[slot];
+        FILE *                            handle;
+        char                              path[4096], header[64];
+
+        if (!segmentPath(spool, slot, path, sizeof(path)) ||
+            !(handle = fopen(path, "rb")))
+        {
+            continue;
+        }
+
+        if (fgets(header, sizeof(header), handle) &&
+            sscanf(header, LD_SPOOL_MAGIC " %lu", &segment->sequence) == 1 &&
+            fseek(handle, 0, SEEK_END) == 0)
+        {
+            segment->present = LDBooleanTrue;
+            segment->size    = ftell(handle);
+
+            if (!found || segment->sequence > spool->segments[spool->tail].sequence)
+            {
+                spool->tail = slot;
+                found       = LDBooleanTrue;
+            }
+        }
+
+        fclose(handle);
+
+        if (!segment->present) {
+            LD_LOG_1(LD_LOG_WARNING, "discarding invalid event spool %s", path);
+
+            remove(path);
+        }
+    }
+
+    if (!found) {
+        return;
+    }
+
+    /* walk back from the newest segment to find the run of older ones */
+    spool->head  = spool->tail;
+    spool->count = 1;
+
+    for (i = 1; i < LD_SPOOL_SEGMENTS; i++) {
+        const unsigned int previous =
+            (spool->head + LD_SPOOL_SEGMENTS - 1) % LD_SPOOL_SEGMENTS;
+
+        if (!spool->segments[previous].present ||
+            spool->segments[previous].sequence >=
+                spool->segments[spool->head].sequence)
+        {
+            break;
+        }
+
+        spool->head = previous;
+        spool->count++;
+    }
+
+    /* anything outside of the run can not be ordered, so is dropped */
+    for (slot = 0; slot < LD_SPOOL_SEGMENTS; slot++) {
+        const unsigned int position =
+            (slot + LD_SPOOL_SEGMENTS - spool->head) % LD_SPOOL_SEGMENTS;
+
+        if (spool->segments[slot].present && position >= spool->count) {
+            removeSegment(spool, slot);
+        }
+    }
+
+    spool->nextSequence = spool->segments[spool->tail].sequence + 1;
+}
+
+struct LDEventSpool *
+LDi_eventSpoolOpen(
+    const char *const  directory,
+    const char *const  mobileKey,
+    const unsigned int maxBytes)
+{
+    struct LDEventSpool *spool;
+    const char *         iter;
+    unsigned long        hash;
+    char                 prefix[4096];
+    int                  status;
+
+    LD_ASSERT(directory);
+    LD_ASSERT(mobileKey);
+
+    /* FNV-1a, so that the key itself is never written to the file system */
+    hash = 2166136261UL;
+
+    for (iter = mobileKey; *iter; iter++) {
+        hash = ((hash ^ (unsigned char)*iter) * 16777619UL) & 0xFFFFFFFFUL;
+    }
+
+    status = snprintf(prefix, sizeof(prefix), "%s/ld-events-%08lx", directory, hash);
+
+    if (status < 0 || (size_t)status >= sizeof(prefix)) {
+        LD_LOG(LD_LOG_ERROR, "event spool directory too long");
+
+        return NULL;
+    }
+
+    if (!(spool = LDAlloc(sizeof(*spool)))) {
+        LD_LOG(LD_LOG_CRITICAL, "no memory for the event spool");
+
+        return NULL;
+    }
+
+    memset(spool, 0, sizeof(*spool));
+
+    if (!(spool->prefix = LDStrDup(prefix))) {
+        LDFree(spool);
+
+        return NULL;
+    }
+
+    spool->segmentMaxBytes = maxBytes / LD_SPOOL_SEGMENTS;
+    spool->tail            = LD_SPOOL_SEGMENTS - 1;
+
+    adoptSegments(spool);
+
+    return spool;
+}
+
+void
+LDi_eventSpoolFree(struct LDEventSpool *const spool)
+{
+    if (spool) {
+        LDFree(spool->prefix);
+        LDFree(spool);
+    }
+}
+
+LDBoolean
+LDi_eventSpoolAppend(
+    struct LDEventSpool *const spool,
+    const char *const          payloadId,
+    const char *const          payload)
+{
+    FILE * handle;
+    char   path[4096], header[64];
+    size_t payloadSize;
+    long   recordSize;
+    int    headerSize;
+
+    LD_ASSERT(spool);
+    LD_ASSERT(payloadId);
+    LD_ASSERT(payload);
+
+    payloadSize = strlen(payload);
+
+    headerSize = snprintf(
+        header, sizeof(header), "%s %lu\n", payloadId, (unsigned long)payloadSize);
+
+    if (headerSize < 0 || (size_t)headerSize >= sizeof(header)) {
+        return LDBooleanFalse;
+    }
+
+    recordSize = headerSize + (long)payloadSize + 1;
+
+    if (recordSize + LD_SPOOL_HEADER_MAX > (long)spool->segmentMaxBytes) {
+        LD_LOG(LD_LOG_WARNING, "event payload too large to spool");
+
+        return LDBooleanFalse;
+    }
+
+    if (spool->count == 0 ||
+        spool->segments[spool->tail].size + recordSize >
+            (long)spool->segmentMaxBytes)
+    {
+        if (!startSegment(spool)) {
+            return LDBooleanFalse;
+        }
+    }
+
+    if (!segmentPath(spool, spool->tail, path, sizeof(path))) {
+        return LDBooleanFalse;
+    }
+
+    if (!(handle = fopen(path, "ab"))) {
+        LD_LOG_1(LD_LOG_ERROR, "failed to open event spool %s", path);
+
+        return LDBooleanFalse;
+    }
+
+    if (fwrite(header, 1, headerSize, handle) != (size_t)headerSize ||
+        fwrite(payload, 1, payloadSize, handle) != payloadSize ||
+        fputc('\n', handle) == EOF)
+    {
+        LD_LOG_1(LD_LOG_ERROR, "failed to write event spool %s", path);
+
+        fclose(handle);
+
+        /* a partial record would hide every later one, so start over */
+        spool->segments[spool->tail].size = (long)spool->segmentMaxBytes;
+
+        return LDBooleanFalse;
+    }
+
+    if (fclose(handle) != 0) {
+        LD_LOG_1(LD_LOG_ERROR, "failed to write event spool %s", path);
+
+        /* some of the record may have reached the file all the same */
+        spool->segments[spool->tail].size = (long)spool->segmentMaxBytes;
+
+        return LDBooleanFalse;
+    }
+
+    spool->segments[spool->tail].size += recordSize;
+
+    return LDBooleanTrue;
+}
+
+LDBoolean
+LDi_eventSpoolPeek(
+    struct LDEventSpool *const spool,
+    char **const               payload,
+    char *const                payloadId)
+{
+    LD_ASSERT(spool);
+    LD_ASSERT(payload);
+    LD_ASSERT(payloadId);
+
+    *payload         = NULL;
+    spool->peekedEnd = 0;
+
+    while (spool->count > 0) {
+        FILE *        handle;
+        char          path[4096], header[64], *end, *buffer;
+        unsigned long payloadSize;
+
+        if (!segmentPath(spool, spool->head, path, sizeof(path))) {
+            return LDBooleanFalse;
+        }
+
+        if (!(handle = fopen(path, "rb"))) {
+            removeHead(spool);
+
+            continue;
+        }
+
+        if (spool->readOffset == 0) {
+            if (!fgets(header, sizeof(header), handle)) {
+                goto corrupt;
+            }
+
+            spool->readOffset = ftell(handle);
+        } else if (fseek(handle, spool->readOffset, SEEK_SET) != 0) {
+            goto corrupt;
+        }
+
+        if (spool->readOffset >= spool->segments[spool->head].size) {
+            fclose(handle);
+            removeHead(spool);
+
+            continue;
+        }
+
+        if (!fgets(header, sizeof(header), handle) ||
+            strlen(header) <= LD_UUID_SIZE + 1 || header[LD_UUID_SIZE] != ' ')
+        {
+            goto corrupt;
+        }
+
+        payloadSize = strtoul(header + LD_UUID_SIZE + 1, &end, 10);
+
+        if (*end != '\n' || payloadSize > spool->segmentMaxBytes) {
+            goto corrupt;
+        }
+
+        if (!(buffer = LDAlloc(payloadSize + 1))) {
+            fclose(handle);
+
+            return LDBooleanFalse;
+        }
+
+        if (fread(buffer, 1, payloadSize, handle) != payloadSize ||
+            fgetc(handle) != '\n')
+        {
+            LDFree(buffer);
+
+            goto corrupt;
+        }
+
+        buffer[payloadSize] = 0;
+
+        memcpy(payloadId, header, LD_UUID_SIZE);
+        payloadId[LD_UUID_SIZE] = 0;
+
+        spool->peekedEnd = ftell(handle);
+
+        fclose(handle);
+
+        *payload = buffer;
+
+        return LDBooleanTrue;
+
+    corrupt:
+        LD_LOG_1(LD_LOG_WARNING, "discarding corrupt event spool %s", path);
+
+        fclose(handle);
+        removeHead(spool);
+    }
+
+    return LDBooleanTrue;
+}
+
+void
+LDi_eventSpoolAck(struct LDEventSpool *const spool)
+{
+    LD_ASSERT(spool);
+
+    if (spool->peekedEnd == 0) {
+        return;
+    }
+
+    spool->readOffset = spool->peekedEnd;
+    spool->peekedEnd  = 0;
+
+    if (spool->readOffset >= spool->segments[spool->head].size) {
+        removeHead(spool);
+    }
+}
+
+LDBoolean
+LDi_eventSpoolIsEmpty(const struct LDEventSpool *const spool)
+{
+    LD_ASSERT(spool);
+
+    return spool->count == 0;
+}
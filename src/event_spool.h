@@ -0,0 +1,46 @@
+#pragma once
+
+#include <launchdarkly/boolean.h>
+
+/* A bounded on-disk queue of event payloads that could not be delivered.
+ *
+ * Payloads are appended to a fixed ring of segment files, each holding at
+ * most a fraction of the configured byte cap. When the ring is full the
+ * oldest segment is discarded. Read progress is not persisted, after a
+ * restart payloads may be resent, which is safe as each is keyed by its
+ * payload identifier.
+ *
+ * A spool is not thread safe, callers must serialize access. */
+struct LDEventSpool;
+
+/* Opens the spool for an environment, adopting any segments left by a
+ * previous run. Returns NULL on failure. */
+struct LDEventSpool *
+LDi_eventSpoolOpen(
+    const char *const  directory,
+    const char *const  mobileKey,
+    const unsigned int maxBytes);
+
+void
+LDi_eventSpoolFree(struct LDEventSpool *const spool);
+
+LDBoolean
+LDi_eventSpoolAppend(
+    struct LDEventSpool *const spool,
+    const char *const          payloadId,
+    const char *const          payload);
+
+/* Reads the oldest payload without removing it. Sets `payload` to NULL when
+ * the spool is empty. `payloadId` must hold LD_UUID_SIZE + 1 bytes. */
+LDBoolean
+LDi_eventSpoolPeek(
+    struct LDEventSpool *const spool,
+    char **const               payload,
+    char *const                payloadId);
+
+/* Removes the payload returned by the last peek */
+void
+LDi_eventSpoolAck(struct LDEventSpool *const spool);
+
+LDBoolean
+LDi_eventSpoolIsEmpty(const struct LDEventSpool *const spool);
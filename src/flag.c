@@ -2,20 +2,42 @@
 
 #include "assertion.h"
 #include "flag.h"
+#include "utility.h"
 
-LDBoolean
-LDi_flag_parse(
-    struct LDFlag *const       result,
-    const char *const          key,
-    const struct LDJSON *const raw)
+/* Reads a member that the flag keeps, moving it out of raw when take is
+ * set and copying it otherwise */
+static struct LDJSON *
+LDi_flag_member(
+    struct LDJSON *const raw, const char *const key, const LDBoolean take)
+{
+    const struct LDJSON *member;
+
+    if (take) {
+        return LDObjectDetachKey(raw, key);
+    }
+
+    if (!(member = LDObjectLookup(raw, key))) {
+        return NULL;
+    }
+
+    return LDJSONDuplicate(member);
+}
+
+static LDBoolean
+LDi_flag_parse_internal(
+    struct LDFlag *const result,
+    const char *const    key,
+    struct LDJSON *const raw,
+    const LDBoolean      take)
 {
-    const struct LDJSON *tmp;
+    struct LDJSON *tmp;
 
     LD_ASSERT(result);
     LD_ASSERT(raw);
 
     result->key         = NULL;
     result->value       = NULL;
+    result->valueHash   = 0;
     result->version     = -1;
     result->flagVersion = -1;
     result->variation = -1;
@@ -51,7 +73,9 @@ LDi_flag_parse(
             goto error;
         }
 
-        if (!(result->key = LDStrDup(LDGetText(tmp)))) {
+        if (!(result->key = take ? LDi_takeText(tmp)
+                                 : LDStrDup(LDGetText(tmp))))
+        {
             LD_LOG(LD_LOG_ERROR, "LDi_flag_parse failed to duplicate key");
 
             goto error;
@@ -59,12 +83,15 @@ LDi_flag_parse(
     }
 
     /* value; required */
-    if ((tmp = LDObjectLookup(raw, "value"))) {
-        if (!(result->value = LDJSONDuplicate(tmp))) {
+    if (LDObjectLookup(raw, "value")) {
+        if (!(result->value = LDi_flag_member(raw, "value", take))) {
             LD_LOG(LD_LOG_ERROR, "LDi_flag_parse failed to duplicate value");
 
             goto error;
         }
+
+        /* hashed here, as puts parse flags on several threads */
+        result->valueHash = LDi_hashJSON(result->value);
     } else {
         LD_LOG(LD_LOG_ERROR, "LDi_flag_parse expected value");
 
@@ -137,7 +164,7 @@ LDi_flag_parse(
     /* reason; optional */
     if ((tmp = LDObjectLookup(raw, "reason"))) {
         if (LDJSONGetType(tmp) == LDObject) {
-            if (!(result->reason = LDJSONDuplicate(tmp))) {
+            if (!(result->reason = LDi_flag_member(raw, "reason", take))) {
                 LD_LOG(LD_LOG_ERROR, "LDi_flag_parse failed to duplicate reason");
 
                 goto error;
@@ -155,6 +182,29 @@ error:
     return LDBooleanFalse;
 }
 
+LDBoolean
+LDi_flag_parse(
+    struct LDFlag *const       result,
+    const char *const          key,
+    const struct LDJSON *const raw)
+{
+    LD_ASSERT(result);
+    LD_ASSERT(raw);
+
+    /* nothing is modified without take */
+    return LDi_flag_parse_internal(
+        result, key, (struct LDJSON *)raw, LDBooleanFalse);
+}
+
+LDBoolean
+LDi_flag_take(struct LDFlag *const result, struct LDJSON *const raw)
+{
+    LD_ASSERT(result);
+    LD_ASSERT(raw);
+
+    return LDi_flag_parse_internal(result, NULL, raw, LDBooleanTrue);
+}
+
 struct LDJSON *
 LDi_flag_to_json(struct LDFlag *const flag)
 {
@@ -178,7 +228,7 @@ LDi_flag_to_json(struct LDFlag *const flag)
     }
     tmp = NULL;
 
-    if (!(tmp = LDJSONDuplicate(flag->value))) {
+    if (!(tmp = LDi_retainJSON(flag->value))) {
         goto error;
     }
 
@@ -241,7 +291,7 @@ LDi_flag_to_json(struct LDFlag *const flag)
     }
 
     if (flag->reason) {
-        if (!(tmp = LDJSONDuplicate(flag->reason))) {
+        if (!(tmp = LDi_retainJSON(flag->reason))) {
             goto error;
         }
 
@@ -282,6 +332,39 @@ error:
     return NULL;
 }
 
+LDBoolean
+LDi_flag_duplicate(
+    struct LDFlag *const result, const struct LDFlag *const source)
+{
+    LD_ASSERT(result);
+    LD_ASSERT(source);
+
+    *result        = *source;
+    result->key    = NULL;
+    result->value  = NULL;
+    result->reason = NULL;
+
+    if (!(result->key = LDStrDup(source->key))) {
+        goto error;
+    }
+
+    if (source->value && !(result->value = LDi_retainJSON(source->value))) {
+        goto error;
+    }
+
+    if (source->reason && !(result->reason = LDi_retainJSON(source->reason)))
+    {
+        goto error;
+    }
+
+    return LDBooleanTrue;
+
+error:
+    LDi_flag_destroy(result);
+
+    return LDBooleanFalse;
+}
+
 void
 LDi_flag_destroy(struct LDFlag *const flag)
 {
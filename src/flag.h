@@ -3,18 +3,21 @@
 #include <launchdarkly/boolean.h>
 #include <launchdarkly/json.h>
 
+/* Ordered largest first, so that nothing is padded */
 struct LDFlag
 {
     char *         key;
     struct LDJSON *value;
+    /* LDi_hashJSON of value, zero until computed */
+    unsigned long  valueHash;
+    struct LDJSON *reason;
+    double         debugEventsUntilDate;
     int            version;
     int            flagVersion;
     int            variation;
-    LDBoolean      trackEvents;
-    LDBoolean      trackReason;
-    struct LDJSON *reason;
-    double         debugEventsUntilDate;
-    LDBoolean      deleted;
+    unsigned int   trackEvents : 1;
+    unsigned int   trackReason : 1;
+    unsigned int   deleted : 1;
 };
 
 LDBoolean
@@ -23,8 +26,18 @@ LDi_flag_parse(
     const char *const          key,
     const struct LDJSON *const raw);
 
+/* Parses like LDi_flag_parse without a key, but moves the key, value, and
+ * reason out of `raw` instead of copying them, so `raw` is only fit to be
+ * freed after. */
+LDBoolean
+LDi_flag_take(struct LDFlag *const result, struct LDJSON *const raw);
+
 struct LDJSON *
 LDi_flag_to_json(struct LDFlag *const flag);
 
+LDBoolean
+LDi_flag_duplicate(
+    struct LDFlag *const result, const struct LDFlag *const source);
+
 void
 LDi_flag_destroy(struct LDFlag *const flag);
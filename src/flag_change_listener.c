@@ -1,29 +1,39 @@
 #include "flag_change_listener.h"
+#include "uthash.h"
 #include "utlist.h"
 #include <launchdarkly/memory.h>
 
 #include <string.h>
 
 struct ChangeListener {
-    /* Owned flag key; must be freed. */
+    /* Owned flag key; must be freed. Also the key of the hash table. */
     char *flag;
-    /* User-provided callback. */
-    LDlistenerfn callback;
+    /* User-provided callbacks for the flag, in order of registration. */
+    LDlistenerfn *callbacks;
+    unsigned int count;
+    unsigned int capacity;
+    /* Used by uthash.h macros. */
+    UT_hash_handle hh;
+};
+
+struct AllFlagsListener {
+    LDallflagslistenerfn callback;
+    void *userData;
     /* Used by utlist.h macros. */
-    struct ChangeListener *next;
+    struct AllFlagsListener *next;
 };
 
 static struct ChangeListener *
-newListener(const char* flag, LDlistenerfn callback) {
+newListener(const char* flag) {
     struct ChangeListener *listener = NULL;
 
     if (!(listener = LDAlloc(sizeof(struct ChangeListener)))) {
-        return LDBooleanFalse;
+        return NULL;
     }
 
-    listener->callback = callback;
-    listener->flag = NULL;
-    listener->next = NULL;
+    listener->callbacks = NULL;
+    listener->count = 0;
+    listener->capacity = 0;
 
     if (!(listener->flag = LDStrDup(flag))) {
         LDFree(listener);
@@ -35,35 +45,14 @@ newListener(const char* flag, LDlistenerfn callback) {
 
 static void
 freeListener(struct ChangeListener *listener) {
+    LDFree(listener->callbacks);
     LDFree(listener->flag);
     LDFree(listener);
 }
 
-/* Used by the utlist's LL_SEARCH macro to locate a ChangeListener. */
-static int
-flagcmp(struct ChangeListener *a, struct ChangeListener *b) {
-
-    /* If the listeners have different flags, return that. */
-    int cmp = strcmp(a->flag, b->flag);
-    if (cmp != 0) {
-        return cmp;
-    }
-
-    /* If the listeners have the same flag & callback, they are equal. */
-    if (a->callback == b->callback) {
-        return 0;
-    }
-
-    /* Otherwise, sort by the callback address to provide something stable.*/
-    if ((unsigned long) a->callback > (unsigned long) b->callback) {
-        return 1;
-    }
-    return -1;
-}
-
 void
 LDi_initListeners(struct ChangeListener** listeners) {
-    /* Setting the list head to NULL is utlist's only requirement for operation. */
+    /* Setting the table head to NULL is uthash's only requirement for operation. */
     *listeners = NULL;
 }
 
@@ -74,66 +63,213 @@ LDi_freeListeners(struct ChangeListener** listeners) {
     tmp = NULL;
     listener = NULL;
 
-    if (*listeners) {
-        LL_FOREACH_SAFE(*listeners, listener, tmp) {
-            LL_DELETE(*listeners, listener);
-            freeListener(listener);
-        }
-        *listeners = NULL;
+    HASH_ITER(hh, *listeners, listener, tmp) {
+        HASH_DEL(*listeners, listener);
+        freeListener(listener);
     }
+    *listeners = NULL;
 }
 
 LDBoolean
 LDi_listenerAdd(struct ChangeListener** listeners, const char* flag, LDlistenerfn callback) {
-    struct ChangeListener *new, *existing;
+    struct ChangeListener *listener;
+    unsigned int i;
+
+    listener = NULL;
 
-    new = NULL;
-    existing = NULL;
+    HASH_FIND_STR(*listeners, flag, listener);
 
-    if (!(new = newListener(flag, callback))) {
-        return LDBooleanFalse;
+    if (listener) {
+        /* Ensure uniqueness of (flag, function pointer) combo. */
+        for (i = 0; i < listener->count; i++) {
+            if (listener->callbacks[i] == callback) {
+                return LDBooleanTrue;
+            }
+        }
+    } else {
+        if (!(listener = newListener(flag))) {
+            return LDBooleanFalse;
+        }
+
+        HASH_ADD_KEYPTR(hh, *listeners, listener->flag, strlen(listener->flag), listener);
     }
 
-    LL_SEARCH(*listeners, existing, new, flagcmp);
+    if (listener->count == listener->capacity) {
+        const unsigned int capacity = listener->capacity ? listener->capacity * 2 : 2;
+        LDlistenerfn *callbacks;
 
-    /* Ensure uniqueness of (flag, function pointer) combo. */
-    if (existing) {
-        freeListener(new);
-        return LDBooleanTrue;
+        if (!(callbacks = LDRealloc(listener->callbacks, sizeof(LDlistenerfn) * capacity))) {
+            if (listener->count == 0) {
+                HASH_DEL(*listeners, listener);
+                freeListener(listener);
+            }
+            return LDBooleanFalse;
+        }
+
+        listener->callbacks = callbacks;
+        listener->capacity = capacity;
     }
 
-    LL_PREPEND(*listeners, new);
+    listener->callbacks[listener->count++] = callback;
     return LDBooleanTrue;
 }
 
 void
 LDi_listenerRemove(struct ChangeListener** listeners, const char* flag, LDlistenerfn callback) {
-    struct ChangeListener *tmp, *listener;
+    struct ChangeListener *listener;
+    unsigned int i;
 
-    tmp = NULL;
     listener = NULL;
 
-    LL_FOREACH_SAFE(*listeners, listener, tmp) {
-        if (strcmp(listener->flag, flag) == 0 && listener->callback == callback) {
-            LL_DELETE(*listeners, listener);
-            freeListener(listener);
+    HASH_FIND_STR(*listeners, flag, listener);
 
-            break; /* early out, since listenerInsert disallows duplicates */
+    if (!listener) {
+        return;
+    }
+
+    for (i = 0; i < listener->count; i++) {
+        if (listener->callbacks[i] == callback) {
+            /* Keep the remaining callbacks in order of registration. */
+            memmove(&listener->callbacks[i], &listener->callbacks[i + 1],
+                    sizeof(LDlistenerfn) * (listener->count - i - 1));
+            listener->count--;
+
+            break; /* early out, since listenerAdd disallows duplicates */
         }
     }
+
+    if (listener->count == 0) {
+        HASH_DEL(*listeners, listener);
+        freeListener(listener);
+    }
 }
 
 
 void
 LDi_listenersDispatch(struct ChangeListener* listeners, const char *flag, LDBoolean status) {
-    struct ChangeListener *tmp, *listener;
+    struct ChangeListener *listener;
+    unsigned int i;
+
+    listener = NULL;
+
+    HASH_FIND_STR(listeners, flag, listener);
+
+    if (listener) {
+        for (i = 0; i < listener->count; i++) {
+            listener->callbacks[i](flag, status);
+        }
+    }
+}
+
+LDBoolean
+LDi_listenersWatch(struct ChangeListener* listeners, const char *flag) {
+    struct ChangeListener *listener;
+
+    listener = NULL;
+
+    HASH_FIND_STR(listeners, flag, listener);
+
+    return listener != NULL;
+}
+
+LDBoolean
+LDi_listenersCollect(struct ChangeListener* listeners, const char *flag, LDlistenerfn **callbacks, unsigned int *count) {
+    struct ChangeListener *listener;
+
+    *callbacks = NULL;
+    *count = 0;
+    listener = NULL;
+
+    HASH_FIND_STR(listeners, flag, listener);
+
+    if (!listener) {
+        return LDBooleanTrue;
+    }
+
+    if (!(*callbacks = LDAlloc(sizeof(LDlistenerfn) * listener->count))) {
+        return LDBooleanFalse;
+    }
+
+    memcpy(*callbacks, listener->callbacks, sizeof(LDlistenerfn) * listener->count);
+    *count = listener->count;
+
+    return LDBooleanTrue;
+}
+
+LDBoolean
+LDi_allFlagsListenerAdd(struct AllFlagsListener** listeners, LDallflagslistenerfn callback, void *userData) {
+    struct AllFlagsListener *listener;
+
+    listener = NULL;
+
+    LL_SEARCH_SCALAR(*listeners, listener, callback, callback);
+
+    if (!listener) {
+        if (!(listener = LDAlloc(sizeof(struct AllFlagsListener)))) {
+            return LDBooleanFalse;
+        }
+
+        listener->callback = callback;
+        LL_APPEND(*listeners, listener);
+    }
+
+    listener->userData = userData;
+    return LDBooleanTrue;
+}
+
+void
+LDi_allFlagsListenerRemove(struct AllFlagsListener** listeners, LDallflagslistenerfn callback) {
+    struct AllFlagsListener *listener;
+
+    listener = NULL;
+
+    LL_SEARCH_SCALAR(*listeners, listener, callback, callback);
+
+    if (listener) {
+        LL_DELETE(*listeners, listener);
+        LDFree(listener);
+    }
+}
+
+void
+LDi_freeAllFlagsListeners(struct AllFlagsListener** listeners) {
+    struct AllFlagsListener *tmp, *listener;
 
     tmp = NULL;
     listener = NULL;
 
-    LL_FOREACH_SAFE(listeners, listener, tmp) {
-        if (strcmp(listener->flag, flag) == 0) {
-            listener->callback(flag, status);
+    LL_FOREACH_SAFE(*listeners, listener, tmp) {
+        LL_DELETE(*listeners, listener);
+        LDFree(listener);
+    }
+    *listeners = NULL;
+}
+
+LDBoolean
+LDi_allFlagsListenersCollect(struct AllFlagsListener* listeners, struct AllFlagsListener** copy) {
+    struct AllFlagsListener *listener, *duplicate;
+
+    *copy = NULL;
+
+    LL_FOREACH(listeners, listener) {
+        if (!(duplicate = LDAlloc(sizeof(struct AllFlagsListener)))) {
+            LDi_freeAllFlagsListeners(copy);
+            return LDBooleanFalse;
         }
+
+        duplicate->callback = listener->callback;
+        duplicate->userData = listener->userData;
+        LL_APPEND(*copy, duplicate);
+    }
+
+    return LDBooleanTrue;
+}
+
+void
+LDi_allFlagsListenersDispatch(struct AllFlagsListener* listeners, const struct LDFlagChange *changes, unsigned int changeCount) {
+    struct AllFlagsListener *listener;
+
+    LL_FOREACH(listeners, listener) {
+        listener->callback(changes, changeCount, listener->userData);
     }
 }
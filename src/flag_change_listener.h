@@ -6,18 +6,21 @@
 /* ChangeListener represents user-provided callbacks that will be invoked when flag add/upsert operations
  * take place.
  *
+ * Listeners are kept in a hash table keyed by flag, each entry holding the callbacks for that flag. Looking up the
+ * listeners of a flag does not depend on how many other flags are watched.
+ *
  * The ChangeListener struct should be stored as a pointer, and initialized with LDi_initListeners.
  *
  * Only one callback can be registered for a given (flag, function pointer) pair; this is enforced at insertion time.
  * */
 struct ChangeListener;
 
-/* Initialize a list of ChangeListeners.
+/* Initialize a table of ChangeListeners.
  * Must be called before any other operation. */
 void
 LDi_initListeners(struct ChangeListener** listeners);
 
-/* Free a list of ChangeListeners. */
+/* Free a table of ChangeListeners. */
 void
 LDi_freeListeners(struct ChangeListener** listeners);
 
@@ -27,10 +30,46 @@ LDi_freeListeners(struct ChangeListener** listeners);
 LDBoolean
 LDi_listenerAdd(struct ChangeListener** listeners, const char* flag, LDlistenerfn callback);
 
-/* Deletes a listener from the list. */
+/* Deletes a listener from the table. */
 void
 LDi_listenerRemove(struct ChangeListener** listeners, const char* flag, LDlistenerfn callback);
 
 /* Dispatches an event for a given flag to all registered listeners. */
 void
 LDi_listenersDispatch(struct ChangeListener* listeners, const char *flag, LDBoolean status);
+
+/* Returns true if any listener is registered for the flag. */
+LDBoolean
+LDi_listenersWatch(struct ChangeListener* listeners, const char *flag);
+
+/* Copies the callbacks registered for a flag, so that they may be invoked after releasing the lock guarding the list.
+ * Sets callbacks to NULL if there are none. The array must be freed with LDFree. If allocation fails, returns false. */
+LDBoolean
+LDi_listenersCollect(struct ChangeListener* listeners, const char *flag, LDlistenerfn **callbacks, unsigned int *count);
+
+/* AllFlagsListener represents user-provided callbacks that receive every change made by a store update at once.
+ *
+ * The AllFlagsListener struct should be stored as a pointer, initialized to NULL. Each callback is registered once. */
+struct AllFlagsListener;
+
+/* Insert a new listener, or replace the user data of an existing one. If allocation fails, returns false. */
+LDBoolean
+LDi_allFlagsListenerAdd(struct AllFlagsListener** listeners, LDallflagslistenerfn callback, void *userData);
+
+/* Deletes a listener from the list. */
+void
+LDi_allFlagsListenerRemove(struct AllFlagsListener** listeners, LDallflagslistenerfn callback);
+
+/* Free a list of AllFlagsListeners. */
+void
+LDi_freeAllFlagsListeners(struct AllFlagsListener** listeners);
+
+/* Copies the registered listeners, so that they may be invoked after releasing the lock guarding the list. Sets
+ * copy to NULL if there are none. The copy must be freed with LDi_freeAllFlagsListeners. If allocation fails,
+ * returns false. */
+LDBoolean
+LDi_allFlagsListenersCollect(struct AllFlagsListener* listeners, struct AllFlagsListener** copy);
+
+/* Dispatches a change set to every listener in the list. */
+void
+LDi_allFlagsListenersDispatch(struct AllFlagsListener* listeners, const struct LDFlagChange *changes, unsigned int changeCount);
@@ -0,0 +1,779 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <launchdarkly/api.h>
+
+#include "flag_image.h"
+#include "ldinternal.h"
+
+/*
+ * Layout, integers are 32 bit little endian and doubles are native:
+ *
+ * header   magic, format, flag count, total size, checksum of everything
+ *          after the header, and a probe double detecting foreign layouts
+ * keys     one entry per flag sorted by key: key offset, key length, and
+ *          record offset
+ * records  fixed size per flag, scalar values are inline while text, other
+ *          values, and reasons are offsets into the string area
+ * strings  NUL terminated, so they are usable in place
+ */
+#define LD_IMAGE_MAGIC "LDFLAGS"
+#define LD_IMAGE_FORMAT 1
+#define LD_IMAGE_PROBE 1.5
+#define LD_IMAGE_HEADER_SIZE 32
+#define LD_IMAGE_ENTRY_SIZE 12
+#define LD_IMAGE_RECORD_SIZE 48
+
+/* how a record holds its value */
+#define LD_IMAGE_NULL 0
+#define LD_IMAGE_BOOL 1
+#define LD_IMAGE_NUMBER 2
+#define LD_IMAGE_TEXT 3
+#define LD_IMAGE_JSON 4
+
+struct LDFlagImage
+{
+    const unsigned char *data;
+    size_t               size;
+    unsigned int         flagCount;
+    /* otherwise data was allocated */
+    LDBoolean mapped;
+};
+
+static void
+putUnsigned(unsigned char *const target, const unsigned long value)
+{
+    target[0] = (unsigned char)(value & 0xff);
+    target[1] = (unsigned char)((value >> 8) & 0xff);
+    target[2] = (unsigned char)((value >> 16) & 0xff);
+    target[3] = (unsigned char)((value >> 24) & 0xff);
+}
+
+static unsigned long
+getUnsigned(const unsigned char *const source)
+{
+    return (unsigned long)source[0] | ((unsigned long)source[1] << 8) |
+           ((unsigned long)source[2] << 16) | ((unsigned long)source[3] << 24);
+}
+
+static void
+putSigned(unsigned char *const target, const int value)
+{
+    putUnsigned(target, (unsigned long)value & 0xffffffffUL);
+}
+
+static int
+getSigned(const unsigned char *const source)
+{
+    const unsigned long value = getUnsigned(source);
+
+    if (value & 0x80000000UL) {
+        return -(int)(~value & 0x7fffffffUL) - 1;
+    }
+
+    return (int)value;
+}
+
+static void
+putDouble(unsigned char *const target, const double value)
+{
+    memcpy(target, &value, sizeof(double));
+}
+
+static double
+getDouble(const unsigned char *const source)
+{
+    double value;
+
+    memcpy(&value, source, sizeof(double));
+
+    return value;
+}
+
+/* FNV-1a */
+static unsigned long
+checksum(const unsigned char *const data, const size_t size)
+{
+    unsigned long hash;
+    size_t        i;
+
+    hash = 2166136261UL;
+
+    for (i = 0; i < size; i++) {
+        hash ^= data[i];
+        hash = (hash * 16777619UL) & 0xffffffffUL;
+    }
+
+    return hash;
+}
+
+/* Holds the string area while it is built */
+struct LDImageStrings
+{
+    char * data;
+    size_t size;
+    size_t capacity;
+};
+
+/* Appends text including its terminator, and reports where it starts */
+static LDBoolean
+appendString(
+    struct LDImageStrings *const strings,
+    const char *const            text,
+    size_t *const                offset)
+{
+    const size_t length = strlen(text) + 1;
+
+    if (strings->size + length > strings->capacity) {
+        size_t capacity;
+        char * data;
+
+        capacity = strings->capacity ? strings->capacity * 2 : 1024;
+
+        while (capacity < strings->size + length) {
+            capacity *= 2;
+        }
+
+        if (!(data = (char *)LDRealloc(strings->data, capacity))) {
+            return LDBooleanFalse;
+        }
+
+        strings->data     = data;
+        strings->capacity = capacity;
+    }
+
+    memcpy(strings->data + strings->size, text, length);
+
+    *offset = strings->size;
+    strings->size += length;
+
+    return LDBooleanTrue;
+}
+
+/* Appends the serialization of json, reporting where it starts */
+static LDBoolean
+appendJSON(
+    struct LDImageStrings *const strings,
+    const struct LDJSON *const   json,
+    size_t *const                offset,
+    size_t *const                length)
+{
+    char *    serialized;
+    LDBoolean appended;
+
+    if (!(serialized = LDJSONSerialize(json))) {
+        return LDBooleanFalse;
+    }
+
+    *length  = strlen(serialized);
+    appended = appendString(strings, serialized, offset);
+
+    LDFree(serialized);
+
+    return appended;
+}
+
+static int
+compareFlags(const void *const left, const void *const right)
+{
+    return strcmp(
+        (*(const struct LDFlag *const *)left)->key,
+        (*(const struct LDFlag *const *)right)->key);
+}
+
+/* Fills in the record of a single flag, string offsets are relative to the
+ * start of the string area until adjusted by the caller */
+static LDBoolean
+encodeFlag(
+    unsigned char *const         record,
+    const struct LDFlag *const   flag,
+    struct LDImageStrings *const strings)
+{
+    size_t offset, length;
+    int    kind;
+
+    memset(record, 0, LD_IMAGE_RECORD_SIZE);
+
+    putSigned(record, flag->version);
+    putSigned(record + 4, flag->flagVersion);
+    putSigned(record + 8, flag->variation);
+    record[12] = (unsigned char)flag->trackEvents;
+    record[13] = (unsigned char)flag->trackReason;
+    putDouble(record + 16, flag->debugEventsUntilDate);
+
+    switch (flag->value ? LDJSONGetType(flag->value) : LDNull) {
+        case LDBool:
+            kind = LD_IMAGE_BOOL;
+            putDouble(record + 24, LDGetBool(flag->value) ? 1 : 0);
+            break;
+        case LDNumber:
+            kind = LD_IMAGE_NUMBER;
+            putDouble(record + 24, LDGetNumber(flag->value));
+            break;
+        case LDText:
+            kind = LD_IMAGE_TEXT;
+            length = strlen(LDGetText(flag->value));
+
+            if (!appendString(strings, LDGetText(flag->value), &offset)) {
+                return LDBooleanFalse;
+            }
+
+            putUnsigned(record + 32, (unsigned long)offset);
+            putUnsigned(record + 36, (unsigned long)length);
+            break;
+        case LDObject:
+        case LDArray:
+            kind = LD_IMAGE_JSON;
+
+            if (!appendJSON(strings, flag->value, &offset, &length)) {
+                return LDBooleanFalse;
+            }
+
+            putUnsigned(record + 32, (unsigned long)offset);
+            putUnsigned(record + 36, (unsigned long)length);
+            break;
+        default:
+            kind = LD_IMAGE_NULL;
+            break;
+    }
+
+    record[14] = (unsigned char)kind;
+
+    if (flag->reason) {
+        if (!appendJSON(strings, flag->reason, &offset, &length)) {
+            return LDBooleanFalse;
+        }
+
+        /* a reason is present if its length is non zero */
+        putUnsigned(record + 40, (unsigned long)offset);
+        putUnsigned(record + 44, (unsigned long)length);
+    }
+
+    return LDBooleanTrue;
+}
+
+/* Moves a string offset from the string area to the whole image */
+static void
+rebaseOffset(unsigned char *const field, const size_t base)
+{
+    putUnsigned(field, getUnsigned(field) + (unsigned long)base);
+}
+
+static LDBoolean
+writeFile(
+    const char *const          path,
+    const unsigned char *const data,
+    const size_t               size)
+{
+    FILE * handle;
+    char * temporary;
+    size_t pathLength;
+
+    pathLength = strlen(path);
+
+    if (!(temporary = (char *)LDAlloc(pathLength + 5))) {
+        return LDBooleanFalse;
+    }
+
+    memcpy(temporary, path, pathLength);
+    memcpy(temporary + pathLength, ".tmp", 5);
+
+    if (!(handle = fopen(temporary, "wb"))) {
+        LD_LOG_1(LD_LOG_ERROR, "failed to create flag snapshot %s", temporary);
+
+        LDFree(temporary);
+
+        return LDBooleanFalse;
+    }
+
+    if (fwrite(data, 1, size, handle) != size || fclose(handle) != 0) {
+        LD_LOG_1(LD_LOG_ERROR, "failed to write flag snapshot %s", temporary);
+
+        remove(temporary);
+        LDFree(temporary);
+
+        return LDBooleanFalse;
+    }
+
+#ifdef _WIN32
+    /* rename does not replace existing files */
+    remove(path);
+#endif
+
+    if (rename(temporary, path) != 0) {
+        LD_LOG_1(LD_LOG_ERROR, "failed to replace flag snapshot %s", path);
+
+        remove(temporary);
+        LDFree(temporary);
+
+        return LDBooleanFalse;
+    }
+
+    LDFree(temporary);
+
+    return LDBooleanTrue;
+}
+
+LDBoolean
+LDi_flagImageSave(
+    const char *const                 path,
+    const struct LDFlag *const *const flags,
+    const unsigned int                flagCount)
+{
+    const struct LDFlag ** sorted;
+    unsigned char *        image;
+    struct LDImageStrings  strings;
+    size_t                 fixedSize, keyOffset, i;
+    LDBoolean              saved;
+
+    LD_ASSERT(path);
+
+    sorted  = NULL;
+    image   = NULL;
+    saved   = LDBooleanFalse;
+    memset(&strings, 0, sizeof(strings));
+
+    fixedSize = LD_IMAGE_HEADER_SIZE +
+                (size_t)flagCount * (LD_IMAGE_ENTRY_SIZE + LD_IMAGE_RECORD_SIZE);
+
+    if (!(image = (unsigned char *)LDAlloc(fixedSize))) {
+        goto cleanup;
+    }
+
+    memset(image, 0, fixedSize);
+
+    if (flagCount) {
+        if (!(sorted = (const struct LDFlag **)LDAlloc(
+                  sizeof(struct LDFlag *) * flagCount)))
+        {
+            goto cleanup;
+        }
+
+        memcpy(sorted, flags, sizeof(struct LDFlag *) * flagCount);
+        qsort(sorted, flagCount, sizeof(struct LDFlag *), compareFlags);
+    }
+
+    for (i = 0; i < flagCount; i++) {
+        unsigned char *const entry =
+            image + LD_IMAGE_HEADER_SIZE + i * LD_IMAGE_ENTRY_SIZE;
+        const size_t recordOffset = LD_IMAGE_HEADER_SIZE +
+                                    flagCount * LD_IMAGE_ENTRY_SIZE +
+                                    i * LD_IMAGE_RECORD_SIZE;
+
+        if (!appendString(&strings, sorted[i]->key, &keyOffset) ||
+            !encodeFlag(image + recordOffset, sorted[i], &strings))
+        {
+            goto cleanup;
+        }
+
+        putUnsigned(entry, (unsigned long)keyOffset);
+        putUnsigned(entry + 4, (unsigned long)strlen(sorted[i]->key));
+        putUnsigned(entry + 8, (unsigned long)recordOffset);
+    }
+
+    /* string offsets were recorded relative to the string area */
+    for (i = 0; i < flagCount; i++) {
+        unsigned char *const entry =
+            image + LD_IMAGE_HEADER_SIZE + i * LD_IMAGE_ENTRY_SIZE;
+        unsigned char *const record = image + getUnsigned(entry + 8);
+
+        rebaseOffset(entry, fixedSize);
+
+        if (record[14] == LD_IMAGE_TEXT || record[14] == LD_IMAGE_JSON) {
+            rebaseOffset(record + 32, fixedSize);
+        }
+
+        if (getUnsigned(record + 44)) {
+            rebaseOffset(record + 40, fixedSize);
+        }
+    }
+
+    {
+        unsigned char *whole;
+
+        if (!(whole = (unsigned char *)LDRealloc(
+                  image, fixedSize + strings.size)))
+        {
+            goto cleanup;
+        }
+
+        image = whole;
+
+        if (strings.size) {
+            memcpy(image + fixedSize, strings.data, strings.size);
+        }
+    }
+
+    memcpy(image, LD_IMAGE_MAGIC, 8);
+    putUnsigned(image + 8, LD_IMAGE_FORMAT);
+    putUnsigned(image + 12, flagCount);
+    putUnsigned(image + 16, (unsigned long)(fixedSize + strings.size));
+    putUnsigned(
+        image + 20,
+        checksum(
+            image + LD_IMAGE_HEADER_SIZE,
+            fixedSize + strings.size - LD_IMAGE_HEADER_SIZE));
+    putDouble(image + 24, LD_IMAGE_PROBE);
+
+    saved = writeFile(path, image, fixedSize + strings.size);
+
+cleanup:
+    LDFree(strings.data);
+    LDFree(sorted);
+    LDFree(image);
+
+    return saved;
+}
+
+/* Returns the NUL terminated string of length at offset, NULL if it does not
+ * lie within the image */
+static const char *
+getString(
+    const struct LDFlagImage *const image,
+    const unsigned long             offset,
+    const unsigned long             length)
+{
+    if (offset >= image->size || length >= image->size - offset ||
+        image->data[offset + length] != '\0')
+    {
+        return NULL;
+    }
+
+    return (const char *)image->data + offset;
+}
+
+static const unsigned char *
+getEntry(const struct LDFlagImage *const image, const unsigned int index)
+{
+    return image->data + LD_IMAGE_HEADER_SIZE +
+           (size_t)index * LD_IMAGE_ENTRY_SIZE;
+}
+
+static LDBoolean
+validate(struct LDFlagImage *const image)
+{
+    const unsigned char *const data = image->data;
+    unsigned long              flagCount, i;
+    double                     probe;
+
+    if (image->size < LD_IMAGE_HEADER_SIZE ||
+        memcmp(data, LD_IMAGE_MAGIC, 8) != 0)
+    {
+        LD_LOG(LD_LOG_ERROR, "not a flag snapshot");
+
+        return LDBooleanFalse;
+    }
+
+    probe = LD_IMAGE_PROBE;
+
+    if (getUnsigned(data + 8) != LD_IMAGE_FORMAT ||
+        memcmp(data + 24, &probe, sizeof(double)) != 0)
+    {
+        LD_LOG(LD_LOG_ERROR, "unsupported flag snapshot format");
+
+        return LDBooleanFalse;
+    }
+
+    flagCount = getUnsigned(data + 12);
+
+    if (getUnsigned(data + 16) != image->size ||
+        flagCount > (image->size - LD_IMAGE_HEADER_SIZE) /
+                        (LD_IMAGE_ENTRY_SIZE + LD_IMAGE_RECORD_SIZE) ||
+        getUnsigned(data + 20) !=
+            checksum(
+                data + LD_IMAGE_HEADER_SIZE,
+                image->size - LD_IMAGE_HEADER_SIZE))
+    {
+        LD_LOG(LD_LOG_ERROR, "flag snapshot is corrupt");
+
+        return LDBooleanFalse;
+    }
+
+    image->flagCount = (unsigned int)flagCount;
+
+    /* keys are needed for every lookup, so check them once up front */
+    for (i = 0; i < flagCount; i++) {
+        const unsigned char *const entry = getEntry(image, (unsigned int)i);
+        const unsigned long        record = getUnsigned(entry + 8);
+        const char *               key;
+
+        if (!(key = getString(
+                  image, getUnsigned(entry), getUnsigned(entry + 4))) ||
+            record > image->size - LD_IMAGE_RECORD_SIZE ||
+            (i > 0 && strcmp(LDi_flagImageKey(image, (unsigned int)i - 1), key) >= 0))
+        {
+            LD_LOG(LD_LOG_ERROR, "flag snapshot key table is corrupt");
+
+            return LDBooleanFalse;
+        }
+    }
+
+    return LDBooleanTrue;
+}
+
+#ifndef _WIN32
+static LDBoolean
+mapFile(struct LDFlagImage *const image, const char *const path)
+{
+    struct stat status;
+    void *      data;
+    int         handle;
+
+    if ((handle = open(path, O_RDONLY)) < 0) {
+        return LDBooleanFalse;
+    }
+
+    if (fstat(handle, &status) != 0 || status.st_size <= 0) {
+        close(handle);
+
+        return LDBooleanFalse;
+    }
+
+    data = mmap(NULL, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, handle, 0);
+
+    close(handle);
+
+    if (data == MAP_FAILED) {
+        return LDBooleanFalse;
+    }
+
+    image->data   = (const unsigned char *)data;
+    image->size   = (size_t)status.st_size;
+    image->mapped = LDBooleanTrue;
+
+    return LDBooleanTrue;
+}
+#else
+static LDBoolean
+mapFile(struct LDFlagImage *const image, const char *const path)
+{
+    FILE *         handle;
+    unsigned char *data;
+    long           size;
+
+    if (!(handle = fopen(path, "rb"))) {
+        return LDBooleanFalse;
+    }
+
+    if (fseek(handle, 0, SEEK_END) != 0 || (size = ftell(handle)) <= 0 ||
+        fseek(handle, 0, SEEK_SET) != 0 ||
+        !(data = (unsigned char *)LDAlloc((size_t)size)))
+    {
+        fclose(handle);
+
+        return LDBooleanFalse;
+    }
+
+    if (fread(data, 1, (size_t)size, handle) != (size_t)size) {
+        LDFree(data);
+        fclose(handle);
+
+        return LDBooleanFalse;
+    }
+
+    fclose(handle);
+
+    image->data   = data;
+    image->size   = (size_t)size;
+    image->mapped = LDBooleanFalse;
+
+    return LDBooleanTrue;
+}
+#endif
+
+struct LDFlagImage *
+LDi_flagImageOpen(const char *const path)
+{
+    struct LDFlagImage *image;
+
+    LD_ASSERT(path);
+
+    if (!(image = (struct LDFlagImage *)LDAlloc(sizeof(struct LDFlagImage)))) {
+        return NULL;
+    }
+
+    memset(image, 0, sizeof(struct LDFlagImage));
+
+    if (!mapFile(image, path)) {
+        LD_LOG_1(LD_LOG_INFO, "no readable flag snapshot at %s", path);
+
+        LDFree(image);
+
+        return NULL;
+    }
+
+    if (!validate(image)) {
+        LDi_flagImageClose(image);
+
+        return NULL;
+    }
+
+    return image;
+}
+
+void
+LDi_flagImageClose(struct LDFlagImage *const image)
+{
+    if (image) {
+#ifndef _WIN32
+        if (image->mapped) {
+            munmap((void *)image->data, image->size);
+        } else {
+            LDFree((void *)image->data);
+        }
+#else
+        LDFree((void *)image->data);
+#endif
+
+        LDFree(image);
+    }
+}
+
+unsigned int
+LDi_flagImageCount(const struct LDFlagImage *const image)
+{
+    LD_ASSERT(image);
+
+    return image->flagCount;
+}
+
+const char *
+LDi_flagImageKey(const struct LDFlagImage *const image, const unsigned int index)
+{
+    LD_ASSERT(image);
+    LD_ASSERT(index < image->flagCount);
+
+    return (const char *)image->data + getUnsigned(getEntry(image, index));
+}
+
+int
+LDi_flagImageVersion(
+    const struct LDFlagImage *const image, const unsigned int index)
+{
+    LD_ASSERT(image);
+    LD_ASSERT(index < image->flagCount);
+
+    return getSigned(image->data + getUnsigned(getEntry(image, index) + 8));
+}
+
+LDBoolean
+LDi_flagImageFind(
+    const struct LDFlagImage *const image,
+    const char *const               key,
+    unsigned int *const             index)
+{
+    unsigned int low, high;
+
+    LD_ASSERT(image);
+    LD_ASSERT(key);
+    LD_ASSERT(index);
+
+    low  = 0;
+    high = image->flagCount;
+
+    while (low < high) {
+        const unsigned int middle = low + (high - low) / 2;
+        const int compared = strcmp(LDi_flagImageKey(image, middle), key);
+
+        if (compared == 0) {
+            *index = middle;
+
+            return LDBooleanTrue;
+        } else if (compared < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    return LDBooleanFalse;
+}
+
+LDBoolean
+LDi_flagImageRead(
+    const struct LDFlagImage *const image,
+    const unsigned int              index,
+    struct LDFlag *const            result)
+{
+    const unsigned char *record;
+    const char *         text;
+
+    LD_ASSERT(image);
+    LD_ASSERT(index < image->flagCount);
+    LD_ASSERT(result);
+
+    record = image->data + getUnsigned(getEntry(image, index) + 8);
+
+    memset(result, 0, sizeof(struct LDFlag));
+
+    result->version              = getSigned(record);
+    result->flagVersion          = getSigned(record + 4);
+    result->variation            = getSigned(record + 8);
+    result->trackEvents          = (LDBoolean)record[12];
+    result->trackReason          = (LDBoolean)record[13];
+    result->debugEventsUntilDate = getDouble(record + 16);
+    result->deleted              = LDBooleanFalse;
+
+    if (!(result->key = LDStrDup(LDi_flagImageKey(image, index)))) {
+        goto error;
+    }
+
+    switch (record[14]) {
+        case LD_IMAGE_NULL:
+            result->value = LDNewNull();
+            break;
+        case LD_IMAGE_BOOL:
+            result->value = LDNewBool(getDouble(record + 24) != 0);
+            break;
+        case LD_IMAGE_NUMBER:
+            result->value = LDNewNumber(getDouble(record + 24));
+            break;
+        case LD_IMAGE_TEXT:
+        case LD_IMAGE_JSON:
+            if (!(text = getString(
+                      image, getUnsigned(record + 32), getUnsigned(record + 36))))
+            {
+                goto corrupt;
+            }
+
+            result->value = record[14] == LD_IMAGE_TEXT
+                                ? LDNewText(text)
+                                : LDJSONDeserialize(text);
+            break;
+        default:
+            goto corrupt;
+    }
+
+    if (!result->value) {
+        goto error;
+    }
+
+    if (getUnsigned(record + 44)) {
+        if (!(text = getString(
+                  image, getUnsigned(record + 40), getUnsigned(record + 44))))
+        {
+            goto corrupt;
+        }
+
+        if (!(result->reason = LDJSONDeserialize(text))) {
+            goto error;
+        }
+    }
+
+    return LDBooleanTrue;
+
+corrupt:
+    LD_LOG(LD_LOG_ERROR, "flag snapshot record is corrupt");
+error:
+    LDi_flag_destroy(result);
+
+    return LDBooleanFalse;
+}
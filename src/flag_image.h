@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stddef.h>
+
+#include <launchdarkly/boolean.h>
+
+#include "flag.h"
+
+/* A binary flag snapshot, either mapped from a file or held in memory.
+ * Immutable once opened, so safe to read from any thread. */
+struct LDFlagImage;
+
+/* Writes the flags to `path` in the binary snapshot format. The file is
+ * replaced atomically where the platform allows. */
+LDBoolean
+LDi_flagImageSave(
+    const char *const                 path,
+    const struct LDFlag *const *const flags,
+    const unsigned int                flagCount);
+
+/* Maps a snapshot written by LDi_flagImageSave, validating its header,
+ * checksum, and key table. Returns NULL if missing or invalid. */
+struct LDFlagImage *
+LDi_flagImageOpen(const char *const path);
+
+void
+LDi_flagImageClose(struct LDFlagImage *const image);
+
+unsigned int
+LDi_flagImageCount(const struct LDFlagImage *const image);
+
+/* Keys are in ascending strcmp order and point into the image */
+const char *
+LDi_flagImageKey(const struct LDFlagImage *const image, const unsigned int index);
+
+int
+LDi_flagImageVersion(
+    const struct LDFlagImage *const image, const unsigned int index);
+
+LDBoolean
+LDi_flagImageFind(
+    const struct LDFlagImage *const image,
+    const char *const               key,
+    unsigned int *const             index);
+
+/* Builds an owned flag from the record at index */
+LDBoolean
+LDi_flagImageRead(
+    const struct LDFlagImage *const image,
+    const unsigned int              index,
+    struct LDFlag *const            result);
@@ -0,0 +1,367 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <launchdarkly/api.h>
+
+#include "flag_journal.h"
+#include "ldinternal.h"
+
+/*
+ * One record per line, each the JSON of a flag as in a patch event. Text in
+ * JSON never contains a raw newline, so a record is complete exactly when
+ * its newline was written.
+ */
+#define LD_JOURNAL_SUFFIX ".journal"
+
+/* compaction waits until the journal is this many times the snapshot size */
+#define LD_JOURNAL_COMPACT_RATIO 1
+/* and at least this size, small snapshots are rewritten too often otherwise */
+#define LD_JOURNAL_COMPACT_MIN_BYTES 4096
+
+static char *
+journalPath(const char *const snapshotPath)
+{
+    char * path;
+    size_t size;
+
+    size = strlen(snapshotPath) + sizeof(LD_JOURNAL_SUFFIX);
+
+    if (!(path = (char *)LDAlloc(size))) {
+        LD_LOG(LD_LOG_ERROR, "failed to allocate journal path");
+
+        return NULL;
+    }
+
+    snprintf(path, size, "%s%s", snapshotPath, LD_JOURNAL_SUFFIX);
+
+    return path;
+}
+
+/* -1 if the file cannot be read */
+static long
+fileSize(const char *const path)
+{
+    FILE *file;
+    long  size;
+
+    if (!(file = fopen(path, "rb"))) {
+        return -1;
+    }
+
+    if (fseek(file, 0, SEEK_END) != 0) {
+        size = -1;
+    } else {
+        size = ftell(file);
+    }
+
+    fclose(file);
+
+    return size;
+}
+
+static char *
+serializeRecord(const struct LDFlag *const flag)
+{
+    struct LDJSON *json, *tmp;
+    char *         text;
+
+    json = NULL;
+    tmp  = NULL;
+    text = NULL;
+
+    if (!flag->deleted) {
+        if (!(json = LDi_flag_to_json((struct LDFlag *)flag))) {
+            goto cleanup;
+        }
+    } else {
+        /* a deleted flag has no value, while a record requires one */
+        if (!(json = LDNewObject())) {
+            goto cleanup;
+        }
+
+        if (!(tmp = LDNewText(flag->key)) ||
+            !LDObjectSetKey(json, "key", tmp))
+        {
+            goto cleanup;
+        }
+        tmp = NULL;
+
+        if (!(tmp = LDNewNull()) || !LDObjectSetKey(json, "value", tmp)) {
+            goto cleanup;
+        }
+        tmp = NULL;
+
+        if (!(tmp = LDNewNumber(flag->version)) ||
+            !LDObjectSetKey(json, "version", tmp))
+        {
+            goto cleanup;
+        }
+        tmp = NULL;
+
+        if (!(tmp = LDNewBool(LDBooleanTrue)) ||
+            !LDObjectSetKey(json, "deleted", tmp))
+        {
+            goto cleanup;
+        }
+        tmp = NULL;
+    }
+
+    text = LDJSONSerialize(json);
+
+cleanup:
+    LDJSONFree(json);
+    LDJSONFree(tmp);
+
+    return text;
+}
+
+LDBoolean
+LDi_flagJournalAppend(
+    const char *const snapshotPath, const struct LDFlag *const flag)
+{
+    FILE *    file;
+    char *    path, *record;
+    size_t    length;
+    LDBoolean success;
+
+    LD_ASSERT(snapshotPath);
+    LD_ASSERT(flag);
+
+    file    = NULL;
+    path    = NULL;
+    record  = NULL;
+    success = LDBooleanFalse;
+
+    if (!(record = serializeRecord(flag))) {
+        LD_LOG(LD_LOG_ERROR, "failed to serialize journal record");
+
+        goto cleanup;
+    }
+
+    if (!(path = journalPath(snapshotPath))) {
+        goto cleanup;
+    }
+
+    if (!(file = fopen(path, "ab"))) {
+        LD_LOG_1(LD_LOG_WARNING, "failed to open flag journal %s", path);
+
+        goto cleanup;
+    }
+
+    length = strlen(record);
+
+    if (fwrite(record, 1, length, file) != length || fputc('\n', file) == EOF)
+    {
+        LD_LOG_1(LD_LOG_WARNING, "failed to append to flag journal %s", path);
+
+        goto cleanup;
+    }
+
+    success = LDBooleanTrue;
+
+cleanup:
+    if (file && fclose(file) != 0) {
+        success = LDBooleanFalse;
+    }
+
+    LDFree(path);
+    LDFree(record);
+
+    return success;
+}
+
+LDBoolean
+LDi_flagJournalShouldCompact(const char *const snapshotPath)
+{
+    char *path;
+    long  journalBytes, snapshotBytes;
+
+    LD_ASSERT(snapshotPath);
+
+    if (!(path = journalPath(snapshotPath))) {
+        return LDBooleanTrue;
+    }
+
+    journalBytes = fileSize(path);
+
+    LDFree(path);
+
+    if ((snapshotBytes = fileSize(snapshotPath)) < 0) {
+        return LDBooleanTrue;
+    }
+
+    return journalBytes > LD_JOURNAL_COMPACT_MIN_BYTES &&
+           journalBytes > snapshotBytes * LD_JOURNAL_COMPACT_RATIO;
+}
+
+void
+LDi_flagJournalRemove(const char *const snapshotPath)
+{
+    char *path;
+
+    LD_ASSERT(snapshotPath);
+
+    if ((path = journalPath(snapshotPath))) {
+        remove(path);
+
+        LDFree(path);
+    }
+}
+
+/* Replaces the journal with its first `size` bytes, so that later appends
+ * do not land on the same line as an untrusted tail */
+static void
+truncateJournal(
+    const char *const path, const char *const text, const size_t size)
+{
+    FILE * file;
+    char * temporary;
+    size_t pathLength;
+
+    if (size == 0) {
+        if (remove(path) != 0) {
+            LD_LOG_1(LD_LOG_ERROR, "failed to remove flag journal %s", path);
+        }
+
+        return;
+    }
+
+    pathLength = strlen(path);
+
+    if (!(temporary = (char *)LDAlloc(pathLength + 5))) {
+        LD_LOG(LD_LOG_ERROR, "failed to allocate journal path");
+
+        return;
+    }
+
+    memcpy(temporary, path, pathLength);
+    memcpy(temporary + pathLength, ".tmp", 5);
+
+    if (!(file = fopen(temporary, "wb"))) {
+        LD_LOG_1(LD_LOG_ERROR, "failed to create flag journal %s", temporary);
+
+        LDFree(temporary);
+
+        return;
+    }
+
+    if (fwrite(text, 1, size, file) != size || fclose(file) != 0) {
+        LD_LOG_1(LD_LOG_ERROR, "failed to write flag journal %s", temporary);
+
+        remove(temporary);
+        LDFree(temporary);
+
+        return;
+    }
+
+#ifdef _WIN32
+    /* rename does not replace existing files */
+    remove(path);
+#endif
+
+    if (rename(temporary, path) != 0) {
+        LD_LOG_1(LD_LOG_ERROR, "failed to replace flag journal %s", path);
+
+        remove(temporary);
+    }
+
+    LDFree(temporary);
+}
+
+unsigned int
+LDi_flagJournalReplay(
+    const char *const snapshotPath,
+    LDFlagJournalFn   fn,
+    void *const       context)
+{
+    FILE *        file;
+    char *        path, *text, *line, *end;
+    long          size;
+    unsigned int  replayed;
+
+    LD_ASSERT(snapshotPath);
+    LD_ASSERT(fn);
+
+    file     = NULL;
+    text     = NULL;
+    replayed = 0;
+
+    if (!(path = journalPath(snapshotPath))) {
+        return 0;
+    }
+
+    if ((size = fileSize(path)) <= 0 || !(file = fopen(path, "rb"))) {
+        goto cleanup;
+    }
+
+    if (!(text = (char *)LDAlloc(size + 1))) {
+        LD_LOG(LD_LOG_ERROR, "failed to allocate flag journal");
+
+        goto cleanup;
+    }
+
+    if (fread(text, 1, size, file) != (size_t)size) {
+        LD_LOG_1(LD_LOG_WARNING, "failed to read flag journal %s", path);
+
+        goto cleanup;
+    }
+
+    /* closed before the journal may be replaced below */
+    fclose(file);
+    file = NULL;
+
+    text[size] = 0;
+
+    for (line = text; (end = strchr(line, '\n')); line = end + 1) {
+        struct LDJSON *json;
+        struct LDFlag  flag;
+
+        *end = 0;
+
+        if (!(json = LDJSONDeserialize(line))) {
+            break;
+        }
+
+        if (!LDi_flag_take(&flag, json)) {
+            LDJSONFree(json);
+
+            break;
+        }
+
+        LDJSONFree(json);
+
+        if (flag.deleted) {
+            LDJSONFree(flag.value);
+            flag.value     = NULL;
+            flag.valueHash = 0;
+        }
+
+        fn(context, flag);
+
+        replayed++;
+    }
+
+    if (*line || line != text + size) {
+        LD_LOG_1(
+            LD_LOG_WARNING, "discarding the end of flag journal %s", path);
+
+        /* the records kept end in the newlines replaced while parsing */
+        for (end = text; end < line; end++) {
+            if (!*end) {
+                *end = '\n';
+            }
+        }
+
+        truncateJournal(path, text, line - text);
+    }
+
+cleanup:
+    if (file) {
+        fclose(file);
+    }
+
+    LDFree(text);
+    LDFree(path);
+
+    return replayed;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <launchdarkly/boolean.h>
+
+#include "flag.h"
+
+/* A journal records single flag updates beside a snapshot written by
+ * LDi_flagImageSave, so an update costs its own size rather than that of
+ * every flag. Each function takes the path of the snapshot, the journal
+ * lives next to it. */
+
+/* Receives a replayed flag, taking ownership of it */
+typedef void (*LDFlagJournalFn)(void *const context, struct LDFlag flag);
+
+/* Appends the flag, which may be deleted, to the journal */
+LDBoolean
+LDi_flagJournalAppend(
+    const char *const snapshotPath, const struct LDFlag *const flag);
+
+/* True once the journal has outgrown the snapshot, or there is no
+ * snapshot for it to apply to. The journal should then be replaced by a
+ * new snapshot. */
+LDBoolean
+LDi_flagJournalShouldCompact(const char *const snapshotPath);
+
+/* Discards the journal, once a snapshot includes everything in it */
+void
+LDi_flagJournalRemove(const char *const snapshotPath);
+
+/* Calls `fn` for each record in the order appended. A torn or invalid
+ * record ends the replay, as anything after it cannot be trusted, and is
+ * cut from the journal along with the rest so that appends start on a line
+ * of their own. Returns the number of records replayed. */
+unsigned int
+LDi_flagJournalReplay(
+    const char *const snapshotPath,
+    LDFlagJournalFn   fn,
+    void *const       context);
@@ -13,10 +13,14 @@
 #include "concurrency.h"
 #include "config.h"
 #include "event_processor.h"
+#include "event_spool.h"
 #include "logging.h"
+#include "network_runtime.h"
+#include "notifier.h"
 #include "sse.h"
 #include "store.h"
 #include "user.h"
+#include "user_request.h"
 #include "utility.h"
 
 #ifndef _WINDOWS
@@ -38,8 +42,9 @@ LDi_base64_encode(const unsigned char *src, size_t len, size_t *out_len);
 
 void
 LDi_cancelread(const int handle);
+/* on success etag is set to the entity tag of the response, if any */
 char *
-LDi_fetchfeaturemap(struct LDClient *client, long *response);
+LDi_fetchfeaturemap(struct LDClient *client, long *response, char **etag);
 
 void
 LDi_readstream(
@@ -57,11 +62,20 @@ LDi_sendevents(
 
 void
 LDi_reinitializeconnection(struct LDClient *const client);
+/* wakes background work, signals is a mask of LD_SIGNAL_* */
+void
+LDi_signalbackground(struct LDClient *const client, const int signals);
 void
 LDi_startstopstreaming(
     struct LDClient *const client, const LDBoolean stopstreaming);
+/* Stores the flags of a put, unless they were requested for a user before
+ * the identify `generation` was taken from. Returns LDBooleanFalse if they
+ * were not stored. */
 LDBoolean
-LDi_onstreameventput(struct LDClient *const client, const char *const data);
+LDi_onstreameventput(
+    struct LDClient *const client,
+    const unsigned int     generation,
+    const char *const      data);
 void
 LDi_onstreameventpatch(struct LDClient *const client, const char *const data);
 void
@@ -94,6 +108,18 @@ LDi_earlyinit(void);
 void
 LDi_updatestatus(struct LDClient *const client, const LDStatus status);
 
+/* lock free reads of single client fields */
+LDStatus
+LDi_getstatus(struct LDClient *const client);
+LDBoolean
+LDi_isoffline(struct LDClient *const client);
+LDBoolean
+LDi_isbackground(struct LDClient *const client);
+/* true while initializing, while an identify is waiting for flags, or while
+ * cached flags are waiting to be revalidated */
+LDBoolean
+LDi_awaitingflags(struct LDClient *const client);
+
 THREAD_RETURN
 LDi_bgeventsender(void *const v);
 THREAD_RETURN
@@ -101,6 +127,39 @@ LDi_bgfeaturepoller(void *const v);
 THREAD_RETURN
 LDi_bgfeaturestreamer(void *const v);
 
+/* makes the next poll unconditional, and any poll in flight stale, expects
+ * caller to own clientLock for writing */
+void
+LDi_resetpolletag(struct LDClient *const client);
+
+/* Returns the file persisting the flags of the user in the environment of
+ * the client, named by a hash so that neither key nor user is revealed. NULL
+ * unless a cache directory is configured. */
+char *
+LDi_flagcachepath(
+    const struct LDClient *const      client,
+    const struct LDUserRequest *const request);
+
+/* records that the store now holds the flags of the current user, expects
+ * caller to own clientLock for writing */
+void
+LDi_identifycompleted(struct LDClient *const client);
+
+/* Taken before a connection or poll is issued, to tell whether its flags
+ * are still those of the current user */
+unsigned int
+LDi_identifygeneration(struct LDClient *const client);
+
+/* bundles and delivers queued events, blocking until complete */
+void
+LDi_sendqueuedevents(struct LDClient *const client);
+
+LDBoolean
+LDi_attachnetworktask(struct LDClient *const client);
+/* blocks until the runtime has released the client, then flushes events */
+void
+LDi_detachnetworktask(struct LDClient *const client);
+
 double
 LDi_calculateStreamDelay(const unsigned int retries);
 
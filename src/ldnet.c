@@ -1,37 +1,24 @@
+#include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include <curl/curl.h>
 
+#ifdef LAUNCHDARKLY_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
 #include <launchdarkly/api.h>
 
 #include "ldinternal.h"
+#include "ldnet.h"
 
 #define LD_STREAMTIMEOUT_MS 300000
 #define LD_USER_AGENT_HEADER "User-Agent: CClient/" LD_SDK_VERSION
 #define UNUSED(x) (void)(x)
-
-struct MemoryStruct
-{
-    char * memory;
-    size_t size;
-};
-
-struct streamdata
-{
-    struct MemoryStruct mem;
-    double              lastdatatime;
-    curl_off_t          lastdataamt;
-    struct LDClient *   client;
-    struct LDSSEParser *parser;
-};
-
-struct cbhandlecontext
-{
-    struct LDClient *client;
-    void (*cb)(struct LDClient *, int);
-};
+/* event payloads smaller than this are not worth compressing */
+#define LD_GZIP_MIN_BYTES 1024
 
 typedef size_t (*WriteCB)(void *, size_t, size_t, void *);
 
@@ -108,9 +95,7 @@ ProgressCallback(void *clientp,
     LD_ASSERT(clientp);
     context  = (struct streamdata *)clientp;
 
-    LDi_rwlock_rdlock(&context->client->clientLock);
-    status = context->client->status;
-    LDi_rwlock_rdunlock(&context->client->clientLock);
+    status = LDi_getstatus(context->client);
 
     /* Upon explicit shutdown of the client, return 1 to cause CURL to
      * abort the connection. Otherwise, it's possible for the connection to hang
@@ -311,420 +296,391 @@ LDi_cancelread(const int handle)
 #endif
 }
 
-/*
- * this function reads data and passes it to the stream callback.
- * it doesn't return except after a disconnect. (or some other failure.)
- */
-void
-LDi_readstream(
-    struct LDClient *const    client,
-    long *                     response,
-    struct LDSSEParser *const parser,
-    void                      cbhandle(struct LDClient *, int))
+
+/* Builds the URL of a user scoped request. When REPORT is in use the user is
+ * sent as the request body, otherwise it is encoded into the path. Returns
+ * LDBooleanFalse on failure. */
+static LDBoolean
+prepareUserURL(
+    struct LDClient *const       client,
+    const char *const            base,
+    const char *const            reportPath,
+    const char *const            getPath,
+    char *const                  url,
+    const size_t                 urlSize,
+    struct LDUserRequest **const r_user)
 {
-    CURLcode               res;
-    struct MemoryStruct    headers;
-    struct streamdata      streamdata;
-    struct cbhandlecontext handledata;
-    CURL *                 curl;
-    struct curl_slist *    headerlist, *headertmp;
-    char *                 userJSONText;
-    char                   url[4096];
+    struct LDUserRequest *user;
 
     LD_ASSERT(client);
-    LD_ASSERT(response);
-    LD_ASSERT(parser);
-    LD_ASSERT(cbhandle);
+    LD_ASSERT(base);
+    LD_ASSERT(reportPath);
+    LD_ASSERT(getPath);
+    LD_ASSERT(url);
+    LD_ASSERT(r_user);
 
-    curl       = NULL;
-    headerlist = NULL;
-    headertmp  = NULL;
+    *r_user = NULL;
 
-    handledata.client = client;
-    handledata.cb     = cbhandle;
+    if (!(user = LDi_acquireUserRequest(client->shared))) {
+        LD_LOG(LD_LOG_CRITICAL, "no user available for request");
 
-    memset(&headers, 0, sizeof(headers));
-    memset(&streamdata, 0, sizeof(streamdata));
+        return LDBooleanFalse;
+    }
 
-    streamdata.parser       = parser;
-    streamdata.lastdataamt  = 0;
-    streamdata.client       = client;
+    if (client->shared->sharedConfig->useReport) {
+        if (snprintf(url, urlSize, "%s%s", base, reportPath) < 0) {
+            LD_LOG(LD_LOG_CRITICAL, "snprintf usereport failed");
 
-    LDi_getMonotonicMilliseconds(&streamdata.lastdatatime);
+            goto error;
+        }
+    } else {
+        if (snprintf(url, urlSize, "%s%s/%s", base, getPath, user->encoded) <
+            0) {
+            LD_LOG(LD_LOG_ERROR, "snprintf !usereport failed");
 
-    LDi_rwlock_rdlock(&client->shared->sharedUserLock);
-    LDi_rwlock_rdlock(&client->clientLock);
+            goto error;
+        }
+    }
 
-    userJSONText = LDi_serializeUser(client->shared->sharedUser);
+    if (client->shared->sharedConfig->useReasons) {
+        const size_t len = strlen(url);
 
-    LDi_rwlock_rdunlock(&client->clientLock);
-    LDi_rwlock_rdunlock(&client->shared->sharedUserLock);
+        if (snprintf(url + len, urlSize - len, "?withReasons=true") < 0) {
+            LD_LOG(LD_LOG_ERROR, "snprintf useReason failed");
+
+            goto error;
+        }
+    }
 
-    if (userJSONText == NULL) {
-        LD_LOG(LD_LOG_CRITICAL, "failed to serialize user");
+    *r_user = user;
 
-        return;
+    return LDBooleanTrue;
+
+error:
+    LDi_userRequestRelease(user);
+
+    return LDBooleanFalse;
+}
+
+/* Configures a prepared transfer to send the user as a REPORT */
+static LDBoolean
+prepareReport(struct LDTransfer *const transfer)
+{
+    struct curl_slist *headertmp;
+
+    LD_ASSERT(transfer);
+    LD_ASSERT(transfer->user);
+
+    if (curl_easy_setopt(transfer->curl, CURLOPT_CUSTOMREQUEST, "REPORT") !=
+        CURLE_OK)
+    {
+        LD_LOG(LD_LOG_CRITICAL, "curl_easy_setopt CURLOPT_CUSTOMREQUEST failed");
+
+        return LDBooleanFalse;
     }
 
-    if (client->shared->sharedConfig->useReport) {
-        if (snprintf(
-                url,
-                sizeof(url),
-                "%s/meval",
-                client->shared->sharedConfig->streamURI) < 0)
-        {
-            LDFree(userJSONText);
+    if (!(headertmp = curl_slist_append(
+              transfer->headerlist, "Content-Type: application/json")))
+    {
+        LD_LOG(LD_LOG_CRITICAL, "curl_slist_append failed for headermime");
 
-            LD_LOG(LD_LOG_CRITICAL, "snprintf usereport failed");
+        return LDBooleanFalse;
+    }
+    transfer->headerlist = headertmp;
 
-            return;
-        }
-    } else {
-        int                  status;
-        size_t               b64len;
-        unsigned char *const b64text = LDi_base64_encode(
-            (unsigned char *)userJSONText, strlen(userJSONText), &b64len);
+    if (curl_easy_setopt(
+            transfer->curl, CURLOPT_POSTFIELDS, transfer->user->json) !=
+        CURLE_OK)
+    {
+        LD_LOG(LD_LOG_CRITICAL, "curl_easy_setopt CURLOPT_POSTFIELDS failed");
 
-        if (!b64text) {
-            LDFree(userJSONText);
+        return LDBooleanFalse;
+    }
 
-            LD_LOG(LD_LOG_ERROR, "LDi_base64_encode == NULL in LDi_readstream");
+    return LDBooleanTrue;
+}
+
+/* Makes a poll conditional on the flags having changed since the last poll
+ * stored them */
+static LDBoolean
+prepareConditional(
+    struct LDClient *const client, struct LDTransfer *const transfer)
+{
+    struct curl_slist *headertmp;
+    char *             header;
+    size_t             headerSize;
+
+/* This is done as a macro so that the string is a literal */
+#define LD_IF_NONE_MATCH_HEADER "If-None-Match: "
+
+    header = NULL;
+
+    LDi_rwlock_rdlock(&client->clientLock);
 
-            return;
+    if (client->pollETag) {
+        headerSize =
+            sizeof(LD_IF_NONE_MATCH_HEADER) + strlen(client->pollETag);
+
+        if ((header = LDAlloc(headerSize))) {
+            snprintf(
+                header,
+                headerSize,
+                "%s%s",
+                LD_IF_NONE_MATCH_HEADER,
+                client->pollETag);
         }
+    }
 
-        status = snprintf(
-            url,
-            sizeof(url),
-            "%s/meval/%s",
-            client->shared->sharedConfig->streamURI,
-            b64text);
+    LDi_rwlock_rdunlock(&client->clientLock);
 
-        LDFree(b64text);
+#undef LD_IF_NONE_MATCH_HEADER
 
-        if (status < 0) {
-            LDFree(userJSONText);
+    if (header == NULL) {
+        /* an unconditional request is always acceptable */
+        return LDBooleanTrue;
+    }
 
-            LD_LOG(LD_LOG_ERROR, "snprintf !usereport failed");
+    headertmp = curl_slist_append(transfer->headerlist, header);
 
-            return;
-        }
+    LDFree(header);
+
+    if (!headertmp) {
+        LD_LOG(LD_LOG_CRITICAL, "curl_slist_append failed for headeretag");
+
+        return LDBooleanFalse;
     }
+    transfer->headerlist = headertmp;
 
-    if (client->shared->sharedConfig->useReasons) {
-        const size_t len = strlen(url);
+    return LDBooleanTrue;
+}
 
-        if (snprintf(
-                url + len, sizeof(url) - len, "?withReasons=true") < 0)
-        {
-            LDFree(userJSONText);
+LDBoolean
+LDi_prepareStreamTransfer(
+    struct LDClient *const    client,
+    struct LDTransfer *const  transfer,
+    struct LDSSEParser *const parser,
+    void                      cbhandle(struct LDClient *, int))
+{
+    char url[4096];
 
-            LD_LOG(LD_LOG_ERROR, "snprintf useReason failed");
+    LD_ASSERT(client);
+    LD_ASSERT(transfer);
+    LD_ASSERT(parser);
+    LD_ASSERT(cbhandle);
 
-            return;
-        }
+    memset(transfer, 0, sizeof(*transfer));
+
+    transfer->handledata.client = client;
+    transfer->handledata.cb     = cbhandle;
+
+    transfer->stream.parser      = parser;
+    transfer->stream.lastdataamt = 0;
+    transfer->stream.client      = client;
+
+    LDi_getMonotonicMilliseconds(&transfer->stream.lastdatatime);
+
+    if (!prepareUserURL(
+            client,
+            client->shared->sharedConfig->streamURI,
+            "/meval",
+            "/meval",
+            url,
+            sizeof(url),
+            &transfer->user))
+    {
+        return LDBooleanFalse;
     }
 
     if (!prepareShared(
             url,
             client->shared->sharedConfig,
-            &curl,
-            &headerlist,
+            &transfer->curl,
+            &transfer->headerlist,
             &WriteMemoryCallback,
-            &headers,
+            &transfer->headers,
             &StreamWriteCallback,
-            &streamdata,
+            &transfer->stream,
             client))
     {
-        LDFree(userJSONText);
-
-        return;
+        goto error;
     }
 
-    if (client->shared->sharedConfig->useReport) {
-        if (curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "REPORT") != CURLE_OK)
-        {
-            LD_LOG(
-                LD_LOG_CRITICAL,
-                "curl_easy_setopt CURLOPT_CUSTOMREQUEST failed");
-
-            goto cleanup;
-        }
-
-        if (!(headertmp = curl_slist_append(
-                  headerlist, "Content-Type: application/json")))
-        {
-            LD_LOG(LD_LOG_CRITICAL, "curl_slist_append failed for headermime");
-
-            goto cleanup;
-        }
-        headerlist = headertmp;
-
-        if (curl_easy_setopt(curl, CURLOPT_POSTFIELDS, userJSONText) !=
-            CURLE_OK) {
-            LD_LOG(
-                LD_LOG_CRITICAL, "curl_easy_setopt CURLOPT_POSTFIELDS failed");
-
-            goto cleanup;
-        }
+    if (client->shared->sharedConfig->useReport &&
+        !prepareReport(transfer)) {
+        goto error;
     }
 
-    if (curl_easy_setopt(curl, CURLOPT_OPENSOCKETFUNCTION, SocketCallback) !=
+    if (curl_easy_setopt(
+            transfer->curl, CURLOPT_OPENSOCKETFUNCTION, SocketCallback) !=
         CURLE_OK)
     {
         LD_LOG(
             LD_LOG_CRITICAL,
             "curl_easy_setopt CURLOPT_OPENSOCKETFUNCTION failed");
 
-        goto cleanup;
+        goto error;
     }
 
-    if (curl_easy_setopt(curl, CURLOPT_OPENSOCKETDATA, &handledata) != CURLE_OK)
+    if (curl_easy_setopt(
+            transfer->curl, CURLOPT_OPENSOCKETDATA, &transfer->handledata) !=
+        CURLE_OK)
     {
         LD_LOG(
             LD_LOG_CRITICAL, "curl_easy_setopt CURLOPT_OPENSOCKETDATA failed");
 
-        goto cleanup;
+        goto error;
     }
 
-    if (curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headerlist) != CURLE_OK) {
+    /* an empty string offers every encoding curl was built with */
+    if (curl_easy_setopt(transfer->curl, CURLOPT_ACCEPT_ENCODING, "") !=
+        CURLE_OK)
+    {
+        LD_LOG(
+            LD_LOG_CRITICAL, "curl_easy_setopt CURLOPT_ACCEPT_ENCODING failed");
+
+        goto error;
+    }
+
+    if (curl_easy_setopt(
+            transfer->curl, CURLOPT_HTTPHEADER, transfer->headerlist) !=
+        CURLE_OK)
+    {
         LD_LOG(LD_LOG_CRITICAL, "curl_easy_setopt CURLOPT_HTTPHEADER failed");
 
-        goto cleanup;
+        goto error;
     }
 
     /* This needs set or progress callbacks will not be made. */
-    if (curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0)) {
+    if (curl_easy_setopt(transfer->curl, CURLOPT_NOPROGRESS, 0)) {
         LD_LOG(LD_LOG_CRITICAL, "curl_easy_setopt CURLOPT_NOPROGRESS failed");
 
-        goto cleanup;
+        goto error;
     }
 
     /* Expose the data to the progress callback so it can track the last time
      * that data was received. */
-    if (curl_easy_setopt(curl, CURLOPT_XFERINFODATA, &streamdata) != CURLE_OK) {
+    if (curl_easy_setopt(
+            transfer->curl, CURLOPT_XFERINFODATA, &transfer->stream) !=
+        CURLE_OK)
+    {
         LD_LOG(LD_LOG_CRITICAL, "curl_easy_setopt CURLOPT_XFERINFODATA failed");
 
-        goto cleanup;
+        goto error;
     }
 
-    if (curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION,
-                        ProgressCallback)) {
-        LD_LOG(LD_LOG_CRITICAL, "curl_easy_setopt CURLOPT_XFERINFOFUNCTION failed");
+    if (curl_easy_setopt(
+            transfer->curl, CURLOPT_XFERINFOFUNCTION, ProgressCallback))
+    {
+        LD_LOG(
+            LD_LOG_CRITICAL, "curl_easy_setopt CURLOPT_XFERINFOFUNCTION failed");
 
-        goto cleanup;
+        goto error;
     }
 
     LD_LOG_1(LD_LOG_INFO, "connecting to stream %s", url);
-    res = curl_easy_perform(curl);
-
-    /* CURL_LAST = 99 so the union of curl responses + http response codes should have no overlap. */
-    if (res == CURLE_OK) {
-        long response_code;
-        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response_code);
-        LD_LOG_1(LD_LOG_DEBUG, "curl response code %ld", response_code);
-        *response = response_code;
-    } else {
-        LD_LOG_1(LD_LOG_DEBUG, "curl_easy_perform returned error code %d", res);
-        *response = res;
-    }
 
-cleanup:
-    LDFree(streamdata.mem.memory);
-    LDFree(headers.memory);
-    LDFree(userJSONText);
+    return LDBooleanTrue;
 
-    curl_slist_free_all(headerlist);
+error:
+    LDi_destroyTransfer(transfer);
 
-    curl_easy_cleanup(curl);
+    return LDBooleanFalse;
 }
 
-char *
-LDi_fetchfeaturemap(struct LDClient *const client, long *response)
+LDBoolean
+LDi_preparePollTransfer(
+    struct LDClient *const client, struct LDTransfer *const transfer)
 {
-    CURLcode            res;
-    struct MemoryStruct headers, data;
-    CURL *              curl       = NULL;
-    struct curl_slist * headerlist = NULL, *headertmp = NULL;
-    char *              userJSONText;
-    char                url[4096];
-
-    memset(&headers, 0, sizeof(headers));
-    memset(&data, 0, sizeof(data));
-
-    LDi_rwlock_rdlock(&client->shared->sharedUserLock);
-    LDi_rwlock_rdlock(&client->clientLock);
-
-    userJSONText = LDi_serializeUser(client->shared->sharedUser);
-
-    LDi_rwlock_rdunlock(&client->clientLock);
-    LDi_rwlock_rdunlock(&client->shared->sharedUserLock);
-
-    if (userJSONText == NULL) {
-        LD_LOG(LD_LOG_CRITICAL, "failed to serialize user");
-
-        return NULL;
-    }
-
-    if (client->shared->sharedConfig->useReport) {
-        if (snprintf(
-                url,
-                sizeof(url),
-                "%s/msdk/evalx/user",
-                client->shared->sharedConfig->appURI) < 0)
-        {
-            LDFree(userJSONText);
-
-            LD_LOG(LD_LOG_CRITICAL, "snprintf usereport failed");
+    char url[4096];
 
-            return NULL;
-        }
-    } else {
-        int                  status;
-        size_t               b64len;
-        unsigned char *const b64text = LDi_base64_encode(
-            (unsigned char *)userJSONText, strlen(userJSONText), &b64len);
-
-        if (!b64text) {
-            LDFree(userJSONText);
-
-            LD_LOG(
-                LD_LOG_CRITICAL,
-                "LDi_base64_encode == NULL in LDi_fetchfeaturemap");
+    LD_ASSERT(client);
+    LD_ASSERT(transfer);
 
-            return NULL;
-        }
+    memset(transfer, 0, sizeof(*transfer));
 
-        status = snprintf(
+    if (!prepareUserURL(
+            client,
+            client->shared->sharedConfig->appURI,
+            "/msdk/evalx/user",
+            "/msdk/evalx/users",
             url,
             sizeof(url),
-            "%s/msdk/evalx/users/%s",
-            client->shared->sharedConfig->appURI,
-            b64text);
-
-        LDFree(b64text);
-
-        if (status < 0) {
-            LDFree(userJSONText);
-
-            LD_LOG(LD_LOG_ERROR, "snprintf !usereport failed");
-
-            return NULL;
-        }
-    }
-
-    if (client->shared->sharedConfig->useReasons) {
-        const size_t len = strlen(url);
-        if (snprintf(
-                url + len, sizeof(url) - len, "?withReasons=true") < 0)
-        {
-            LDFree(userJSONText);
-
-            LD_LOG(LD_LOG_ERROR, "snprintf useReason failed");
-
-            return NULL;
-        }
+            &transfer->user))
+    {
+        return LDBooleanFalse;
     }
 
     if (!prepareShared(
             url,
             client->shared->sharedConfig,
-            &curl,
-            &headerlist,
+            &transfer->curl,
+            &transfer->headerlist,
             &WriteMemoryCallback,
-            &headers,
+            &transfer->headers,
             &WriteMemoryCallback,
-            &data,
+            &transfer->data,
             client))
     {
-        LDFree(userJSONText);
-
-        return NULL;
+        goto error;
     }
 
-    if (client->shared->sharedConfig->useReport) {
-        if (curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "REPORT") != CURLE_OK)
-        {
-            LD_LOG(
-                LD_LOG_CRITICAL,
-                "curl_easy_setopt CURLOPT_CUSTOMREQUEST failed");
-
-            goto error;
-        }
-
-        if (!(headertmp = curl_slist_append(
-                  headerlist, "Content-Type: application/json")))
-        {
-            LD_LOG(LD_LOG_CRITICAL, "curl_slist_append failed for headermime");
-
-            goto error;
-        }
-        headerlist = headertmp;
-
-        if (curl_easy_setopt(curl, CURLOPT_POSTFIELDS, userJSONText) !=
-            CURLE_OK) {
-            LD_LOG(
-                LD_LOG_CRITICAL, "curl_easy_setopt CURLOPT_POSTFIELDS failed");
-
-            goto error;
-        }
+    if (client->shared->sharedConfig->useReport &&
+        !prepareReport(transfer)) {
+        goto error;
     }
 
-    if (curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headerlist) != CURLE_OK) {
-        LD_LOG(LD_LOG_CRITICAL, "curl_easy_setopt CURLOPT_HTTPHEADER failed");
+    if (!prepareConditional(client, transfer)) {
         goto error;
     }
 
-    if (curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, (long)client->shared->sharedConfig->requestTimeoutMillis)) {
-        LD_LOG(LD_LOG_CRITICAL, "curl_easy_setopt CURLOPT_TIMEOUT_MS failed");
+    /* an empty string offers every encoding curl was built with */
+    if (curl_easy_setopt(transfer->curl, CURLOPT_ACCEPT_ENCODING, "") !=
+        CURLE_OK)
+    {
+        LD_LOG(
+            LD_LOG_CRITICAL, "curl_easy_setopt CURLOPT_ACCEPT_ENCODING failed");
 
         goto error;
     }
 
-    res = curl_easy_perform(curl);
+    if (curl_easy_setopt(
+            transfer->curl, CURLOPT_HTTPHEADER, transfer->headerlist) !=
+        CURLE_OK)
+    {
+        LD_LOG(LD_LOG_CRITICAL, "curl_easy_setopt CURLOPT_HTTPHEADER failed");
 
-    if (res == CURLE_OK) {
-        long response_code;
-        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response_code);
-        *response = response_code;
-    } else {
-        LD_LOG_1(LD_LOG_DEBUG, "curl_easy_perform returned error code %d", res);
-        *response = -1;
+        goto error;
     }
 
-    LDFree(userJSONText);
-    LDFree(headers.memory);
-
-    curl_slist_free_all(headerlist);
+    if (curl_easy_setopt(
+            transfer->curl,
+            CURLOPT_TIMEOUT_MS,
+            (long)client->shared->sharedConfig->requestTimeoutMillis))
+    {
+        LD_LOG(LD_LOG_CRITICAL, "curl_easy_setopt CURLOPT_TIMEOUT_MS failed");
 
-    curl_easy_cleanup(curl);
+        goto error;
+    }
 
-    return data.memory;
+    return LDBooleanTrue;
 
 error:
-    LDFree(userJSONText);
-    LDFree(data.memory);
-    LDFree(headers.memory);
-
-    curl_slist_free_all(headerlist);
+    LDi_destroyTransfer(transfer);
 
-    curl_easy_cleanup(curl);
-
-    return NULL;
+    return LDBooleanFalse;
 }
 
-void
-LDi_sendevents(
-    struct LDClient *const client,
-    const char *const      eventdata,
-    const char *const      payloadUUID,
-    long *const             response)
+LDBoolean
+LDi_prepareEventTransfer(
+    struct LDClient *const   client,
+    struct LDTransfer *const transfer,
+    const char *const        eventdata,
+    const char *const        payloadUUID)
 {
-    CURLcode            res;
-    struct MemoryStruct headers, data;
-    CURL *              curl       = NULL;
-    struct curl_slist * headerlist = NULL, *headertmp = NULL;
-    char                url[4096];
+    struct curl_slist *headertmp;
+    const char *       body;
+    size_t             bodySize;
+    char               url[4096];
 
 /* This is done as a macro so that the string is a literal */
 #define LD_PAYLOAD_ID_HEADER "X-LaunchDarkly-Payload-ID: "
@@ -732,8 +688,12 @@ LDi_sendevents(
     /* do not need to add space for null termination because of sizeof */
     char payloadIdHeader[sizeof(LD_PAYLOAD_ID_HEADER) + LD_UUID_SIZE];
 
-    memset(&headers, 0, sizeof(headers));
-    memset(&data, 0, sizeof(data));
+    LD_ASSERT(client);
+    LD_ASSERT(transfer);
+    LD_ASSERT(eventdata);
+    LD_ASSERT(payloadUUID);
+
+    memset(transfer, 0, sizeof(*transfer));
 
     if (snprintf(
             url,
@@ -743,40 +703,40 @@ LDi_sendevents(
     {
         LD_LOG(LD_LOG_CRITICAL, "snprintf config->eventsURI failed");
 
-        return;
+        return LDBooleanFalse;
     }
 
     if (!prepareShared(
             url,
             client->shared->sharedConfig,
-            &curl,
-            &headerlist,
+            &transfer->curl,
+            &transfer->headerlist,
             &WriteMemoryCallback,
-            &headers,
+            &transfer->headers,
             &WriteMemoryCallback,
-            &data,
+            &transfer->data,
             client))
     {
-        return;
+        return LDBooleanFalse;
     }
 
-    if (!(headertmp =
-              curl_slist_append(headerlist, "Content-Type: application/json")))
+    if (!(headertmp = curl_slist_append(
+              transfer->headerlist, "Content-Type: application/json")))
     {
         LD_LOG(LD_LOG_CRITICAL, "curl_slist_append failed for headermime");
 
-        goto cleanup;
+        goto error;
     }
-    headerlist = headertmp;
+    transfer->headerlist = headertmp;
 
-    if (!(headertmp =
-              curl_slist_append(headerlist, "X-LaunchDarkly-Event-Schema: 3")))
+    if (!(headertmp = curl_slist_append(
+              transfer->headerlist, "X-LaunchDarkly-Event-Schema: 3")))
     {
         LD_LOG(LD_LOG_CRITICAL, "curl_slist_append failed for headerschema");
 
-        goto cleanup;
+        goto error;
     }
-    headerlist = headertmp;
+    transfer->headerlist = headertmp;
 
     {
         int len;
@@ -790,51 +750,360 @@ LDi_sendevents(
 
         if (len != sizeof(payloadIdHeader) - 1) {
             LD_LOG(LD_LOG_CRITICAL, "unable to generate payload ID header");
-            goto cleanup;
+
+            goto error;
         }
     }
 
 #undef LD_PAYLOAD_ID_HEADER
 
-    if (!(headertmp = curl_slist_append(headerlist, payloadIdHeader))) {
-        goto cleanup;
+    if (!(headertmp = curl_slist_append(transfer->headerlist, payloadIdHeader)))
+    {
+        goto error;
     }
-    headerlist = headertmp;
+    transfer->headerlist = headertmp;
+
+    body     = eventdata;
+    bodySize = strlen(eventdata);
 
-    if (curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headerlist) != CURLE_OK) {
+#ifdef LAUNCHDARKLY_HAVE_ZLIB
+    if (client->shared->sharedConfig->compressEvents &&
+        bodySize >= LD_GZIP_MIN_BYTES)
+    {
+        size_t gzipSize;
+
+        if ((transfer->body = LDi_gzip(eventdata, bodySize, &gzipSize))) {
+            if (!(headertmp = curl_slist_append(
+                      transfer->headerlist, "Content-Encoding: gzip")))
+            {
+                LD_LOG(
+                    LD_LOG_CRITICAL, "curl_slist_append failed for headergzip");
+
+                goto error;
+            }
+            transfer->headerlist = headertmp;
+
+            body     = transfer->body;
+            bodySize = gzipSize;
+        } else {
+            LD_LOG(LD_LOG_WARNING, "failed to compress events, sending plain");
+        }
+    }
+#endif
+
+    if (curl_easy_setopt(
+            transfer->curl, CURLOPT_HTTPHEADER, transfer->headerlist) !=
+        CURLE_OK)
+    {
         LD_LOG(LD_LOG_CRITICAL, "curl_easy_setopt CURLOPT_HTTPHEADER failed");
 
-        goto cleanup;
+        goto error;
+    }
+
+    if (curl_easy_setopt(
+            transfer->curl, CURLOPT_POSTFIELDSIZE, (long)bodySize) != CURLE_OK)
+    {
+        LD_LOG(
+            LD_LOG_CRITICAL, "curl_easy_setopt CURLOPT_POSTFIELDSIZE failed");
+
+        goto error;
     }
 
-    if (curl_easy_setopt(curl, CURLOPT_POSTFIELDS, eventdata) != CURLE_OK) {
+    if (curl_easy_setopt(transfer->curl, CURLOPT_POSTFIELDS, body) !=
+        CURLE_OK)
+    {
         LD_LOG(LD_LOG_CRITICAL, "curl_easy_setopt CURLOPT_POSTFIELDS failed");
 
-        goto cleanup;
+        goto error;
     }
 
-    if (curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, (long)client->shared->sharedConfig->requestTimeoutMillis)) {
+    if (curl_easy_setopt(
+            transfer->curl,
+            CURLOPT_TIMEOUT_MS,
+            (long)client->shared->sharedConfig->requestTimeoutMillis))
+    {
         LD_LOG(LD_LOG_CRITICAL, "curl_easy_setopt CURLOPT_TIMEOUT_MS failed");
 
-        goto cleanup;
+        goto error;
+    }
+
+    return LDBooleanTrue;
+
+error:
+    LDi_destroyTransfer(transfer);
+
+    return LDBooleanFalse;
+}
+
+#ifdef LAUNCHDARKLY_HAVE_ZLIB
+char *
+LDi_gzip(const char *const data, const size_t size, size_t *const gzipSize)
+{
+    z_stream stream;
+    char *   result;
+    uLong    bound;
+
+    LD_ASSERT(data);
+    LD_ASSERT(gzipSize);
+
+    memset(&stream, 0, sizeof(stream));
+
+    /* adding 16 to the window bits selects a gzip wrapper */
+    if (deflateInit2(
+            &stream,
+            Z_DEFAULT_COMPRESSION,
+            Z_DEFLATED,
+            MAX_WBITS + 16,
+            8,
+            Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+        LD_LOG(LD_LOG_ERROR, "deflateInit2 failed");
+
+        return NULL;
+    }
+
+    bound = deflateBound(&stream, (uLong)size);
+
+    if (!(result = LDAlloc(bound))) {
+        deflateEnd(&stream);
+
+        return NULL;
     }
 
-    res = curl_easy_perform(curl);
+    stream.next_in   = (Bytef *)data;
+    stream.avail_in  = (uInt)size;
+    stream.next_out  = (Bytef *)result;
+    stream.avail_out = (uInt)bound;
+
+    if (deflate(&stream, Z_FINISH) != Z_STREAM_END) {
+        LD_LOG(LD_LOG_ERROR, "deflate failed");
+
+        deflateEnd(&stream);
+        LDFree(result);
+
+        return NULL;
+    }
+
+    *gzipSize = stream.total_out;
+
+    deflateEnd(&stream);
+
+    return result;
+}
+#endif
+
+long
+LDi_transferResponse(
+    struct LDTransfer *const transfer, const CURLcode res, const long failure)
+{
+    LD_ASSERT(transfer);
 
     if (res == CURLE_OK) {
         long response_code;
-        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response_code);
-        *response = response_code;
-    } else {
-        LD_LOG_1(LD_LOG_DEBUG, "curl_easy_perform returned error code %d", res);
+
+        curl_easy_getinfo(transfer->curl, CURLINFO_RESPONSE_CODE, &response_code);
+        LD_LOG_1(LD_LOG_DEBUG, "curl response code %ld", response_code);
+
+        return response_code;
+    }
+
+    LD_LOG_1(LD_LOG_DEBUG, "curl_easy_perform returned error code %d", res);
+
+    return failure;
+}
+
+/* ASCII case insensitive comparison of the first n characters */
+static LDBoolean
+headerNameEqual(const char *a, const char *b, size_t n)
+{
+    for (; n > 0; n--, a++, b++) {
+        if (tolower((unsigned char)*a) != tolower((unsigned char)*b)) {
+            return LDBooleanFalse;
+        }
+    }
+
+    return LDBooleanTrue;
+}
+
+char *
+LDi_transferHeader(
+    const struct LDTransfer *const transfer, const char *const name)
+{
+    const char *line;
+    size_t      nameLength;
+    char *      result;
+
+    LD_ASSERT(transfer);
+    LD_ASSERT(name);
+
+    if (transfer->headers.memory == NULL) {
+        return NULL;
+    }
+
+    nameLength = strlen(name);
+    result     = NULL;
+
+    for (line = transfer->headers.memory; *line;) {
+        const char *next, *value, *valueEnd;
+
+        if (!(next = strchr(line, '\n'))) {
+            next = line + strlen(line);
+        }
+
+        if ((size_t)(next - line) > nameLength && line[nameLength] == ':' &&
+            headerNameEqual(line, name, nameLength))
+        {
+            value    = line + nameLength + 1;
+            valueEnd = next;
+
+            while (value < valueEnd && (*value == ' ' || *value == '\t')) {
+                value++;
+            }
+
+            while (valueEnd > value &&
+                   (valueEnd[-1] == '\r' || valueEnd[-1] == ' ' ||
+                    valueEnd[-1] == '\t'))
+            {
+                valueEnd--;
+            }
+
+            /* when redirected the final response takes precedence */
+            LDFree(result);
+
+            if ((result = LDAlloc(valueEnd - value + 1))) {
+                memcpy(result, value, valueEnd - value);
+                result[valueEnd - value] = 0;
+            }
+        }
+
+        line = *next ? next + 1 : next;
+    }
+
+    return result;
+}
+
+char *
+LDi_transferTakeData(struct LDTransfer *const transfer)
+{
+    char *data;
+
+    LD_ASSERT(transfer);
+
+    data                 = transfer->data.memory;
+    transfer->data.memory = NULL;
+    transfer->data.size   = 0;
+
+    return data;
+}
+
+void
+LDi_destroyTransfer(struct LDTransfer *const transfer)
+{
+    if (transfer) {
+        LDFree(transfer->stream.mem.memory);
+        LDFree(transfer->headers.memory);
+        LDFree(transfer->data.memory);
+        LDi_userRequestRelease(transfer->user);
+        LDFree(transfer->body);
+
+        curl_slist_free_all(transfer->headerlist);
+
+        if (transfer->curl) {
+            curl_easy_cleanup(transfer->curl);
+        }
+
+        memset(transfer, 0, sizeof(*transfer));
+    }
+}
+
+/*
+ * this function reads data and passes it to the stream callback.
+ * it doesn't return except after a disconnect. (or some other failure.)
+ */
+void
+LDi_readstream(
+    struct LDClient *const    client,
+    long *                    response,
+    struct LDSSEParser *const parser,
+    void                      cbhandle(struct LDClient *, int))
+{
+    CURLcode          res;
+    struct LDTransfer transfer;
+
+    LD_ASSERT(client);
+    LD_ASSERT(response);
+    LD_ASSERT(parser);
+    LD_ASSERT(cbhandle);
+
+    if (!LDi_prepareStreamTransfer(client, &transfer, parser, cbhandle)) {
         *response = -1;
+
+        return;
     }
 
-cleanup:
-    LDFree(data.memory);
-    LDFree(headers.memory);
+    res = curl_easy_perform(transfer.curl);
 
-    curl_slist_free_all(headerlist);
+    /* CURL_LAST = 99 so the union of curl responses + http response codes
+     * should have no overlap. */
+    *response = LDi_transferResponse(&transfer, res, (long)res);
 
-    curl_easy_cleanup(curl);
+    LDi_destroyTransfer(&transfer);
+}
+
+char *
+LDi_fetchfeaturemap(
+    struct LDClient *const client, long *response, char **const etag)
+{
+    CURLcode          res;
+    struct LDTransfer transfer;
+    char *            data;
+
+    LD_ASSERT(client);
+    LD_ASSERT(response);
+    LD_ASSERT(etag);
+
+    *etag = NULL;
+
+    if (!LDi_preparePollTransfer(client, &transfer)) {
+        return NULL;
+    }
+
+    res = curl_easy_perform(transfer.curl);
+
+    *response = LDi_transferResponse(&transfer, res, -1);
+    data      = LDi_transferTakeData(&transfer);
+
+    if (*response == 200) {
+        *etag = LDi_transferHeader(&transfer, "ETag");
+    }
+
+    LDi_destroyTransfer(&transfer);
+
+    return data;
+}
+
+void
+LDi_sendevents(
+    struct LDClient *const client,
+    const char *const      eventdata,
+    const char *const      payloadUUID,
+    long *const            response)
+{
+    CURLcode          res;
+    struct LDTransfer transfer;
+
+    LD_ASSERT(client);
+    LD_ASSERT(eventdata);
+    LD_ASSERT(payloadUUID);
+    LD_ASSERT(response);
+
+    if (!LDi_prepareEventTransfer(client, &transfer, eventdata, payloadUUID)) {
+        return;
+    }
+
+    res = curl_easy_perform(transfer.curl);
+
+    *response = LDi_transferResponse(&transfer, res, -1);
+
+    LDi_destroyTransfer(&transfer);
 }
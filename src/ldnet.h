@@ -0,0 +1,97 @@
+#pragma once
+
+#include <curl/curl.h>
+
+#include <launchdarkly/boolean.h>
+
+#include "client.h"
+#include "sse.h"
+#include "user_request.h"
+
+struct MemoryStruct
+{
+    char * memory;
+    size_t size;
+};
+
+struct streamdata
+{
+    struct MemoryStruct mem;
+    double              lastdatatime;
+    curl_off_t          lastdataamt;
+    struct LDClient *   client;
+    struct LDSSEParser *parser;
+};
+
+struct cbhandlecontext
+{
+    struct LDClient *client;
+    void (*cb)(struct LDClient *, int);
+};
+
+/* A single HTTP request against LaunchDarkly. Transfers are prepared without
+ * being performed, so that they can either be run to completion with
+ * curl_easy_perform, or driven by a curl multi handle on the network runtime.
+ *
+ * A prepared transfer must not be moved in memory, curl holds pointers into
+ * it. Release it with LDi_destroyTransfer. */
+struct LDTransfer
+{
+    CURL *                 curl;
+    struct curl_slist *    headerlist;
+    struct MemoryStruct    headers;
+    struct MemoryStruct    data;
+    struct streamdata      stream;
+    struct cbhandlecontext handledata;
+    /* the user the request is for, json is also used as a REPORT body */
+    struct LDUserRequest *user;
+    /* owned request body, if it differs from the data given to prepare */
+    char *body;
+};
+
+/* Returns LDBooleanFalse on failure, the transfer is left in a clean state. */
+LDBoolean
+LDi_prepareStreamTransfer(
+    struct LDClient *const    client,
+    struct LDTransfer *const  transfer,
+    struct LDSSEParser *const parser,
+    void                      cbhandle(struct LDClient *, int));
+
+/* Returns LDBooleanFalse on failure, the transfer is left in a clean state. */
+LDBoolean
+LDi_preparePollTransfer(
+    struct LDClient *const client, struct LDTransfer *const transfer);
+
+/* Returns LDBooleanFalse on failure, the transfer is left in a clean state.
+ * `eventdata` is not copied and must outlive the transfer. */
+LDBoolean
+LDi_prepareEventTransfer(
+    struct LDClient *const   client,
+    struct LDTransfer *const transfer,
+    const char *const        eventdata,
+    const char *const        payloadUUID);
+
+/* Returns the HTTP status of a completed transfer, or `failure` if curl
+ * itself failed. */
+long
+LDi_transferResponse(
+    struct LDTransfer *const transfer, const CURLcode res, const long failure);
+
+/* Returns a copy of the value of the named response header, or NULL if it
+ * was not present. */
+char *
+LDi_transferHeader(
+    const struct LDTransfer *const transfer, const char *const name);
+
+/* Takes ownership of the response body of a completed transfer. */
+char *
+LDi_transferTakeData(struct LDTransfer *const transfer);
+
+void
+LDi_destroyTransfer(struct LDTransfer *const transfer);
+
+#ifdef LAUNCHDARKLY_HAVE_ZLIB
+/* Returns a gzip encoded copy of data, or NULL on failure */
+char *
+LDi_gzip(const char *const data, const size_t size, size_t *const gzipSize);
+#endif
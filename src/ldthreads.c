@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #ifndef _WINDOWS
 #include <unistd.h>
 #else
@@ -13,12 +14,387 @@
 
 #include "flag.h"
 #include "ldinternal.h"
+#include "ldnet.h"
+#include "network_runtime.h"
 
 /*
  * all the code that runs in the background here.
  * plus the server event parser and streaming update handler.
  */
 
+/* the most spooled payloads resent per flush interval */
+#define LD_SPOOL_DRAIN_MAX 16
+
+/* the fewest flags worth parsing on a thread of their own */
+#define LD_PUT_MIN_FLAGS_PER_THREAD 2048
+
+/* Returns LDBooleanTrue once the payload is finished with, otherwise the
+ * payload should be sent again after a short delay. */
+static LDBoolean
+LDi_oneventresponse(
+    struct LDClient *const client,
+    const long             response,
+    LDBoolean *const       sendFailed)
+{
+    if (response == 200 || response == 202) {
+        LD_LOG(LD_LOG_TRACE, "successfuly sent event batch");
+
+        *sendFailed = LDBooleanFalse;
+
+        return LDBooleanTrue;
+    }
+
+    if (*sendFailed == LDBooleanTrue) {
+        return LDBooleanTrue;
+    }
+
+    *sendFailed = LDBooleanTrue;
+
+    if (response == 401 || response == 403) {
+        LDi_rwlock_wrlock(&client->clientLock);
+        LDi_updatestatus(client, LDStatusFailed);
+        LDi_rwlock_wrunlock(&client->clientLock);
+
+        LD_LOG(LD_LOG_ERROR, "mobile key not authorized, event sending failed");
+
+        return LDBooleanTrue;
+    }
+
+    return LDBooleanFalse;
+}
+
+/* Determines if a failed delivery may succeed later, as opposed to the payload
+ * having been rejected. */
+static LDBoolean
+LDi_eventretryable(const long response)
+{
+    return response <= 0 || response == 408 || response == 429 ||
+           response >= 500;
+}
+
+/* Called once delivery of a fresh payload has been abandoned */
+static void
+LDi_spoolpayload(
+    struct LDClient *const client,
+    const char *const      payload,
+    const char *const      payloadId,
+    const long             response)
+{
+    if (client->eventSpool && LDi_eventretryable(response) &&
+        LDi_eventSpoolAppend(client->eventSpool, payloadId, payload))
+    {
+        LD_LOG(LD_LOG_WARNING, "sending events failed spooled event batch");
+
+        return;
+    }
+
+    LD_LOG(LD_LOG_WARNING, "sending events failed deleting event batch");
+}
+
+/* Applies the response to a payload read from the spool. Returns LDBooleanTrue
+ * if the payload was removed from the spool. */
+static LDBoolean
+LDi_onspooledresponse(struct LDClient *const client, const long response)
+{
+    if (response == 200 || response == 202) {
+        LDi_eventSpoolAck(client->eventSpool);
+
+        return LDBooleanTrue;
+    }
+
+    if (!LDi_eventretryable(response)) {
+        LD_LOG(LD_LOG_WARNING, "spooled event batch rejected deleting it");
+
+        LDi_eventSpoolAck(client->eventSpool);
+
+        return LDBooleanTrue;
+    }
+
+    return LDBooleanFalse;
+}
+
+/* Resends spooled payloads, stopping at the first that can not be
+ * delivered. At most `limit` are sent to bound the time spent. */
+static void
+LDi_drainspool(struct LDClient *const client, unsigned int limit)
+{
+    if (!client->eventSpool) {
+        return;
+    }
+
+    while (limit-- > 0) {
+        char *    payload;
+        char      payloadId[LD_UUID_SIZE + 1];
+        long      response;
+        LDBoolean removed;
+
+        if (!LDi_eventSpoolPeek(client->eventSpool, &payload, payloadId) ||
+            payload == NULL)
+        {
+            return;
+        }
+
+        response = 0;
+
+        LDi_sendevents(client, payload, payloadId, &response);
+
+        LDFree(payload);
+
+        removed = LDi_onspooledresponse(client, response);
+
+        if (!removed) {
+            return;
+        }
+    }
+}
+
+/* A serialized event payload awaiting delivery */
+struct LDEventChunk
+{
+    char *               payload;
+    char                 payloadId[LD_UUID_SIZE + 1];
+    struct LDEventChunk *next;
+};
+
+static void
+LDi_freeeventchunks(struct LDEventChunk *chunk)
+{
+    while (chunk) {
+        struct LDEventChunk *const next = chunk->next;
+
+        LDFree(chunk->payload);
+        LDFree(chunk);
+
+        chunk = next;
+    }
+}
+
+/* Takes ownership of payload, which is freed on failure */
+static struct LDEventChunk *
+LDi_neweventchunk(char *const payload)
+{
+    struct LDEventChunk *chunk;
+
+    if (!(chunk = LDAlloc(sizeof(*chunk)))) {
+        LDFree(payload);
+
+        return NULL;
+    }
+
+    memset(chunk, 0, sizeof(*chunk));
+
+    chunk->payload = payload;
+
+    if (!LDi_UUIDv4(chunk->payloadId)) {
+        LD_LOG(LD_LOG_ERROR, "failed to generate payload identifier");
+
+        LDi_freeeventchunks(chunk);
+
+        return NULL;
+    }
+
+    return chunk;
+}
+
+/* Joins serialized events into a JSON array */
+static char *
+LDi_joineventchunk(
+    char *const *const  parts,
+    const size_t *const sizes,
+    const size_t        count,
+    const size_t        total)
+{
+    char * joined, *iter;
+    size_t i;
+
+    if (!(joined = LDAlloc(total + 1))) {
+        return NULL;
+    }
+
+    iter    = joined;
+    *iter++ = '[';
+
+    for (i = 0; i < count; i++) {
+        if (i > 0) {
+            *iter++ = ',';
+        }
+
+        memcpy(iter, parts[i], sizes[i]);
+        iter += sizes[i];
+    }
+
+    *iter++ = ']';
+    *iter   = 0;
+
+    return joined;
+}
+
+/* Serializes each event on its own, and groups them into chunks of at most
+ * maxBytes. An event larger than maxBytes becomes a chunk of its own. */
+static LDBoolean
+LDi_splitevents(
+    const struct LDJSON *const  payloadJSON,
+    const size_t                maxBytes,
+    struct LDEventChunk **const chunks)
+{
+    struct LDEventChunk **tail;
+    struct LDJSON *       iter;
+    char **               parts;
+    size_t *              sizes, count, start, end, i;
+    LDBoolean             success;
+
+    success = LDBooleanFalse;
+    tail    = chunks;
+    count   = 0;
+    parts   = NULL;
+    sizes   = NULL;
+
+    i = LDCollectionGetSize(payloadJSON);
+
+    if (!(parts = LDAlloc(i * sizeof(char *))) ||
+        !(sizes = LDAlloc(i * sizeof(size_t))))
+    {
+        goto cleanup;
+    }
+
+    for (iter = LDGetIter(payloadJSON); iter; iter = LDIterNext(iter)) {
+        if (!(parts[count] = LDJSONSerialize(iter))) {
+            goto cleanup;
+        }
+
+        sizes[count] = strlen(parts[count]);
+        count++;
+    }
+
+    for (start = 0; start < count; start = end) {
+        struct LDEventChunk *chunk;
+        char *               joined;
+        /* brackets enclosing the array */
+        size_t total = 2 + sizes[start];
+
+        for (end = start + 1; end < count && total + 1 + sizes[end] <= maxBytes;
+             end++)
+        {
+            total += 1 + sizes[end];
+        }
+
+        if (!(joined = LDi_joineventchunk(
+                  parts + start, sizes + start, end - start, total)) ||
+            !(chunk = LDi_neweventchunk(joined)))
+        {
+            goto cleanup;
+        }
+
+        *tail = chunk;
+        tail  = &chunk->next;
+    }
+
+    success = LDBooleanTrue;
+
+cleanup:
+    for (i = 0; i < count; i++) {
+        LDFree(parts[i]);
+    }
+
+    LDFree(parts);
+    LDFree(sizes);
+
+    if (!success) {
+        LDi_freeeventchunks(*chunks);
+        *chunks = NULL;
+    }
+
+    return success;
+}
+
+/* Bundles queued events into serialized payloads, each with its own
+ * identifier. Sets `chunks` to NULL when there is nothing to send. */
+static LDBoolean
+LDi_bundleeventchunks(
+    struct LDClient *const client, struct LDEventChunk **const chunks)
+{
+    struct LDJSON *payloadJSON;
+    char *         serialized;
+    size_t         maxBytes;
+    LDBoolean      success;
+
+    *chunks = NULL;
+
+    if (!LDi_bundleEventPayload(client->eventProcessor, &payloadJSON)) {
+        LD_LOG(LD_LOG_ERROR, "failed to bundle event payload");
+
+        return LDBooleanFalse;
+    }
+
+    if (payloadJSON == NULL) {
+        return LDBooleanTrue;
+    }
+
+    maxBytes = client->shared->sharedConfig->eventsMaxPayloadBytes;
+
+    if (maxBytes > 0 && LDCollectionGetSize(payloadJSON) > 1) {
+        success = LDi_splitevents(payloadJSON, maxBytes, chunks);
+    } else {
+        if ((serialized = LDJSONSerialize(payloadJSON))) {
+            *chunks = LDi_neweventchunk(serialized);
+        }
+
+        success = *chunks != NULL;
+    }
+
+    LDJSONFree(payloadJSON);
+
+    if (!success) {
+        LD_LOG(LD_LOG_ERROR, "failed to serialize event payload");
+    }
+
+    return success;
+}
+
+/* Delivers a single payload, retrying once after a short delay */
+static void
+LDi_sendeventchunk(
+    struct LDClient *const client, const struct LDEventChunk *const chunk)
+{
+    LDBoolean sendFailed;
+    long      response;
+
+    sendFailed = LDBooleanFalse;
+    while (LDBooleanTrue) {
+        response = 0;
+
+        LDi_sendevents(client, chunk->payload, chunk->payloadId, &response);
+
+        if (LDi_oneventresponse(client, response, &sendFailed)) {
+            break;
+        }
+
+        LDi_mutex_lock(&client->condMtx);
+        LDi_cond_wait(&client->eventCond, &client->condMtx, 1000);
+        LDi_mutex_unlock(&client->condMtx);
+    }
+
+    if (sendFailed) {
+        LDi_spoolpayload(client, chunk->payload, chunk->payloadId, response);
+    }
+}
+
+void
+LDi_sendqueuedevents(struct LDClient *const client)
+{
+    struct LDEventChunk *chunks, *chunk;
+
+    if (!LDi_bundleeventchunks(client, &chunks)) {
+        return;
+    }
+
+    for (chunk = chunks; chunk; chunk = chunk->next) {
+        LDi_sendeventchunk(client, chunk);
+    }
+
+    LDi_freeeventchunks(chunks);
+}
+
 THREAD_RETURN
 LDi_bgeventsender(void *const v)
 {
@@ -26,20 +402,13 @@ LDi_bgeventsender(void *const v)
     LDBoolean              finalflush = LDBooleanFalse;
 
     while (LDBooleanTrue) {
-        struct LDJSON *payloadJSON;
-        char *         payloadSerialized;
-        LDStatus       status;
-        int            ms;
-        char           payloadId[LD_UUID_SIZE + 1];
-        LDBoolean      sendFailed;
-
-        LDi_rwlock_wrlock(&client->clientLock);
+        LDStatus status;
+        int      ms;
 
-        status = client->status;
+        status = LDi_getstatus(client);
 
         if (status == LDStatusFailed || finalflush) {
             LD_LOG(LD_LOG_TRACE, "killing thread LDi_bgeventsender");
-            LDi_rwlock_wrunlock(&client->clientLock);
             return THREAD_RETURN_DEFAULT;
         }
 
@@ -47,102 +416,197 @@ LDi_bgeventsender(void *const v)
 
         if (status != LDStatusShuttingdown) {
             LDi_mutex_lock(&client->condMtx);
-            LDi_rwlock_wrunlock(&client->clientLock);
-            LDi_cond_wait(&client->eventCond, &client->condMtx, ms);
+            /* rechecked under condMtx, so the shutdown signal is not missed */
+            if (LDi_getstatus(client) != LDStatusShuttingdown) {
+                LDi_cond_wait(&client->eventCond, &client->condMtx, ms);
+            }
             LDi_mutex_unlock(&client->condMtx);
-        } else {
-            LDi_rwlock_wrunlock(&client->clientLock);
         }
 
         LD_LOG(LD_LOG_TRACE, "bgsender running");
 
-        LDi_rwlock_rdlock(&client->clientLock);
-        if (client->status == LDStatusShuttingdown) {
+        if (LDi_getstatus(client) == LDStatusShuttingdown) {
             finalflush = LDBooleanTrue;
         }
 
-        if (client->offline) {
-            LDi_rwlock_rdunlock(&client->clientLock);
+        if (LDi_isoffline(client)) {
             continue;
         }
-        LDi_rwlock_rdunlock(&client->clientLock);
 
-        payloadId[LD_UUID_SIZE] = 0;
+        /* anything left is retained on disk for the next run */
+        if (!finalflush) {
+            LDi_drainspool(client, LD_SPOOL_DRAIN_MAX);
+        }
 
-        if (!LDi_UUIDv4(payloadId)) {
-            LD_LOG(LD_LOG_ERROR, "failed to generate payload identifier");
+        LDi_sendqueuedevents(client);
+    }
+}
 
-            continue;
+/* Determines if polling is currently unnecessary, and the interval to use.
+ * Only called by whichever thread polls. */
+static LDBoolean
+LDi_pollingskipped(struct LDClient *const client, int *const ms)
+{
+    struct LDConfig *const config = client->shared->sharedConfig;
+    LDBoolean              skippolling;
+    unsigned int           unchanged;
+
+    skippolling = LDi_isoffline(client);
+    *ms         = config->pollingIntervalMillis;
+    if (LDi_isbackground(client)) {
+        *ms         = config->backgroundPollingIntervalMillis;
+        skippolling = skippolling || config->disableBackgroundUpdating;
+    } else {
+        skippolling = skippolling || config->streaming;
+    }
+
+    LDi_rwlock_rdlock(&client->clientLock);
+    unchanged = client->pollsUnchanged;
+    LDi_rwlock_rdunlock(&client->clientLock);
+
+    /* adaptive polling doubles the interval per unchanged poll */
+    for (;
+         unchanged > 0 && *ms < config->maxPollingIntervalMillis;
+         unchanged--)
+    {
+        if (*ms > config->maxPollingIntervalMillis / 2) {
+            *ms = config->maxPollingIntervalMillis;
+        } else {
+            *ms *= 2;
         }
+    }
 
-        if (!LDi_bundleEventPayload(client->eventProcessor, &payloadJSON)) {
-            LD_LOG(
-                LD_LOG_ERROR,
-                "LDi_bgeventsender failed to bundle event payload");
+    return skippolling;
+}
 
-            continue;
-        }
+void
+LDi_resetpolletag(struct LDClient *const client)
+{
+    LDFree(client->pollETag);
+    client->pollETag       = NULL;
+    client->pollsUnchanged = 0;
+    client->pollGeneration++;
+}
 
-        if (payloadJSON == NULL) {
-            continue;
-        }
+/* Taken before a poll is issued, to be given to LDi_onpollresponse */
+static unsigned int
+LDi_pollgeneration(struct LDClient *const client)
+{
+    unsigned int generation;
 
-        if (!(payloadSerialized = LDJSONSerialize(payloadJSON))) {
-            LD_LOG(
-                LD_LOG_ERROR,
-                "LDi_bgeventsender failed to serialize event payload");
+    LDi_rwlock_rdlock(&client->clientLock);
+    generation = client->pollGeneration;
+    LDi_rwlock_rdunlock(&client->clientLock);
 
-            LDJSONFree(payloadJSON);
+    return generation;
+}
 
-            continue;
-        }
+/* Tracks unchanged polls for adaptive polling, expects clientLock for
+ * writing */
+static void
+LDi_polloutcome(
+    struct LDClient *const client,
+    const unsigned int     generation,
+    const LDBoolean        changed)
+{
+    /* a poll issued before a reset says nothing of the flags since */
+    if (client->pollGeneration != generation) {
+        return;
+    }
+
+    if (changed) {
+        client->pollsUnchanged = 0;
+    } else if (client->pollsUnchanged < 32) {
+        client->pollsUnchanged++;
+    }
+}
 
-        LDJSONFree(payloadJSON);
+/* Returns LDBooleanTrue if the poll succeeded. Takes ownership of etag.
+ * `generation` and `identifyGeneration` are those taken when the poll was
+ * issued. */
+static LDBoolean
+LDi_onpollresponse(
+    struct LDClient *const client,
+    const unsigned int     generation,
+    const unsigned int     identifyGeneration,
+    const long             response,
+    const char *const      data,
+    char *const            etag)
+{
+    if ((response == 200 || response == 304) &&
+        LDi_pollgeneration(client) != generation)
+    {
+        /* issued for a user or flags since replaced, so neither its flags
+         * nor its entity tag describe what the store should hold */
+        LD_LOG(LD_LOG_TRACE, "discarding stale poll");
 
-        sendFailed = LDBooleanFalse;
-        while (LDBooleanTrue) {
-            long response = 0;
+        LDFree(etag);
 
-            LDi_sendevents(client, payloadSerialized, payloadId, &response);
+        return LDBooleanFalse;
+    }
 
-            if (response == 200 || response == 202) {
-                LD_LOG(LD_LOG_TRACE, "successfuly sent event batch");
+    if (response == 200) {
+        unsigned int revision;
+        LDBoolean    changed;
 
-                sendFailed = LDBooleanFalse;
+        if (!data) {
+            LDFree(etag);
 
-                break;
-            } else {
-                if (sendFailed == LDBooleanTrue) {
-                    break;
-                }
+            return LDBooleanFalse;
+        }
 
-                sendFailed = LDBooleanTrue;
+        revision = LDi_storeRevision(&client->store);
 
-                if (response == 401 || response == 403) {
-                    LDi_rwlock_wrlock(&client->clientLock);
-                    LDi_updatestatus(client, LDStatusFailed);
-                    LDi_rwlock_wrunlock(&client->clientLock);
+        /* rechecks identifyGeneration in the critical section storing the
+         * flags, as an identify may have run since the check above */
+        if (!LDi_onstreameventput(client, identifyGeneration, data)) {
+            LDFree(etag);
 
-                    LD_LOG(
-                        LD_LOG_ERROR,
-                        "mobile key not authorized, event sending failed");
+            return LDBooleanFalse;
+        }
 
-                    break;
-                }
+        changed = revision != LDi_storeRevision(&client->store);
 
-                LDi_mutex_lock(&client->condMtx);
-                LDi_cond_wait(&client->eventCond, &client->condMtx, 1000);
-                LDi_mutex_unlock(&client->condMtx);
-            }
+        /* only remembered once the flags it describes have been stored, and
+         * unless something replaced them meanwhile */
+        LDi_rwlock_wrlock(&client->clientLock);
+        if (client->pollGeneration == generation) {
+            LDi_polloutcome(client, generation, changed);
+            LDFree(client->pollETag);
+            client->pollETag = etag;
+        } else {
+            LDFree(etag);
         }
+        LDi_rwlock_wrunlock(&client->clientLock);
 
-        if (sendFailed) {
-            LD_LOG(
-                LD_LOG_WARNING, "sending events failed deleting event batch");
+        return LDBooleanTrue;
+    }
+
+    LDFree(etag);
+
+    if (response == 304) {
+        LD_LOG(LD_LOG_TRACE, "poll not modified");
+
+        /* the store already holds these flags, so skip parsing them */
+        LDi_rwlock_wrlock(&client->clientLock);
+        LDi_polloutcome(client, generation, LDBooleanFalse);
+        if (LDi_getstatus(client) == LDStatusInitializing) {
+            LDi_updatestatus(client, LDStatusInitialized);
         }
+        LDi_rwlock_wrunlock(&client->clientLock);
 
-        LDFree(payloadSerialized);
+        return LDBooleanTrue;
+    } else if (response == 401 || response == 403) {
+        LDi_rwlock_wrlock(&client->clientLock);
+        LDi_updatestatus(client, LDStatusFailed);
+        LDi_rwlock_wrunlock(&client->clientLock);
+
+        LD_LOG(LD_LOG_ERROR, "mobile key not authorized, polling failed");
+    } else {
+        LD_LOG(LD_LOG_ERROR, "poll failed will retry again");
     }
+
+    return LDBooleanFalse;
 }
 
 /*
@@ -154,438 +618,1276 @@ LDi_bgfeaturepoller(void *const v)
     struct LDClient *const client = v;
 
     while (LDBooleanTrue) {
-        LDBoolean skippolling;
-        int       ms;
-        long      response;
-        char *    data;
+        LDBoolean    skippolling;
+        LDStatus     status;
+        int          ms;
+        long         response;
+        char *       data, *etag;
+        unsigned int generation, identifyGeneration;
 
-        LDi_rwlock_wrlock(&client->clientLock);
+        status = LDi_getstatus(client);
 
-        if (client->status == LDStatusFailed ||
-            client->status == LDStatusShuttingdown) {
+        if (status == LDStatusFailed || status == LDStatusShuttingdown) {
             LD_LOG(LD_LOG_TRACE, "killing thread LDi_bgfeaturepoller");
-            LDi_rwlock_wrunlock(&client->clientLock);
             return THREAD_RETURN_DEFAULT;
         }
 
-        skippolling = client->offline;
-        ms          = client->shared->sharedConfig->pollingIntervalMillis;
-        if (client->background) {
-            ms = client->shared->sharedConfig->backgroundPollingIntervalMillis;
-            skippolling =
-                skippolling ||
-                client->shared->sharedConfig->disableBackgroundUpdating;
-        } else {
-            skippolling =
-                skippolling || client->shared->sharedConfig->streaming;
-        }
+        skippolling = LDi_pollingskipped(client, &ms);
 
         /* this triggers the first time the thread runs, so we don't have
         to wait */
-        if (!skippolling && client->status == LDStatusInitializing) {
+        if (!skippolling && LDi_awaitingflags(client)) {
             ms = 0;
         }
 
         if (ms > 0) {
             LDi_mutex_lock(&client->condMtx);
-            LDi_rwlock_wrunlock(&client->clientLock);
-            LDi_cond_wait(&client->pollCond, &client->condMtx, ms);
+            /* rechecked under condMtx, so the shutdown signal is not missed */
+            status = LDi_getstatus(client);
+            if (status != LDStatusFailed && status != LDStatusShuttingdown) {
+                LDi_cond_wait(&client->pollCond, &client->condMtx, ms);
+            }
             LDi_mutex_unlock(&client->condMtx);
-        } else {
-            LDi_rwlock_wrunlock(&client->clientLock);
         }
 
         if (skippolling) {
             continue;
         }
 
-        LDi_rwlock_rdlock(&client->clientLock);
-        if (client->status == LDStatusFailed ||
-            client->status == LDStatusShuttingdown) {
-            LDi_rwlock_rdunlock(&client->clientLock);
+        status = LDi_getstatus(client);
+
+        if (status == LDStatusFailed || status == LDStatusShuttingdown) {
             continue;
         }
-        LDi_rwlock_rdunlock(&client->clientLock);
 
-        response = 0;
-        data     = LDi_fetchfeaturemap(client, &response);
+        response           = 0;
+        generation         = LDi_pollgeneration(client);
+        identifyGeneration = LDi_identifygeneration(client);
+        data               = LDi_fetchfeaturemap(client, &response, &etag);
 
-        if (response == 200) {
-            if (!data) {
-                continue;
-            }
+        LDi_onpollresponse(
+            client, generation, identifyGeneration, response, data, etag);
 
-            LDi_onstreameventput(client, data);
-        } else if (response == 401 || response == 403) {
-            LDi_rwlock_wrlock(&client->clientLock);
-            LDi_updatestatus(client, LDStatusFailed);
-            LDi_rwlock_wrunlock(&client->clientLock);
+        LDFree(data);
+    }
+}
 
-            LD_LOG(LD_LOG_ERROR, "mobile key not authorized, polling failed");
-        } else {
-            LD_LOG(LD_LOG_ERROR, "poll failed will retry again");
-        }
+/* A range of the flags of a put, parsed by one thread */
+struct LDPutRange
+{
+    const struct LDJSON **items;
+    struct LDFlag *       flags;
+    size_t                begin;
+    size_t                end;
+    LDBoolean             failed;
+    LDBoolean             started;
+    ld_thread_t           thread;
+};
+
+/* Parses the range, leaving nothing allocated if any flag fails */
+static THREAD_RETURN
+LDi_parseputrange(void *const rangeRaw)
+{
+    struct LDPutRange *const range = (struct LDPutRange *)rangeRaw;
+    size_t                   i, j;
+
+    for (i = range->begin; i < range->end; i++) {
+        if (!LDi_flag_parse(
+                &range->flags[i], LDIterKey(range->items[i]), range->items[i]))
+        {
+            LD_LOG(LD_LOG_ERROR, "stream PUT: error parsing flag");
+
+            for (j = range->begin; j < i; j++) {
+                LDi_flag_destroy(&range->flags[j]);
+            }
+
+            range->failed = LDBooleanTrue;
+
+            break;
+        }
+    }
+
+    return THREAD_RETURN_DEFAULT;
+}
+
+/* Parses every flag of the payload into `flags`, splitting large payloads
+ * into ranges of keys parsed in parallel. The payload is only read, which
+ * is safe from any number of threads.
+ *
+ * Unlike a patch, a put copies what it keeps rather than taking it from the
+ * payload. Members taken from a payload this large pin it in place once
+ * freed, fragmenting the heap enough that later puts were several times
+ * slower in benchmark-put-ingest. */
+static LDBoolean
+LDi_parseputflags(
+    struct LDClient *const     client,
+    const struct LDJSON *const payload,
+    struct LDFlag *const       flags,
+    const size_t               flagCount)
+{
+    const struct LDJSON **items;
+    const struct LDJSON * iter;
+    struct LDPutRange *   ranges;
+    size_t                rangeCount, i, j;
+    LDBoolean             failed;
+
+    rangeCount = flagCount / LD_PUT_MIN_FLAGS_PER_THREAD;
+
+    if (rangeCount > client->shared->sharedConfig->flagParseThreads) {
+        rangeCount = client->shared->sharedConfig->flagParseThreads;
+    }
+
+    if (rangeCount < 1) {
+        rangeCount = 1;
+    }
+
+    items  = NULL;
+    ranges = NULL;
+    failed = LDBooleanTrue;
+
+    if (!(items = (const struct LDJSON **)LDAlloc(
+              sizeof(struct LDJSON *) * (flagCount ? flagCount : 1))) ||
+        !(ranges = (struct LDPutRange *)LDAlloc(
+              sizeof(struct LDPutRange) * rangeCount)))
+    {
+        LD_LOG(LD_LOG_ERROR, "stream PUT: failed to allocate parse ranges");
+
+        goto cleanup;
+    }
+
+    for (i = 0, iter = LDGetIter(payload); i < flagCount;
+         i++, iter = LDIterNext(iter))
+    {
+        LD_ASSERT(iter);
+
+        items[i] = iter;
+    }
+
+    for (i = 0; i < rangeCount; i++) {
+        ranges[i].items   = items;
+        ranges[i].flags   = flags;
+        ranges[i].begin   = flagCount * i / rangeCount;
+        ranges[i].end     = flagCount * (i + 1) / rangeCount;
+        ranges[i].failed  = LDBooleanFalse;
+        ranges[i].started = LDBooleanFalse;
+    }
+
+    /* the first range is parsed here, as is any without a thread */
+    for (i = 1; i < rangeCount; i++) {
+        ranges[i].started = LDi_thread_create(
+            &ranges[i].thread, LDi_parseputrange, &ranges[i]);
+    }
+
+    failed = LDBooleanFalse;
+
+    for (i = 0; i < rangeCount; i++) {
+        if (ranges[i].started) {
+            LDi_thread_join(&ranges[i].thread);
+        } else {
+            LDi_parseputrange(&ranges[i]);
+        }
+
+        failed |= ranges[i].failed;
+    }
+
+    if (failed) {
+        for (i = 0; i < rangeCount; i++) {
+            if (!ranges[i].failed) {
+                for (j = ranges[i].begin; j < ranges[i].end; j++) {
+                    LDi_flag_destroy(&flags[j]);
+                }
+            }
+        }
+    }
+
+cleanup:
+    LDFree(items);
+    LDFree(ranges);
+
+    return !failed;
+}
+
+LDBoolean
+LDi_onstreameventput(
+    struct LDClient *const client,
+    const unsigned int     generation,
+    const char *const      data)
+{
+    struct LDJSON *payload;
+    struct LDFlag *flags;
+    size_t flagCount, i;
+    LDBoolean storeResult;
+
+    payload = NULL;
+
+    if (!(payload = LDJSONDeserialize(data))) {
+        LD_LOG(LD_LOG_ERROR, "stream PUT: failed to deserialize event data");
+        return LDBooleanFalse;
+    }
+
+    if (LDJSONGetType(payload) != LDObject) {
+        LD_LOG(LD_LOG_ERROR, "stream PUT: data must be a JSON object");
+        LDJSONFree(payload);
+        return LDBooleanFalse;
+    }
+
+    flagCount = LDCollectionGetSize(payload);
+
+    if (!(flags = LDAlloc(sizeof(struct LDFlag) * flagCount))) {
+        LD_LOG(LD_LOG_ERROR, "stream PUT: failed to allocate space for flags");
+        LDJSONFree(payload);
+        return LDBooleanFalse;
+    }
+
+    if (!LDi_parseputflags(client, payload, flags, flagCount)) {
+        LDJSONFree(payload);
+        LDFree(flags);
+        return LDBooleanFalse;
+    }
+
+    LDJSONFree(payload);
+
+    /* checked and stored in one critical section, so that an identify
+     * cannot come between them */
+    LDi_rwlock_wrlock(&client->clientLock);
+
+    if (client->identifyGeneration != generation) {
+        LDi_rwlock_wrunlock(&client->clientLock);
+
+        LD_LOG(LD_LOG_TRACE, "discarding put requested for a previous user");
+
+        for (i = 0; i < flagCount; i++) {
+            LDi_flag_destroy(&flags[i]);
+        }
+
+        LDFree(flags);
+
+        return LDBooleanFalse;
+    }
+
+    storeResult = LDi_storePut(&client->store, flags, flagCount);
+
+    if (storeResult) {
+        LDi_atomic_store(&client->cachedFlags, LDBooleanFalse);
+        LDi_identifycompleted(client);
+    }
+    LDi_updatestatus(client, storeResult ? LDStatusInitialized : LDStatusFailed);
+    LDi_rwlock_wrunlock(&client->clientLock);
+
+    return storeResult;
+}
+
+void
+LDi_onstreameventpatch(struct LDClient *const client, const char *const data)
+{
+    struct LDJSON *payload;
+    struct LDFlag  flag;
+
+    LD_ASSERT(client);
+    LD_ASSERT(data);
+
+    payload = NULL;
+
+    if (!(payload = LDJSONDeserialize(data))) {
+        LD_LOG(LD_LOG_ERROR, "failed to deserialize patch discarding update");
+
+        goto cleanup;
+    }
+
+    if (!LDi_flag_take(&flag, payload)) {
+        LD_LOG(LD_LOG_ERROR, "failed to parse flag patch discarding update");
+
+        goto cleanup;
+    }
+
+    if (!LDi_storeUpsert(&client->store, flag)) {
+        LD_LOG(LD_LOG_ERROR, "failed to upsert flag");
+
+        goto cleanup;
+    }
+
+cleanup:
+    LDJSONFree(payload);
+}
+
+void
+LDi_onstreameventdelete(struct LDClient *const client, const char *const data)
+{
+    struct LDJSON *payload, *tmp;
+    char *         key;
+    unsigned int   version;
+
+    LD_ASSERT(client);
+    LD_ASSERT(data);
+
+    payload = NULL;
+
+    if (!(payload = LDJSONDeserialize(data))) {
+        LD_LOG(LD_LOG_ERROR, "failed to parse delete discarding update");
+
+        goto cleanup;
+    }
+
+    if (LDJSONGetType(payload) != LDObject) {
+        goto cleanup;
+    }
+
+    if (!(tmp = LDObjectLookup(payload, "version"))) {
+        goto cleanup;
+    }
+
+    if (LDJSONGetType(tmp) != LDNumber) {
+        goto cleanup;
+    }
+
+    version = LDGetNumber(tmp);
+
+    if (!(tmp = LDObjectLookup(payload, "key"))) {
+        goto cleanup;
+    }
+
+    if (LDJSONGetType(tmp) != LDText) {
+        goto cleanup;
+    }
+
+    if (!(key = LDi_takeText(tmp))) {
+        goto cleanup;
+    }
+
+    if (!LDi_storeDeleteTaken(&client->store, key, version)) {
+        LD_LOG(LD_LOG_ERROR, "failed to delete flag");
+
+        goto cleanup;
+    }
+
+cleanup:
+    LDJSONFree(payload);
+}
+
+void
+LDi_startstopstreaming(
+    struct LDClient *const client, const LDBoolean stopstreaming)
+{
+    LDi_atomic_store(&client->shouldstopstreaming, stopstreaming);
+    LDi_signalbackground(client, LD_SIGNAL_POLL | LD_SIGNAL_STREAM);
+}
+
+static void
+LDi_updatehandle(struct LDClient *const client, const int handle)
+{
+    LDi_rwlock_wrlock(&client->clientLock);
+    LDi_socketStore(&client->streamhandle, handle);
+    LDi_rwlock_wrunlock(&client->clientLock);
+}
+
+void
+LDi_reinitializeconnection(struct LDClient *const client)
+{
+    LDBoolean socketOpen;
+    int socketHandle;
+
+    socketOpen = LDi_socketLoad(&client->streamhandle, &socketHandle);
+
+    if (socketOpen) {
+        LDi_cancelread(socketHandle);
+        LDi_socketClose(&client->streamhandle);
+    }
+    LDi_signalbackground(client, LD_SIGNAL_POLL | LD_SIGNAL_STREAM);
+}
+
+/* The context of the SSE parser of a stream connection */
+struct LDStreamContext
+{
+    struct LDClient *client;
+    /* of the client when the connection was issued */
+    unsigned int identifyGeneration;
+};
+
+static LDBoolean
+LDi_onEvent(
+    const char *const eventName,
+    const char *const eventBuffer,
+    void *const       rawContext)
+{
+    struct LDStreamContext *context;
+    struct LDClient *       client;
+
+    LD_ASSERT(eventName);
+    LD_ASSERT(eventBuffer);
+    LD_ASSERT(rawContext);
+
+    context = (struct LDStreamContext *)rawContext;
+    client  = context->client;
+
+    /* a connection issued before an identify streams the flags of the
+     * previous user, it is ended so that one for the new user replaces it */
+    if (LDi_identifygeneration(client) != context->identifyGeneration) {
+        LD_LOG(LD_LOG_TRACE, "ending stream requested for a previous user");
+
+        return LDBooleanFalse;
+    }
+
+    /* the store no longer matches the last poll */
+    LDi_rwlock_wrlock(&client->clientLock);
+    LDi_resetpolletag(client);
+    LDi_rwlock_wrunlock(&client->clientLock);
+
+    if (strcmp(eventName, "put") == 0) {
+        if (!LDi_onstreameventput(
+                client, context->identifyGeneration, eventBuffer))
+        {
+            return LDi_identifygeneration(client) ==
+                   context->identifyGeneration;
+        }
+    } else if (strcmp(eventName, "patch") == 0) {
+        LDi_onstreameventpatch(client, eventBuffer);
+    } else if (strcmp(eventName, "delete") == 0) {
+        LDi_onstreameventdelete(client, eventBuffer);
+    } else {
+        LD_LOG_1(LD_LOG_ERROR, "sse unknown event name: %s", eventName);
+    }
+
+    return LDBooleanTrue;
+}
+
+double
+LDi_calculateStreamDelay(const unsigned int retries)
+{
+    if (retries == 0) {
+        return 0;
+    } else if (retries == 1) {
+        return 1000;
+    } else {
+        double backoff;
+
+        unsigned int rng = 0;
+
+        LDi_random(&rng);
+
+        /* calculate time to wait */
+        backoff = 1000 * pow(2, retries);
+
+        /* cap (min not built in) */
+        if (backoff > 30 * 1000) {
+            backoff = 30 * 1000;
+        }
+
+        /* jitter */
+        backoff /= 2;
+
+        return backoff + LDi_normalize(rng, 0, LD_RAND_MAX, 0, backoff);
+    }
+}
+
+/* Updates the retry count after a stream disconnects. Returns LDBooleanFalse
+ * if the failure is permanent. */
+static LDBoolean
+LDi_onstreamresponse(
+    struct LDClient *const client,
+    const long             response,
+    const time_t           startedOn,
+    unsigned int *const    retries)
+{
+    LDBoolean intentionallyClosed;
+
+    if (response == CURLE_COULDNT_RESOLVE_HOST) {
+        LD_LOG(LD_LOG_ERROR, "couldn't resolve host for streaming endpoint");
+
+    } else if (response >= 400 && response < 500) {
+        LDBoolean permanentFailure = LDBooleanFalse;
+
+        if (response == 401 || response == 403) {
+            LD_LOG(LD_LOG_ERROR, "mobile key not authorized, streaming failed");
+
+            permanentFailure = LDBooleanTrue;
+        } else if (response != 400 && response != 408 && response != 429) {
+            LD_LOG(LD_LOG_ERROR, "streaming unrecoverable response code");
+
+            permanentFailure = LDBooleanTrue;
+        }
+
+        if (permanentFailure) {
+            LDi_rwlock_wrlock(&client->clientLock);
+            LDi_updatestatus(client, LDStatusFailed);
+            LDi_rwlock_wrunlock(&client->clientLock);
+
+            LD_LOG(LD_LOG_TRACE, "streaming permanent failure");
+
+            return LDBooleanFalse;
+        }
+    }
+
+    LDi_rwlock_rdlock(&client->clientLock);
+    intentionallyClosed = LDi_socketClosed(&client->streamhandle);
+    LDi_rwlock_rdunlock(&client->clientLock);
+
+    if (intentionallyClosed) {
+        *retries = 0;
+    } else {
+        if (response == 200) {
+            if (time(NULL) > startedOn + 60) {
+                LD_LOG(
+                    LD_LOG_ERROR,
+                    "streaming failed after 60 seconds, retrying");
+
+                *retries = 0;
+            } else {
+                LD_LOG(
+                    LD_LOG_ERROR,
+                    "streaming failed within 60 seconds, backing off");
+
+                (*retries)++;
+            }
+        } else {
+            LD_LOG(
+                LD_LOG_ERROR,
+                "streaming failed with recoverable error, backing off");
+
+            (*retries)++;
+        }
+    }
+
+    return LDBooleanTrue;
+}
+
+THREAD_RETURN
+LDi_bgfeaturestreamer(void *const v)
+{
+    struct LDClient *const client = v;
+
+    unsigned int retries = 0;
+
+    while (LDBooleanTrue) {
+        time_t   startedOn;
+        long     response;
+        LDStatus status;
+
+        /* Wait on any retry delays required. Status change such as shut down
+        will cause a short circuit */
+        if (retries) {
+            LDi_mutex_lock(&client->condMtx);
+            LDi_cond_wait(
+                &client->streamCond,
+                &client->condMtx,
+                LDi_calculateStreamDelay(retries));
+            LDi_mutex_unlock(&client->condMtx);
+        }
+
+        status = LDi_getstatus(client);
+
+        /* Handle shutdown if initialized */
+        if (status == LDStatusFailed || status == LDStatusShuttingdown) {
+            LD_LOG(LD_LOG_TRACE, "killing thread LDi_bgfeaturestreamer");
+
+            return THREAD_RETURN_DEFAULT;
+        }
+
+        /* If we are actually not supposed to be streaming just wait */
+        if (!client->shared->sharedConfig->streaming ||
+            LDi_isoffline(client) || LDi_isbackground(client))
+        {
+            /* Ensures we skip directly to shutdown handler */
+            retries = 0;
+
+            LDi_mutex_lock(&client->condMtx);
+            /* rechecked under condMtx, so the shutdown signal is not missed */
+            status = LDi_getstatus(client);
+            if (status != LDStatusFailed && status != LDStatusShuttingdown) {
+                LDi_cond_wait(&client->streamCond, &client->condMtx, 1000);
+            }
+            LDi_mutex_unlock(&client->condMtx);
+
+            continue;
+        }
+
+        startedOn = time(NULL);
+
+        {
+            struct LDSSEParser     parser;
+            struct LDStreamContext context;
+
+            context.client             = client;
+            context.identifyGeneration = LDi_identifygeneration(client);
+
+            LDSSEParserInitialize(&parser, LDi_onEvent, &context);
+
+            /* this won't return until it disconnects */
+            LDi_readstream(client, &response, &parser, LDi_updatehandle);
+
+            LDSSEParserDestroy(&parser);
+        }
+
+        if (!LDi_onstreamresponse(client, response, startedOn, &retries)) {
+            return THREAD_RETURN_DEFAULT;
+        }
+    }
+}
+
+/*
+ * the network runtime equivalent of the threads above. one runtime thread
+ * drives every client, and each tick applies the same scheduling rules as
+ * the dedicated threads.
+ */
+
+/* floor on the delay between polls while a client is failing to initialize */
+#define LD_POLL_RETRY_MS 1000
+
+/* one of the concurrent event payload deliveries of a client */
+struct LDEventDelivery
+{
+    struct LDTransfer transfer;
+    /* NULL when the delivery is free */
+    struct LDEventChunk *chunk;
+    LDBoolean            active;
+    /* a previous attempt at delivering chunk failed */
+    LDBoolean failed;
+    /* chunk was read from the spool, rather than bundled */
+    LDBoolean spooled;
+    double    retryAt;
+};
+
+struct LDClientNetworkTask
+{
+    struct LDNetworkTask task;
+    struct LDClient *    client;
+
+    struct LDTransfer      stream;
+    struct LDSSEParser     parser;
+    struct LDStreamContext streamContext;
+    LDBoolean              streamActive;
+    unsigned int       streamRetries;
+    time_t             streamStartedOn;
+    double             streamWakeAt;
+
+    struct LDTransfer poll;
+    /* of the client when the active poll was issued */
+    unsigned int      pollGeneration;
+    unsigned int      pollIdentifyGeneration;
+    LDBoolean         pollActive;
+    LDBoolean         pollFailed;
+    double            pollWakeAt;
+
+    struct LDEventDelivery *deliveries;
+    unsigned int            deliveryCount;
+    /* bundled payloads waiting for a free delivery */
+    struct LDEventChunk *eventsPending;
+    double               eventsWakeAt;
+    double               spoolWakeAt;
+};
+
+void
+LDi_signalbackground(struct LDClient *const client, const int signals)
+{
+    if (signals & LD_SIGNAL_EVENTS) {
+        LDi_cond_signal(&client->eventCond);
+    }
+
+    if (signals & LD_SIGNAL_POLL) {
+        LDi_cond_signal(&client->pollCond);
+    }
+
+    if (signals & LD_SIGNAL_STREAM) {
+        LDi_cond_signal(&client->streamCond);
+    }
+
+    if (client->networkTask) {
+        LDi_networkRuntimeSignal(
+            client->shared->networkRuntime,
+            &client->networkTask->task,
+            signals);
+    }
+}
+
+static void
+LDi_earliest(double *const next, const double candidate)
+{
+    if (candidate < *next) {
+        *next = candidate;
+    }
+}
+
+static void
+LDi_streamfinished(struct LDClientNetworkTask *const nt, const long response)
+{
+    double now;
+
+    LDi_destroyTransfer(&nt->stream);
+    LDSSEParserDestroy(&nt->parser);
+    nt->streamActive = LDBooleanFalse;
+
+    /* a permanent failure marks the client failed, which halts streaming */
+    LDi_onstreamresponse(
+        nt->client, response, nt->streamStartedOn, &nt->streamRetries);
+
+    LDi_getMonotonicMilliseconds(&now);
+    nt->streamWakeAt = now + LDi_calculateStreamDelay(nt->streamRetries);
+}
+
+static void
+LDi_streamtick(
+    struct LDClientNetworkTask *const nt,
+    const double                      now,
+    const int                         signals,
+    double *const                     next)
+{
+    struct LDClient *const client = nt->client;
+    LDStatus               status;
+    LDBoolean              shouldstream;
+
+    if (nt->streamActive) {
+        return;
+    }
+
+    status       = LDi_getstatus(client);
+    shouldstream = client->shared->sharedConfig->streaming &&
+                   !LDi_isoffline(client) && !LDi_isbackground(client);
+
+    if (status == LDStatusFailed || status == LDStatusShuttingdown) {
+        return;
+    }
+
+    if (!shouldstream) {
+        nt->streamRetries = 0;
+        nt->streamWakeAt  = 0;
+
+        return;
+    }
+
+    /* a signal short circuits any retry delay */
+    if (signals & LD_SIGNAL_STREAM) {
+        nt->streamWakeAt = now;
+    }
+
+    if (now < nt->streamWakeAt) {
+        LDi_earliest(next, nt->streamWakeAt);
+
+        return;
+    }
+
+    nt->streamStartedOn = time(NULL);
+
+    nt->streamContext.client             = client;
+    nt->streamContext.identifyGeneration = LDi_identifygeneration(client);
+
+    LDSSEParserInitialize(&nt->parser, LDi_onEvent, &nt->streamContext);
+
+    if (!LDi_prepareStreamTransfer(
+            client, &nt->stream, &nt->parser, LDi_updatehandle) ||
+        !LDi_networkRuntimeAddTransfer(
+            nt->task.runtime, &nt->task, nt->stream.curl))
+    {
+        LDi_streamfinished(nt, -1);
+        LDi_earliest(next, nt->streamWakeAt);
+
+        return;
+    }
+
+    nt->streamActive = LDBooleanTrue;
+}
+
+static void
+LDi_pollfinished(
+    struct LDClientNetworkTask *const nt,
+    const long                        response,
+    char *const                       data,
+    char *const                       etag)
+{
+    struct LDClient *const client = nt->client;
+    double                 now;
+    int                    ms;
+
+    nt->pollActive = LDBooleanFalse;
+    nt->pollFailed = !LDi_onpollresponse(
+        client,
+        nt->pollGeneration,
+        nt->pollIdentifyGeneration,
+        response,
+        data,
+        etag);
+
+    LDFree(data);
+
+    LDi_pollingskipped(client, &ms);
+
+    if (nt->pollFailed && LDi_awaitingflags(client) &&
+        ms > LD_POLL_RETRY_MS) {
+        ms = LD_POLL_RETRY_MS;
+    }
+
+    LDi_getMonotonicMilliseconds(&now);
+    nt->pollWakeAt = now + ms;
+}
+
+static void
+LDi_polltick(
+    struct LDClientNetworkTask *const nt,
+    const double                      now,
+    const int                         signals,
+    double *const                     next)
+{
+    struct LDClient *const client = nt->client;
+    LDStatus               status;
+    LDBoolean              skippolling;
+    int                    ms;
 
-        LDFree(data);
+    if (nt->pollActive) {
+        return;
     }
-}
 
-LDBoolean
-LDi_onstreameventput(struct LDClient *const client, const char *const data)
-{
-    struct LDJSON *payload, *payloadIter;
-    struct LDFlag *flags;
-    size_t flagCount;
-    size_t i;
-    LDBoolean storeResult;
+    status      = LDi_getstatus(client);
+    skippolling = LDi_pollingskipped(client, &ms);
 
-    payload = NULL;
+    if (status == LDStatusFailed || status == LDStatusShuttingdown) {
+        return;
+    }
 
-    if (!(payload = LDJSONDeserialize(data))) {
-        LD_LOG(LD_LOG_ERROR, "stream PUT: failed to deserialize event data");
-        return LDBooleanFalse;
+    /* a signal restarts the interval, as it does for the polling thread */
+    if ((signals & LD_SIGNAL_POLL) || skippolling) {
+        nt->pollFailed = LDBooleanFalse;
+        nt->pollWakeAt = now + ms;
     }
 
-    if (LDJSONGetType(payload) != LDObject) {
-        LD_LOG(LD_LOG_ERROR, "stream PUT: data must be a JSON object");
-        LDJSONFree(payload);
-        return LDBooleanFalse;
+    if (skippolling) {
+        return;
     }
 
-    flagCount = LDCollectionGetSize(payload);
+    /* a client waiting for flags polls immediately */
+    if (now < nt->pollWakeAt && !(LDi_awaitingflags(client) && !nt->pollFailed))
+    {
+        LDi_earliest(next, nt->pollWakeAt);
 
-    if (!(flags = LDAlloc(sizeof(struct LDFlag) * flagCount))) {
-        LD_LOG(LD_LOG_ERROR, "stream PUT: failed to allocate space for flags");
-        LDJSONFree(payload);
-        return LDBooleanFalse;
+        return;
     }
 
-    payloadIter = LDGetIter(payload);
-
-    for (i = 0; i < flagCount; i++)  {
-        LD_ASSERT(payloadIter);
-        if (!LDi_flag_parse(&flags[i], LDIterKey(payloadIter), payloadIter)) {
-            size_t j;
+    nt->pollGeneration         = LDi_pollgeneration(client);
+    nt->pollIdentifyGeneration = LDi_identifygeneration(client);
 
-            LD_LOG(LD_LOG_ERROR, "stream PUT: error parsing flag");
-            for (j = 0; j < i; j++) {
-                LDi_flag_destroy(&flags[j]);
-            }
+    if (!LDi_preparePollTransfer(client, &nt->poll)) {
+        LDi_pollfinished(nt, -1, NULL, NULL);
+        LDi_earliest(next, nt->pollWakeAt);
 
-            LDJSONFree(payload);
-            LDFree(flags);
-            return LDBooleanFalse;
-        }
-        payloadIter = LDIterNext(payloadIter);
+        return;
     }
 
-    LDJSONFree(payload);
+    if (!LDi_networkRuntimeAddTransfer(
+            nt->task.runtime, &nt->task, nt->poll.curl)) {
+        LDi_destroyTransfer(&nt->poll);
+        LDi_pollfinished(nt, -1, NULL, NULL);
+        LDi_earliest(next, nt->pollWakeAt);
 
-    storeResult = LDi_storePut(&client->store, flags, flagCount);
+        return;
+    }
 
-    LDi_rwlock_wrlock(&client->clientLock);
-    LDi_updatestatus(client, storeResult ? LDStatusInitialized : LDStatusFailed);
-    LDi_rwlock_wrunlock(&client->clientLock);
+    nt->pollActive = LDBooleanTrue;
+}
 
-    return storeResult;
+static void
+LDi_releasedelivery(struct LDEventDelivery *const delivery)
+{
+    LDi_freeeventchunks(delivery->chunk);
+
+    delivery->chunk   = NULL;
+    delivery->failed  = LDBooleanFalse;
+    delivery->spooled = LDBooleanFalse;
 }
 
-void
-LDi_onstreameventpatch(struct LDClient *const client, const char *const data)
+static void
+LDi_eventsfinished(
+    struct LDClientNetworkTask *const nt,
+    struct LDEventDelivery *const     delivery,
+    const long                        response)
 {
-    struct LDJSON *payload;
-    struct LDFlag  flag;
+    struct LDClient *const client = nt->client;
+    double                 now;
 
-    LD_ASSERT(client);
-    LD_ASSERT(data);
+    delivery->active = LDBooleanFalse;
 
-    payload = NULL;
+    LDi_getMonotonicMilliseconds(&now);
 
-    if (!(payload = LDJSONDeserialize(data))) {
-        LD_LOG(LD_LOG_ERROR, "failed to deserialize patch discarding update");
+    if (delivery->spooled) {
+        /* spooled payloads are only retried on the next interval */
+        if (!LDi_onspooledresponse(client, response)) {
+            nt->spoolWakeAt =
+                now + client->shared->sharedConfig->eventsFlushIntervalMillis;
+        }
 
-        goto cleanup;
-    }
+        LDi_releasedelivery(delivery);
+    } else if (LDi_oneventresponse(client, response, &delivery->failed)) {
+        if (delivery->failed) {
+            LDi_spoolpayload(
+                client,
+                delivery->chunk->payload,
+                delivery->chunk->payloadId,
+                response);
+        }
 
-    if (!LDi_flag_parse(&flag, NULL, payload)) {
-        LD_LOG(LD_LOG_ERROR, "failed to parse flag patch discarding update");
+        LDi_releasedelivery(delivery);
+    } else {
+        delivery->retryAt = now + 1000;
+    }
+}
 
-        goto cleanup;
+static void
+LDi_eventsstart(
+    struct LDClientNetworkTask *const nt,
+    struct LDEventDelivery *const     delivery)
+{
+    if (!LDi_prepareEventTransfer(
+            nt->client,
+            &delivery->transfer,
+            delivery->chunk->payload,
+            delivery->chunk->payloadId))
+    {
+        LDi_eventsfinished(nt, delivery, 0);
+
+        return;
     }
 
-    if (!LDi_storeUpsert(&client->store, flag)) {
-        LD_LOG(LD_LOG_ERROR, "failed to upsert flag");
+    if (!LDi_networkRuntimeAddTransfer(
+            nt->task.runtime, &nt->task, delivery->transfer.curl))
+    {
+        LDi_destroyTransfer(&delivery->transfer);
+        LDi_eventsfinished(nt, delivery, 0);
 
-        goto cleanup;
+        return;
     }
 
-cleanup:
-    LDJSONFree(payload);
+    delivery->active = LDBooleanTrue;
 }
 
-void
-LDi_onstreameventdelete(struct LDClient *const client, const char *const data)
+/* Fills a free delivery with the next pending payload, or failing that with
+ * the oldest spooled payload. Only one spooled payload is sent at a time, as
+ * the spool is strictly ordered. */
+static void
+LDi_eventsassign(
+    struct LDClientNetworkTask *const nt,
+    struct LDEventDelivery *const     delivery,
+    const double                      now,
+    const LDBoolean                   offline)
 {
-    struct LDJSON *payload, *tmp;
-    const char *   key;
-    unsigned int   version;
+    struct LDClient *const client = nt->client;
+    struct LDEventChunk *  chunk;
+    unsigned int           i;
 
-    LD_ASSERT(client);
-    LD_ASSERT(data);
-
-    payload = NULL;
+    if (nt->eventsPending) {
+        delivery->chunk       = nt->eventsPending;
+        nt->eventsPending     = delivery->chunk->next;
+        delivery->chunk->next = NULL;
 
-    if (!(payload = LDJSONDeserialize(data))) {
-        LD_LOG(LD_LOG_ERROR, "failed to parse delete discarding update");
+        return;
+    }
 
-        goto cleanup;
+    if (offline || !client->eventSpool || now < nt->spoolWakeAt ||
+        LDi_eventSpoolIsEmpty(client->eventSpool))
+    {
+        return;
     }
 
-    if (LDJSONGetType(payload) != LDObject) {
-        goto cleanup;
+    for (i = 0; i < nt->deliveryCount; i++) {
+        if (nt->deliveries[i].spooled) {
+            return;
+        }
     }
 
-    if (!(tmp = LDObjectLookup(payload, "version"))) {
-        goto cleanup;
+    if (!(chunk = LDAlloc(sizeof(*chunk)))) {
+        return;
     }
 
-    if (LDJSONGetType(tmp) != LDNumber) {
-        goto cleanup;
+    memset(chunk, 0, sizeof(*chunk));
+
+    if (!LDi_eventSpoolPeek(client->eventSpool, &chunk->payload, chunk->payloadId) ||
+        chunk->payload == NULL)
+    {
+        LDFree(chunk);
+
+        return;
     }
 
-    version = LDGetNumber(tmp);
+    delivery->chunk   = chunk;
+    delivery->spooled = LDBooleanTrue;
+}
 
-    if (!(tmp = LDObjectLookup(payload, "key"))) {
-        goto cleanup;
+static void
+LDi_eventstick(
+    struct LDClientNetworkTask *const nt,
+    const double                      now,
+    const int                         signals,
+    double *const                     next)
+{
+    struct LDClient *const client = nt->client;
+    LDStatus               status;
+    LDBoolean              offline;
+    unsigned int           i;
+
+    status  = LDi_getstatus(client);
+    offline = LDi_isoffline(client);
+
+    /* the final flush is performed when the task is detached */
+    if (status == LDStatusFailed || status == LDStatusShuttingdown) {
+        return;
     }
 
-    if (LDJSONGetType(tmp) != LDText) {
-        goto cleanup;
+    if (signals & LD_SIGNAL_EVENTS) {
+        nt->eventsWakeAt = now;
     }
 
-    key = LDGetText(tmp);
+    /* the next batch is bundled while earlier ones are still in flight, but
+     * only once the previous batch has been handed to a delivery */
+    if (now >= nt->eventsWakeAt) {
+        nt->eventsWakeAt =
+            now + client->shared->sharedConfig->eventsFlushIntervalMillis;
 
-    if (!LDi_storeDelete(&client->store, key, version)) {
-        LD_LOG(LD_LOG_ERROR, "failed to delete flag");
+        if (!offline && nt->eventsPending == NULL) {
+            LD_LOG(LD_LOG_TRACE, "bgsender running");
 
-        goto cleanup;
+            LDi_bundleeventchunks(client, &nt->eventsPending);
+        }
     }
 
-cleanup:
-    LDJSONFree(payload);
-}
+    LDi_earliest(next, nt->eventsWakeAt);
 
-void
-LDi_startstopstreaming(
-    struct LDClient *const client, const LDBoolean stopstreaming)
-{
-    client->shouldstopstreaming = stopstreaming;
-    LDi_cond_signal(&client->pollCond);
-    LDi_cond_signal(&client->streamCond);
-}
+    for (i = 0; i < nt->deliveryCount; i++) {
+        struct LDEventDelivery *const delivery = &nt->deliveries[i];
 
-static void
-LDi_updatehandle(struct LDClient *const client, const int handle)
-{
-    LDi_rwlock_wrlock(&client->clientLock);
-    LDi_socketStore(&client->streamhandle, handle);
-    LDi_rwlock_wrunlock(&client->clientLock);
-}
+        if (delivery->active) {
+            continue;
+        }
 
-void
-LDi_reinitializeconnection(struct LDClient *const client)
-{
-    LDBoolean socketOpen;
-    int socketHandle;
+        if (delivery->chunk == NULL) {
+            LDi_eventsassign(nt, delivery, now, offline);
 
-    socketOpen = LDi_socketLoad(&client->streamhandle, &socketHandle);
+            if (delivery->chunk == NULL) {
+                continue;
+            }
+        } else if (now < delivery->retryAt) {
+            LDi_earliest(next, delivery->retryAt);
 
-    if (socketOpen) {
-        LDi_cancelread(socketHandle);
-        LDi_socketClose(&client->streamhandle);
+            continue;
+        }
+
+        LDi_eventsstart(nt, delivery);
+
+        if (!delivery->active && delivery->chunk) {
+            LDi_earliest(next, delivery->retryAt);
+        }
     }
-    LDi_cond_signal(&client->pollCond);
-    LDi_cond_signal(&client->streamCond);
 }
 
-static LDBoolean
-LDi_onEvent(
-    const char *const eventName,
-    const char *const eventBuffer,
-    void *const       rawContext)
+static double
+LDi_networktasktick(
+    struct LDNetworkTask *const task, const double now, const int signals)
 {
-    struct LDClient *client;
-
-    LD_ASSERT(eventName);
-    LD_ASSERT(eventBuffer);
-    LD_ASSERT(rawContext);
+    struct LDClientNetworkTask *const nt = task->context;
 
-    client = (struct LDClient *)rawContext;
+    /* the runtime bounds how long it sleeps, so this is only a default */
+    double next = now + 60 * 1000;
 
-    if (strcmp(eventName, "put") == 0) {
-        LDi_onstreameventput(client, eventBuffer);
-    } else if (strcmp(eventName, "patch") == 0) {
-        LDi_onstreameventpatch(client, eventBuffer);
-    } else if (strcmp(eventName, "delete") == 0) {
-        LDi_onstreameventdelete(client, eventBuffer);
-    } else {
-        LD_LOG_1(LD_LOG_ERROR, "sse unknown event name: %s", eventName);
-    }
+    LDi_streamtick(nt, now, signals, &next);
+    LDi_polltick(nt, now, signals, &next);
+    LDi_eventstick(nt, now, signals, &next);
 
-    return LDBooleanTrue;
+    return next;
 }
 
-double
-LDi_calculateStreamDelay(const unsigned int retries)
+static void
+LDi_networktaskdone(
+    struct LDNetworkTask *const task, CURL *const curl, const CURLcode res)
 {
-    if (retries == 0) {
-        return 0;
-    } else if (retries == 1) {
-        return 1000;
+    struct LDClientNetworkTask *const nt = task->context;
+
+    if (nt->streamActive && curl == nt->stream.curl) {
+        /* CURL_LAST = 99 so the union of curl responses + http response codes
+         * should have no overlap. */
+        LDi_streamfinished(
+            nt, LDi_transferResponse(&nt->stream, res, (long)res));
+    } else if (nt->pollActive && curl == nt->poll.curl) {
+        long  response;
+        char *data, *etag;
+
+        response = LDi_transferResponse(&nt->poll, res, -1);
+        data     = LDi_transferTakeData(&nt->poll);
+        etag     = NULL;
+
+        if (response == 200) {
+            etag = LDi_transferHeader(&nt->poll, "ETag");
+        }
+
+        LDi_destroyTransfer(&nt->poll);
+        LDi_pollfinished(nt, response, data, etag);
     } else {
-        double backoff;
+        unsigned int i;
 
-        unsigned int rng = 0;
+        for (i = 0; i < nt->deliveryCount; i++) {
+            struct LDEventDelivery *const delivery = &nt->deliveries[i];
 
-        LDi_random(&rng);
+            if (delivery->active && curl == delivery->transfer.curl) {
+                long response;
 
-        /* calculate time to wait */
-        backoff = 1000 * pow(2, retries);
+                response = LDi_transferResponse(&delivery->transfer, res, -1);
 
-        /* cap (min not built in) */
-        if (backoff > 30 * 1000) {
-            backoff = 30 * 1000;
+                LDi_destroyTransfer(&delivery->transfer);
+                LDi_eventsfinished(nt, delivery, response);
+
+                break;
+            }
         }
+    }
+}
 
-        /* jitter */
-        backoff /= 2;
+static void
+LDi_networktaskstop(struct LDNetworkTask *const task)
+{
+    struct LDClientNetworkTask *const nt = task->context;
+    unsigned int                      i;
+
+    if (nt->streamActive) {
+        LDi_networkRuntimeRemoveTransfer(task->runtime, nt->stream.curl);
+        LDi_destroyTransfer(&nt->stream);
+        LDSSEParserDestroy(&nt->parser);
+        nt->streamActive = LDBooleanFalse;
+    }
 
-        return backoff + LDi_normalize(rng, 0, LD_RAND_MAX, 0, backoff);
+    if (nt->pollActive) {
+        LDi_networkRuntimeRemoveTransfer(task->runtime, nt->poll.curl);
+        LDi_destroyTransfer(&nt->poll);
+        nt->pollActive = LDBooleanFalse;
+    }
+
+    /* interrupted payloads are retained for the final flush */
+    for (i = 0; i < nt->deliveryCount; i++) {
+        struct LDEventDelivery *const delivery = &nt->deliveries[i];
+
+        if (delivery->active) {
+            LDi_networkRuntimeRemoveTransfer(
+                task->runtime, delivery->transfer.curl);
+            LDi_destroyTransfer(&delivery->transfer);
+            delivery->active = LDBooleanFalse;
+        }
     }
 }
 
-THREAD_RETURN
-LDi_bgfeaturestreamer(void *const v)
+LDBoolean
+LDi_attachnetworktask(struct LDClient *const client)
 {
-    struct LDClient *const client = v;
+    struct LDClientNetworkTask *nt;
+    double                      now;
 
-    int retries = 0;
+    LD_ASSERT(client);
+    LD_ASSERT(client->shared->networkRuntime);
 
-    while (LDBooleanTrue) {
-        time_t    startedOn;
-        long       response;
-        LDBoolean intentionallyClosed;
+    if (!(nt = LDAlloc(sizeof(*nt)))) {
+        LD_LOG(LD_LOG_CRITICAL, "no memory for the network task");
 
-        /* Wait on any retry delays required. Status change such as shut down
-        will cause a short circuit */
-        if (retries) {
-            LDi_mutex_lock(&client->condMtx);
-            LDi_cond_wait(
-                &client->streamCond,
-                &client->condMtx,
-                LDi_calculateStreamDelay(retries));
-            LDi_mutex_unlock(&client->condMtx);
-        }
+        return LDBooleanFalse;
+    }
 
-        LDi_rwlock_wrlock(&client->clientLock);
+    memset(nt, 0, sizeof(*nt));
 
-        /* Handle shutdown if initialized */
-        if (client->status == LDStatusFailed ||
-            client->status == LDStatusShuttingdown) {
-            LD_LOG(LD_LOG_TRACE, "killing thread LDi_bgfeaturestreamer");
+    nt->deliveryCount =
+        client->shared->sharedConfig->eventsMaxConcurrentRequests;
 
-            LDi_rwlock_wrunlock(&client->clientLock);
+    if (nt->deliveryCount == 0) {
+        nt->deliveryCount = 1;
+    }
 
-            return THREAD_RETURN_DEFAULT;
-        }
+    if (!(nt->deliveries =
+              LDAlloc(nt->deliveryCount * sizeof(struct LDEventDelivery))))
+    {
+        LD_LOG(LD_LOG_CRITICAL, "no memory for the network task");
 
-        /* If we are actually not supposed to be streaming just wait */
-        if (!client->shared->sharedConfig->streaming || client->offline ||
-            client->background)
-        {
-            /* Ensures we skip directly to shutdown handler */
-            retries = 0;
+        LDFree(nt);
 
-            LDi_mutex_lock(&client->condMtx);
-            LDi_rwlock_wrunlock(&client->clientLock);
-            LDi_cond_wait(&client->streamCond, &client->condMtx, 1000);
-            LDi_mutex_unlock(&client->condMtx);
+        return LDBooleanFalse;
+    }
 
-            continue;
-        }
+    memset(nt->deliveries, 0, nt->deliveryCount * sizeof(struct LDEventDelivery));
 
-        LDi_rwlock_wrunlock(&client->clientLock);
+    nt->client       = client;
+    nt->task.context = nt;
+    nt->task.tick    = LDi_networktasktick;
+    nt->task.done    = LDi_networktaskdone;
+    nt->task.stop    = LDi_networktaskstop;
 
-        startedOn = time(NULL);
+    LDi_getMonotonicMilliseconds(&now);
+    nt->eventsWakeAt =
+        now + client->shared->sharedConfig->eventsFlushIntervalMillis;
 
-        {
-            struct LDSSEParser parser;
+    client->networkTask = nt;
 
-            LDSSEParserInitialize(&parser, LDi_onEvent, (void *)client);
+    if (!LDi_networkRuntimeAttach(client->shared->networkRuntime, &nt->task)) {
+        client->networkTask = NULL;
 
-            /* this won't return until it disconnects */
-            LDi_readstream(client, &response, &parser, LDi_updatehandle);
+        LDFree(nt->deliveries);
+        LDFree(nt);
 
-            LDSSEParserDestroy(&parser);
-        }
+        return LDBooleanFalse;
+    }
 
-        if (response == CURLE_COULDNT_RESOLVE_HOST) {
-            LD_LOG(LD_LOG_ERROR, "couldn't resolve host for streaming endpoint");
+    return LDBooleanTrue;
+}
 
-        } else if (response >= 400 && response < 500) {
-            LDBoolean permanentFailure = LDBooleanFalse;
+void
+LDi_detachnetworktask(struct LDClient *const client)
+{
+    struct LDClientNetworkTask *nt;
+    LDBoolean                   offline;
+    unsigned int                i;
 
-            if (response == 401 || response == 403) {
-                LD_LOG(
-                    LD_LOG_ERROR,
-                    "mobile key not authorized, streaming failed");
+    LD_ASSERT(client);
 
-                permanentFailure = LDBooleanTrue;
-            } else if (response != 400 && response != 408 && response != 429) {
-                LD_LOG(LD_LOG_ERROR, "streaming unrecoverable response code");
+    if (!(nt = client->networkTask)) {
+        return;
+    }
 
-                permanentFailure = LDBooleanTrue;
-            }
+    LDi_networkRuntimeDetach(client->shared->networkRuntime, &nt->task);
 
-            if (permanentFailure) {
-                LDi_rwlock_wrlock(&client->clientLock);
-                LDi_updatestatus(client, LDStatusFailed);
-                LDi_rwlock_wrunlock(&client->clientLock);
+    client->networkTask = NULL;
 
-                LD_LOG(LD_LOG_TRACE, "streaming permanent failure");
+    offline = LDi_isoffline(client);
 
-                return THREAD_RETURN_DEFAULT;
-            }
-        }
+    /* final flush, as performed by the event thread on shutdown */
+    if (!offline) {
+        struct LDEventChunk *chunk;
 
-        LDi_rwlock_rdlock(&client->clientLock);
-        intentionallyClosed = LDi_socketClosed(&client->streamhandle);
-        LDi_rwlock_rdunlock(&client->clientLock);
+        for (i = 0; i < nt->deliveryCount; i++) {
+            struct LDEventDelivery *const delivery = &nt->deliveries[i];
+            long                          response;
 
-        if (intentionallyClosed) {
-            retries = 0;
-        } else {
-            if (response == 200) {
-                if (time(NULL) > startedOn + 60) {
-                    LD_LOG(
-                        LD_LOG_ERROR,
-                        "streaming failed after 60 seconds, retrying");
-
-                    retries = 0;
-                } else {
-                    LD_LOG(
-                        LD_LOG_ERROR,
-                        "streaming failed within 60 seconds, backing off");
-
-                    retries++;
-                }
-            } else {
-                LD_LOG(
-                    LD_LOG_ERROR,
-                    "streaming failed with recoverable error, backing off");
+            if (!delivery->chunk) {
+                continue;
+            }
 
-                retries++;
+            response = 0;
+
+            LDi_sendevents(
+                client,
+                delivery->chunk->payload,
+                delivery->chunk->payloadId,
+                &response);
+
+            if (delivery->spooled) {
+                LDi_onspooledresponse(client, response);
+            } else if (response != 200 && response != 202) {
+                LDi_spoolpayload(
+                    client,
+                    delivery->chunk->payload,
+                    delivery->chunk->payloadId,
+                    response);
             }
         }
+
+        for (chunk = nt->eventsPending; chunk; chunk = chunk->next) {
+            LDi_sendeventchunk(client, chunk);
+        }
+
+        LDi_sendqueuedevents(client);
+    }
+
+    for (i = 0; i < nt->deliveryCount; i++) {
+        LDi_releasedelivery(&nt->deliveries[i]);
     }
+
+    LDi_freeeventchunks(nt->eventsPending);
+    LDFree(nt->deliveries);
+    LDFree(nt);
 }
@@ -0,0 +1,375 @@
+#include <string.h>
+
+#include <curl/curl.h>
+
+#include <launchdarkly/api.h>
+
+#include "ldinternal.h"
+#include "network_runtime.h"
+#include "utlist.h"
+
+/* The longest time the runtime will sleep before reevaluating its tasks */
+#define LD_RUNTIME_MAX_WAIT_MS 1000
+
+/* curl_multi_poll and curl_multi_wakeup were introduced in 7.68.0 */
+#if LIBCURL_VERSION_NUM >= 0x074400
+#define LD_HAVE_MULTI_WAKEUP
+#endif
+
+struct LDNetworkRuntime
+{
+    CURLM *     multi;
+    ld_thread_t thread;
+    ld_mutex_t  lock;
+    ld_cond_t   detachCond;
+    LDBoolean   stopping;
+    /* attached tasks not yet adopted by the runtime thread */
+    struct LDNetworkTask *incoming;
+    /* only modified by the runtime thread, while holding lock */
+    struct LDNetworkTask *tasks;
+};
+
+static void
+wakeRuntime(struct LDNetworkRuntime *const runtime)
+{
+#ifdef LD_HAVE_MULTI_WAKEUP
+    curl_multi_wakeup(runtime->multi);
+#else
+    (void)runtime;
+#endif
+}
+
+static void
+waitRuntime(struct LDNetworkRuntime *const runtime, int timeout)
+{
+#ifdef LD_HAVE_MULTI_WAKEUP
+    curl_multi_poll(runtime->multi, NULL, 0, timeout, NULL);
+#else
+    int numfds;
+
+    /* without curl_multi_wakeup signals are only noticed by polling */
+    if (timeout > 50) {
+        timeout = 50;
+    }
+
+    numfds = 0;
+
+    if (curl_multi_wait(runtime->multi, NULL, 0, timeout, &numfds) ==
+            CURLM_OK &&
+        numfds == 0)
+    {
+        LDi_sleepMilliseconds(timeout);
+    }
+#endif
+}
+
+/* Removes tasks pending detach, and notifies waiters once stopped */
+static void
+retireTasks(struct LDNetworkRuntime *const runtime)
+{
+    struct LDNetworkTask *task, *tmp, *detached;
+
+    detached = NULL;
+
+    LDi_mutex_lock(&runtime->lock);
+
+    DL_CONCAT(runtime->tasks, runtime->incoming);
+    runtime->incoming = NULL;
+
+    DL_FOREACH_SAFE(runtime->tasks, task, tmp)
+    {
+        if (task->detaching) {
+            DL_DELETE(runtime->tasks, task);
+            DL_APPEND(detached, task);
+        }
+    }
+
+    LDi_mutex_unlock(&runtime->lock);
+
+    if (detached == NULL) {
+        return;
+    }
+
+    DL_FOREACH(detached, task) { task->stop(task); }
+
+    LDi_mutex_lock(&runtime->lock);
+
+    /* the owner may free the task as soon as runtime is cleared */
+    DL_FOREACH_SAFE(detached, task, tmp)
+    {
+        DL_DELETE(detached, task);
+        task->runtime = NULL;
+    }
+
+    LDi_cond_signal(&runtime->detachCond);
+
+    LDi_mutex_unlock(&runtime->lock);
+}
+
+static THREAD_RETURN
+LDi_networkRuntimeThread(void *const v)
+{
+    struct LDNetworkRuntime *const runtime = v;
+
+    while (LDBooleanTrue) {
+        struct LDNetworkTask *task;
+        CURLMsg *             message;
+        double                now, next;
+        int                   running, queued, timeout;
+
+        LDi_mutex_lock(&runtime->lock);
+        if (runtime->stopping) {
+            LDi_mutex_unlock(&runtime->lock);
+
+            break;
+        }
+        LDi_mutex_unlock(&runtime->lock);
+
+        retireTasks(runtime);
+
+        LDi_getMonotonicMilliseconds(&now);
+        next = now + LD_RUNTIME_MAX_WAIT_MS;
+
+        DL_FOREACH(runtime->tasks, task)
+        {
+            double wakeAt;
+            int    signals;
+
+            LDi_mutex_lock(&runtime->lock);
+            signals       = task->signals;
+            task->signals = 0;
+            LDi_mutex_unlock(&runtime->lock);
+
+            wakeAt = task->tick(task, now, signals);
+
+            if (wakeAt < next) {
+                next = wakeAt;
+            }
+        }
+
+        curl_multi_perform(runtime->multi, &running);
+
+        while ((message = curl_multi_info_read(runtime->multi, &queued))) {
+            if (message->msg == CURLMSG_DONE) {
+                CURL *const    curl = message->easy_handle;
+                const CURLcode res  = message->data.result;
+                char *         taskPointer;
+
+                taskPointer = NULL;
+                curl_easy_getinfo(curl, CURLINFO_PRIVATE, &taskPointer);
+                curl_multi_remove_handle(runtime->multi, curl);
+
+                task = (struct LDNetworkTask *)taskPointer;
+                LD_ASSERT(task);
+
+                task->done(task, curl, res);
+
+                /* give the task a chance to schedule follow up work */
+                next = now;
+            }
+        }
+
+        LDi_getMonotonicMilliseconds(&now);
+
+        timeout = next > now ? (int)(next - now) : 0;
+
+        if (timeout > LD_RUNTIME_MAX_WAIT_MS) {
+            timeout = LD_RUNTIME_MAX_WAIT_MS;
+        }
+
+        waitRuntime(runtime, timeout);
+    }
+
+    LD_LOG(LD_LOG_TRACE, "killing thread LDi_networkRuntimeThread");
+
+    return THREAD_RETURN_DEFAULT;
+}
+
+struct LDNetworkRuntime *
+LDi_networkRuntimeNew(void)
+{
+    struct LDNetworkRuntime *runtime;
+
+    if (!(runtime = LDAlloc(sizeof(*runtime)))) {
+        LD_LOG(LD_LOG_CRITICAL, "no memory for the network runtime");
+
+        return NULL;
+    }
+
+    memset(runtime, 0, sizeof(*runtime));
+
+    if (!(runtime->multi = curl_multi_init())) {
+        LD_LOG(LD_LOG_CRITICAL, "curl_multi_init returned NULL");
+
+        goto err1;
+    }
+
+    if (!LDi_mutex_init(&runtime->lock)) {
+        goto err2;
+    }
+
+    if (!LDi_cond_init(&runtime->detachCond)) {
+        goto err3;
+    }
+
+    if (!LDi_thread_create(
+            &runtime->thread, LDi_networkRuntimeThread, runtime)) {
+        goto err4;
+    }
+
+    return runtime;
+
+err4:
+    LDi_cond_destroy(&runtime->detachCond);
+err3:
+    LDi_mutex_destroy(&runtime->lock);
+err2:
+    curl_multi_cleanup(runtime->multi);
+err1:
+    LDFree(runtime);
+
+    return NULL;
+}
+
+void
+LDi_networkRuntimeFree(struct LDNetworkRuntime *const runtime)
+{
+    if (runtime) {
+        LDi_mutex_lock(&runtime->lock);
+        runtime->stopping = LDBooleanTrue;
+        LDi_mutex_unlock(&runtime->lock);
+
+        wakeRuntime(runtime);
+
+        LDi_thread_join(&runtime->thread);
+
+        LD_ASSERT(runtime->tasks == NULL);
+        LD_ASSERT(runtime->incoming == NULL);
+
+        LDi_cond_destroy(&runtime->detachCond);
+        LDi_mutex_destroy(&runtime->lock);
+        curl_multi_cleanup(runtime->multi);
+
+        LDFree(runtime);
+    }
+}
+
+LDBoolean
+LDi_networkRuntimeAttach(
+    struct LDNetworkRuntime *const runtime, struct LDNetworkTask *const task)
+{
+    LD_ASSERT(runtime);
+    LD_ASSERT(task);
+    LD_ASSERT(task->tick);
+    LD_ASSERT(task->done);
+    LD_ASSERT(task->stop);
+
+    LDi_mutex_lock(&runtime->lock);
+
+    if (runtime->stopping) {
+        LDi_mutex_unlock(&runtime->lock);
+
+        return LDBooleanFalse;
+    }
+
+    task->runtime   = runtime;
+    task->signals   = 0;
+    task->detaching = LDBooleanFalse;
+
+    DL_APPEND(runtime->incoming, task);
+
+    LDi_mutex_unlock(&runtime->lock);
+
+    wakeRuntime(runtime);
+
+    return LDBooleanTrue;
+}
+
+void
+LDi_networkRuntimeDetach(
+    struct LDNetworkRuntime *const runtime, struct LDNetworkTask *const task)
+{
+    struct LDNetworkTask *iter;
+
+    LD_ASSERT(runtime);
+    LD_ASSERT(task);
+
+    LDi_mutex_lock(&runtime->lock);
+
+    DL_FOREACH(runtime->incoming, iter)
+    {
+        if (iter == task) {
+            break;
+        }
+    }
+
+    if (iter) {
+        /* never adopted, so nothing has been started */
+        DL_DELETE(runtime->incoming, task);
+        task->runtime = NULL;
+    } else if (task->runtime) {
+        task->detaching = LDBooleanTrue;
+
+        wakeRuntime(runtime);
+
+        while (task->runtime) {
+            LDi_cond_wait(
+                &runtime->detachCond, &runtime->lock, LD_RUNTIME_MAX_WAIT_MS);
+        }
+    }
+
+    LDi_mutex_unlock(&runtime->lock);
+}
+
+void
+LDi_networkRuntimeSignal(
+    struct LDNetworkRuntime *const runtime,
+    struct LDNetworkTask *const    task,
+    const int                      signals)
+{
+    LD_ASSERT(runtime);
+    LD_ASSERT(task);
+
+    LDi_mutex_lock(&runtime->lock);
+    if (task->runtime) {
+        task->signals |= signals;
+    }
+    LDi_mutex_unlock(&runtime->lock);
+
+    wakeRuntime(runtime);
+}
+
+LDBoolean
+LDi_networkRuntimeAddTransfer(
+    struct LDNetworkRuntime *const runtime,
+    struct LDNetworkTask *const    task,
+    CURL *const                    curl)
+{
+    LD_ASSERT(runtime);
+    LD_ASSERT(task);
+    LD_ASSERT(curl);
+
+    if (curl_easy_setopt(curl, CURLOPT_PRIVATE, (void *)task) != CURLE_OK) {
+        LD_LOG(LD_LOG_CRITICAL, "curl_easy_setopt CURLOPT_PRIVATE failed");
+
+        return LDBooleanFalse;
+    }
+
+    if (curl_multi_add_handle(runtime->multi, curl) != CURLM_OK) {
+        LD_LOG(LD_LOG_CRITICAL, "curl_multi_add_handle failed");
+
+        return LDBooleanFalse;
+    }
+
+    return LDBooleanTrue;
+}
+
+void
+LDi_networkRuntimeRemoveTransfer(
+    struct LDNetworkRuntime *const runtime, CURL *const curl)
+{
+    LD_ASSERT(runtime);
+    LD_ASSERT(curl);
+
+    curl_multi_remove_handle(runtime->multi, curl);
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <curl/curl.h>
+
+#include <launchdarkly/boolean.h>
+
+/* Signals that may be delivered to a task, these wake the matching work
+ * early. */
+#define LD_SIGNAL_EVENTS 1
+#define LD_SIGNAL_POLL 2
+#define LD_SIGNAL_STREAM 4
+#define LD_SIGNAL_ALL (LD_SIGNAL_EVENTS | LD_SIGNAL_POLL | LD_SIGNAL_STREAM)
+
+struct LDNetworkRuntime;
+
+/* A unit of work driven by the network runtime. All callbacks are invoked on
+ * the runtime thread, and never concurrently with each other. */
+struct LDNetworkTask
+{
+    void *context;
+    /* Called at least once per loop iteration. Should start any transfers
+     * that are due with LDi_networkRuntimeAddTransfer, and return the
+     * monotonic time in milliseconds at which it next needs to run. */
+    double (*tick)(struct LDNetworkTask *task, double now, int signals);
+    /* Called when a transfer added by this task completes. The transfer has
+     * already been removed from the runtime. */
+    void (*done)(struct LDNetworkTask *task, CURL *curl, CURLcode res);
+    /* Called when the task is detached. Must remove any active transfers. */
+    void (*stop)(struct LDNetworkTask *task);
+
+    /* owned by the runtime */
+    struct LDNetworkRuntime *runtime;
+    int                      signals;
+    LDBoolean                detaching;
+    struct LDNetworkTask *   prev;
+    struct LDNetworkTask *   next;
+};
+
+/* Starts the runtime thread. Returns NULL on failure. */
+struct LDNetworkRuntime *
+LDi_networkRuntimeNew(void);
+
+/* Stops the runtime thread. All tasks must have been detached. */
+void
+LDi_networkRuntimeFree(struct LDNetworkRuntime *const runtime);
+
+LDBoolean
+LDi_networkRuntimeAttach(
+    struct LDNetworkRuntime *const runtime, struct LDNetworkTask *const task);
+
+/* Blocks until the runtime no longer references the task. Must not be called
+ * from the runtime thread. */
+void
+LDi_networkRuntimeDetach(
+    struct LDNetworkRuntime *const runtime, struct LDNetworkTask *const task);
+
+void
+LDi_networkRuntimeSignal(
+    struct LDNetworkRuntime *const runtime,
+    struct LDNetworkTask *const    task,
+    const int                      signals);
+
+/* Runtime thread only */
+LDBoolean
+LDi_networkRuntimeAddTransfer(
+    struct LDNetworkRuntime *const runtime,
+    struct LDNetworkTask *const    task,
+    CURL *const                    curl);
+
+/* Runtime thread only */
+void
+LDi_networkRuntimeRemoveTransfer(
+    struct LDNetworkRuntime *const runtime, CURL *const curl);
@@ -0,0 +1,380 @@
+#include <string.h>
+
+#include <launchdarkly/api.h>
+
+#include "ldinternal.h"
+#include "notifier.h"
+#include "utlist.h"
+#include "uthash.h"
+
+/* The longest a waiter sleeps before rechecking, guards against a missed
+ * signal as conditions are only ever signalled, not broadcast */
+#define LD_NOTIFIER_MAX_WAIT_MS 100
+
+struct LDNotification
+{
+    LDNotifyFn fn;
+    void *     context;
+    char *     key;
+    int        value;
+    /* set instead of fn for notifications carrying data */
+    LDNotifyDataFn dataFn;
+    void *         data;
+    void (*freeData)(void *);
+    /* position in the queue, used by LDi_notifierFlush */
+    unsigned long sequence;
+    /* set while this is the latest pending notification for its fn,
+     * context, and key */
+    LDBoolean      indexed;
+    /* other indexed notifications with the same key but another fn or
+     * context, only the first of them is in the index */
+    struct LDNotification *sameKey;
+    UT_hash_handle         hh;
+
+    struct LDNotification *prev;
+    struct LDNotification *next;
+};
+
+struct LDNotifier
+{
+    ld_thread_t thread;
+    ld_mutex_t  lock;
+    ld_cond_t   queueCond;
+    ld_cond_t   deliveredCond;
+    LDBoolean   stopping;
+    /* pending notifications, oldest first */
+    struct LDNotification *queue;
+    /* latest pending notification by key */
+    struct LDNotification *index;
+    unsigned long          queued;
+    unsigned long          delivered;
+};
+
+static void
+freeNotification(struct LDNotification *const notification)
+{
+    if (notification) {
+        if (notification->freeData) {
+            notification->freeData(notification->data);
+        }
+
+        LDFree(notification->key);
+        LDFree(notification);
+    }
+}
+
+static struct LDNotification *
+newNotification(
+    LDNotifyFn        fn,
+    void *const       context,
+    const char *const key,
+    const int         value)
+{
+    struct LDNotification *notification;
+
+    if (!(notification = (struct LDNotification *)LDAlloc(
+              sizeof(struct LDNotification))))
+    {
+        return NULL;
+    }
+
+    memset(notification, 0, sizeof(struct LDNotification));
+
+    notification->fn      = fn;
+    notification->context = context;
+    notification->value   = value;
+
+    if (key && !(notification->key = LDStrDup(key))) {
+        freeNotification(notification);
+
+        return NULL;
+    }
+
+    return notification;
+}
+
+/* Expects the lock */
+static void
+unindex(
+    struct LDNotifier *const     notifier,
+    struct LDNotification *const notification)
+{
+    struct LDNotification *head, **link;
+
+    HASH_FIND_STR(notifier->index, notification->key, head);
+
+    if (head == notification) {
+        HASH_DEL(notifier->index, notification);
+
+        if ((head = notification->sameKey)) {
+            HASH_ADD_KEYPTR(
+                hh, notifier->index, head->key, strlen(head->key), head);
+        }
+    } else {
+        for (link = &head->sameKey; *link != notification;
+             link = &(*link)->sameKey)
+        {}
+
+        *link = notification->sameKey;
+    }
+
+    notification->sameKey = NULL;
+    notification->indexed = LDBooleanFalse;
+}
+
+static THREAD_RETURN
+LDi_notifierThread(void *const rawNotifier)
+{
+    struct LDNotifier *const notifier = (struct LDNotifier *)rawNotifier;
+
+    LDi_mutex_lock(&notifier->lock);
+
+    while (!notifier->stopping) {
+        struct LDNotification *notification;
+
+        if (!(notification = notifier->queue)) {
+            LDi_cond_wait(
+                &notifier->queueCond,
+                &notifier->lock,
+                LD_NOTIFIER_MAX_WAIT_MS);
+
+            continue;
+        }
+
+        DL_DELETE(notifier->queue, notification);
+
+        if (notification->indexed) {
+            unindex(notifier, notification);
+        }
+
+        /* user code never runs while the lock is held */
+        LDi_mutex_unlock(&notifier->lock);
+
+        if (notification->dataFn) {
+            notification->dataFn(notification->context, notification->data);
+        } else {
+            notification->fn(
+                notification->context, notification->key, notification->value);
+        }
+
+        LDi_mutex_lock(&notifier->lock);
+
+        notifier->delivered = notification->sequence;
+        LDi_cond_signal(&notifier->deliveredCond);
+
+        freeNotification(notification);
+    }
+
+    LDi_mutex_unlock(&notifier->lock);
+
+    return THREAD_RETURN_DEFAULT;
+}
+
+struct LDNotifier *
+LDi_notifierNew(void)
+{
+    struct LDNotifier *notifier;
+
+    if (!(notifier = (struct LDNotifier *)LDAlloc(sizeof(struct LDNotifier))))
+    {
+        return NULL;
+    }
+
+    memset(notifier, 0, sizeof(struct LDNotifier));
+
+    if (!LDi_mutex_init(&notifier->lock)) {
+        goto err1;
+    }
+
+    if (!LDi_cond_init(&notifier->queueCond)) {
+        goto err2;
+    }
+
+    if (!LDi_cond_init(&notifier->deliveredCond)) {
+        goto err3;
+    }
+
+    if (!LDi_thread_create(&notifier->thread, LDi_notifierThread, notifier)) {
+        goto err4;
+    }
+
+    return notifier;
+
+err4:
+    LDi_cond_destroy(&notifier->deliveredCond);
+err3:
+    LDi_cond_destroy(&notifier->queueCond);
+err2:
+    LDi_mutex_destroy(&notifier->lock);
+err1:
+    LDFree(notifier);
+
+    return NULL;
+}
+
+void
+LDi_notifierFree(struct LDNotifier *const notifier)
+{
+    struct LDNotification *notification, *tmp;
+
+    if (!notifier) {
+        return;
+    }
+
+    LDi_mutex_lock(&notifier->lock);
+    notifier->stopping = LDBooleanTrue;
+    LDi_cond_signal(&notifier->queueCond);
+    LDi_mutex_unlock(&notifier->lock);
+
+    LDi_thread_join(&notifier->thread);
+
+    HASH_CLEAR(hh, notifier->index);
+
+    DL_FOREACH_SAFE(notifier->queue, notification, tmp)
+    {
+        DL_DELETE(notifier->queue, notification);
+        freeNotification(notification);
+    }
+
+    LDi_cond_destroy(&notifier->deliveredCond);
+    LDi_cond_destroy(&notifier->queueCond);
+    LDi_mutex_destroy(&notifier->lock);
+
+    LDFree(notifier);
+}
+
+static void
+enqueue(
+    struct LDNotifier *const     notifier,
+    struct LDNotification *const notification)
+{
+    struct LDNotification *head, *latest;
+
+    LDi_mutex_lock(&notifier->lock);
+
+    if (notification->key) {
+        HASH_FIND_STR(notifier->index, notification->key, head);
+
+        for (latest = head; latest; latest = latest->sameKey) {
+            if (latest->fn == notification->fn &&
+                latest->context == notification->context)
+            {
+                break;
+            }
+        }
+
+        if (latest) {
+            if (latest->value == notification->value) {
+                LDi_mutex_unlock(&notifier->lock);
+
+                freeNotification(notification);
+
+                return;
+            }
+
+            unindex(notifier, latest);
+
+            HASH_FIND_STR(notifier->index, notification->key, head);
+        }
+
+        if (head) {
+            notification->sameKey = head->sameKey;
+            head->sameKey         = notification;
+        } else {
+            HASH_ADD_KEYPTR(
+                hh,
+                notifier->index,
+                notification->key,
+                strlen(notification->key),
+                notification);
+        }
+
+        notification->indexed = LDBooleanTrue;
+    }
+
+    notification->sequence = ++notifier->queued;
+
+    DL_APPEND(notifier->queue, notification);
+    LDi_cond_signal(&notifier->queueCond);
+
+    LDi_mutex_unlock(&notifier->lock);
+}
+
+LDBoolean
+LDi_notify(
+    struct LDNotifier *const notifier,
+    LDNotifyFn               fn,
+    void *const              context,
+    const char *const        key,
+    const int                value)
+{
+    struct LDNotification *notification;
+
+    LD_ASSERT(notifier);
+    LD_ASSERT(fn);
+
+    /* allocated before locking, even though it may turn out redundant */
+    if (!(notification = newNotification(fn, context, key, value))) {
+        return LDBooleanFalse;
+    }
+
+    enqueue(notifier, notification);
+
+    return LDBooleanTrue;
+}
+
+LDBoolean
+LDi_notifyData(
+    struct LDNotifier *const notifier,
+    LDNotifyDataFn           fn,
+    void *const              context,
+    void *const              data,
+    void (*freeData)(void *))
+{
+    struct LDNotification *notification;
+
+    LD_ASSERT(notifier);
+    LD_ASSERT(fn);
+
+    if (!(notification = (struct LDNotification *)LDAlloc(
+              sizeof(struct LDNotification))))
+    {
+        if (freeData) {
+            freeData(data);
+        }
+
+        return LDBooleanFalse;
+    }
+
+    memset(notification, 0, sizeof(struct LDNotification));
+
+    notification->dataFn   = fn;
+    notification->context  = context;
+    notification->data     = data;
+    notification->freeData = freeData;
+
+    enqueue(notifier, notification);
+
+    return LDBooleanTrue;
+}
+
+void
+LDi_notifierFlush(struct LDNotifier *const notifier)
+{
+    unsigned long target;
+
+    LD_ASSERT(notifier);
+
+    LDi_mutex_lock(&notifier->lock);
+
+    target = notifier->queued;
+
+    while (notifier->delivered < target && !notifier->stopping) {
+        LDi_cond_wait(
+            &notifier->deliveredCond,
+            &notifier->lock,
+            LD_NOTIFIER_MAX_WAIT_MS);
+    }
+
+    LDi_mutex_unlock(&notifier->lock);
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <launchdarkly/boolean.h>
+
+struct LDNotifier;
+
+/* Delivers a notification, invoked on the notifier thread. `key` is NULL for
+ * notifications enqueued without one. */
+typedef void (*LDNotifyFn)(
+    void *const context, const char *const key, const int value);
+
+/* Delivers a notification carrying data, invoked on the notifier thread */
+typedef void (*LDNotifyDataFn)(void *const context, void *const data);
+
+/* Starts the notifier thread. Returns NULL on failure. */
+struct LDNotifier *
+LDi_notifierNew(void);
+
+/* Stops the notifier thread, discarding anything not yet delivered. */
+void
+LDi_notifierFree(struct LDNotifier *const notifier);
+
+/* Queues a call of `fn` on the notifier thread. Notifications are delivered
+ * in the order they were queued.
+ *
+ * Notifications with a key are coalesced: if the most recent notification
+ * still pending for the same `fn`, `context`, and `key` carries the same
+ * value, no new notification is queued. The key is copied. */
+LDBoolean
+LDi_notify(
+    struct LDNotifier *const notifier,
+    LDNotifyFn               fn,
+    void *const              context,
+    const char *const        key,
+    const int                value);
+
+/* Queues a call of `fn` on the notifier thread, taking ownership of `data`
+ * which is released with `freeData` once delivered or discarded. These are
+ * never coalesced. On failure `data` is released immediately. */
+LDBoolean
+LDi_notifyData(
+    struct LDNotifier *const notifier,
+    LDNotifyDataFn           fn,
+    void *const              context,
+    void *const              data,
+    void (*freeData)(void *));
+
+/* Blocks until everything queued so far has been delivered. Must not be
+ * called from the notifier thread. */
+void
+LDi_notifierFlush(struct LDNotifier *const notifier);
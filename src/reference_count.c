@@ -11,10 +11,6 @@ LDi_rc_initialize(
     LD_ASSERT(value);
     LD_ASSERT(destructor);
 
-    if (!LDi_mutex_init(&rc->lock)) {
-        return LDBooleanFalse;
-    }
-
     rc->count      = 1;
     rc->value      = value;
     rc->destructor = destructor;
@@ -27,24 +23,15 @@ LDi_rc_increment(struct ld_rc_t *const rc)
 {
     LD_ASSERT(rc);
 
-    LDi_mutex_lock(&rc->lock);
-    rc->count++;
-    LDi_mutex_unlock(&rc->lock);
+    LDi_atomic_add(&rc->count, 1);
 }
 
 void
 LDi_rc_decrement(struct ld_rc_t *const rc)
 {
-    unsigned int count;
-
     LD_ASSERT(rc);
 
-    LDi_mutex_lock(&rc->lock);
-    rc->count--;
-    count = rc->count;
-    LDi_mutex_unlock(&rc->lock);
-
-    if (count == 0) {
+    if (LDi_atomic_add(&rc->count, -1) == 0) {
         rc->destructor(rc->value);
     }
 }
@@ -52,7 +39,6 @@ LDi_rc_decrement(struct ld_rc_t *const rc)
 void
 LDi_rc_destroy(struct ld_rc_t *const rc)
 {
-    if (rc) {
-        LDi_mutex_destroy(&rc->lock);
-    }
+    /* nothing is held beyond the structure itself */
+    (void)rc;
 }
@@ -6,10 +6,10 @@
 
 struct ld_rc_t
 {
-    void *       value;
-    unsigned int count;
+    /* atomic, so that counting takes no lock */
+    ld_atomic_int_t count;
+    void *          value;
     void (*destructor)(void *value);
-    ld_mutex_t lock;
 };
 
 LDBoolean
@@ -1,9 +1,35 @@
+#include <stddef.h>
+#include <string.h>
+
 #include <launchdarkly/memory.h>
 
 #include "assertion.h"
+#include "flag_journal.h"
+#include "slab.h"
 #include "store.h"
+#include "utility.h"
 #include "uthash.h"
 
+/* values whose text is at least this long are decoded only when read */
+#define LD_LAZY_MIN_BYTES (16 * 1024)
+/* memory decoded lazy values may hold before the least recent are dropped */
+#define LD_DECODED_MAX_BYTES (4 * 1024 * 1024)
+/* keys up to this size, with their terminator, fit in a pooled node */
+#define LD_STORE_NODE_KEY_BYTES 32
+
+static struct LDSlabPool LDi_storeNodes =
+    LD_SLAB_POOL(offsetof(struct LDStoreNode, key) + LD_STORE_NODE_KEY_BYTES);
+
+static void
+LDi_freeStoreNode(struct LDStoreNode *const node, const size_t keySize)
+{
+    if (keySize <= LD_STORE_NODE_KEY_BYTES) {
+        LDi_slabFree(&LDi_storeNodes, node);
+    } else {
+        LDFree(node);
+    }
+}
+
 static void
 LDi_destroyStoreNode(void *const nodeRaw)
 {
@@ -13,8 +39,10 @@ LDi_destroyStoreNode(void *const nodeRaw)
 
     if (node) {
         LDi_rc_destroy(&node->rc);
-        LDi_flag_destroy(&node->flag);
-        LDFree(nodeRaw);
+        /* the key is part of the node */
+        LDi_releaseJSON(node->flag.value);
+        LDi_releaseJSON(node->flag.reason);
+        LDi_freeStoreNode(node, strlen(node->key) + 1);
     }
 }
 
@@ -27,8 +55,55 @@ LDi_storeFreeHash(struct LDStoreNode *flags)
     {
         HASH_DEL(flags, node);
 
-        LDi_destroyStoreNode(node);
+        /* readers, and the decoded values cache, may still hold the node */
+        LDi_rc_decrement(&node->rc);
+    }
+}
+
+static void
+LDi_freeDecoded(
+    struct LDStore *const store, struct LDDecodedValue *const decoded)
+{
+    HASH_DEL(store->decoded, decoded);
+    store->decodedBytes -= decoded->bytes;
+
+    LDJSONFree(decoded->value);
+    LDi_rc_decrement(&decoded->node->rc);
+    LDFree(decoded);
+}
+
+/* Drops every decoded value */
+static void
+LDi_storeDropDecoded(struct LDStore *const store)
+{
+    struct LDDecodedValue *decoded, *tmp;
+
+    LDi_mutex_lock(&store->decodedLock);
+
+    HASH_ITER(hh, store->decoded, decoded, tmp)
+    {
+        LDi_freeDecoded(store, decoded);
     }
+
+    LDi_mutex_unlock(&store->decodedLock);
+}
+
+/* Drops the decoded value of a node that is being replaced, if any */
+static void
+LDi_storeDropDecodedNode(
+    struct LDStore *const store, struct LDStoreNode *const node)
+{
+    struct LDDecodedValue *decoded;
+
+    LDi_mutex_lock(&store->decodedLock);
+
+    HASH_FIND(hh, store->decoded, &node, sizeof(node), decoded);
+
+    if (decoded) {
+        LDi_freeDecoded(store, decoded);
+    }
+
+    LDi_mutex_unlock(&store->decodedLock);
 }
 
 void
@@ -36,9 +111,41 @@ LDi_storeFreeFlags(struct LDStore *const store)
 {
     LD_ASSERT(store);
 
+    LDi_storeDropDecoded(store);
     LDi_storeFreeHash(store->flags);
+    LDi_flagImageClose(store->image);
 
     store->flags = NULL;
+    store->image = NULL;
+}
+
+static void
+LDi_freeSnapshot(struct LDStoreSnapshot *const snapshot)
+{
+    unsigned int i;
+
+    if (snapshot) {
+        for (i = 0; i < snapshot->flagCount; i++) {
+            LDi_flag_destroy(&snapshot->flags[i]);
+        }
+
+        LDFree(snapshot->flags);
+        LDFree(snapshot->user);
+        LDFree(snapshot);
+    }
+}
+
+static void
+LDi_freeSnapshots(struct LDStoreSnapshot *snapshots)
+{
+    struct LDStoreSnapshot *snapshot, *tmp;
+
+    HASH_ITER(hh, snapshots, snapshot, tmp)
+    {
+        HASH_DEL(snapshots, snapshot);
+
+        LDi_freeSnapshot(snapshot);
+    }
 }
 
 LDBoolean
@@ -50,10 +157,42 @@ LDi_storeInitialize(struct LDStore *const store)
         return LDBooleanFalse;
     }
 
+    if (!LDi_valuePoolInitialize(&store->values)) {
+        LDi_rwlock_destroy(&store->lock);
+
+        return LDBooleanFalse;
+    }
+
+    if (!LDi_mutex_init(&store->decodedLock)) {
+        LDi_valuePoolDestroy(&store->values);
+        LDi_rwlock_destroy(&store->lock);
+
+        return LDBooleanFalse;
+    }
+
     store->flags       = NULL;
+    store->image       = NULL;
     store->initialized = LDBooleanFalse;
+    store->revision    = 0;
+    store->notifier    = NULL;
+    store->persister   = NULL;
+
+    store->cachePath        = NULL;
+    store->cachePathNext    = NULL;
+    store->cachePathPending = LDBooleanFalse;
+
+    store->snapshots         = NULL;
+    store->snapshotsBytes    = 0;
+    store->snapshotsMaxCount = 0;
+    store->snapshotsMaxBytes = 0;
+
+    store->lazyMinBytes    = LD_LAZY_MIN_BYTES;
+    store->decoded         = NULL;
+    store->decodedBytes    = 0;
+    store->decodedMaxBytes = LD_DECODED_MAX_BYTES;
 
     LDi_initListeners(&store->listeners);
+    store->allFlagsListeners = NULL;
 
     return LDBooleanTrue;
 }
@@ -62,32 +201,259 @@ void
 LDi_storeDestroy(struct LDStore *const store)
 {
     if (store) {
+        LDi_storeDropDecoded(store);
         LDi_storeFreeHash(store->flags);
+        LDi_flagImageClose(store->image);
         LDi_rwlock_destroy(&store->lock);
         LDi_freeListeners(&store->listeners);
+        LDi_freeAllFlagsListeners(&store->allFlagsListeners);
+        LDi_freeSnapshots(store->snapshots);
+        LDFree(store->cachePath);
+        LDFree(store->cachePathNext);
+        LDi_mutex_destroy(&store->decodedLock);
+        LDi_valuePoolDestroy(&store->values);
+    }
+}
+
+/* Approximates the memory held by a JSON value, NULL is allowed */
+static unsigned int
+LDi_jsonFootprint(const struct LDJSON *const json)
+{
+    const struct LDJSON *iter;
+    unsigned int         bytes;
+
+    if (!json) {
+        return 0;
+    }
+
+    /* roughly the size of a node */
+    bytes = 64;
+
+    if (LDi_lazyJSONText(json)) {
+        return bytes + strlen(LDi_lazyJSONText(json)) + 1;
+    }
+
+    switch (LDJSONGetType(json)) {
+        case LDText:
+            bytes += strlen(LDGetText(json)) + 1;
+            break;
+        case LDObject:
+        case LDArray:
+            for (iter = LDGetIter(json); iter; iter = LDIterNext(iter)) {
+                bytes += LDi_jsonFootprint(iter);
+
+                if (LDJSONGetType(json) == LDObject) {
+                    bytes += strlen(LDIterKey(iter)) + 1;
+                }
+            }
+            break;
+        default:
+            break;
+    }
+
+    return bytes;
+}
+
+/* Stored values are shared with anything reading them, instead of copied,
+ * and equal values are one value held by the pool. Large values are kept
+ * as text instead. A value that cannot be shared is kept as it is. */
+static void
+LDi_shareFlagValues(struct LDStore *const store, struct LDFlag *const flag)
+{
+    struct LDJSON *shared;
+
+    if (flag->value) {
+        if (!flag->valueHash) {
+            flag->valueHash = LDi_hashJSON(flag->value);
+        }
+
+        /* a tree takes several times the memory of its text, so this
+         * overestimates the text and only rules values out */
+        if (store->lazyMinBytes && !LDi_lazyJSONText(flag->value) &&
+            (LDJSONGetType(flag->value) == LDObject ||
+             LDJSONGetType(flag->value) == LDArray) &&
+            LDi_jsonFootprint(flag->value) >= store->lazyMinBytes &&
+            (shared = LDi_newLazyJSON(flag->value)))
+        {
+            if (strlen(LDi_lazyJSONText(shared)) >= store->lazyMinBytes) {
+                LDJSONFree(flag->value);
+                flag->value = shared;
+            } else {
+                LDJSONFree(shared);
+            }
+        }
+
+        if (!LDi_lazyJSONText(flag->value)) {
+            flag->value = LDi_valuePoolIntern(
+                &store->values, flag->value, flag->valueHash);
+        }
+    }
+
+    /* most flags carry one of a few reasons */
+    if (flag->reason) {
+        flag->reason = LDi_valuePoolIntern(
+            &store->values, flag->reason, LDi_hashJSON(flag->reason));
     }
 }
 
 static struct LDStoreNode *
-LDi_allocateStoreNode(struct LDFlag flag)
+LDi_allocateStoreNode(struct LDStore *const store, struct LDFlag flag)
 {
     struct LDStoreNode *node;
+    size_t              keySize;
+
+    keySize = strlen(flag.key) + 1;
 
-    if (!(node = LDAlloc(sizeof(struct LDStoreNode)))) {
+    /* the key is stored inline, so a node is a single allocation, and most
+     * keys are short enough for a node from the pool */
+    if (keySize <= LD_STORE_NODE_KEY_BYTES) {
+        node = (struct LDStoreNode *)LDi_slabAlloc(&LDi_storeNodes);
+    } else {
+        node = (struct LDStoreNode *)LDAlloc(
+            offsetof(struct LDStoreNode, key) + keySize);
+    }
+
+    if (!node) {
         return NULL;
     }
 
     if (!LDi_rc_initialize(&node->rc, (void *)node, LDi_destroyStoreNode)) {
-        LDFree(node);
+        LDi_freeStoreNode(node, keySize);
 
         return NULL;
     }
 
-    node->flag = flag;
+    /* cannot fail, so the caller still owns flag whenever this does */
+    LDi_shareFlagValues(store, &flag);
+
+    memcpy(node->key, flag.key, keySize);
+    LDFree(flag.key);
+
+    node->flag     = flag;
+    node->flag.key = node->key;
 
     return node;
 }
 
+/* Returns the node for key, first moving it from the image into the hash if
+ * needed. Expects the write lock. */
+static struct LDStoreNode *
+LDi_storeAdopt(struct LDStore *const store, const char *const key)
+{
+    struct LDStoreNode *node;
+    struct LDFlag       flag;
+    unsigned int        index;
+
+    HASH_FIND_STR(store->flags, key, node);
+
+    if (node || !store->image ||
+        !LDi_flagImageFind(store->image, key, &index))
+    {
+        return node;
+    }
+
+    if (!LDi_flagImageRead(store->image, index, &flag)) {
+        LD_LOG(LD_LOG_ERROR, "failed to read flag from snapshot");
+
+        return NULL;
+    }
+
+    if (!(node = LDi_allocateStoreNode(store, flag))) {
+        LDi_flag_destroy(&flag);
+
+        return NULL;
+    }
+
+    HASH_ADD_KEYPTR(hh, store->flags, node->flag.key, strlen(node->flag.key), node);
+
+    return node;
+}
+
+/* Moves whatever is left in the image into the hash and releases the image.
+ * If a flag cannot be moved the image is kept, so no flag is lost. Expects
+ * the write lock. */
+static LDBoolean
+LDi_storeAdoptAll(struct LDStore *const store)
+{
+    const char * key;
+    unsigned int i;
+
+    if (!store->image) {
+        return LDBooleanTrue;
+    }
+
+    for (i = 0; i < LDi_flagImageCount(store->image); i++) {
+        key = LDi_flagImageKey(store->image, i);
+
+        if (!LDi_storeAdopt(store, key)) {
+            LD_LOG_1(
+                LD_LOG_ERROR, "failed to move flag %s out of snapshot", key);
+
+            return LDBooleanFalse;
+        }
+    }
+
+    LDi_flagImageClose(store->image);
+    store->image = NULL;
+
+    return LDBooleanTrue;
+}
+
+/* Takes the read lock, returns false if the hash could not be made to hold
+ * every flag. The read lock is held either way. */
+static LDBoolean
+LDi_storeReadAll(struct LDStore *const store)
+{
+    LDBoolean adopted;
+
+    LDi_rwlock_rdlock(&store->lock);
+
+    while (store->image) {
+        LDi_rwlock_rdunlock(&store->lock);
+
+        LDi_rwlock_wrlock(&store->lock);
+        adopted = LDi_storeAdoptAll(store);
+        LDi_rwlock_wrunlock(&store->lock);
+
+        LDi_rwlock_rdlock(&store->lock);
+
+        if (!adopted) {
+            return LDBooleanFalse;
+        }
+    }
+
+    return LDBooleanTrue;
+}
+
+/* Invoked on the notifier thread, calls whichever listeners are registered by
+ * the time the change is delivered */
+static void
+LDi_notifyListeners(void *const storeRaw, const char *const key, const int deleted)
+{
+    struct LDStore *const store = (struct LDStore *)storeRaw;
+    LDlistenerfn *        callbacks;
+    unsigned int          count, i;
+    LDBoolean             collected;
+
+    LDi_rwlock_rdlock(&store->lock);
+    collected = LDi_listenersCollect(store->listeners, key, &callbacks, &count);
+    LDi_rwlock_rdunlock(&store->lock);
+
+    if (!collected) {
+        LD_LOG(LD_LOG_ERROR, "failed to collect flag listeners");
+
+        return;
+    }
+
+    for (i = 0; i < count; i++) {
+        callbacks[i](key, deleted);
+    }
+
+    LDFree(callbacks);
+}
+
+/* Expects the write lock. Enqueueing under the lock keeps notifications for
+ * a flag in the order its changes were applied. */
 static void
 LDi_fireListenersFor(
     struct LDStore *const store, const char *const key, const LDBoolean deleted)
@@ -95,7 +461,393 @@ LDi_fireListenersFor(
     LD_ASSERT(store);
     LD_ASSERT(key);
 
-    LDi_listenersDispatch(store->listeners, key, deleted);
+    if (!store->notifier) {
+        LDi_listenersDispatch(store->listeners, key, deleted);
+    } else if (LDi_listenersWatch(store->listeners, key)) {
+        if (!LDi_notify(
+                store->notifier, LDi_notifyListeners, store, key, deleted))
+        {
+            LD_LOG(LD_LOG_ERROR, "failed to queue flag change notification");
+        }
+    }
+}
+
+/* Invoked on the persister thread, writes the flags unless the store has
+ * moved on to another path since this was queued */
+static void
+LDi_persistStore(void *const storeRaw, const char *const path, const int unused)
+{
+    struct LDStore *const store = (struct LDStore *)storeRaw;
+    struct LDStoreNode ** nodes;
+    struct LDFlag **      flags;
+    struct LDStoreNode *  node, *tmp;
+    unsigned int          nodeCount, flagCount, i;
+
+    (void)unused;
+
+    nodes     = NULL;
+    flags     = NULL;
+    nodeCount = 0;
+    flagCount = 0;
+
+    if (!LDi_storeReadAll(store) || !store->cachePath ||
+        strcmp(store->cachePath, path) != 0)
+    {
+        LDi_rwlock_rdunlock(&store->lock);
+
+        return;
+    }
+
+    nodeCount = HASH_COUNT(store->flags);
+
+    if (nodeCount &&
+        (!(nodes = (struct LDStoreNode **)LDAlloc(
+             sizeof(struct LDStoreNode *) * nodeCount)) ||
+         !(flags = (struct LDFlag **)LDAlloc(
+             sizeof(struct LDFlag *) * nodeCount))))
+    {
+        LDi_rwlock_rdunlock(&store->lock);
+
+        LD_LOG(LD_LOG_ERROR, "failed to allocate flags to persist");
+
+        LDFree(nodes);
+
+        return;
+    }
+
+    /* referenced so the file is written without holding the lock */
+    i = 0;
+
+    HASH_ITER(hh, store->flags, node, tmp)
+    {
+        LDi_rc_increment(&node->rc);
+        nodes[i++] = node;
+
+        if (!node->flag.deleted) {
+            flags[flagCount++] = &node->flag;
+        }
+    }
+
+    LDi_rwlock_rdunlock(&store->lock);
+
+    if (LDi_flagImageSave(path, (const struct LDFlag *const *)flags, flagCount))
+    {
+        /* the snapshot includes every journaled update */
+        LDi_flagJournalRemove(path);
+    } else {
+        LD_LOG(LD_LOG_WARNING, "failed to persist flags");
+    }
+
+    for (i = 0; i < nodeCount; i++) {
+        LDi_rc_decrement(&nodes[i]->rc);
+    }
+
+    LDFree(nodes);
+    LDFree(flags);
+}
+
+/* Queues a write of the flags, coalesced with any write still pending.
+ * Expects the write lock. */
+static void
+LDi_storeSchedulePersist(struct LDStore *const store)
+{
+    if (!store->cachePath || !store->persister) {
+        return;
+    }
+
+    if (!LDi_notify(
+            store->persister, LDi_persistStore, store, store->cachePath, 0))
+    {
+        LD_LOG(LD_LOG_ERROR, "failed to queue flag persistence");
+    }
+}
+
+/* A single update waiting to be journaled */
+struct LDJournalEntry
+{
+    char *              path;
+    struct LDStoreNode *node;
+};
+
+static void
+LDi_freeJournalEntry(void *const entryRaw)
+{
+    struct LDJournalEntry *const entry = (struct LDJournalEntry *)entryRaw;
+
+    LDi_rc_decrement(&entry->node->rc);
+    LDFree(entry->path);
+    LDFree(entry);
+}
+
+/* Invoked on the persister thread, appends the update unless the store has
+ * moved on to another path or flag since this was queued. A flag replaced
+ * by a put must not be appended, as the snapshot of that put may already
+ * have been written. The whole store is written instead once the journal
+ * outgrows it. */
+static void
+LDi_journalStore(void *const storeRaw, void *const entryRaw)
+{
+    struct LDStore *const        store = (struct LDStore *)storeRaw;
+    struct LDJournalEntry *const entry = (struct LDJournalEntry *)entryRaw;
+    struct LDStoreNode *         node;
+    LDBoolean                    current;
+
+    LDi_rwlock_rdlock(&store->lock);
+
+    current = store->cachePath && strcmp(store->cachePath, entry->path) == 0;
+
+    if (current) {
+        HASH_FIND_STR(store->flags, entry->node->flag.key, node);
+
+        current = node && node->flag.version == entry->node->flag.version &&
+                  node->flag.deleted == entry->node->flag.deleted;
+    }
+
+    LDi_rwlock_rdunlock(&store->lock);
+
+    if (!current) {
+        return;
+    }
+
+    if (!LDi_flagJournalAppend(entry->path, &entry->node->flag) ||
+        LDi_flagJournalShouldCompact(entry->path))
+    {
+        LDi_persistStore(store, entry->path, 0);
+    }
+}
+
+/* Queues an append of the node to the journal, the node is referenced
+ * until then. Expects the write lock. */
+static void
+LDi_storeScheduleJournal(
+    struct LDStore *const store, struct LDStoreNode *const node)
+{
+    struct LDJournalEntry *entry;
+
+    if (!store->cachePath || !store->persister) {
+        return;
+    }
+
+    if (!(entry = (struct LDJournalEntry *)LDAlloc(
+              sizeof(struct LDJournalEntry))))
+    {
+        LD_LOG(LD_LOG_ERROR, "failed to queue flag journal");
+
+        return;
+    }
+
+    if (!(entry->path = LDStrDup(store->cachePath))) {
+        LD_LOG(LD_LOG_ERROR, "failed to queue flag journal");
+
+        LDFree(entry);
+
+        return;
+    }
+
+    LDi_rc_increment(&node->rc);
+    entry->node = node;
+
+    if (!LDi_notifyData(
+            store->persister,
+            LDi_journalStore,
+            store,
+            entry,
+            LDi_freeJournalEntry))
+    {
+        LD_LOG(LD_LOG_ERROR, "failed to queue flag journal");
+    }
+}
+
+/* Switches to the path set since the last put. Expects the write lock. */
+static void
+LDi_storeApplyCachePath(struct LDStore *const store)
+{
+    if (store->cachePathPending) {
+        LDFree(store->cachePath);
+
+        store->cachePath        = store->cachePathNext;
+        store->cachePathNext    = NULL;
+        store->cachePathPending = LDBooleanFalse;
+    }
+}
+
+LDBoolean
+LDi_storeSetCachePath(struct LDStore *const store, const char *const path)
+{
+    char *copy;
+
+    LD_ASSERT(store);
+
+    copy = NULL;
+
+    if (path && !(copy = LDStrDup(path))) {
+        return LDBooleanFalse;
+    }
+
+    LDi_rwlock_wrlock(&store->lock);
+    LDFree(store->cachePathNext);
+    store->cachePathNext    = copy;
+    store->cachePathPending = LDBooleanTrue;
+    LDi_rwlock_wrunlock(&store->lock);
+
+    return LDBooleanTrue;
+}
+
+/* The flags changed by a single store update */
+struct LDFlagChangeSet
+{
+    struct LDFlagChange *changes;
+    unsigned int         count;
+    unsigned int         capacity;
+};
+
+static void
+LDi_changeSetFree(void *const setRaw)
+{
+    struct LDFlagChangeSet *const set = (struct LDFlagChangeSet *)setRaw;
+    unsigned int                  i;
+
+    if (set) {
+        for (i = 0; i < set->count; i++) {
+            LDFree((char *)set->changes[i].flagKey);
+        }
+
+        LDFree(set->changes);
+        LDFree(set);
+    }
+}
+
+static LDBoolean
+LDi_changeSetAppend(
+    struct LDFlagChangeSet *const set,
+    const char *const             key,
+    const LDFlagChangeKind        kind)
+{
+    char *keyCopy;
+
+    if (set->count == set->capacity) {
+        const unsigned int   capacity = set->capacity ? set->capacity * 2 : 4;
+        struct LDFlagChange *changes;
+
+        if (!(changes = (struct LDFlagChange *)LDRealloc(
+                  set->changes, sizeof(struct LDFlagChange) * capacity)))
+        {
+            return LDBooleanFalse;
+        }
+
+        set->changes  = changes;
+        set->capacity = capacity;
+    }
+
+    if (!(keyCopy = LDStrDup(key))) {
+        return LDBooleanFalse;
+    }
+
+    set->changes[set->count].flagKey = keyCopy;
+    set->changes[set->count].kind    = kind;
+    set->count++;
+
+    return LDBooleanTrue;
+}
+
+/* Records how a flag moved from previous to next, either may be NULL if
+ * absent. Deleted placeholders count as absent. */
+static LDBoolean
+LDi_changeSetCompare(
+    struct LDFlagChangeSet *const   set,
+    const struct LDStoreNode *const previous,
+    const struct LDStoreNode *const next)
+{
+    const LDBoolean wasLive = previous && !previous->flag.deleted;
+    const LDBoolean isLive  = next && !next->flag.deleted;
+
+    if (!wasLive && isLive) {
+        return LDi_changeSetAppend(set, next->flag.key, LDFlagAdded);
+    } else if (wasLive && !isLive) {
+        return LDi_changeSetAppend(set, previous->flag.key, LDFlagDeleted);
+    } else if (wasLive && isLive &&
+               previous->flag.version != next->flag.version)
+    {
+        return LDi_changeSetAppend(set, next->flag.key, LDFlagUpdated);
+    }
+
+    return LDBooleanTrue;
+}
+
+/* Invoked on the notifier thread */
+static void
+LDi_notifyAllFlagsListeners(void *const storeRaw, void *const setRaw)
+{
+    struct LDStore *const         store = (struct LDStore *)storeRaw;
+    struct LDFlagChangeSet *const set   = (struct LDFlagChangeSet *)setRaw;
+    struct AllFlagsListener *     listeners;
+    LDBoolean                     collected;
+
+    LDi_rwlock_rdlock(&store->lock);
+    collected =
+        LDi_allFlagsListenersCollect(store->allFlagsListeners, &listeners);
+    LDi_rwlock_rdunlock(&store->lock);
+
+    if (!collected) {
+        LD_LOG(LD_LOG_ERROR, "failed to collect all flags listeners");
+
+        return;
+    }
+
+    LDi_allFlagsListenersDispatch(listeners, set->changes, set->count);
+    LDi_freeAllFlagsListeners(&listeners);
+}
+
+/* Expects the write lock, takes ownership of set */
+static void
+LDi_fireAllFlagsListeners(
+    struct LDStore *const store, struct LDFlagChangeSet *const set)
+{
+    if (!set) {
+        return;
+    }
+
+    if (set->count == 0) {
+        LDi_changeSetFree(set);
+    } else if (!store->notifier) {
+        LDi_allFlagsListenersDispatch(
+            store->allFlagsListeners, set->changes, set->count);
+        LDi_changeSetFree(set);
+    } else if (!LDi_notifyData(
+                   store->notifier,
+                   LDi_notifyAllFlagsListeners,
+                   store,
+                   set,
+                   LDi_changeSetFree))
+    {
+        LD_LOG(LD_LOG_ERROR, "failed to queue flag change set");
+    }
+}
+
+/* Returns an empty change set if anyone is listening for one, expects the
+ * write lock */
+static struct LDFlagChangeSet *
+LDi_newChangeSet(const struct LDStore *const store)
+{
+    struct LDFlagChangeSet *set;
+
+    if (!store->allFlagsListeners) {
+        return NULL;
+    }
+
+    if (!(set = (struct LDFlagChangeSet *)LDAlloc(
+              sizeof(struct LDFlagChangeSet))))
+    {
+        LD_LOG(LD_LOG_ERROR, "failed to allocate flag change set");
+
+        return NULL;
+    }
+
+    set->changes  = NULL;
+    set->count    = 0;
+    set->capacity = 0;
+
+    return set;
 }
 
 enum versionStatus {
@@ -122,38 +874,55 @@ versionStatus(struct LDStoreNode *existingFlag, int incomingVersion)
 }
 
 
-LDBoolean
-LDi_storeUpsert(struct LDStore *const store, struct LDFlag flag)
+/* Replayed updates are already in the journal, so they are not appended
+ * to it again */
+static LDBoolean
+LDi_storeUpsertInternal(
+    struct LDStore *const store, struct LDFlag flag, const LDBoolean journal)
 {
     struct LDStoreNode *existing, *replacement;
+    struct LDFlagChangeSet *changes;
     enum versionStatus status;
+    const char *key;
 
     LD_ASSERT(store);
     LD_ASSERT(flag.key);
 
     /* Theoretically reduce lock contention by eagerly allocating the replacement store node.
      * Downside: the allocation is unnecessary if the update is stale, but this is unlikely. */
-    if (!(replacement = LDi_allocateStoreNode(flag))) {
+    if (!(replacement = LDi_allocateStoreNode(store, flag))) {
         LDi_flag_destroy(&flag);
 
         return LDBooleanFalse;
     }
 
+    /* the flag no longer owns its key, the node does */
+    key = replacement->key;
+
     LDi_rwlock_wrlock(&store->lock);
 
-    HASH_FIND_STR(store->flags, flag.key, existing);
+    existing = LDi_storeAdopt(store, key);
 
     status = versionStatus(existing, flag.version);
 
+    changes = NULL;
+
+    if (status != VERSION_STALE && (changes = LDi_newChangeSet(store))) {
+        if (!LDi_changeSetCompare(changes, existing, replacement)) {
+            LD_LOG(LD_LOG_ERROR, "failed to record flag change");
+        }
+    }
+
     switch (status) {
         case VERSION_NEW: {
-            HASH_ADD_KEYPTR(hh, store->flags, flag.key, strlen(flag.key), replacement);
+            HASH_ADD_KEYPTR(hh, store->flags, key, strlen(key), replacement);
             break;
         }
         case VERSION_INCREASED: {
             HASH_DEL(store->flags, existing);
+            LDi_storeDropDecodedNode(store, existing);
             LDi_rc_decrement(&existing->rc);
-            HASH_ADD_KEYPTR(hh, store->flags, flag.key, strlen(flag.key), replacement);
+            HASH_ADD_KEYPTR(hh, store->flags, key, strlen(key), replacement);
             break;
         }
         case VERSION_STALE: {
@@ -163,12 +932,50 @@ LDi_storeUpsert(struct LDStore *const store, struct LDFlag flag)
     }
 
     if (status != VERSION_STALE) {
-        LDi_fireListenersFor(store, flag.key, flag.deleted);
+        store->revision++;
+
+        LDi_fireListenersFor(store, key, flag.deleted);
+        LDi_fireAllFlagsListeners(store, changes);
+
+        if (journal) {
+            LDi_storeScheduleJournal(store, replacement);
+        }
     }
 
     LDi_rwlock_wrunlock(&store->lock);
 
-    return LDBooleanTrue;
+    return LDBooleanTrue;
+}
+
+LDBoolean
+LDi_storeUpsert(struct LDStore *const store, struct LDFlag flag)
+{
+    return LDi_storeUpsertInternal(store, flag, LDBooleanTrue);
+}
+
+void
+LDi_storeReplayFlag(struct LDStore *const store, struct LDFlag flag)
+{
+    LD_ASSERT(store);
+
+    if (!LDi_storeUpsertInternal(store, flag, LDBooleanFalse)) {
+        LD_LOG(LD_LOG_ERROR, "failed to replay journaled flag");
+    }
+}
+
+static void
+LDi_storeReplayJournaled(void *const storeRaw, struct LDFlag flag)
+{
+    LDi_storeReplayFlag((struct LDStore *)storeRaw, flag);
+}
+
+unsigned int
+LDi_storeReplayJournal(struct LDStore *const store, const char *const path)
+{
+    LD_ASSERT(store);
+    LD_ASSERT(path);
+
+    return LDi_flagJournalReplay(path, LDi_storeReplayJournaled, store);
 }
 
 struct LDStoreNode *
@@ -183,6 +990,23 @@ LDi_storeGet(struct LDStore *const store, const char *const key)
 
     HASH_FIND_STR(store->flags, key, lookup);
 
+    if (!lookup && store->image) {
+        LDi_rwlock_rdunlock(&store->lock);
+
+        /* the first read of a flag moves it out of the image */
+        LDi_rwlock_wrlock(&store->lock);
+
+        if ((lookup = LDi_storeAdopt(store, key)) && !lookup->flag.deleted) {
+            LDi_rc_increment(&lookup->rc);
+        } else {
+            lookup = NULL;
+        }
+
+        LDi_rwlock_wrunlock(&store->lock);
+
+        return lookup;
+    }
+
     if (lookup && !lookup->flag.deleted) {
         LDi_rc_increment(&lookup->rc);
 
@@ -202,16 +1026,30 @@ LDi_storeDelete(
     const char *const     key,
     const unsigned int    version)
 {
-    struct LDFlag flag;
+    char *copy;
 
     LD_ASSERT(store);
     LD_ASSERT(key);
 
-    if (!(flag.key = LDStrDup(key))) {
+    if (!(copy = LDStrDup(key))) {
         return LDBooleanFalse;
     }
 
+    return LDi_storeDeleteTaken(store, copy, version);
+}
+
+LDBoolean
+LDi_storeDeleteTaken(
+    struct LDStore *const store, char *const key, const unsigned int version)
+{
+    struct LDFlag flag;
+
+    LD_ASSERT(store);
+    LD_ASSERT(key);
+
+    flag.key                  = key;
     flag.value                = NULL;
+    flag.valueHash            = 0;
     flag.version              = version;
     flag.variation            = 0;
     flag.trackEvents          = LDBooleanFalse;
@@ -223,6 +1061,31 @@ LDi_storeDelete(
     return LDi_storeUpsert(store, flag);
 }
 
+/* Compares flag versions, as a put replaces every flag at once */
+static LDBoolean
+LDi_storeHashDiffers(
+    struct LDStoreNode *const current, struct LDStoreNode *const incoming)
+{
+    struct LDStoreNode *node, *tmp, *existing;
+
+    if (HASH_COUNT(current) != HASH_COUNT(incoming)) {
+        return LDBooleanTrue;
+    }
+
+    HASH_ITER(hh, incoming, node, tmp)
+    {
+        HASH_FIND_STR(current, node->flag.key, existing);
+
+        if (!existing || existing->flag.version != node->flag.version ||
+            existing->flag.deleted != node->flag.deleted)
+        {
+            return LDBooleanTrue;
+        }
+    }
+
+    return LDBooleanFalse;
+}
+
 LDBoolean
 LDi_storePut(
     struct LDStore *const store,
@@ -244,9 +1107,11 @@ LDi_storePut(
         } else {
             struct LDStoreNode *node;
 
-            if (!(node = LDi_allocateStoreNode(flags[i]))) {
+            if (!(node = LDi_allocateStoreNode(store, flags[i]))) {
                 LD_LOG(LD_LOG_ERROR, "failed to allocate storage node for flag");
 
+                LDi_flag_destroy(&flags[i]);
+
                 failed = LDBooleanTrue;
 
                 continue;
@@ -262,27 +1127,300 @@ LDi_storePut(
     if (failed) {
         LDi_storeFreeHash(flagsHash);
     } else {
-        struct LDStoreNode *node, *tmp;
+        struct LDStoreNode *    node, *tmp, *previous;
+        struct LDFlagChangeSet *changes;
 
         LDi_rwlock_wrlock(&store->lock);
 
+        /* changes are computed against every flag held so far */
+        LDi_storeAdoptAll(store);
+
+        if ((changes = LDi_newChangeSet(store))) {
+            HASH_ITER(hh, flagsHash, node, tmp)
+            {
+                HASH_FIND_STR(store->flags, node->flag.key, previous);
+
+                if (!LDi_changeSetCompare(changes, previous, node)) {
+                    LD_LOG(LD_LOG_ERROR, "failed to record flag change");
+                }
+            }
+
+            HASH_ITER(hh, store->flags, previous, tmp)
+            {
+                HASH_FIND_STR(flagsHash, previous->flag.key, node);
+
+                if (!node && !LDi_changeSetCompare(changes, previous, NULL)) {
+                    LD_LOG(LD_LOG_ERROR, "failed to record flag change");
+                }
+            }
+        }
+
+        LDi_storeApplyCachePath(store);
+
+        if (!store->initialized ||
+            LDi_storeHashDiffers(store->flags, flagsHash)) {
+            store->revision++;
+
+            LDi_storeSchedulePersist(store);
+        }
+
         oldHash            = store->flags;
         store->flags       = flagsHash;
         store->initialized = LDBooleanTrue;
 
+        /* the put supersedes anything the image still holds */
+        LDi_flagImageClose(store->image);
+        store->image = NULL;
+
+        /* every node was replaced */
+        LDi_storeDropDecoded(store);
+
         HASH_ITER(hh, store->flags, node, tmp)
         {
             LDi_fireListenersFor(store, node->flag.key, LDBooleanFalse);
         }
 
+        LDi_fireAllFlagsListeners(store, changes);
+
         LDi_rwlock_wrunlock(&store->lock);
 
         LDi_storeFreeHash(oldHash);
+
+        /* the replaced flags were likely the last to hold some values */
+        LDi_valuePoolPrune(&store->values);
     }
 
     return !failed;
 }
 
+/* Copies the live flags of the store, returns NULL if it holds none yet */
+static struct LDStoreSnapshot *
+LDi_newSnapshot(struct LDStore *const store, const char *const user)
+{
+    struct LDStoreSnapshot *snapshot;
+    struct LDStoreNode *    node, *tmp;
+    unsigned int            count;
+
+    if (!(snapshot = (struct LDStoreSnapshot *)LDAlloc(
+              sizeof(struct LDStoreSnapshot))))
+    {
+        return NULL;
+    }
+
+    memset(snapshot, 0, sizeof(struct LDStoreSnapshot));
+
+    if (!(snapshot->user = LDStrDup(user))) {
+        goto error;
+    }
+
+    snapshot->bytes = sizeof(struct LDStoreSnapshot) + strlen(user) + 1;
+
+    if (!LDi_storeReadAll(store) || !store->initialized) {
+        LDi_rwlock_rdunlock(&store->lock);
+
+        goto error;
+    }
+
+    count = HASH_COUNT(store->flags);
+
+    if (count && !(snapshot->flags = (struct LDFlag *)LDAlloc(
+                       sizeof(struct LDFlag) * count)))
+    {
+        LDi_rwlock_rdunlock(&store->lock);
+
+        goto error;
+    }
+
+    HASH_ITER(hh, store->flags, node, tmp)
+    {
+        struct LDFlag *const flag = &snapshot->flags[snapshot->flagCount];
+
+        if (node->flag.deleted) {
+            continue;
+        }
+
+        if (!LDi_flag_duplicate(flag, &node->flag)) {
+            LDi_rwlock_rdunlock(&store->lock);
+
+            goto error;
+        }
+
+        snapshot->flagCount++;
+        snapshot->bytes += sizeof(struct LDFlag) + strlen(flag->key) + 1 +
+                           LDi_jsonFootprint(flag->value) +
+                           LDi_jsonFootprint(flag->reason);
+    }
+
+    LDi_rwlock_rdunlock(&store->lock);
+
+    return snapshot;
+
+error:
+    LDi_freeSnapshot(snapshot);
+
+    return NULL;
+}
+
+LDBoolean
+LDi_storeSwitchUser(
+    struct LDStore *const store,
+    const char *const     previousUser,
+    const char *const     nextUser)
+{
+    struct LDStoreSnapshot *previous, *next, *existing, *tmp;
+    LDBoolean               restored;
+
+    LD_ASSERT(store);
+    LD_ASSERT(nextUser);
+
+    if (store->snapshotsMaxCount == 0) {
+        return LDBooleanFalse;
+    }
+
+    /* any copy for the same user would be older than what is stored */
+    if (previousUser && strcmp(previousUser, nextUser) == 0) {
+        return LDBooleanFalse;
+    }
+
+    previous = NULL;
+
+    if (previousUser && (previous = LDi_newSnapshot(store, previousUser)) &&
+        previous->bytes > store->snapshotsMaxBytes)
+    {
+        LD_LOG(LD_LOG_INFO, "flags of previous user too large to keep");
+
+        LDi_freeSnapshot(previous);
+        previous = NULL;
+    }
+
+    LDi_rwlock_wrlock(&store->lock);
+
+    HASH_FIND_STR(store->snapshots, nextUser, next);
+
+    if (next) {
+        HASH_DEL(store->snapshots, next);
+        store->snapshotsBytes -= next->bytes;
+    }
+
+    if (previous) {
+        HASH_FIND_STR(store->snapshots, previous->user, existing);
+
+        if (existing) {
+            HASH_DEL(store->snapshots, existing);
+            store->snapshotsBytes -= existing->bytes;
+            LDi_freeSnapshot(existing);
+        }
+
+        HASH_ADD_KEYPTR(
+            hh,
+            store->snapshots,
+            previous->user,
+            strlen(previous->user),
+            previous);
+        store->snapshotsBytes += previous->bytes;
+
+        /* iteration is in insertion order, so the oldest go first */
+        HASH_ITER(hh, store->snapshots, existing, tmp)
+        {
+            if (HASH_COUNT(store->snapshots) <= store->snapshotsMaxCount &&
+                store->snapshotsBytes <= store->snapshotsMaxBytes)
+            {
+                break;
+            }
+
+            HASH_DEL(store->snapshots, existing);
+            store->snapshotsBytes -= existing->bytes;
+            LDi_freeSnapshot(existing);
+        }
+    }
+
+    LDi_rwlock_wrunlock(&store->lock);
+
+    if (!next) {
+        return LDBooleanFalse;
+    }
+
+    /* ownership of the flags passes to the store */
+    restored        = LDi_storePut(store, next->flags, next->flagCount);
+    next->flags     = NULL;
+    next->flagCount = 0;
+
+    LDi_freeSnapshot(next);
+
+    return restored;
+}
+
+void
+LDi_storePutImage(struct LDStore *const store, struct LDFlagImage *const image)
+{
+    struct LDStoreNode *    oldHash, *node, *tmp;
+    struct LDFlagImage *    oldImage;
+    struct LDFlagChangeSet *changes;
+    unsigned int            i, index;
+    LDBoolean               recorded;
+
+    LD_ASSERT(store);
+    LD_ASSERT(image);
+
+    LDi_rwlock_wrlock(&store->lock);
+
+    if ((changes = LDi_newChangeSet(store))) {
+        LDi_storeAdoptAll(store);
+
+        recorded = LDBooleanTrue;
+
+        for (i = 0; i < LDi_flagImageCount(image); i++) {
+            const char *const key = LDi_flagImageKey(image, i);
+
+            HASH_FIND_STR(store->flags, key, node);
+
+            if (!node || node->flag.deleted) {
+                recorded &= LDi_changeSetAppend(changes, key, LDFlagAdded);
+            } else if (node->flag.version != LDi_flagImageVersion(image, i)) {
+                recorded &= LDi_changeSetAppend(changes, key, LDFlagUpdated);
+            }
+        }
+
+        HASH_ITER(hh, store->flags, node, tmp)
+        {
+            if (!node->flag.deleted &&
+                !LDi_flagImageFind(image, node->flag.key, &index))
+            {
+                recorded &=
+                    LDi_changeSetAppend(changes, node->flag.key, LDFlagDeleted);
+            }
+        }
+
+        if (!recorded) {
+            LD_LOG(LD_LOG_ERROR, "failed to record flag change");
+        }
+    }
+
+    /* the image was read from disk already, so it is not written back */
+    LDi_storeApplyCachePath(store);
+
+    oldHash  = store->flags;
+    oldImage = store->image;
+
+    store->flags       = NULL;
+    store->image       = image;
+    store->initialized = LDBooleanTrue;
+    store->revision++;
+
+    LDi_storeDropDecoded(store);
+
+    for (i = 0; i < LDi_flagImageCount(image); i++) {
+        LDi_fireListenersFor(store, LDi_flagImageKey(image, i), LDBooleanFalse);
+    }
+
+    LDi_fireAllFlagsListeners(store, changes);
+
+    LDi_rwlock_wrunlock(&store->lock);
+
+    LDi_storeFreeHash(oldHash);
+    LDi_flagImageClose(oldImage);
+}
+
 LDBoolean
 LDi_storeGetAll(
     struct LDStore *const       store,
@@ -296,7 +1434,11 @@ LDi_storeGetAll(
     LD_ASSERT(flags);
     LD_ASSERT(flagCount);
 
-    LDi_rwlock_rdlock(&store->lock);
+    if (!LDi_storeReadAll(store)) {
+        LDi_rwlock_rdunlock(&store->lock);
+
+        return LDBooleanFalse;
+    }
 
     count = HASH_COUNT(store->flags);
 
@@ -347,7 +1489,9 @@ LDi_storeGetJSON(struct LDStore *const store)
         return NULL;
     }
 
-    LDi_rwlock_rdlock(&store->lock);
+    if (!LDi_storeReadAll(store)) {
+        goto error;
+    }
 
     HASH_ITER(hh, store->flags, node, tmp)
     {
@@ -379,6 +1523,98 @@ error:
     return NULL;
 }
 
+/* Returns a copy of the value of the node for the caller to own, decoding
+ * a lazy value through a cache of recently decoded values */
+struct LDJSON *
+LDi_storeCopyValue(struct LDStore *const store, struct LDStoreNode *const node)
+{
+    struct LDDecodedValue *decoded, *tmp;
+    struct LDJSON *        value, *result;
+    const char *           text;
+
+    LD_ASSERT(store);
+    LD_ASSERT(node);
+
+    if (!(text = LDi_lazyJSONText(node->flag.value))) {
+        return LDJSONDuplicate(node->flag.value);
+    }
+
+    LDi_mutex_lock(&store->decodedLock);
+
+    HASH_FIND(hh, store->decoded, &node, sizeof(node), decoded);
+
+    if (decoded) {
+        /* iteration is in insertion order, so this makes it the latest */
+        HASH_DEL(store->decoded, decoded);
+        HASH_ADD(hh, store->decoded, node, sizeof(decoded->node), decoded);
+
+        result = LDJSONDuplicate(decoded->value);
+
+        LDi_mutex_unlock(&store->decodedLock);
+
+        return result;
+    }
+
+    LDi_mutex_unlock(&store->decodedLock);
+
+    /* decoded without the lock, at worst twice by racing readers */
+    if (!(value = LDJSONDeserialize(text))) {
+        LD_LOG(LD_LOG_ERROR, "failed to decode lazy flag value");
+
+        return NULL;
+    }
+
+    if (!(result = LDJSONDuplicate(value))) {
+        LDJSONFree(value);
+
+        return NULL;
+    }
+
+    if (!(decoded = (struct LDDecodedValue *)LDAlloc(
+              sizeof(struct LDDecodedValue))))
+    {
+        LDJSONFree(value);
+
+        return result;
+    }
+
+    decoded->node  = node;
+    decoded->value = value;
+    decoded->bytes = LDi_jsonFootprint(value);
+
+    LDi_mutex_lock(&store->decodedLock);
+
+    HASH_FIND(hh, store->decoded, &node, sizeof(node), tmp);
+
+    if (tmp || decoded->bytes > store->decodedMaxBytes) {
+        LDi_mutex_unlock(&store->decodedLock);
+
+        LDJSONFree(value);
+        LDFree(decoded);
+
+        return result;
+    }
+
+    LDi_rc_increment(&node->rc);
+
+    HASH_ADD(hh, store->decoded, node, sizeof(decoded->node), decoded);
+    store->decodedBytes += decoded->bytes;
+
+    /* the oldest go first, which is never the one just added */
+    HASH_ITER(hh, store->decoded, decoded, tmp)
+    {
+        if (store->decodedBytes <= store->decodedMaxBytes) {
+            break;
+        }
+
+        LDi_freeDecoded(store, decoded);
+    }
+
+    LDi_mutex_unlock(&store->decodedLock);
+
+    return result;
+}
+
 /* Registers a listener callback for a given flag, returning true on success or if the combination of flag key and listener
  * callback is already registered. */
 LDBoolean
@@ -409,3 +1645,47 @@ LDi_storeUnregisterListener(struct LDStore *const store, const char *const flagK
     LDi_listenerRemove(&store->listeners, flagKey, op);
     LDi_rwlock_wrunlock(&store->lock);
 }
+
+LDBoolean
+LDi_storeRegisterAllFlagsListener(
+    struct LDStore *const      store,
+    LDallflagslistenerfn       op,
+    void *const                userData)
+{
+    LDBoolean status;
+
+    LD_ASSERT(store);
+    LD_ASSERT(op);
+
+    LDi_rwlock_wrlock(&store->lock);
+    status = LDi_allFlagsListenerAdd(&store->allFlagsListeners, op, userData);
+    LDi_rwlock_wrunlock(&store->lock);
+
+    return status;
+}
+
+void
+LDi_storeUnregisterAllFlagsListener(
+    struct LDStore *const store, LDallflagslistenerfn op)
+{
+    LD_ASSERT(store);
+    LD_ASSERT(op);
+
+    LDi_rwlock_wrlock(&store->lock);
+    LDi_allFlagsListenerRemove(&store->allFlagsListeners, op);
+    LDi_rwlock_wrunlock(&store->lock);
+}
+
+unsigned int
+LDi_storeRevision(struct LDStore *const store)
+{
+    unsigned int revision;
+
+    LD_ASSERT(store);
+
+    LDi_rwlock_rdlock(&store->lock);
+    revision = store->revision;
+    LDi_rwlock_rdunlock(&store->lock);
+
+    return revision;
+}
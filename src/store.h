@@ -4,22 +4,85 @@
 
 #include "concurrency.h"
 #include "flag.h"
+#include "flag_image.h"
 #include "reference_count.h"
 #include "uthash.h"
 #include "flag_change_listener.h"
+#include "notifier.h"
+#include "value_pool.h"
 
 struct LDStoreNode
 {
     struct LDFlag  flag;
     struct ld_rc_t rc;
     UT_hash_handle hh;
+    /* flag.key points here, the node is allocated to fit it */
+    char           key[1];
+};
+
+/* A lazy flag value once decoded, see LDi_storeCopyValue */
+struct LDDecodedValue
+{
+    /* the key, which a reference is held to */
+    struct LDStoreNode *node;
+    struct LDJSON *     value;
+    /* approximate memory held by value */
+    unsigned int        bytes;
+    UT_hash_handle      hh;
+};
+
+/* Copies of the flags of a user no longer current, see LDi_storeSwitchUser */
+struct LDStoreSnapshot
+{
+    /* the serialized user */
+    char *         user;
+    struct LDFlag *flags;
+    unsigned int   flagCount;
+    /* approximate memory held by flags */
+    unsigned int   bytes;
+    UT_hash_handle hh;
 };
 
 struct LDStore
 {
     struct LDStoreNode     *flags;
+    /* flags absent from the hash are read from this when first needed,
+     * until the next put replaces it. NULL unless restored from a file. */
+    struct LDFlagImage     *image;
     struct ChangeListener  *listeners;
+    struct AllFlagsListener *allFlagsListeners;
+    /* listeners are notified through this when set, and otherwise called
+     * while the store is locked */
+    struct LDNotifier      *notifier;
+    /* flags are written through this, apart from the notifier so that slow
+     * disks and slow listeners do not hold each other up */
+    struct LDNotifier      *persister;
     LDBoolean               initialized;
+    /* incremented whenever the stored flags actually change */
+    unsigned int            revision;
+    /* where flags are written after each change, NULL if nowhere. A new
+     * path only takes effect with the next put, which carries the flags of
+     * the user it belongs to. Guarded by lock. */
+    char *                  cachePath;
+    char *                  cachePathNext;
+    LDBoolean               cachePathPending;
+    /* least recently used first, guarded by lock */
+    struct LDStoreSnapshot *snapshots;
+    unsigned int            snapshotsBytes;
+    /* no snapshots are kept while snapshotsMaxCount is zero */
+    unsigned int            snapshotsMaxCount;
+    unsigned int            snapshotsMaxBytes;
+    /* values of stored flags, which equal values share */
+    struct LDValuePool      values;
+    /* values whose text is at least this long are kept as text, and only
+     * decoded when read, zero keeps every value decoded */
+    unsigned int            lazyMinBytes;
+    /* least recently used first, guarded by decodedLock. Trees are evicted
+     * beyond decodedMaxBytes, and the text decoded again when next read. */
+    struct LDDecodedValue * decoded;
+    unsigned int            decodedBytes;
+    unsigned int            decodedMaxBytes;
+    ld_mutex_t              decodedLock;
     ld_rwlock_t             lock;
 };
 
@@ -38,12 +101,21 @@ LDi_storePut(
     struct LDFlag *       flags,
     const unsigned int    flagCount);
 
+/* Replaces every flag with those of the image, taking ownership of it */
+void
+LDi_storePutImage(struct LDStore *const store, struct LDFlagImage *const image);
+
 LDBoolean
 LDi_storeDelete(
     struct LDStore *const store,
     const char *const     key,
     const unsigned int    version);
 
+/* Deletes like LDi_storeDelete, taking ownership of `key` */
+LDBoolean
+LDi_storeDeleteTaken(
+    struct LDStore *const store, char *const key, const unsigned int version);
+
 struct LDStoreNode *
 LDi_storeGet(struct LDStore *const store, const char *const key);
 
@@ -56,6 +128,15 @@ LDi_storeGetAll(
 struct LDJSON *
 LDi_storeGetJSON(struct LDStore *const store);
 
+/* Returns a copy of the value of the node for the caller to own, decoding
+ * a lazy value through a cache of recently decoded values */
+struct LDJSON *
+LDi_storeCopyValue(
+    struct LDStore *const store, struct LDStoreNode *const node);
+
+unsigned int
+LDi_storeRevision(struct LDStore *const store);
+
 LDBoolean
 LDi_storeRegisterListener(
     struct LDStore *const store, const char *const flagKey, LDlistenerfn op);
@@ -64,5 +145,43 @@ void
 LDi_storeUnregisterListener(
     struct LDStore *const store, const char *const flagKey, LDlistenerfn op);
 
+LDBoolean
+LDi_storeRegisterAllFlagsListener(
+    struct LDStore *const      store,
+    LDallflagslistenerfn       op,
+    void *const                userData);
+
+void
+LDi_storeUnregisterAllFlagsListener(
+    struct LDStore *const store, LDallflagslistenerfn op);
+
+/* Sets where flags are persisted from the next put on, NULL stops
+ * persisting. Writes happen on the persister thread: a put rewrites the
+ * file, coalesced with any write still pending, while an upsert is
+ * appended to a journal beside it. The store is never persisted without a
+ * persister. */
+LDBoolean
+LDi_storeSetCachePath(struct LDStore *const store, const char *const path);
+
+/* Applies the updates journaled beside the snapshot at `path`, after
+ * LDi_storePutImage of that snapshot. Returns the number applied. */
+unsigned int
+LDi_storeReplayJournal(struct LDStore *const store, const char *const path);
+
+/* Applies one flag replayed from a journal, taking ownership of it. Unlike
+ * an upsert, it is not journaled again. */
+void
+LDi_storeReplayFlag(struct LDStore *const store, struct LDFlag flag);
+
+/* Keeps a copy of the current flags for `previousUser`, unless NULL, then
+ * replaces them with any copy kept for `nextUser`. Users are identified by
+ * their serialization. Returns true if flags were replaced. Least recently
+ * used copies are discarded beyond the configured limits. */
+LDBoolean
+LDi_storeSwitchUser(
+    struct LDStore *const store,
+    const char *const     previousUser,
+    const char *const     nextUser);
+
 void
 LDi_storeFreeFlags(struct LDStore *const store);
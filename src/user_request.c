@@ -0,0 +1,115 @@
+#include <string.h>
+
+#include <launchdarkly/api.h>
+
+#include "ldinternal.h"
+#include "user_request.h"
+
+static void
+destroyUserRequest(void *const rawRequest)
+{
+    struct LDUserRequest *const request = rawRequest;
+
+    if (request) {
+        LDi_rc_destroy(&request->rc);
+        LDFree(request->json);
+        LDFree(request->encoded);
+        LDFree(request);
+    }
+}
+
+struct LDUserRequest *
+LDi_newUserRequest(const struct LDUser *const user)
+{
+    struct LDUserRequest *request;
+    size_t                encodedLength;
+
+    LD_ASSERT(user);
+
+    if (!(request = LDAlloc(sizeof(*request)))) {
+        LD_LOG(LD_LOG_CRITICAL, "no memory for user request");
+
+        return NULL;
+    }
+
+    memset(request, 0, sizeof(*request));
+
+    if (!(request->json = LDi_serializeUser(user))) {
+        LD_LOG(LD_LOG_CRITICAL, "failed to serialize user");
+
+        goto error;
+    }
+
+    if (!(request->encoded = (char *)LDi_base64_encode(
+              (unsigned char *)request->json,
+              strlen(request->json),
+              &encodedLength)))
+    {
+        LD_LOG(LD_LOG_CRITICAL, "LDi_base64_encode == NULL");
+
+        goto error;
+    }
+
+    if (!LDi_rc_initialize(&request->rc, request, destroyUserRequest)) {
+        goto error;
+    }
+
+    return request;
+
+error:
+    LDFree(request->json);
+    LDFree(request->encoded);
+    LDFree(request);
+
+    return NULL;
+}
+
+void
+LDi_userRequestRetain(struct LDUserRequest *const request)
+{
+    LD_ASSERT(request);
+
+    LDi_rc_increment(&request->rc);
+}
+
+void
+LDi_userRequestRelease(struct LDUserRequest *const request)
+{
+    if (request) {
+        LDi_rc_decrement(&request->rc);
+    }
+}
+
+struct LDUserRequest *
+LDi_acquireUserRequest(struct LDGlobal_i *const shared)
+{
+    struct LDUserRequest *request;
+
+    LD_ASSERT(shared);
+
+    LDi_mutex_lock(&shared->userRequestLock);
+
+    if ((request = shared->userRequest)) {
+        LDi_userRequestRetain(request);
+    }
+
+    LDi_mutex_unlock(&shared->userRequestLock);
+
+    return request;
+}
+
+void
+LDi_setUserRequest(
+    struct LDGlobal_i *const shared, struct LDUserRequest *const request)
+{
+    struct LDUserRequest *previous;
+
+    LD_ASSERT(shared);
+
+    LDi_mutex_lock(&shared->userRequestLock);
+    previous            = shared->userRequest;
+    shared->userRequest = request;
+    LDi_mutex_unlock(&shared->userRequestLock);
+
+    LDi_userRequestRelease(previous);
+}
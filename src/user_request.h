@@ -0,0 +1,39 @@
+#pragma once
+
+#include <launchdarkly/boolean.h>
+
+#include "reference_count.h"
+#include "user.h"
+
+struct LDGlobal_i;
+
+/* The form of a user sent to LaunchDarkly when requesting flags. Built once
+ * per identify and shared by every environment. Immutable once built. */
+struct LDUserRequest
+{
+    struct ld_rc_t rc;
+    /* serialized user, used as the REPORT body */
+    char *json;
+    /* base64 of json, used as the final path segment for GET */
+    char *encoded;
+};
+
+/* Returns NULL on failure. The result holds a single reference. */
+struct LDUserRequest *
+LDi_newUserRequest(const struct LDUser *const user);
+
+void
+LDi_userRequestRetain(struct LDUserRequest *const request);
+
+void
+LDi_userRequestRelease(struct LDUserRequest *const request);
+
+/* Returns a new reference to the current user request, or NULL if there is
+ * none. Does not take any user locks. */
+struct LDUserRequest *
+LDi_acquireUserRequest(struct LDGlobal_i *const shared);
+
+/* Replaces the current user request, taking ownership of the reference */
+void
+LDi_setUserRequest(
+    struct LDGlobal_i *const shared, struct LDUserRequest *const request);
@@ -0,0 +1,191 @@
+#include <launchdarkly/api.h>
+
+#include "assertion.h"
+#include "utility.h"
+#include "value_pool.h"
+
+/* pruning is not worth it below this many values */
+#define LD_POOL_MIN_PRUNE 64
+
+LDBoolean
+LDi_valuePoolInitialize(struct LDValuePool *const pool)
+{
+    LD_ASSERT(pool);
+
+    if (!LDi_mutex_init(&pool->lock)) {
+        return LDBooleanFalse;
+    }
+
+    pool->values  = NULL;
+    pool->count   = 0;
+    pool->pruneAt = LD_POOL_MIN_PRUNE;
+
+    return LDBooleanTrue;
+}
+
+static void
+LDi_freePooledValue(struct LDPooledValue *const entry)
+{
+    LDi_releaseJSON(entry->value);
+    LDFree(entry);
+}
+
+void
+LDi_valuePoolDestroy(struct LDValuePool *const pool)
+{
+    struct LDPooledValue *head, *tmp, *entry, *next;
+
+    if (pool) {
+        HASH_ITER(hh, pool->values, head, tmp)
+        {
+            HASH_DEL(pool->values, head);
+
+            for (entry = head; entry; entry = next) {
+                next = entry->next;
+
+                LDi_freePooledValue(entry);
+            }
+        }
+
+        pool->count = 0;
+
+        LDi_mutex_destroy(&pool->lock);
+    }
+}
+
+/* Expects the lock */
+static void
+LDi_valuePoolPruneLocked(struct LDValuePool *const pool)
+{
+    struct LDPooledValue *head, *tmp, *entry, **link, *kept;
+
+    kept = NULL;
+
+    /* survivors move to a new table, as one may replace its removed head */
+    HASH_ITER(hh, pool->values, head, tmp)
+    {
+        HASH_DEL(pool->values, head);
+
+        link = &head;
+
+        while ((entry = *link)) {
+            /* nothing can take another handle while the lock is held */
+            if (LDi_sharedJSONReferences(entry->value) == 1) {
+                *link = entry->next;
+
+                LDi_freePooledValue(entry);
+
+                pool->count--;
+            } else {
+                link = &entry->next;
+            }
+        }
+
+        if (head) {
+            HASH_ADD(hh, kept, hash, sizeof(head->hash), head);
+        }
+    }
+
+    pool->values  = kept;
+    pool->pruneAt = pool->count * 2;
+
+    if (pool->pruneAt < LD_POOL_MIN_PRUNE) {
+        pool->pruneAt = LD_POOL_MIN_PRUNE;
+    }
+}
+
+struct LDJSON *
+LDi_valuePoolIntern(
+    struct LDValuePool *const pool,
+    struct LDJSON *const      value,
+    const unsigned long       hash)
+{
+    struct LDPooledValue *head, *entry;
+    struct LDJSON *       shared, *result;
+
+    LD_ASSERT(pool);
+    LD_ASSERT(value);
+
+    if (LDJSONGetType(value) == LDText) {
+        return value;
+    }
+
+    LDi_mutex_lock(&pool->lock);
+
+    HASH_FIND(hh, pool->values, &hash, sizeof(hash), head);
+
+    for (entry = head; entry; entry = entry->next) {
+        if (LDJSONCompare(entry->value, value)) {
+            result = LDi_acquireJSON(entry->value);
+
+            LDi_mutex_unlock(&pool->lock);
+
+            LDJSONFree(value);
+
+            return result;
+        }
+    }
+
+    if (!(shared = LDi_shareJSON(value))) {
+        LDi_mutex_unlock(&pool->lock);
+
+        return value;
+    }
+
+    if (!(entry = (struct LDPooledValue *)LDAlloc(sizeof(struct LDPooledValue))))
+    {
+        /* shared all the same, only not pooled */
+        LDi_mutex_unlock(&pool->lock);
+
+        return shared;
+    }
+
+    /* the embedded handle serves both, the temporary one is not needed */
+    entry->value = LDi_acquireJSON(shared);
+    result       = LDi_acquireJSON(shared);
+
+    LDJSONFree(shared);
+
+    entry->hash = hash;
+
+    if (head) {
+        entry->next = head->next;
+        head->next  = entry;
+    } else {
+        entry->next = NULL;
+
+        HASH_ADD(hh, pool->values, hash, sizeof(entry->hash), entry);
+    }
+
+    if (++pool->count >= pool->pruneAt) {
+        LDi_valuePoolPruneLocked(pool);
+    }
+
+    LDi_mutex_unlock(&pool->lock);
+
+    return result;
+}
+
+void
+LDi_valuePoolPrune(struct LDValuePool *const pool)
+{
+    LD_ASSERT(pool);
+
+    LDi_mutex_lock(&pool->lock);
+    LDi_valuePoolPruneLocked(pool);
+    LDi_mutex_unlock(&pool->lock);
+}
+
+unsigned int
+LDi_valuePoolCount(struct LDValuePool *const pool)
+{
+    unsigned int count;
+
+    LD_ASSERT(pool);
+
+    LDi_mutex_lock(&pool->lock);
+    count = pool->count;
+    LDi_mutex_unlock(&pool->lock);
+
+    return count;
+}
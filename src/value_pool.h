@@ -0,0 +1,56 @@
+#pragma once
+
+#include <launchdarkly/boolean.h>
+#include <launchdarkly/json.h>
+
+#include "concurrency.h"
+#include "uthash.h"
+
+/* Interns flag values, so that flags holding equal values share a single
+ * tree. Most environments repeat a handful of values across many flags and
+ * every put repeats all of them again. Pooled values are held by their
+ * embedded handle, so holding one costs no allocation at all. Text is not
+ * pooled, having nowhere to keep a handle. */
+
+struct LDPooledValue
+{
+    unsigned long         hash;
+    /* from LDi_acquireJSON, the pool holds a reference */
+    struct LDJSON *       value;
+    /* other values with the same hash, only the first is in the hash table */
+    struct LDPooledValue *next;
+    UT_hash_handle        hh;
+};
+
+struct LDValuePool
+{
+    struct LDPooledValue *values;
+    unsigned int          count;
+    /* values nothing else references are dropped once count reaches this */
+    unsigned int          pruneAt;
+    ld_mutex_t            lock;
+};
+
+LDBoolean
+LDi_valuePoolInitialize(struct LDValuePool *const pool);
+
+void
+LDi_valuePoolDestroy(struct LDValuePool *const pool);
+
+/* Takes ownership of `value`, with `hash` its LDi_hashJSON, and returns an
+ * equal value already pooled, or else pools it. The result is released with
+ * LDi_releaseJSON. Values that cannot be pooled, including on allocation
+ * failure, are returned as they are or as a plain handle. Safe from any
+ * thread. */
+struct LDJSON *
+LDi_valuePoolIntern(
+    struct LDValuePool *const pool,
+    struct LDJSON *const      value,
+    const unsigned long       hash);
+
+/* Drops the values no longer held by anything but the pool */
+void
+LDi_valuePoolPrune(struct LDValuePool *const pool);
+
+unsigned int
+LDi_valuePoolCount(struct LDValuePool *const pool);
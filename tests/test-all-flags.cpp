@@ -39,6 +39,7 @@ TEST_F(AllFlagsWithClientFixture, BasicAllFlags) {
 
     flag.key = LDStrDup("test");
     flag.value = LDNewText("alice");
+    flag.valueHash = 0;
     flag.version = 2;
     flag.variation = 3;
     flag.trackEvents = LDBooleanFalse;
@@ -79,6 +80,7 @@ TEST_F(AllFlagsWithClientFixture, AllFlagsDeletedFlag) {
 
     flag.key = LDStrDup("test");
     flag.value = LDNewText("alice");
+    flag.valueHash = 0;
     flag.version = 2;
     flag.variation = 3;
     flag.trackEvents = LDBooleanFalse;
@@ -89,6 +91,7 @@ TEST_F(AllFlagsWithClientFixture, AllFlagsDeletedFlag) {
 
     flagDeleted.key = LDStrDup("test2");
     flagDeleted.value = NULL; //Note this is different than a JSON value of null.
+    flagDeleted.valueHash = 0;
     flagDeleted.version = 2;
     flagDeleted.variation = 0;
     flagDeleted.trackEvents = LDBooleanFalse;
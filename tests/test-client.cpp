@@ -1,5 +1,7 @@
 #include "gtest/gtest.h"
 #include "commonfixture.h"
+#include <cstdio>
+#include <thread>
 #include <unordered_map>
 #include "callback-spy.hpp"
 
@@ -8,6 +10,8 @@ extern "C" {
 #include "logging.h"
 
 #include "client.h"
+#include "ldinternal.h"
+#include "user_request.h"
 }
 
 // Inherit from the CommonFixture to give a reasonable name for the test output.
@@ -103,6 +107,7 @@ TEST_F(ClientFixture, SaveFlagsOmitsDeletedFlags) {
 
     flag.key = LDStrDup("test");
     flag.value = LDNewText("alice");
+    flag.valueHash = 0;
     flag.version = 2;
     flag.flagVersion = 10;
     flag.variation = 3;
@@ -114,6 +119,7 @@ TEST_F(ClientFixture, SaveFlagsOmitsDeletedFlags) {
 
     flagDeleted.key = LDStrDup("test2");
     flagDeleted.value = NULL; //Note this is different from a JSON value of null.
+    flagDeleted.valueHash = 0;
     flagDeleted.version = 2;
     flagDeleted.flagVersion = 0;
     flagDeleted.variation = 0;
@@ -146,3 +152,171 @@ TEST_F(ClientFixture, SaveFlagsOmitsDeletedFlags) {
     LDJSONFree(expectedJSON);
     LDJSONFree(actualJSON);
 }
+
+TEST_F(ClientFixture, IdentifyReplacesUserRequest) {
+    struct LDUser *user;
+    struct LDConfig *config;
+    struct LDClient *client;
+    struct LDUserRequest *before, *after;
+
+    ASSERT_TRUE(config = LDConfigNew("b"));
+    LDConfigSetOffline(config, LDBooleanTrue);
+    ASSERT_TRUE(user = LDUserNew("a"));
+    ASSERT_TRUE(client = LDClientInit(config, user, 0));
+
+    ASSERT_TRUE(before = LDi_acquireUserRequest(client->shared));
+    ASSERT_STREQ(before->json, "{\"key\":\"a\"}");
+    ASSERT_STREQ(before->encoded, "eyJrZXkiOiJhIn0=");
+
+    ASSERT_TRUE(user = LDUserNew("c"));
+    LDClientIdentify(client, user);
+
+    ASSERT_TRUE(after = LDi_acquireUserRequest(client->shared));
+    ASSERT_STREQ(after->json, "{\"key\":\"c\"}");
+
+    /* a request in flight keeps its user alive across identify */
+    ASSERT_STREQ(before->json, "{\"key\":\"a\"}");
+
+    LDi_userRequestRelease(before);
+    LDi_userRequestRelease(after);
+
+    LDClientClose(client);
+}
+
+TEST_F(ClientFixture, IdentifyKeepsServingFlagsUntilReplaced) {
+    struct LDUser *user;
+    struct LDConfig *config;
+    struct LDClient *client;
+    double latency;
+
+    ASSERT_TRUE(config = LDConfigNew("b"));
+    ASSERT_TRUE(user = LDUserNew("a"));
+    ASSERT_TRUE(client = LDClientInit(config, user, 0));
+
+    ASSERT_TRUE(LDi_onstreameventput(client, LDi_identifygeneration(client), "{}"));
+    ASSERT_TRUE(LDClientIsInitialized(client));
+    ASSERT_FALSE(LDClientGetIdentifyLatency(client, &latency));
+
+    ASSERT_TRUE(user = LDUserNew("c"));
+    LDClientIdentify(client, user);
+
+    /* no gap while the flags of the new user are fetched */
+    ASSERT_TRUE(LDClientIsInitialized(client));
+    ASSERT_TRUE(LDi_awaitingflags(client));
+    ASSERT_FALSE(LDClientGetIdentifyLatency(client, &latency));
+
+    ASSERT_TRUE(LDi_onstreameventput(client, LDi_identifygeneration(client), "{}"));
+    ASSERT_FALSE(LDi_awaitingflags(client));
+    ASSERT_TRUE(LDClientGetIdentifyLatency(client, &latency));
+    ASSERT_GE(latency, 0);
+
+    /* times out as nothing delivers the flags of this user */
+    ASSERT_TRUE(user = LDUserNew("d"));
+    ASSERT_FALSE(LDClientIdentifyAwait(client, user, 10));
+
+    LDClientClose(client);
+}
+
+TEST_F(ClientFixture, IdentifyAwaitIgnoresPutsOfPreviousUser) {
+    struct LDUser *user;
+    struct LDConfig *config;
+    struct LDClient *client;
+    unsigned int generation;
+    LDBoolean stored;
+    double latency;
+
+    ASSERT_TRUE(config = LDConfigNew("b"));
+    ASSERT_TRUE(user = LDUserNew("a"));
+    ASSERT_TRUE(client = LDClientInit(config, user, 0));
+
+    generation = LDi_identifygeneration(client);
+    ASSERT_TRUE(LDi_onstreameventput(client, generation, "{}"));
+
+    /* a put for the previous user, parsed while the identify runs */
+    std::thread late([&]() {
+        LDi_sleepMilliseconds(20);
+        stored = LDi_onstreameventput(client, generation, "{\"old\":{\"value\":true,\"version\":1}}");
+    });
+
+    ASSERT_TRUE(user = LDUserNew("c"));
+    ASSERT_FALSE(LDClientIdentifyAwait(client, user, 200));
+    late.join();
+
+    ASSERT_FALSE(stored);
+    ASSERT_TRUE(LDi_awaitingflags(client));
+    ASSERT_FALSE(LDClientGetIdentifyLatency(client, &latency));
+    ASSERT_FALSE(LDBoolVariation(client, "old", false));
+
+    ASSERT_TRUE(LDi_onstreameventput(client, LDi_identifygeneration(client), "{}"));
+    ASSERT_FALSE(LDi_awaitingflags(client));
+    ASSERT_TRUE(LDClientGetIdentifyLatency(client, &latency));
+
+    LDClientClose(client);
+}
+
+TEST_F(ClientFixture, FlagCacheRestoresPreviousRun) {
+    struct LDUser *user;
+    struct LDConfig *config;
+    struct LDClient *client;
+    struct LDUserRequest *request;
+    char *path;
+
+    ASSERT_TRUE(config = LDConfigNew("b"));
+    LDConfigSetOffline(config, LDBooleanTrue);
+    ASSERT_TRUE(LDConfigSetFlagCacheDirectory(config, "."));
+    ASSERT_TRUE(user = LDUserNew("a"));
+    ASSERT_TRUE(client = LDClientInit(config, user, 0));
+
+    ASSERT_FALSE(LDClientIsUsingCachedFlags(client));
+    ASSERT_TRUE(LDClientRestoreFlags(client, "{\"flag\":{\"value\":true,\"version\":1}}"));
+
+    /* written in the background */
+    LDi_notifierFlush(client->shared->persister);
+    LDClientClose(client);
+
+    ASSERT_TRUE(config = LDConfigNew("b"));
+    LDConfigSetOffline(config, LDBooleanTrue);
+    ASSERT_TRUE(LDConfigSetFlagCacheDirectory(config, "."));
+    ASSERT_TRUE(user = LDUserNew("a"));
+    ASSERT_TRUE(client = LDClientInit(config, user, 0));
+
+    ASSERT_TRUE(LDClientIsInitialized(client));
+    ASSERT_TRUE(LDClientIsUsingCachedFlags(client));
+    ASSERT_TRUE(LDBoolVariation(client, "flag", false));
+
+    /* the cache of one user is not used for another */
+    ASSERT_TRUE(user = LDUserNew("c"));
+    LDClientIdentify(client, user);
+    ASSERT_FALSE(LDClientIsInitialized(client));
+    ASSERT_FALSE(LDClientIsUsingCachedFlags(client));
+
+    LDi_notifierFlush(client->shared->persister);
+    ASSERT_TRUE(path = LDi_flagcachepath(client, client->shared->userRequest));
+    ASSERT_NE(std::remove(path), 0);
+    LDFree(path);
+
+    ASSERT_TRUE(user = LDUserNew("a"));
+    ASSERT_TRUE(request = LDi_newUserRequest(user));
+    ASSERT_TRUE(path = LDi_flagcachepath(client, request));
+
+    /* named by the 64-bit FNV-1a of the mobile key and the user */
+    {
+        const std::string identity = std::string("b\n") + request->json;
+        unsigned long long hash = 0xcbf29ce484222325ULL;
+        char expected[32];
+
+        for (const char c : identity) {
+            hash = (hash ^ (unsigned char)c) * 0x100000001b3ULL;
+        }
+
+        std::snprintf(expected, sizeof(expected), "./ld-%016llx.flags", hash);
+        ASSERT_STREQ(path, expected);
+    }
+
+    ASSERT_EQ(std::remove(path), 0);
+    LDFree(path);
+    LDi_userRequestRelease(request);
+    LDUserFree(user);
+
+    LDClientClose(client);
+}
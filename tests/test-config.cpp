@@ -95,5 +95,12 @@ TEST_F(ConfigFixture, Setters) {
     LDConfigSetInlineUsersInEvents(config, LDBooleanTrue);
     ASSERT_TRUE(config->inlineUsersInEvents);
 
+    /* respects minimum */
+    ASSERT_TRUE(LDConfigSetEventSpool(config, "/spool", 0));
+    ASSERT_EQ(config->eventSpoolMaxBytes, 256 * 1024);
+
+    ASSERT_TRUE(LDConfigSetEventSpool(config, "/spool", 1024 * 1024));
+    ASSERT_EQ(config->eventSpoolMaxBytes, 1024 * 1024);
+
     LDConfigFree(config);
 }
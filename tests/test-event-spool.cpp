@@ -0,0 +1,154 @@
+#include "gtest/gtest.h"
+#include "commonfixture.h"
+
+#include <string>
+
+extern "C" {
+#include <launchdarkly/api.h>
+
+#include "event_spool.h"
+#include "ldinternal.h"
+}
+
+// Inherit from the CommonFixture to give a reasonable name for the test output.
+// Any custom setup and teardown would happen in this derived class.
+class EventSpoolFixture : public CommonFixture {
+protected:
+    std::string key;
+
+    void SetUp() override {
+        CommonFixture::SetUp();
+
+        // each test gets its own segment files in the working directory
+        key = ::testing::UnitTest::GetInstance()->current_test_info()->name();
+    }
+
+    void TearDown() override {
+        struct LDEventSpool *spool;
+        char *payload, payloadId[LD_UUID_SIZE + 1];
+
+        // draining a spool removes its segment files
+        ASSERT_TRUE(spool = LDi_eventSpoolOpen(".", key.c_str(), 1024 * 1024));
+        while (LDi_eventSpoolPeek(spool, &payload, payloadId) && payload) {
+            LDFree(payload);
+            LDi_eventSpoolAck(spool);
+        }
+        LDi_eventSpoolFree(spool);
+
+        CommonFixture::TearDown();
+    }
+
+    static void expectNext(struct LDEventSpool *const spool,
+        const char *const expectedId, const char *const expectedPayload)
+    {
+        char *payload, payloadId[LD_UUID_SIZE + 1];
+
+        ASSERT_TRUE(LDi_eventSpoolPeek(spool, &payload, payloadId));
+        ASSERT_TRUE(payload);
+        ASSERT_STREQ(payloadId, expectedId);
+        ASSERT_STREQ(payload, expectedPayload);
+
+        LDFree(payload);
+        LDi_eventSpoolAck(spool);
+    }
+};
+
+static const char *const id1 = "00000000-0000-4000-8000-000000000001";
+static const char *const id2 = "00000000-0000-4000-8000-000000000002";
+static const char *const id3 = "00000000-0000-4000-8000-000000000003";
+
+TEST_F(EventSpoolFixture, EmptyPeek) {
+    struct LDEventSpool *spool;
+    char *payload, payloadId[LD_UUID_SIZE + 1];
+
+    ASSERT_TRUE(spool = LDi_eventSpoolOpen(".", key.c_str(), 1024 * 1024));
+    ASSERT_TRUE(LDi_eventSpoolIsEmpty(spool));
+    ASSERT_TRUE(LDi_eventSpoolPeek(spool, &payload, payloadId));
+    ASSERT_FALSE(payload);
+
+    LDi_eventSpoolFree(spool);
+}
+
+TEST_F(EventSpoolFixture, FirstInFirstOut) {
+    struct LDEventSpool *spool;
+
+    ASSERT_TRUE(spool = LDi_eventSpoolOpen(".", key.c_str(), 1024 * 1024));
+    ASSERT_TRUE(LDi_eventSpoolAppend(spool, id1, "[1]"));
+    ASSERT_TRUE(LDi_eventSpoolAppend(spool, id2, "[2]"));
+
+    expectNext(spool, id1, "[1]");
+
+    ASSERT_TRUE(LDi_eventSpoolAppend(spool, id3, "[3]"));
+
+    expectNext(spool, id2, "[2]");
+    expectNext(spool, id3, "[3]");
+
+    ASSERT_TRUE(LDi_eventSpoolIsEmpty(spool));
+
+    LDi_eventSpoolFree(spool);
+}
+
+TEST_F(EventSpoolFixture, PeekWithoutAckRepeats) {
+    struct LDEventSpool *spool;
+    char *payload, payloadId[LD_UUID_SIZE + 1];
+
+    ASSERT_TRUE(spool = LDi_eventSpoolOpen(".", key.c_str(), 1024 * 1024));
+    ASSERT_TRUE(LDi_eventSpoolAppend(spool, id1, "[1]"));
+
+    ASSERT_TRUE(LDi_eventSpoolPeek(spool, &payload, payloadId));
+    ASSERT_STREQ(payload, "[1]");
+    LDFree(payload);
+
+    expectNext(spool, id1, "[1]");
+
+    LDi_eventSpoolFree(spool);
+}
+
+TEST_F(EventSpoolFixture, SurvivesReopen) {
+    struct LDEventSpool *spool;
+
+    ASSERT_TRUE(spool = LDi_eventSpoolOpen(".", key.c_str(), 1024 * 1024));
+    ASSERT_TRUE(LDi_eventSpoolAppend(spool, id1, "[1]"));
+    ASSERT_TRUE(LDi_eventSpoolAppend(spool, id2, "[2]"));
+    LDi_eventSpoolFree(spool);
+
+    ASSERT_TRUE(spool = LDi_eventSpoolOpen(".", key.c_str(), 1024 * 1024));
+    ASSERT_FALSE(LDi_eventSpoolIsEmpty(spool));
+
+    expectNext(spool, id1, "[1]");
+    expectNext(spool, id2, "[2]");
+
+    LDi_eventSpoolFree(spool);
+}
+
+TEST_F(EventSpoolFixture, CapDiscardsOldest) {
+    struct LDEventSpool *spool;
+    char *payload, payloadId[LD_UUID_SIZE + 1];
+    std::string large(150, 'x');
+
+    // eight segments of 256 bytes, each holding a single payload
+    ASSERT_TRUE(spool = LDi_eventSpoolOpen(".", key.c_str(), 8 * 256));
+
+    for (int i = 0; i < 10; i++) {
+        large[0] = (char)('0' + i);
+        ASSERT_TRUE(LDi_eventSpoolAppend(spool, id1, large.c_str()));
+    }
+
+    ASSERT_TRUE(LDi_eventSpoolPeek(spool, &payload, payloadId));
+    ASSERT_TRUE(payload);
+    ASSERT_EQ(payload[0], '2');
+    LDFree(payload);
+
+    LDi_eventSpoolFree(spool);
+}
+
+TEST_F(EventSpoolFixture, RejectsOversizedPayload) {
+    struct LDEventSpool *spool;
+    std::string large(512, 'x');
+
+    ASSERT_TRUE(spool = LDi_eventSpoolOpen(".", key.c_str(), 8 * 256));
+    ASSERT_FALSE(LDi_eventSpoolAppend(spool, id1, large.c_str()));
+    ASSERT_TRUE(LDi_eventSpoolIsEmpty(spool));
+
+    LDi_eventSpoolFree(spool);
+}
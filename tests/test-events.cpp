@@ -8,8 +8,13 @@ extern "C" {
 
 #include "event_processor.h"
 #include "event_processor_internal.h"
+#include "ldnet.h"
 }
 
+#ifdef LAUNCHDARKLY_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
 // Inherit from the CommonFixture to give a reasonable name for the test output.
 // Any custom setup and teardown would happen in this derived class.
 class EventsFixture : public CommonFixture {
@@ -103,6 +108,7 @@ TEST_F(EventsWithClientFixture, BasicSummary) {
 
     flag.key = LDStrDup("test");
     flag.value = LDNewBool(LDBooleanTrue);
+    flag.valueHash = 0;
     flag.version = 2;
     flag.flagVersion = -1;
     flag.variation = 3;
@@ -202,6 +208,83 @@ TEST_F(EventsFixture, InlineUser) {
     LDClientClose(client);
 }
 
+TEST_F(EventsFixture, SharedEventUserOutlivesIdentify) {
+    struct LDConfig *config;
+    struct LDUser *first, *second;
+    struct LDClient *client;
+    struct LDJSON *payload, *expected, *privateAttributes;
+
+    ASSERT_TRUE(config = LDConfigNew("abc"));
+    LDConfigSetOffline(config, LDBooleanTrue);
+    LDConfigSetInlineUsersInEvents(config, LDBooleanTrue);
+    ASSERT_TRUE(privateAttributes = LDNewArray());
+    ASSERT_TRUE(LDArrayPush(privateAttributes, LDNewText("email")));
+    LDConfigSetPrivateAttributes(config, privateAttributes);
+
+    ASSERT_TRUE(first = LDUserNew("first"));
+    ASSERT_TRUE(LDUserSetEmail(first, "first@example.com"));
+    ASSERT_TRUE(LDUserSetName(first, "First"));
+    ASSERT_TRUE(second = LDUserNew("second"));
+
+    ASSERT_TRUE(client = LDClientInit(config, first, 0));
+
+    LDClientTrack(client, "before");
+    // frees the first user while an event for it is still queued
+    LDClientIdentify(client, second);
+    LDClientTrack(client, "after");
+
+    ASSERT_TRUE(LDi_bundleEventPayload(client->eventProcessor, &payload));
+    ASSERT_EQ(LDCollectionGetSize(payload), 4);
+
+    ASSERT_TRUE(expected = LDJSONDeserialize(
+        "{\"key\":\"first\",\"name\":\"First\","
+        "\"privateAttrs\":[\"email\"]}"));
+    ASSERT_TRUE(LDJSONCompare(
+        LDObjectLookup(LDArrayLookup(payload, 0), "user"), expected));
+    ASSERT_TRUE(LDJSONCompare(
+        LDObjectLookup(LDArrayLookup(payload, 1), "user"), expected));
+    LDJSONFree(expected);
+
+    ASSERT_TRUE(expected = LDJSONDeserialize("{\"key\":\"second\"}"));
+    ASSERT_TRUE(LDJSONCompare(
+        LDObjectLookup(LDArrayLookup(payload, 3), "user"), expected));
+    LDJSONFree(expected);
+
+    LDJSONFree(payload);
+    LDClientClose(client);
+}
+
+TEST_F(EventsFixture, EventUserHidesGlobalAndUserPrivateAttributes) {
+    struct LDUser *user;
+    struct LDJSON *names, *json, *expected;
+    struct LDPrivateAttribute *set;
+
+    ASSERT_TRUE(names = LDNewArray());
+    ASSERT_TRUE(LDArrayPush(names, LDNewText("email")));
+    ASSERT_TRUE(LDArrayPush(names, LDNewText("name")));
+    ASSERT_TRUE(LDi_newPrivateAttributes(&set, names));
+
+    ASSERT_TRUE(user = LDUserNew("user"));
+    ASSERT_TRUE(LDUserSetEmail(user, "user@example.com"));
+    ASSERT_TRUE(LDUserSetName(user, "User"));
+    ASSERT_TRUE(LDUserSetCountry(user, "NZ"));
+    ASSERT_TRUE(LDUserSetIP(user, "127.0.0.1"));
+    ASSERT_TRUE(LDUserAddPrivateAttribute(user, "name"));
+    ASSERT_TRUE(LDUserAddPrivateAttribute(user, "country"));
+
+    ASSERT_TRUE(json = LDi_createEventUser(user, LDBooleanFalse, set));
+    ASSERT_TRUE(expected = LDJSONDeserialize(
+        "{\"key\":\"user\",\"ip\":\"127.0.0.1\","
+        "\"privateAttrs\":[\"email\",\"name\",\"country\"]}"));
+    ASSERT_TRUE(LDJSONCompare(json, expected));
+
+    LDJSONFree(expected);
+    LDJSONFree(json);
+    LDi_freePrivateAttributes(&set);
+    LDJSONFree(names);
+    LDUserFree(user);
+}
+
 TEST_F(EventsFixture, OnlyUserKey) {
     struct LDConfig *config;
     struct LDUser *user;
@@ -265,6 +348,7 @@ TEST_F(EventsWithClientFixture, VariationSendsFeatureEventWithReasonIfTrackReaso
 
     flag.key = LDStrDup("flag");
     flag.value = LDNewBool(LDBooleanTrue);
+    flag.valueHash = 0;
     flag.version = 1000;
     flag.flagVersion = -1;
     flag.variation = 3;
@@ -304,6 +388,7 @@ TEST_F(EventsWithClientFixture, VariationSendsFeatureEventWithoutReasonIfTrackRe
 
     flag.key = LDStrDup("flag");
     flag.value = LDNewBool(LDBooleanTrue);
+    flag.valueHash = 0;
     flag.version = 1000;
     flag.flagVersion = -1;
     flag.variation = 3;
@@ -335,3 +420,33 @@ TEST_F(EventsWithClientFixture, VariationSendsFeatureEventWithoutReasonIfTrackRe
     LDJSONFree(expected);
     LDJSONFree(payload);
 }
+
+#ifdef LAUNCHDARKLY_HAVE_ZLIB
+TEST_F(EventsFixture, GzipRoundTrip) {
+    std::string payload;
+    size_t gzipSize;
+    char *gzipped, inflated[8192];
+    z_stream stream;
+
+    for (int i = 0; i < 100; i++) {
+        payload += "{\"kind\":\"custom\",\"key\":\"metric\"},";
+    }
+
+    ASSERT_TRUE(gzipped = LDi_gzip(payload.c_str(), payload.size(), &gzipSize));
+    ASSERT_LT(gzipSize, payload.size());
+
+    memset(&stream, 0, sizeof(stream));
+    ASSERT_EQ(inflateInit2(&stream, MAX_WBITS + 16), Z_OK);
+
+    stream.next_in = (Bytef *)gzipped;
+    stream.avail_in = (uInt)gzipSize;
+    stream.next_out = (Bytef *)inflated;
+    stream.avail_out = sizeof(inflated);
+
+    ASSERT_EQ(inflate(&stream, Z_FINISH), Z_STREAM_END);
+    ASSERT_EQ(std::string(inflated, stream.total_out), payload);
+
+    inflateEnd(&stream);
+    LDFree(gzipped);
+}
+#endif
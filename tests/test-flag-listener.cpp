@@ -1,5 +1,6 @@
 #include "gtest/gtest.h"
 #include "commonfixture.h"
+#include <algorithm>
 #include <unordered_map>
 #include "callback-spy.hpp"
 
@@ -83,6 +84,41 @@ TEST_F(ChangeListenerFixture, TestMultiDispatch) {
     ASSERT_EQ(FLAG_CALLS(testMultiDispatch2).size(), 1);
 }
 
+DEFINE_FLAG_CALLBACK(testRemoveKeeps1);
+DEFINE_FLAG_CALLBACK(testRemoveKeeps2);
+DEFINE_FLAG_CALLBACK(testRemoveKeeps3);
+
+TEST_F(ChangeListenerFixture, TestRemoveKeepsOtherListeners) {
+    struct ChangeListener *listeners;
+    LDlistenerfn *callbacks;
+    unsigned int count;
+    LDi_initListeners(&listeners);
+
+    ASSERT_TRUE(LDi_listenerAdd(&listeners, "flag1", testRemoveKeeps1));
+    ASSERT_TRUE(LDi_listenerAdd(&listeners, "flag1", testRemoveKeeps2));
+    ASSERT_TRUE(LDi_listenerAdd(&listeners, "flag1", testRemoveKeeps3));
+    ASSERT_TRUE(LDi_listenerAdd(&listeners, "flag2", testRemoveKeeps1));
+
+    LDi_listenerRemove(&listeners, "flag1", testRemoveKeeps2);
+    LDi_listenerRemove(&listeners, "flag2", testRemoveKeeps1);
+
+    ASSERT_FALSE(LDi_listenersWatch(listeners, "flag2"));
+    ASSERT_TRUE(LDi_listenersWatch(listeners, "flag1"));
+
+    // remaining callbacks stay in order of registration
+    ASSERT_TRUE(LDi_listenersCollect(listeners, "flag1", &callbacks, &count));
+    ASSERT_EQ(count, 2);
+    ASSERT_EQ(callbacks[0], testRemoveKeeps1);
+    ASSERT_EQ(callbacks[1], testRemoveKeeps3);
+    LDFree(callbacks);
+
+    LDi_listenersDispatch(listeners, "flag2", 0);
+    LDi_freeListeners(&listeners);
+
+    ASSERT_TRUE(FLAG_CALLS(testRemoveKeeps2).empty());
+    ASSERT_TRUE(FLAG_CALLS(testRemoveKeeps1).empty());
+}
+
 // Used for testing the higher-level LDRegister/Unregister listener API surface.
 class FlagListenerFixture : public CommonFixture {
 protected:
@@ -108,10 +144,23 @@ protected:
     }
 };
 
+static ld_atomic_int_t notifierBlocked;
+
+static void blockNotifier(void *const context, const char *const key, const int value) {
+    (void)context;
+    (void)key;
+    (void)value;
+
+    while (LDi_atomic_load(&notifierBlocked)) {
+        LDi_sleepMilliseconds(1);
+    }
+}
+
 static LDFlag makeFlag(const char* name) {
     struct LDFlag flag;
     flag.key = LDStrDup(name);
     flag.value = LDNewBool(LDBooleanTrue);
+    flag.valueHash = 0;
     flag.version = 2;
     flag.flagVersion = -1;
     flag.variation = 3;
@@ -137,7 +186,10 @@ TEST_F(FlagListenerFixture, TestListenerAddedReceivesCallbacks) {
     LDFlag flag = makeFlag("flag1");
 
     ASSERT_TRUE(LDi_storeUpsert(&client->store, flag));
-    ASSERT_TRUE(LDi_storeDelete(&client->store, flag.key, flag.version+1));
+    ASSERT_TRUE(LDi_storeDelete(&client->store, "flag1", flag.version+1));
+
+    // listeners are invoked on the notifier thread
+    LDi_notifierFlush(client->shared->notifier);
 
     LDClientUnregisterFeatureFlagListener(client, "flag1", listenerAdded);
 
@@ -161,10 +213,12 @@ TEST_F(FlagListenerFixture, TestListenerRemovedIgnoresCallback) {
 
     LDFlag flag = makeFlag("flag1");
     ASSERT_TRUE(LDi_storeUpsert(&client->store, flag));
+    LDi_notifierFlush(client->shared->notifier);
 
     LDClientUnregisterFeatureFlagListener(client, "flag1", listenerRemoved);
 
     ASSERT_TRUE(LDi_storeDelete(&client->store, "flag1", 2));
+    LDi_notifierFlush(client->shared->notifier);
 
     auto& calls = FLAG_CALLS(listenerRemoved);
 
@@ -186,6 +240,136 @@ TEST_F(FlagListenerFixture, TestListenerUniqueness) {
     ASSERT_TRUE(LDClientRegisterFeatureFlagListener(client, "flag1", enforceUniqueness));
 
     ASSERT_TRUE(LDi_storeUpsert(&client->store, makeFlag("flag1")));
+    LDi_notifierFlush(client->shared->notifier);
 
     ASSERT_EQ(FLAG_CALLS(enforceUniqueness).size(), 1);
 }
+
+DEFINE_FLAG_CALLBACK(coalesced);
+
+// Changes to a flag that are still pending delivery collapse into one
+// callback, while transitions between updated and deleted are all delivered.
+TEST_F(FlagListenerFixture, TestPendingChangesCoalesce) {
+    LDFlag flag;
+    int version;
+
+    ASSERT_TRUE(LDClientRegisterFeatureFlagListener(client, "flag1", coalesced));
+
+    // hold up the notifier so that the changes below stay pending
+    LDi_atomic_store(&notifierBlocked, 1);
+    ASSERT_TRUE(LDi_notify(client->shared->notifier, blockNotifier, NULL, NULL, 0));
+
+    for (version = 1; version <= 3; version++) {
+        flag = makeFlag("flag1");
+        flag.version = version;
+        ASSERT_TRUE(LDi_storeUpsert(&client->store, flag));
+    }
+
+    ASSERT_TRUE(LDi_storeDelete(&client->store, "flag1", 4));
+
+    flag = makeFlag("flag1");
+    flag.version = 5;
+    ASSERT_TRUE(LDi_storeUpsert(&client->store, flag));
+
+    LDi_atomic_store(&notifierBlocked, 0);
+    LDi_notifierFlush(client->shared->notifier);
+
+    auto& calls = FLAG_CALLS(coalesced);
+
+    ASSERT_EQ(calls.size(), 3);
+    ASSERT_EQ(calls.at(0).status, 0);
+    ASSERT_EQ(calls.at(1).status, 1);
+    ASSERT_EQ(calls.at(2).status, 0);
+}
+
+static void recordNotification(void *const context, const char *const key, const int value) {
+    (void)key;
+
+    static_cast<std::vector<int> *>(context)->push_back(value);
+}
+
+// Only notifications for the same callback, context, and key coalesce.
+TEST_F(FlagListenerFixture, TestPendingChangesCoalescePerContext) {
+    std::vector<int> first, second;
+
+    LDi_atomic_store(&notifierBlocked, 1);
+    ASSERT_TRUE(LDi_notify(client->shared->notifier, blockNotifier, NULL, NULL, 0));
+
+    ASSERT_TRUE(LDi_notify(client->shared->notifier, recordNotification, &first, "flag1", 0));
+    ASSERT_TRUE(LDi_notify(client->shared->notifier, recordNotification, &second, "flag1", 0));
+    ASSERT_TRUE(LDi_notify(client->shared->notifier, recordNotification, &first, "flag1", 0));
+    ASSERT_TRUE(LDi_notify(client->shared->notifier, recordNotification, &second, "flag1", 1));
+    ASSERT_TRUE(LDi_notify(client->shared->notifier, recordNotification, &first, "flag1", 1));
+    ASSERT_TRUE(LDi_notify(client->shared->notifier, recordNotification, &first, "flag2", 1));
+
+    LDi_atomic_store(&notifierBlocked, 0);
+    LDi_notifierFlush(client->shared->notifier);
+
+    ASSERT_EQ(first, std::vector<int>({0, 1, 1}));
+    ASSERT_EQ(second, std::vector<int>({0, 1}));
+}
+
+typedef std::vector<std::vector<std::pair<std::string, LDFlagChangeKind>>> changeSets;
+
+static void recordChangeSet(const struct LDFlagChange *const changes, const unsigned int changeCount,
+        void *const userData) {
+    std::vector<std::pair<std::string, LDFlagChangeKind>> set;
+
+    for (unsigned int i = 0; i < changeCount; i++) {
+        set.emplace_back(changes[i].flagKey, changes[i].kind);
+    }
+
+    std::sort(set.begin(), set.end());
+
+    static_cast<changeSets *>(userData)->push_back(set);
+}
+
+static void putFlags(struct LDStore *const store, std::vector<LDFlag> flags) {
+    struct LDFlag *array;
+
+    ASSERT_TRUE(array = (struct LDFlag *)LDAlloc(sizeof(struct LDFlag) * flags.size()));
+    std::copy(flags.begin(), flags.end(), array);
+
+    ASSERT_TRUE(LDi_storePut(store, array, flags.size()));
+}
+
+TEST_F(FlagListenerFixture, TestAllFlagsListenerReceivesChangeSets) {
+    changeSets sets;
+    LDFlag updated;
+
+    ASSERT_TRUE(LDClientRegisterAllFlagsListener(client, recordChangeSet, &sets));
+
+    putFlags(&client->store, {makeFlag("flag1"), makeFlag("flag2"), makeFlag("flag3")});
+
+    // flag1 is unchanged, flag2 is updated, and flag3 is removed
+    updated = makeFlag("flag2");
+    updated.version = 3;
+    putFlags(&client->store, {makeFlag("flag1"), updated});
+
+    // an identical put is not reported at all
+    updated = makeFlag("flag2");
+    updated.version = 3;
+    putFlags(&client->store, {makeFlag("flag1"), updated});
+
+    ASSERT_TRUE(LDi_storeDelete(&client->store, "flag1", 3));
+
+    LDi_notifierFlush(client->shared->notifier);
+    LDClientUnregisterAllFlagsListener(client, recordChangeSet);
+
+    ASSERT_TRUE(LDi_storeDelete(&client->store, "flag2", 4));
+    LDi_notifierFlush(client->shared->notifier);
+
+    ASSERT_EQ(sets.size(), 3);
+
+    ASSERT_EQ(sets[0].size(), 3);
+    EXPECT_EQ(sets[0][0], std::make_pair(std::string("flag1"), LDFlagAdded));
+    EXPECT_EQ(sets[0][1], std::make_pair(std::string("flag2"), LDFlagAdded));
+    EXPECT_EQ(sets[0][2], std::make_pair(std::string("flag3"), LDFlagAdded));
+
+    ASSERT_EQ(sets[1].size(), 2);
+    EXPECT_EQ(sets[1][0], std::make_pair(std::string("flag2"), LDFlagUpdated));
+    EXPECT_EQ(sets[1][1], std::make_pair(std::string("flag3"), LDFlagDeleted));
+
+    ASSERT_EQ(sets[2].size(), 1);
+    EXPECT_EQ(sets[2][0], std::make_pair(std::string("flag1"), LDFlagDeleted));
+}
@@ -45,3 +45,43 @@ TEST_F(FlagFixture, ParseAndSerializeAllFields) {
     LDJSONFree(flagJSON2);
     LDi_flag_destroy(&flag);
 }
+
+TEST_F(FlagFixture, TakeMovesMembersOutOfPayload) {
+    struct LDFlag flag;
+    struct LDJSON *payload, *expected;
+
+    ASSERT_TRUE(payload = LDJSONDeserialize(
+        "{\"key\":\"a\",\"value\":{\"b\":[1,2]},\"version\":3,"
+        "\"reason\":{\"kind\":\"OFF\"}}"));
+
+    ASSERT_TRUE(LDi_flag_take(&flag, payload));
+
+    ASSERT_STREQ(flag.key, "a");
+    ASSERT_EQ(flag.version, 3);
+    ASSERT_FALSE(LDObjectLookup(payload, "value"));
+    ASSERT_FALSE(LDObjectLookup(payload, "reason"));
+
+    ASSERT_TRUE(expected = LDJSONDeserialize("{\"b\":[1,2]}"));
+    ASSERT_TRUE(LDJSONCompare(flag.value, expected));
+    LDJSONFree(expected);
+
+    ASSERT_TRUE(expected = LDJSONDeserialize("{\"kind\":\"OFF\"}"));
+    ASSERT_TRUE(LDJSONCompare(flag.reason, expected));
+    LDJSONFree(expected);
+
+    LDJSONFree(payload);
+    LDi_flag_destroy(&flag);
+}
+
+TEST_F(FlagFixture, TakeLeavesNothingBehindOnFailure) {
+    struct LDFlag flag;
+    struct LDJSON *payload;
+
+    /* the value is taken before the missing version is noticed */
+    ASSERT_TRUE(payload = LDJSONDeserialize(
+        "{\"key\":\"a\",\"value\":[1,2,3]}"));
+
+    ASSERT_FALSE(LDi_flag_take(&flag, payload));
+
+    LDJSONFree(payload);
+}
@@ -1,6 +1,11 @@
 #include "gtest/gtest.h"
 
+extern "C" {
+#include <launchdarkly/api.h>
+}
+
 int main(int argc, char **argv) {
     ::testing::InitGoogleTest(&argc, argv);
+    LDGlobalInit();
     return RUN_ALL_TESTS();
 }
@@ -43,3 +43,47 @@ TEST_F(MiscFixture, StreamBackoff) {
     ASSERT_LE(delay, 30 * 1000);
     ASSERT_GE(delay, 15 * 1000);
 }
+
+TEST_F(MiscFixture, SharedJSONOutlivesFirstHandle) {
+    struct LDJSON *original, *shared, *retained, *container, *copy;
+    char *serialized;
+
+    ASSERT_TRUE(original = LDJSONDeserialize("{\"a\":[1,{\"b\":true}]}"));
+    ASSERT_TRUE(shared = LDi_shareJSON(original));
+    ASSERT_TRUE(LDi_isSharedJSON(shared));
+
+    ASSERT_TRUE(retained = LDi_retainJSON(shared));
+    ASSERT_TRUE(LDi_isSharedJSON(retained));
+
+    ASSERT_TRUE(container = LDNewObject());
+    ASSERT_TRUE(LDObjectSetKey(container, "value", retained));
+
+    LDJSONFree(shared);
+
+    ASSERT_TRUE(serialized = LDJSONSerialize(container));
+    ASSERT_STREQ(serialized, "{\"value\":{\"a\":[1,{\"b\":true}]}}");
+    LDFree(serialized);
+
+    /* a duplicate is an ordinary owned value */
+    ASSERT_TRUE(copy = LDJSONDuplicate(LDObjectLookup(container, "value")));
+    ASSERT_FALSE(LDi_isSharedJSON(copy));
+    ASSERT_TRUE(LDJSONCompare(copy, LDObjectLookup(container, "value")));
+
+    LDJSONFree(container);
+    LDJSONFree(copy);
+}
+
+TEST_F(MiscFixture, SharingTextReturnsItAsItIs) {
+    struct LDJSON *text, *retained;
+
+    ASSERT_TRUE(text = LDNewText("a"));
+    ASSERT_EQ(LDi_shareJSON(text), text);
+    ASSERT_FALSE(LDi_isSharedJSON(text));
+
+    ASSERT_TRUE(retained = LDi_retainJSON(text));
+    ASSERT_NE(retained, text);
+    ASSERT_STREQ(LDGetText(retained), "a");
+
+    LDJSONFree(text);
+    LDJSONFree(retained);
+}
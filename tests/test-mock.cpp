@@ -48,6 +48,7 @@ makeMinimalFlag(const char *const key, struct LDJSON *const value) {
 
     flag.key = (char *) key;
     flag.value = value;
+    flag.valueHash = 0;
     flag.version = 3;
     flag.flagVersion = 4;
     flag.variation = 2;
@@ -234,3 +235,237 @@ TEST_F(MockFixture, BasicStream) {
     LDi_closeSocket(acceptFD);
     LDi_thread_join(&thread);
 }
+
+TEST_F(MockFixture, NetworkRuntimePoll) {
+    ld_thread_t thread;
+    struct LDConfig *config;
+    struct LDClient *client;
+    struct LDUser *user;
+    char pollURL[1024];
+
+    LDi_listenOnRandomPort(&acceptFD, &acceptPort);
+    LDi_thread_create(&thread, testBasicPoll_thread, NULL);
+
+    ASSERT_GT(snprintf(pollURL, 1024, "http://127.0.0.1:%d", acceptPort), 0);
+
+    ASSERT_TRUE(config = LDConfigNew("key"));
+    LDConfigSetStreaming(config, LDBooleanFalse);
+    LDConfigSetAppURI(config, pollURL);
+    LDConfigSetUseNetworkRuntime(config, LDBooleanTrue);
+
+    ASSERT_TRUE(user = LDUserNew("my-user"));
+    ASSERT_TRUE(client = LDClientInit(config, user, 1000 * 10));
+
+    ASSERT_TRUE(client->networkTask);
+    ASSERT_TRUE(LDBoolVariation(client, "flag1", LDBooleanFalse));
+
+    LDClientClose(client);
+    LDi_closeSocket(acceptFD);
+    LDi_thread_join(&thread);
+}
+
+TEST_F(MockFixture, NetworkRuntimeStream) {
+    ld_thread_t thread;
+    struct LDConfig *config;
+    struct LDClient *client;
+    struct LDUser *user;
+    char streamURL[1024];
+
+    LDi_listenOnRandomPort(&acceptFD, &acceptPort);
+    LDi_thread_create(&thread, testBasicStream_thread, NULL);
+
+    ASSERT_GT(snprintf(streamURL, 1024, "http://127.0.0.1:%d", acceptPort), 0);
+
+    ASSERT_TRUE(config = LDConfigNew("key"));
+    LDConfigSetStreamURI(config, streamURL);
+    LDConfigSetUseNetworkRuntime(config, LDBooleanTrue);
+
+    ASSERT_TRUE(user = LDUserNew("my-user"));
+    ASSERT_TRUE(client = LDClientInit(config, user, 1000 * 10));
+
+    ASSERT_TRUE(client->networkTask);
+    ASSERT_TRUE(LDBoolVariation(client, "flag1", LDBooleanFalse));
+
+    LDClientClose(client);
+    LDi_closeSocket(acceptFD);
+    LDi_thread_join(&thread);
+}
+
+static int conditionalPoll_listenerCalls;
+
+static void
+conditionalPoll_listener(const char *const flagKey, const int status) {
+    LD_ASSERT(flagKey);
+    (void)status;
+
+    conditionalPoll_listenerCalls++;
+}
+
+static THREAD_RETURN
+testConditionalPoll_thread(void *const unused) {
+    struct LDHTTPRequest request;
+    struct LDJSON *payload;
+    char *serialized;
+    int i;
+
+    LD_ASSERT(unused == NULL);
+
+    LD_ASSERT(payload = makeBasicPutBody());
+    LD_ASSERT(serialized = LDJSONSerialize(payload));
+
+    for (i = 0; i < 3; i++) {
+        struct LDJSON *ifNoneMatch;
+
+        LDHTTPRequestInit(&request);
+
+        LDi_readHTTPRequest(acceptFD, &request);
+
+        ifNoneMatch = LDObjectLookup(request.requestHeaders, "If-None-Match");
+
+        if (i == 0) {
+            LD_ASSERT(ifNoneMatch == NULL);
+
+            LDi_sendResponse(request.requestSocket, "200 OK",
+                "ETag: \"v1\"\r\n", serialized);
+        } else {
+            LD_ASSERT(ifNoneMatch);
+            LD_ASSERT(strcmp("\"v1\"", LDGetText(ifNoneMatch)) == 0);
+
+            LDi_sendResponse(request.requestSocket, "304 Not Modified",
+                "ETag: \"v1\"\r\n", NULL);
+        }
+
+        LDHTTPRequestDestroy(&request);
+    }
+
+    LDJSONFree(payload);
+    LDFree(serialized);
+
+    return THREAD_RETURN_DEFAULT;
+}
+
+TEST_F(MockFixture, ConditionalPoll) {
+    ld_thread_t thread;
+    struct LDConfig *config;
+    struct LDClient *client;
+    struct LDUser *user;
+    char pollURL[1024];
+
+    LDi_listenOnRandomPort(&acceptFD, &acceptPort);
+    LDi_thread_create(&thread, testConditionalPoll_thread, NULL);
+
+    ASSERT_GT(snprintf(pollURL, 1024, "http://127.0.0.1:%d", acceptPort), 0);
+
+    ASSERT_TRUE(config = LDConfigNew("key"));
+    LDConfigSetStreaming(config, LDBooleanFalse);
+    LDConfigSetAppURI(config, pollURL);
+    /* below the public minimum so the test polls repeatedly */
+    config->pollingIntervalMillis = 50;
+
+    ASSERT_TRUE(user = LDUserNew("my-user"));
+    ASSERT_TRUE(client = LDClientInit(config, user, 1000 * 10));
+
+    ASSERT_TRUE(LDBoolVariation(client, "flag1", LDBooleanFalse));
+
+    conditionalPoll_listenerCalls = 0;
+    ASSERT_TRUE(LDClientRegisterFeatureFlagListener(
+        client, "flag1", conditionalPoll_listener));
+
+    /* the server only returns once the first 304 has been processed */
+    LDi_thread_join(&thread);
+
+    ASSERT_EQ(conditionalPoll_listenerCalls, 0);
+    ASSERT_EQ(client->status, LDStatusInitialized);
+    ASSERT_TRUE(LDBoolVariation(client, "flag1", LDBooleanFalse));
+
+    LDClientClose(client);
+    LDi_closeSocket(acceptFD);
+}
+
+static int chunkedEvents_posts;
+static int chunkedEvents_maxBody;
+
+static THREAD_RETURN
+testChunkedEvents_thread(void *const unused) {
+    struct LDHTTPRequest request;
+    int events;
+
+    LD_ASSERT(unused == NULL);
+
+    chunkedEvents_posts = 0;
+    chunkedEvents_maxBody = 0;
+
+    /* the identify event followed by every tracked event */
+    for (events = 0; events < 11;) {
+        LDHTTPRequestInit(&request);
+
+        LDi_readHTTPRequest(acceptFD, &request);
+
+        if (strcmp("GET", request.requestMethod) == 0) {
+            testBasicPoll_sendResponse(request.requestSocket);
+        } else {
+            struct LDJSON *body;
+
+            LD_ASSERT(strcmp("POST", request.requestMethod) == 0);
+            LD_ASSERT(body = LDJSONDeserialize(request.requestBody));
+            LD_ASSERT(LDJSONGetType(body) == LDArray);
+
+            events += LDCollectionGetSize(body);
+
+            if (LDCollectionGetSize(body) > 1 &&
+                (int)strlen(request.requestBody) > chunkedEvents_maxBody)
+            {
+                chunkedEvents_maxBody = strlen(request.requestBody);
+            }
+
+            chunkedEvents_posts++;
+
+            LDJSONFree(body);
+
+            LDi_sendResponse(request.requestSocket, "202 Accepted", "", NULL);
+        }
+
+        LDHTTPRequestDestroy(&request);
+    }
+
+    return THREAD_RETURN_DEFAULT;
+}
+
+TEST_F(MockFixture, ChunkedEvents) {
+    ld_thread_t thread;
+    struct LDConfig *config;
+    struct LDClient *client;
+    struct LDUser *user;
+    char serverURL[1024];
+    int i;
+
+    LDi_listenOnRandomPort(&acceptFD, &acceptPort);
+    LDi_thread_create(&thread, testChunkedEvents_thread, NULL);
+
+    ASSERT_GT(snprintf(serverURL, 1024, "http://127.0.0.1:%d", acceptPort), 0);
+
+    ASSERT_TRUE(config = LDConfigNew("key"));
+    LDConfigSetStreaming(config, LDBooleanFalse);
+    LDConfigSetAppURI(config, serverURL);
+    LDConfigSetEventsURI(config, serverURL);
+    LDConfigSetUseNetworkRuntime(config, LDBooleanTrue);
+    LDConfigSetEventsMaxConcurrentRequests(config, 3);
+    LDConfigSetEventsMaxPayloadBytes(config, 400);
+
+    ASSERT_TRUE(user = LDUserNew("my-user"));
+    ASSERT_TRUE(client = LDClientInit(config, user, 1000 * 10));
+
+    for (i = 0; i < 10; i++) {
+        LDClientTrack(client, "metric");
+    }
+
+    LDClientFlush(client);
+
+    LDi_thread_join(&thread);
+
+    ASSERT_GT(chunkedEvents_posts, 1);
+    ASSERT_LE(chunkedEvents_maxBody, 400);
+
+    LDi_closeSocket(acceptFD);
+    LDClientClose(client);
+}
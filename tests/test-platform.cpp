@@ -5,6 +5,7 @@ extern "C" {
 #include <launchdarkly/api.h>
 
 #include "ldinternal.h"
+#include "slab.h"
 }
 
 // Inherit from the CommonFixture to give a reasonable name for the test output.
@@ -47,3 +48,138 @@ TEST_F(PlatformFixture, ConditionWaitTimeout) {
     LDi_cond_destroy(&condition);
     LDi_mutex_destroy(&lock);
 }
+
+TEST_F(PlatformFixture, AtomicInt) {
+    ld_atomic_int_t value;
+
+    LDi_atomic_store(&value, LDStatusInitializing);
+    ASSERT_EQ(LDi_atomic_load(&value), LDStatusInitializing);
+
+    ASSERT_EQ(LDi_atomic_exchange(&value, LDStatusFailed), LDStatusInitializing);
+    ASSERT_EQ(LDi_atomic_load(&value), LDStatusFailed);
+}
+
+struct EpochWriter {
+    struct ld_epoch_t epoch;
+    ld_atomic_int_t   synchronized;
+};
+
+static THREAD_RETURN
+synchronizeEpoch(void *const argument)
+{
+    struct EpochWriter *const writer = (struct EpochWriter *)argument;
+
+    LDi_epoch_synchronize(&writer->epoch);
+    LDi_atomic_store(&writer->synchronized, 1);
+
+    return THREAD_RETURN_DEFAULT;
+}
+
+TEST_F(PlatformFixture, EpochWaitsForReaders) {
+    struct EpochWriter writer;
+    ld_thread_t        thread;
+    ld_atomic_ptr_t    pointer;
+    int                token, value1 = 1, value2 = 2;
+
+    ASSERT_TRUE(LDi_epoch_init(&writer.epoch));
+    LDi_atomic_store(&writer.synchronized, 0);
+    LDi_atomic_store_ptr(&pointer, &value1);
+
+    // without readers synchronizing returns immediately
+    LDi_epoch_synchronize(&writer.epoch);
+
+    token = LDi_epoch_enter(&writer.epoch);
+    ASSERT_EQ(LDi_atomic_load_ptr(&pointer), &value1);
+
+    ASSERT_EQ(LDi_atomic_exchange_ptr(&pointer, &value2), &value1);
+    ASSERT_TRUE(LDi_thread_create(&thread, synchronizeEpoch, &writer));
+
+    LDi_sleepMilliseconds(50);
+    ASSERT_EQ(LDi_atomic_load(&writer.synchronized), 0);
+
+    LDi_epoch_exit(&writer.epoch, token);
+    ASSERT_TRUE(LDi_thread_join(&thread));
+    ASSERT_EQ(LDi_atomic_load(&writer.synchronized), 1);
+
+    LDi_epoch_destroy(&writer.epoch);
+}
+
+static struct LDSlabPool testBlocks = LD_SLAB_POOL(40);
+
+#ifdef LAUNCHDARKLY_SLAB_POOLS
+TEST_F(PlatformFixture, SlabReusesFreedBlocks) {
+    void *first, *second;
+
+    ASSERT_TRUE(first = LDi_slabAlloc(&testBlocks));
+    LDi_slabFree(&testBlocks, first);
+
+    ASSERT_TRUE(second = LDi_slabAlloc(&testBlocks));
+    ASSERT_EQ(first, second);
+    LDi_slabFree(&testBlocks, second);
+}
+#endif
+
+#define SLAB_BLOCKS 100
+
+struct SlabWorker {
+    unsigned char  id;
+    /* allocated by another thread, for this one to free */
+    unsigned char *foreign[SLAB_BLOCKS];
+    ld_atomic_int_t failed;
+};
+
+static THREAD_RETURN
+useSlab(void *const argument)
+{
+    struct SlabWorker *const worker = (struct SlabWorker *)argument;
+    unsigned char *blocks[SLAB_BLOCKS];
+    int round, i, j;
+
+    for (i = 0; i < SLAB_BLOCKS; i++) {
+        LDi_slabFree(&testBlocks, worker->foreign[i]);
+    }
+
+    for (round = 0; round < 200; round++) {
+        for (i = 0; i < SLAB_BLOCKS; i++) {
+            LD_ASSERT(blocks[i] = (unsigned char *)LDi_slabAlloc(&testBlocks));
+            memset(blocks[i], worker->id, 40);
+        }
+
+        for (i = 0; i < SLAB_BLOCKS; i++) {
+            for (j = 0; j < 40; j++) {
+                if (blocks[i][j] != worker->id) {
+                    LDi_atomic_store(&worker->failed, 1);
+                }
+            }
+
+            LDi_slabFree(&testBlocks, blocks[i]);
+        }
+    }
+
+    return THREAD_RETURN_DEFAULT;
+}
+
+TEST_F(PlatformFixture, SlabBlocksAreNeverShared) {
+    struct SlabWorker workers[4];
+    ld_thread_t       threads[4];
+    int               i, j;
+
+    for (i = 0; i < 4; i++) {
+        workers[i].id = (unsigned char)(i + 1);
+        LDi_atomic_store(&workers[i].failed, 0);
+
+        for (j = 0; j < SLAB_BLOCKS; j++) {
+            ASSERT_TRUE(workers[i].foreign[j] =
+                (unsigned char *)LDi_slabAlloc(&testBlocks));
+        }
+    }
+
+    for (i = 0; i < 4; i++) {
+        ASSERT_TRUE(LDi_thread_create(&threads[i], useSlab, &workers[i]));
+    }
+
+    for (i = 0; i < 4; i++) {
+        ASSERT_TRUE(LDi_thread_join(&threads[i]));
+        ASSERT_EQ(LDi_atomic_load(&workers[i].failed), 0);
+    }
+}
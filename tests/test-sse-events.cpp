@@ -1,6 +1,8 @@
 #include "gtest/gtest.h"
 #include "commonfixture.h"
 
+#include <string>
+
 extern "C" {
 #include <launchdarkly/api.h>
 
@@ -35,17 +37,17 @@ protected:
 };
 
 TEST_F(SSEFixture, InitialPut_EmptyObject_ShouldResultInitialized) {
-    ASSERT_TRUE(LDi_onstreameventput(client, "{}"));
+    ASSERT_TRUE(LDi_onstreameventput(client, LDi_identifygeneration(client), "{}"));
     ASSERT_EQ(client->status, LDStatusInitialized);
 }
 
 TEST_F(SSEFixture, InitialPut_MalformedData_EmptyString_ShouldRemainInitializing) {
-    ASSERT_FALSE(LDi_onstreameventput(client, ""));
+    ASSERT_FALSE(LDi_onstreameventput(client, LDi_identifygeneration(client), ""));
     ASSERT_EQ(client->status, LDStatusInitializing);
 }
 
 TEST_F(SSEFixture, InitialPut_MalformedData_InvalidObject_ShouldRemainInitializing) {
-    ASSERT_FALSE(LDi_onstreameventput(client, "{\"things\":{}}"));
+    ASSERT_FALSE(LDi_onstreameventput(client, LDi_identifygeneration(client), "{\"things\":{}}"));
     ASSERT_EQ(client->status, LDStatusInitializing);
 }
 
@@ -53,5 +55,47 @@ TEST_F(SSEFixture, InitialPut_MalformedData_InvalidObject_ShouldRemainInitializi
 // from JSON payload. If decoding fails, we must ensure that all memory of the previously parsed flag(s)
 // is freed. This test requires valgrind.
 TEST_F(SSEFixture, InitialPut_MalformedData_AllMemoryIsFreedIfInvalidFlagEncountered) {
-    ASSERT_FALSE(LDi_onstreameventput(client, "{\"valid_flag_json\":{\"key\":\"valid_flag\",\"value\":true,\"version\":2,\"variation\":3},\"invalid_flag_json\":{}}"));
+    ASSERT_FALSE(LDi_onstreameventput(client, LDi_identifygeneration(client), "{\"valid_flag_json\":{\"key\":\"valid_flag\",\"value\":true,\"version\":2,\"variation\":3},\"invalid_flag_json\":{}}"));
+}
+
+static std::string
+largePut(const int flagCount, const int invalidAt) {
+    std::string payload = "{";
+
+    for (int i = 0; i < flagCount; i++) {
+        const std::string key = "flag-" + std::to_string(i);
+
+        if (i > 0) {
+            payload += ",";
+        }
+
+        if (i == invalidAt) {
+            payload += "\"" + key + "\":{}";
+        } else {
+            payload += "\"" + key + "\":{\"value\":" + std::to_string(i) +
+                ",\"version\":1}";
+        }
+    }
+
+    return payload + "}";
+}
+
+TEST_F(SSEFixture, InitialPut_LargePayloadIsParsedInParallel) {
+    client->shared->sharedConfig->flagParseThreads = 4;
+
+    ASSERT_TRUE(LDi_onstreameventput(client, LDi_identifygeneration(client), largePut(10000, -1).c_str()));
+    ASSERT_EQ(client->status, LDStatusInitialized);
+    ASSERT_EQ(HASH_COUNT(client->store.flags), 10000);
+
+    ASSERT_EQ(LDIntVariation(client, "flag-0", -1), 0);
+    ASSERT_EQ(LDIntVariation(client, "flag-5000", -1), 5000);
+    ASSERT_EQ(LDIntVariation(client, "flag-9999", -1), 9999);
+}
+
+TEST_F(SSEFixture, InitialPut_LargePayloadFreesEveryRangeIfOneFails) {
+    client->shared->sharedConfig->flagParseThreads = 4;
+
+    ASSERT_FALSE(LDi_onstreameventput(client, LDi_identifygeneration(client), largePut(10000, 6000).c_str()));
+    ASSERT_EQ(client->status, LDStatusInitializing);
+    ASSERT_EQ(HASH_COUNT(client->store.flags), 0);
 }
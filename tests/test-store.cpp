@@ -1,6 +1,22 @@
 #include "gtest/gtest.h"
 #include "commonfixture.h"
 
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <unistd.h>
+#endif
+
 extern "C" {
 #include <launchdarkly/api.h>
 
@@ -12,6 +28,7 @@ extern "C" {
 class StoreFixture : public CommonFixture {
 protected:
     struct LDClient *client;
+    std::string directory;
 
     void SetUp() override {
         CommonFixture::SetUp();
@@ -28,9 +45,51 @@ protected:
     }
 
     void TearDown() override {
+        const char *const suffixes[] = {"", ".tmp", ".journal", ".journal.tmp"};
+
         LDClientClose(client);
+
+        if (!directory.empty()) {
+            for (const char *const suffix : suffixes) {
+                std::remove((cachePath() + suffix).c_str());
+            }
+
+#ifdef _WIN32
+            _rmdir(directory.c_str());
+#else
+            rmdir(directory.c_str());
+#endif
+        }
+
         CommonFixture::TearDown();
     }
+
+    /* A snapshot path in a directory of the test's own, which TearDown
+     * removes along with the snapshot and its journal however the test
+     * ends */
+    std::string cachePath() {
+        if (directory.empty()) {
+#ifdef _WIN32
+            char *const name = _tempnam(NULL, "ld-store-");
+
+            if (name && _mkdir(name) == 0) {
+                directory = name;
+            }
+
+            std::free(name);
+#else
+            const char *const base = std::getenv("TMPDIR");
+            std::string pattern = std::string(base ? base : "/tmp") + "/ld-store-XXXXXX";
+
+            if (mkdtemp(&pattern[0])) {
+                directory = pattern;
+            }
+#endif
+            EXPECT_FALSE(directory.empty());
+        }
+
+        return directory + "/flags.ldflags";
+    }
 };
 
 TEST_F(StoreFixture, RestoreAndSaveEmpty) {
@@ -48,6 +107,7 @@ TEST_F(StoreFixture, RestoreAndSaveBasic) {
 
     flag.key = LDStrDup("test");
     flag.value = LDNewBool(LDBooleanTrue);
+    flag.valueHash = 0;
     flag.version = 2;
     flag.flagVersion = -1;
     flag.variation = 3;
@@ -100,3 +160,769 @@ TEST_F(StoreFixture, EmptyDataSetShouldNotCauseAbort) {
     LDJSONFree(json);
     LDFree(jsonStr);
 }
+
+TEST_F(StoreFixture, RevisionOnlyChangesWithFlags) {
+    char *bundle;
+    unsigned int revision;
+    struct LDFlag flag;
+
+    flag.key = LDStrDup("test");
+    flag.value = LDNewBool(LDBooleanTrue);
+    flag.valueHash = 0;
+    flag.version = 2;
+    flag.flagVersion = -1;
+    flag.variation = 3;
+    flag.trackEvents = LDBooleanFalse;
+    flag.trackReason = LDBooleanFalse;
+    flag.reason = NULL;
+    flag.debugEventsUntilDate = 0;
+    flag.deleted = LDBooleanFalse;
+
+    revision = LDi_storeRevision(&client->store);
+    ASSERT_TRUE(LDi_storeUpsert(&client->store, flag));
+    ASSERT_NE(revision, LDi_storeRevision(&client->store));
+
+    ASSERT_TRUE(bundle = LDClientSaveFlags(client));
+
+    /* the first put initializes the store, which counts as a change */
+    ASSERT_TRUE(LDClientRestoreFlags(client, bundle));
+    revision = LDi_storeRevision(&client->store);
+
+    ASSERT_TRUE(LDClientRestoreFlags(client, bundle));
+    ASSERT_EQ(revision, LDi_storeRevision(&client->store));
+
+    /* a stale upsert is not a change */
+    flag.key = LDStrDup("test");
+    flag.value = LDNewBool(LDBooleanFalse);
+    ASSERT_TRUE(LDi_storeUpsert(&client->store, flag));
+    ASSERT_EQ(revision, LDi_storeRevision(&client->store));
+
+    flag.key = LDStrDup("test");
+    flag.value = LDNewBool(LDBooleanFalse);
+    flag.version = 3;
+    ASSERT_TRUE(LDi_storeUpsert(&client->store, flag));
+    ASSERT_NE(revision, LDi_storeRevision(&client->store));
+
+    revision = LDi_storeRevision(&client->store);
+    ASSERT_TRUE(LDClientRestoreFlags(client, bundle));
+    ASSERT_NE(revision, LDi_storeRevision(&client->store));
+
+    LDFree(bundle);
+}
+
+static bool
+storeHas(struct LDStore *const store, const char *const key) {
+    struct LDStoreNode *node;
+
+    if (!(node = LDi_storeGet(store, key))) {
+        return false;
+    }
+
+    LDi_rc_decrement(&node->rc);
+
+    return true;
+}
+
+TEST_F(StoreFixture, SwitchUserRestoresRecentFlags) {
+    struct LDStore *const store = &client->store;
+
+    store->snapshotsMaxCount = 2;
+    store->snapshotsMaxBytes = 1024 * 1024;
+
+    ASSERT_TRUE(LDClientRestoreFlags(client, "{\"a\":{\"value\":1,\"version\":1}}"));
+
+    /* nothing is kept for b yet, so the flags of a remain */
+    ASSERT_FALSE(LDi_storeSwitchUser(store, "a", "b"));
+    ASSERT_TRUE(storeHas(store, "a"));
+
+    ASSERT_TRUE(LDClientRestoreFlags(client, "{\"b\":{\"value\":2,\"version\":1}}"));
+
+    ASSERT_TRUE(LDi_storeSwitchUser(store, "b", "a"));
+    ASSERT_TRUE(storeHas(store, "a"));
+    ASSERT_FALSE(storeHas(store, "b"));
+
+    ASSERT_FALSE(LDi_storeSwitchUser(store, "a", "c"));
+    ASSERT_TRUE(LDClientRestoreFlags(client, "{\"c\":{\"value\":3,\"version\":1}}"));
+
+    /* keeping c discards b, the least recently used */
+    ASSERT_FALSE(LDi_storeSwitchUser(store, "c", "d"));
+    ASSERT_EQ(HASH_COUNT(store->snapshots), 2);
+    ASSERT_FALSE(LDi_storeSwitchUser(store, NULL, "b"));
+
+    ASSERT_TRUE(LDi_storeSwitchUser(store, NULL, "a"));
+    ASSERT_TRUE(storeHas(store, "a"));
+}
+
+TEST_F(StoreFixture, SwitchUserRespectsByteLimit) {
+    struct LDStore *const store = &client->store;
+
+    store->snapshotsMaxCount = 2;
+    store->snapshotsMaxBytes = 64;
+
+    ASSERT_TRUE(LDClientRestoreFlags(client, "{\"a\":{\"value\":1,\"version\":1}}"));
+
+    ASSERT_FALSE(LDi_storeSwitchUser(store, "a", "b"));
+    ASSERT_EQ(HASH_COUNT(store->snapshots), 0);
+    ASSERT_FALSE(LDi_storeSwitchUser(store, "b", "a"));
+}
+
+static const char *const imageFlags =
+    "{\"bool\":{\"value\":true,\"version\":2,\"variation\":1},"
+    "\"number\":{\"value\":3.5,\"version\":4,\"trackEvents\":true},"
+    "\"text\":{\"value\":\"hello\",\"version\":1},"
+    "\"object\":{\"value\":{\"a\":[1,2]},\"version\":7,"
+    "\"reason\":{\"kind\":\"FALLTHROUGH\"}}}";
+
+TEST_F(StoreFixture, SaveAndRestoreFlagsFile) {
+    const std::string path = cachePath();
+    char *before, *after;
+
+    ASSERT_TRUE(LDClientRestoreFlags(client, imageFlags));
+    ASSERT_TRUE(before = LDClientSaveFlags(client));
+    ASSERT_TRUE(LDClientSaveFlagsFile(client, path.c_str()));
+
+    LDi_storeFreeFlags(&client->store);
+    ASSERT_FALSE(storeHas(&client->store, "bool"));
+
+    ASSERT_TRUE(LDClientRestoreFlagsFile(client, path.c_str()));
+    ASSERT_TRUE(LDClientIsInitialized(client));
+
+    /* flags are decoded as they are evaluated */
+    ASSERT_TRUE(LDBoolVariation(client, "bool", false));
+    ASSERT_EQ(HASH_COUNT(client->store.flags), 1);
+    ASSERT_EQ(LDDoubleVariation(client, "number", 0), 3.5);
+    ASSERT_FALSE(storeHas(&client->store, "missing"));
+
+    ASSERT_TRUE(after = LDClientSaveFlags(client));
+
+    {
+        struct LDJSON *beforeJSON, *afterJSON;
+
+        ASSERT_TRUE(beforeJSON = LDJSONDeserialize(before));
+        ASSERT_TRUE(afterJSON = LDJSONDeserialize(after));
+        ASSERT_TRUE(LDJSONCompare(beforeJSON, afterJSON));
+
+        LDJSONFree(beforeJSON);
+        LDJSONFree(afterJSON);
+    }
+
+    LDFree(before);
+    LDFree(after);
+
+}
+
+TEST_F(StoreFixture, RestoredFlagsFileYieldsToUpdates) {
+    const std::string path = cachePath();
+    char *text;
+
+    ASSERT_TRUE(LDClientRestoreFlags(client, imageFlags));
+    ASSERT_TRUE(LDClientSaveFlagsFile(client, path.c_str()));
+    ASSERT_TRUE(LDClientRestoreFlagsFile(client, path.c_str()));
+
+    /* a stale patch loses against the snapshot, a newer one wins */
+    ASSERT_TRUE(LDi_storeDelete(&client->store, "text", 1));
+    ASSERT_TRUE(storeHas(&client->store, "text"));
+    ASSERT_TRUE(LDi_storeDelete(&client->store, "bool", 3));
+    ASSERT_FALSE(storeHas(&client->store, "bool"));
+
+    text = LDStringVariationAlloc(client, "text", "fallback");
+    ASSERT_STREQ(text, "hello");
+    LDFree(text);
+
+    /* a put replaces the snapshot entirely */
+    ASSERT_TRUE(LDClientRestoreFlags(client, "{\"text\":{\"value\":\"bye\",\"version\":2}}"));
+    ASSERT_FALSE(client->store.image);
+    ASSERT_FALSE(storeHas(&client->store, "number"));
+
+}
+
+TEST_F(StoreFixture, RestoreFlagsFileRejectsCorruption) {
+    const std::string path = cachePath();
+    FILE *handle;
+
+    ASSERT_FALSE(LDClientRestoreFlagsFile(client, path.c_str()));
+
+    ASSERT_TRUE(LDClientRestoreFlags(client, imageFlags));
+    ASSERT_TRUE(LDClientSaveFlagsFile(client, path.c_str()));
+
+    ASSERT_TRUE(handle = std::fopen(path.c_str(), "r+b"));
+    ASSERT_EQ(std::fseek(handle, -2, SEEK_END), 0);
+    ASSERT_NE(std::fputc('x', handle), EOF);
+    ASSERT_EQ(std::fclose(handle), 0);
+
+    ASSERT_FALSE(LDClientRestoreFlagsFile(client, path.c_str()));
+    ASSERT_TRUE(storeHas(&client->store, "bool"));
+
+}
+
+static void *failingAlloc(const size_t) { return NULL; }
+static void *failingRealloc(void *const, const size_t) { return NULL; }
+static char *failingStrDup(const char *const) { return NULL; }
+static void *failingCalloc(const size_t, const size_t) { return NULL; }
+static char *failingStrNDup(const char *const, const size_t) { return NULL; }
+
+static char *
+plainStrNDup(const char *const text, const size_t length) {
+    char *const result = (char *)std::malloc(length + 1);
+
+    if (result) {
+        std::memcpy(result, text, length);
+        result[length] = 0;
+    }
+
+    return result;
+}
+
+static char *
+plainStrDup(const char *const text) {
+    return plainStrNDup(text, std::strlen(text));
+}
+
+TEST_F(StoreFixture, SnapshotKeepsFlagsItFailsToMove) {
+    const std::string path = cachePath();
+    struct LDStoreNode **flags;
+    unsigned int flagCount, i;
+    LDBoolean read;
+
+    ASSERT_TRUE(LDClientRestoreFlags(client, imageFlags));
+    ASSERT_TRUE(LDClientSaveFlagsFile(client, path.c_str()));
+    ASSERT_TRUE(LDClientRestoreFlagsFile(client, path.c_str()));
+
+    LDSetMemoryRoutines(failingAlloc, std::free, failingRealloc,
+        failingStrDup, failingCalloc, failingStrNDup);
+
+    read = LDi_storeGetAll(&client->store, &flags, &flagCount);
+
+    LDSetMemoryRoutines(std::malloc, std::free, std::realloc, plainStrDup,
+        std::calloc, plainStrNDup);
+
+    ASSERT_FALSE(read);
+
+    ASSERT_TRUE(LDi_storeGetAll(&client->store, &flags, &flagCount));
+    ASSERT_EQ(flagCount, 4);
+
+    for (i = 0; i < flagCount; i++) {
+        LDi_rc_decrement(&flags[i]->rc);
+    }
+
+    LDFree(flags);
+
+}
+
+static void
+upsertText(
+    struct LDStore *const store,
+    const char *const     key,
+    const int             version,
+    const char *const     text)
+{
+    struct LDFlag flag;
+
+    flag.key                  = LDStrDup(key);
+    flag.value                = LDNewText(text);
+    flag.valueHash            = 0;
+    flag.version              = version;
+    flag.flagVersion          = -1;
+    flag.variation            = 0;
+    flag.trackEvents          = LDBooleanFalse;
+    flag.trackReason          = LDBooleanFalse;
+    flag.reason               = NULL;
+    flag.debugEventsUntilDate = 0;
+    flag.deleted              = LDBooleanFalse;
+
+    ASSERT_TRUE(LDi_storeUpsert(store, flag));
+}
+
+static long
+fileSize(const std::string &path) {
+    FILE *handle;
+    long size;
+
+    if (!(handle = std::fopen(path.c_str(), "rb"))) {
+        return -1;
+    }
+
+    std::fseek(handle, 0, SEEK_END);
+    size = std::ftell(handle);
+    std::fclose(handle);
+
+    return size;
+}
+
+TEST_F(StoreFixture, JournalReplaysUpdatesSinceSnapshot) {
+    const std::string path = cachePath();
+    const std::string journal = path + ".journal";
+    struct LDStore *const store = &client->store;
+    struct LDFlagImage *image;
+    long snapshotSize;
+
+    ASSERT_TRUE(LDi_storeSetCachePath(store, path.c_str()));
+    ASSERT_TRUE(LDClientRestoreFlags(client, imageFlags));
+    LDi_notifierFlush(client->shared->persister);
+
+    ASSERT_GT(snapshotSize = fileSize(path), 0);
+    ASSERT_EQ(fileSize(journal), -1);
+
+    /* updates leave the snapshot alone */
+    upsertText(store, "added", 1, "new");
+    ASSERT_TRUE(LDi_storeDelete(store, "text", 2));
+    LDi_notifierFlush(client->shared->persister);
+
+    ASSERT_EQ(fileSize(path), snapshotSize);
+    ASSERT_GT(fileSize(journal), 0);
+
+    LDi_storeFreeFlags(store);
+    ASSERT_FALSE(storeHas(store, "added"));
+
+    ASSERT_TRUE(image = LDi_flagImageOpen(path.c_str()));
+    LDi_storePutImage(store, image);
+    ASSERT_EQ(LDi_storeReplayJournal(store, path.c_str()), 2);
+
+    ASSERT_TRUE(storeHas(store, "added"));
+    ASSERT_FALSE(storeHas(store, "text"));
+    ASSERT_TRUE(storeHas(store, "bool"));
+
+    /* a put replaces the journal */
+    ASSERT_TRUE(LDClientRestoreFlags(client, imageFlags));
+    LDi_notifierFlush(client->shared->persister);
+
+    ASSERT_EQ(fileSize(journal), -1);
+
+}
+
+TEST_F(StoreFixture, JournalRepairsTornRecord) {
+    const std::string path = cachePath();
+    const std::string journal = path + ".journal";
+    struct LDStore *const store = &client->store;
+    struct LDFlagImage *image;
+    FILE *handle;
+
+    ASSERT_TRUE(LDi_storeSetCachePath(store, path.c_str()));
+    ASSERT_TRUE(LDClientRestoreFlags(client, imageFlags));
+    upsertText(store, "added", 1, "new");
+    LDi_notifierFlush(client->shared->persister);
+
+    /* as if the process died while appending */
+    ASSERT_TRUE(handle = std::fopen(journal.c_str(), "ab"));
+    ASSERT_GE(std::fputs("{\"key\":\"torn\",\"val", handle), 0);
+    ASSERT_EQ(std::fclose(handle), 0);
+
+    LDi_storeFreeFlags(store);
+    ASSERT_TRUE(image = LDi_flagImageOpen(path.c_str()));
+    LDi_storePutImage(store, image);
+    ASSERT_EQ(LDi_storeReplayJournal(store, path.c_str()), 1);
+
+    /* appended after the repair, so it is on a line of its own */
+    upsertText(store, "later", 1, "newer");
+    LDi_notifierFlush(client->shared->persister);
+
+    LDi_storeFreeFlags(store);
+    ASSERT_TRUE(image = LDi_flagImageOpen(path.c_str()));
+    LDi_storePutImage(store, image);
+    ASSERT_EQ(LDi_storeReplayJournal(store, path.c_str()), 2);
+
+    ASSERT_TRUE(storeHas(store, "added"));
+    ASSERT_TRUE(storeHas(store, "later"));
+    ASSERT_FALSE(storeHas(store, "torn"));
+
+}
+
+TEST_F(StoreFixture, JournalCompactsIntoSnapshot) {
+    const std::string path = cachePath();
+    const std::string journal = path + ".journal";
+    const std::string text(1024, 'x');
+    struct LDStore *const store = &client->store;
+    struct LDFlagImage *image;
+    unsigned int index;
+    int version;
+
+    ASSERT_TRUE(LDi_storeSetCachePath(store, path.c_str()));
+    ASSERT_TRUE(LDClientRestoreFlags(client, imageFlags));
+
+    /* each appended before the next, which would otherwise supersede it */
+    for (version = 2; version < 12; version++) {
+        upsertText(store, "text", version, text.c_str());
+        LDi_notifierFlush(client->shared->persister);
+    }
+
+    /* the journal never grows much past the snapshot */
+    ASSERT_LT(fileSize(journal), fileSize(path) + 2 * (long)text.size());
+
+    ASSERT_TRUE(image = LDi_flagImageOpen(path.c_str()));
+    ASSERT_TRUE(LDi_flagImageFind(image, "text", &index));
+    ASSERT_GT(LDi_flagImageVersion(image, index), 2);
+    LDi_flagImageClose(image);
+
+    LDi_storeFreeFlags(store);
+    ASSERT_TRUE(image = LDi_flagImageOpen(path.c_str()));
+    LDi_storePutImage(store, image);
+    LDi_storeReplayJournal(store, path.c_str());
+
+    {
+        struct LDStoreNode *node;
+
+        ASSERT_TRUE(node = LDi_storeGet(store, "text"));
+        ASSERT_EQ(node->flag.version, 11);
+        LDi_rc_decrement(&node->rc);
+    }
+
+}
+
+TEST_F(StoreFixture, EqualValuesArePooled) {
+    struct LDStore *const store = &client->store;
+    struct LDStoreNode *a, *b, *c;
+
+    ASSERT_TRUE(LDClientRestoreFlags(client,
+        "{\"a\":{\"value\":{\"x\":1,\"y\":[true]},\"version\":1},"
+        "\"b\":{\"value\":{\"y\":[true],\"x\":1},\"version\":1},"
+        "\"c\":{\"value\":{\"x\":2},\"version\":1}}"));
+
+    ASSERT_EQ(LDi_valuePoolCount(&store->values), 2);
+
+    ASSERT_TRUE(a = LDi_storeGet(store, "a"));
+    ASSERT_TRUE(b = LDi_storeGet(store, "b"));
+    ASSERT_TRUE(c = LDi_storeGet(store, "c"));
+
+    ASSERT_EQ(a->flag.valueHash, b->flag.valueHash);
+    ASSERT_NE(a->flag.valueHash, c->flag.valueHash);
+    /* the pool, a, and b */
+    ASSERT_EQ(LDi_sharedJSONReferences(a->flag.value), 3);
+
+    LDi_rc_decrement(&a->rc);
+    LDi_rc_decrement(&b->rc);
+    LDi_rc_decrement(&c->rc);
+
+    /* values no flag holds any longer leave the pool */
+    ASSERT_TRUE(LDClientRestoreFlags(client,
+        "{\"a\":{\"value\":{\"x\":2},\"version\":2}}"));
+
+    ASSERT_EQ(LDi_valuePoolCount(&store->values), 1);
+}
+
+static int valueChanges;
+
+static void
+countValueChanges(const char *const key, const int deleted) {
+    valueChanges++;
+}
+
+TEST_F(StoreFixture, PutNotifiesEveryFlagCarried) {
+    struct LDStore *const store = &client->store;
+
+    ASSERT_TRUE(LDClientRestoreFlags(client,
+        "{\"a\":{\"value\":{\"x\":1},\"version\":1},"
+        "\"b\":{\"value\":true,\"version\":1}}"));
+
+    ASSERT_TRUE(LDi_storeRegisterListener(store, "a", countValueChanges));
+    ASSERT_TRUE(LDi_storeRegisterListener(store, "b", countValueChanges));
+    ASSERT_TRUE(LDi_storeRegisterListener(store, "c", countValueChanges));
+
+    valueChanges = 0;
+
+    /* listeners hear of a put even if it leaves their value as it was */
+    ASSERT_TRUE(LDClientRestoreFlags(client,
+        "{\"a\":{\"value\":{\"x\":1},\"version\":2},"
+        "\"b\":{\"value\":true,\"version\":2}}"));
+    LDi_notifierFlush(client->shared->notifier);
+
+    ASSERT_EQ(valueChanges, 2);
+
+    valueChanges = 0;
+
+    ASSERT_TRUE(LDClientRestoreFlags(client,
+        "{\"a\":{\"value\":{\"x\":1},\"version\":3},"
+        "\"b\":{\"value\":false,\"version\":3},"
+        "\"c\":{\"value\":false,\"version\":1}}"));
+    LDi_notifierFlush(client->shared->notifier);
+
+    ASSERT_EQ(valueChanges, 3);
+}
+
+TEST_F(StoreFixture, HashIgnoresMemberOrder) {
+    struct LDJSON *left, *right, *other;
+
+    ASSERT_TRUE(left = LDJSONDeserialize("{\"a\":[1,2],\"b\":-0}"));
+    ASSERT_TRUE(right = LDJSONDeserialize("{\"b\":0,\"a\":[1,2]}"));
+    ASSERT_TRUE(other = LDJSONDeserialize("{\"b\":0,\"a\":[2,1]}"));
+
+    ASSERT_EQ(LDi_hashJSON(left), LDi_hashJSON(right));
+    ASSERT_NE(LDi_hashJSON(left), LDi_hashJSON(other));
+
+    LDJSONFree(left);
+    LDJSONFree(right);
+    LDJSONFree(other);
+}
+
+static const char *const lazyFlags =
+    "{\"big\":{\"value\":{\"config\":[\"aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa\","
+    "\"bbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbb\"],\"enabled\":true},\"version\":1},"
+    "\"other\":{\"value\":[\"cccccccccccccccccccccccccccccccc\","
+    "\"dddddddddddddddddddddddddddddddd\"],\"version\":1},"
+    "\"small\":{\"value\":{\"a\":1},\"version\":1}}";
+
+TEST_F(StoreFixture, LargeValuesDecodeWhenRead) {
+    struct LDStore *const store = &client->store;
+    struct LDStoreNode *node;
+    struct LDJSON *expected, *fallback, *value, *all;
+    char *serialized;
+
+    store->lazyMinBytes = 64;
+
+    ASSERT_TRUE(LDClientRestoreFlags(client, lazyFlags));
+
+    ASSERT_TRUE(node = LDi_storeGet(store, "big"));
+    ASSERT_TRUE(LDi_lazyJSONText(node->flag.value));
+    ASSERT_EQ(LDJSONGetType(node->flag.value), LDObject);
+    ASSERT_TRUE(serialized = LDJSONSerialize(node->flag.value));
+    ASSERT_STREQ(serialized, LDi_lazyJSONText(node->flag.value));
+    LDFree(serialized);
+    LDi_rc_decrement(&node->rc);
+
+    ASSERT_TRUE(node = LDi_storeGet(store, "small"));
+    ASSERT_FALSE(LDi_lazyJSONText(node->flag.value));
+    LDi_rc_decrement(&node->rc);
+
+    ASSERT_EQ(HASH_COUNT(store->decoded), 0);
+
+    ASSERT_TRUE(expected = LDJSONDeserialize(
+        "{\"enabled\":true,\"config\":[\"aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa\","
+        "\"bbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbb\"]}"));
+    ASSERT_TRUE(fallback = LDNewNull());
+
+    ASSERT_TRUE(value = LDJSONVariation(client, "big", fallback));
+    ASSERT_FALSE(LDi_lazyJSONText(value));
+    ASSERT_TRUE(LDJSONCompare(value, expected));
+    LDJSONFree(value);
+
+    ASSERT_EQ(HASH_COUNT(store->decoded), 1);
+
+    ASSERT_TRUE(all = LDAllFlags(client));
+    ASSERT_TRUE(LDJSONCompare(LDObjectLookup(all, "big"), expected));
+    ASSERT_EQ(LDJSONGetType(LDGetIter(LDObjectLookup(all, "other"))), LDText);
+    LDJSONFree(all);
+
+    /* a put replaces the node the decoded value belonged to */
+    ASSERT_TRUE(LDClientRestoreFlags(client, lazyFlags));
+    ASSERT_EQ(HASH_COUNT(store->decoded), 0);
+
+    LDJSONFree(expected);
+    LDJSONFree(fallback);
+}
+
+TEST_F(StoreFixture, UpsertDropsOnlyReplacedDecodedValue) {
+    struct LDStore *const store = &client->store;
+    struct LDJSON *fallback, *value;
+    struct LDStoreNode *node;
+    struct LDFlag flag;
+
+    store->lazyMinBytes = 64;
+
+    ASSERT_TRUE(LDClientRestoreFlags(client, lazyFlags));
+    ASSERT_TRUE(fallback = LDNewNull());
+
+    ASSERT_TRUE(value = LDJSONVariation(client, "big", fallback));
+    LDJSONFree(value);
+    ASSERT_TRUE(value = LDJSONVariation(client, "other", fallback));
+    LDJSONFree(value);
+
+    ASSERT_EQ(HASH_COUNT(store->decoded), 2);
+
+    flag.key = LDStrDup("other");
+    flag.value = LDNewBool(LDBooleanTrue);
+    flag.valueHash = 0;
+    flag.version = 2;
+    flag.flagVersion = -1;
+    flag.variation = 0;
+    flag.trackEvents = LDBooleanFalse;
+    flag.trackReason = LDBooleanFalse;
+    flag.reason = NULL;
+    flag.debugEventsUntilDate = 0;
+    flag.deleted = LDBooleanFalse;
+
+    ASSERT_TRUE(LDi_storeUpsert(store, flag));
+
+    /* the value of the flag left alone stays decoded */
+    ASSERT_EQ(HASH_COUNT(store->decoded), 1);
+
+    ASSERT_TRUE(node = LDi_storeGet(store, "big"));
+    ASSERT_EQ(store->decoded->node, node);
+    LDi_rc_decrement(&node->rc);
+
+    LDJSONFree(fallback);
+}
+
+TEST_F(StoreFixture, DecodedValuesAreEvicted) {
+    struct LDStore *const store = &client->store;
+    struct LDJSON *fallback, *value;
+    struct LDStoreNode *node;
+
+    store->lazyMinBytes    = 64;
+    store->decodedMaxBytes = 400;
+
+    ASSERT_TRUE(LDClientRestoreFlags(client, lazyFlags));
+    ASSERT_TRUE(fallback = LDNewNull());
+
+    ASSERT_TRUE(value = LDJSONVariation(client, "big", fallback));
+    LDJSONFree(value);
+    ASSERT_TRUE(value = LDJSONVariation(client, "other", fallback));
+    LDJSONFree(value);
+
+    /* only the latest fits */
+    ASSERT_EQ(HASH_COUNT(store->decoded), 1);
+    ASSERT_LE(store->decodedBytes, store->decodedMaxBytes);
+
+    ASSERT_TRUE(node = LDi_storeGet(store, "other"));
+    ASSERT_EQ(store->decoded->node, node);
+    LDi_rc_decrement(&node->rc);
+
+    /* and the evicted value decodes again */
+    ASSERT_TRUE(value = LDJSONVariation(client, "big", fallback));
+    ASSERT_EQ(LDJSONGetType(value), LDObject);
+    LDJSONFree(value);
+
+    LDJSONFree(fallback);
+}
+
+#ifdef __GLIBC__
+/* bytes held through LDAlloc, as glibc rounds them up */
+static std::atomic<long> heldBytes;
+
+static void *
+countingAlloc(const size_t bytes) {
+    void *const buffer = std::malloc(bytes);
+
+    if (buffer) {
+        heldBytes += malloc_usable_size(buffer);
+    }
+
+    return buffer;
+}
+
+static void
+countingFree(void *const buffer) {
+    if (buffer) {
+        heldBytes -= malloc_usable_size(buffer);
+    }
+
+    std::free(buffer);
+}
+
+static void *
+countingRealloc(void *const buffer, const size_t bytes) {
+    const long previous = buffer ? malloc_usable_size(buffer) : 0;
+    void *const result = std::realloc(buffer, bytes);
+
+    if (result) {
+        heldBytes += (long)malloc_usable_size(result) - previous;
+    }
+
+    return result;
+}
+
+static char *
+countingStrDup(const char *const text) {
+    char *const result = (char *)countingAlloc(std::strlen(text) + 1);
+
+    if (result) {
+        std::strcpy(result, text);
+    }
+
+    return result;
+}
+
+static void *
+countingCalloc(const size_t count, const size_t size) {
+    void *const buffer = std::calloc(count, size);
+
+    if (buffer) {
+        heldBytes += malloc_usable_size(buffer);
+    }
+
+    return buffer;
+}
+
+static char *
+countingStrNDup(const char *const text, const size_t length) {
+    char *const result = (char *)countingAlloc(length + 1);
+
+    if (result) {
+        std::memcpy(result, text, length);
+        result[length] = 0;
+    }
+
+    return result;
+}
+
+/* The memory a store holds per flag, for flags resembling those of a real
+ * environment */
+static void
+bytesPerFlag(const unsigned int flagCount, long *const bytes) {
+    struct LDStore store;
+    struct LDFlag *flags;
+    long before, after, freed;
+    unsigned int i;
+    char key[32];
+    LDBoolean put;
+
+    ASSERT_TRUE(LDi_storeInitialize(&store));
+
+    LDSetMemoryRoutines(countingAlloc, countingFree, countingRealloc,
+        countingStrDup, countingCalloc, countingStrNDup);
+
+    put = LDBooleanFalse;
+
+    if ((flags = (struct LDFlag *)LDAlloc(sizeof(struct LDFlag) * flagCount))) {
+        freed = malloc_usable_size(flags);
+
+        for (i = 0; i < flagCount; i++) {
+            std::snprintf(key, sizeof(key), "flag-%u", i);
+
+            flags[i].key                  = LDStrDup(key);
+            flags[i].value                = LDNewBool(i % 2);
+            flags[i].valueHash            = 0;
+            flags[i].version              = i;
+            flags[i].flagVersion          = i;
+            flags[i].variation            = i % 2;
+            flags[i].trackEvents          = LDBooleanFalse;
+            flags[i].trackReason          = LDBooleanFalse;
+            flags[i].reason               = LDJSONDeserialize("{\"kind\":\"FALLTHROUGH\"}");
+            flags[i].debugEventsUntilDate = 0;
+            flags[i].deleted              = LDBooleanFalse;
+
+            freed += malloc_usable_size(flags[i].key);
+        }
+
+        /* counted from here, as the JSON nodes the put frees stay pooled for
+         * reuse, while the keys and the array it frees are added back */
+        before = heldBytes;
+
+        put = LDi_storePut(&store, flags, flagCount);
+
+        after = heldBytes + freed;
+    }
+
+    LDi_storeDestroy(&store);
+
+    LDSetMemoryRoutines(std::malloc, std::free, std::realloc, strdup,
+        std::calloc, strndup);
+
+    ASSERT_TRUE(put);
+
+    *bytes = (after - before) / flagCount;
+}
+
+TEST_F(StoreFixture, FlagsAreCompact) {
+    long bytes;
+
+    if (sizeof(void *) == 8) {
+        ASSERT_LE(sizeof(struct LDFlag), 56);
+        ASSERT_LE(sizeof(struct LDStoreNode), 144);
+    }
+
+    /* the node and its key, and the hash table, as values are pooled */
+    ASSERT_NO_FATAL_FAILURE(bytesPerFlag(10000, &bytes));
+    ASSERT_LE(bytes, 200);
+    ASSERT_NO_FATAL_FAILURE(bytesPerFlag(100000, &bytes));
+    ASSERT_LE(bytes, 200);
+}
+#endif
@@ -101,6 +101,7 @@ TEST_F(VariationsWithClientFixture, JSONVariationDefault) {
 static LDFlag &fillFlag(LDJSON *const value, LDFlag &flag) {
     flag.key = LDStrDup("test");
     flag.value = value;
+    flag.valueHash = 0;
     flag.version = 2;
     flag.flagVersion = -1;
     flag.variation = 3;